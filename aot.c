@@ -0,0 +1,1089 @@
+#include "aot.h"
+#include "mod.h"
+#include "natives.h"
+
+#include <limits.h>
+#include <stdarg.h>
+
+SF_API obj_t *
+sf_aot_int (int v)
+{
+  obj_t *o
+      = sf_objstore_box (&(const_t){ .type = CONST_INT, .v.c_int.v = v });
+
+  IR (o);
+  return o;
+}
+
+SF_API obj_t *
+sf_aot_bool (int v)
+{
+  obj_t *o
+      = sf_objstore_box (&(const_t){ .type = CONST_BOOL, .v.c_bool.v = v });
+
+  IR (o);
+  return o;
+}
+
+/**
+ * Sets up the call at ip of argc args, as OP_CALL would, if the callee
+ * on top of the stack is the coded function at lp. Returns the callee
+ * for sf_aot_leave, NULL (with nothing touched) for any other.
+ */
+SF_API obj_t *
+sf_aot_enter (vm_t *vm, size_t ip, int argc, int b, size_t lp)
+{
+  obj_t *name = vm->stack[vm->sp - 1];
+
+  if (name == NULL || name->type != OBJ_FUNC)
+    return NULL;
+
+  fun_t *f = name->v.o_fun.v;
+
+  if (f->type != FUN_CODED || f->v.coded.lp != lp || f->argl != (size_t)argc)
+    return NULL;
+
+  vm->sp--;
+
+  /* OP_CALL pops the args and pushes them back in the order it got them */
+  obj_t **args = vm->stack + vm->sp - argc;
+
+  for (int i = 0; i < argc / 2; i++)
+    {
+      obj_t *t = args[i];
+      args[i] = args[argc - 1 - i];
+      args[argc - 1 - i] = t;
+    }
+
+  frame_t fr = sf_frame_new_local ();
+  fr.return_ip = ip;
+  fr.stack_base = vm->sp;
+  fr.pop_ret_val = b != 1;
+
+  sf_vm_addframe (vm, fr);
+  vm->ip = lp;
+
+  return name;
+}
+
+/* ends a call sf_aot_enter set up, after its code left with r */
+SF_API void
+sf_aot_leave (vm_t *vm, obj_t *name, int r)
+{
+  frame_t *fr = &vm->frames[vm->fp - 1];
+
+  /* the interpreter, or a tail call, goes on with the frame */
+  if (r == SF_VM_NEXT || r == SF_VM_TAIL)
+    sf_vm_exec_single_frame (vm);
+  else
+    {
+      if (fr->pop_ret_val)
+        {
+          obj_t *p = sf_aot_pop (vm);
+          if (p != NULL)
+            DR (p, vm);
+        }
+
+      vm->ip = fr->return_ip;
+    }
+
+  sf_vm_popframe (vm);
+  DR (name, vm);
+}
+
+/* hands local a, held in C, to the frame, which drops it when popped */
+SF_API void
+sf_aot_keep (vm_t *vm, int a, obj_t *o)
+{
+  frame_t *fr = &vm->frames[vm->fp - 1];
+
+  if (o == NULL)
+    return;
+
+  if ((size_t)a >= fr->l.locals_cap)
+    {
+      size_t cap = fr->l.locals_cap;
+
+      while ((size_t)a >= fr->l.locals_cap)
+        fr->l.locals_cap += SF_FRAME_LOCALS_CAP;
+
+      fr->l.locals = SFREALLOC (fr->l.locals,
+                                fr->l.locals_cap * sizeof (*fr->l.locals));
+
+      for (size_t j = cap; j < fr->l.locals_cap; j++)
+        fr->l.locals[j] = NULL;
+    }
+
+  if ((size_t)a >= fr->l.locals_count)
+    fr->l.locals_count = a + 1;
+
+  if (fr->l.locals[a] != NULL)
+    DR (fr->l.locals[a], vm);
+
+  fr->l.locals[a] = o;
+}
+
+/* runs a program sunflower-aot wrote, main() of the generated code */
+SF_API int
+sf_aot_main (const aot_prog_t *p)
+{
+  sf_objstore_init ();
+
+  vm_t vm = sf_vm_new ();
+  sf_natives_add_tovm (&vm);
+
+  if (vm.inst_len != 0 || vm.s_ml != 0)
+    {
+      fprintf (stderr, "sunflower-aot: VM starts with code of its own\n");
+      return 1;
+    }
+
+  vm.inst_cap = p->il + 1;
+  vm.insts = SFREALLOC (vm.insts, vm.inst_cap * sizeof (*vm.insts));
+  vm.inst_len = p->il;
+
+  for (size_t i = 0; i < p->il; i++)
+    {
+      vm.insts[i] = p->insts[i];
+      if (p->insts[i].c != NULL && p->insts[i].op != OP_RANGE_FAST)
+        vm.insts[i].c = SFSTRDUP (p->insts[i].c);
+    }
+
+  vm.s_mc = p->cl + 1;
+  vm.map_consts
+      = SFREALLOC (vm.map_consts, vm.s_mc * sizeof (*vm.map_consts));
+  vm.s_ml = p->cl;
+
+  for (size_t i = 0; i < p->cl; i++)
+    {
+      vm.map_consts[i] = p->consts[i];
+      if (p->consts[i].type == CONST_STRING)
+        vm.map_consts[i].v.c_str.v = SFSTRDUP (p->consts[i].v.c_str.v);
+    }
+
+  if (p->g_slot > vm.meta.g_slot)
+    vm.meta.g_slot = p->g_slot;
+
+  for (size_t i = 0; i < p->ml; i++)
+    {
+      modent_t *e = sf_modstore_put (vm.mod_store, p->mods[i].path);
+
+      if (e != NULL)
+        e->code = p->mods[i].code;
+    }
+
+  /* $SF_JIT=off still runs the C, it just compiles nothing else */
+  if (vm.jit == NULL)
+    {
+      vm.jit = sf_jit_new (SF_JIT_ON);
+      vm.jit->hot = vm.jit->loop_hot = SIZE_MAX;
+    }
+
+  for (size_t i = 0; i < p->fl; i++)
+    sf_jit_install (&vm, p->fns[i].lp, p->fns[i].end, p->fns[i].code);
+
+  frame_t top = sf_frame_new_local ();
+  top.pop_ret_val = 0;
+  top.return_ip = vm.inst_len - 1;
+  top.stack_base = vm.sp;
+  sf_vm_addframe (&vm, top);
+
+  vm.ip = p->start;
+  sf_vm_exec_frame_top (&vm);
+
+  return 0;
+}
+
+/* the translator */
+
+enum
+{
+  ENT_INT,    /* a C int */
+  ENT_BOOL,   /* a C truth value */
+  ENT_LOCAL,  /* a local held in C, borrowed */
+  ENT_GLOBAL, /* a global, borrowed */
+};
+
+/* a value generated code holds in C instead of on the VM stack */
+typedef struct
+{
+  int kind;
+  int var; /* slot of a LOCAL or GLOBAL */
+  char e[40];
+
+} ent_t;
+
+#define AOT_STACK (32)
+
+typedef struct
+{
+  char *s;
+  size_t l, c;
+
+} sbuf_t;
+
+/* one function, or one unit's top level, being translated */
+typedef struct
+{
+  vm_t *vm;
+  size_t lp, end;
+  int fast; /* locals in C */
+  const size_t *known;
+
+  char *skip;   /* [lp, end) that belongs to someone else */
+  char *target; /* [lp, end) jumped to */
+
+  int *ints; /* per local: 1 int, 0 an object, -1 never used */
+  size_t nl;
+
+  /* the top of the VM stack, still in C, innermost last */
+  ent_t st[AOT_STACK];
+  size_t sl;
+
+  size_t nt; /* int temporaries */
+  int demote, fail;
+
+  sbuf_t b;      /* the body */
+  sbuf_t d;      /* ways back to the interpreter, after it */
+  sbuf_t *to;    /* which of them put() writes to */
+  size_t deopt;  /* ip + 1 of the last way back written */
+
+} ac_t;
+
+static void
+put (ac_t *c, const char *fmt, ...)
+{
+  sbuf_t *b = c->to;
+  va_list ap;
+  int n;
+
+  for (;;)
+    {
+      va_start (ap, fmt);
+      n = vsnprintf (b->s + b->l, b->c - b->l, fmt, ap);
+      va_end (ap);
+
+      /* room for the newline too */
+      if ((size_t)n + 1 < b->c - b->l)
+        break;
+
+      b->c = b->c * 2 + n + 2;
+      b->s = SFREALLOC (b->s, b->c);
+    }
+
+  b->l += n;
+  b->s[b->l++] = '\n';
+  b->s[b->l] = '\0';
+}
+
+static void
+a_put_ent (ac_t *c, ent_t *t)
+{
+  if (t->kind == ENT_INT || t->kind == ENT_BOOL)
+    put (c, "  sf_aot_push (vm, sf_aot_%s (%s));",
+         t->kind == ENT_INT ? "int" : "bool", t->e);
+  else
+    put (c, "  sf_aot_push_ref (vm, %s);", t->e);
+}
+
+/* moves what is held in C onto the VM stack, bottom first */
+static void
+a_flush (ac_t *c)
+{
+  for (size_t s = 0; s < c->sl; s++)
+    a_put_ent (c, &c->st[s]);
+
+  c->sl = 0;
+}
+
+static void
+a_push (ac_t *c, int kind, int var, const char *e)
+{
+  if (c->sl == AOT_STACK)
+    a_flush (c);
+
+  c->st[c->sl].kind = kind;
+  c->st[c->sl].var = var;
+  snprintf (c->st[c->sl].e, sizeof (c->st[c->sl].e), "%s", e);
+  c->sl++;
+}
+
+/**
+ * Writes the way back to the interpreter at k, for when a guard there
+ * fails: the stack as the interpreter would have it, the locals in the
+ * frame, and the frame handed over with k still to run.
+ */
+static void
+a_deopt (ac_t *c, size_t k)
+{
+  if (c->deopt == k + 1)
+    return;
+
+  c->deopt = k + 1;
+  c->to = &c->d;
+
+  put (c, "D%zu:;", k);
+
+  for (size_t s = 0; s < c->sl; s++)
+    a_put_ent (c, &c->st[s]);
+
+  for (size_t j = 0; c->fast && j < c->nl; j++)
+    if (c->ints[j] == 1)
+      put (c, "  sf_aot_keep (vm, %zu, sf_aot_int (i%zu));", j, j);
+    else if (c->ints[j] == 0)
+      put (c, "  sf_aot_keep (vm, %zu, l%zu);", j, j);
+
+  put (c, "  vm->ip = %zu;", k);
+  put (c, "  return SF_VM_NEXT;");
+
+  c->to = &c->b;
+}
+
+/* is the value depth down the stack a C truth value */
+static int
+a_isbool (ac_t *c, size_t depth)
+{
+  return depth < c->sl && c->st[c->sl - 1 - depth].kind == ENT_BOOL;
+}
+
+/* the int the value depth down the stack holds into e, guarded */
+static void
+a_int (ac_t *c, size_t k, size_t depth, char *e, size_t n)
+{
+  char v[40];
+  const char *x = v;
+
+  if (depth < c->sl)
+    {
+      ent_t *t = &c->st[c->sl - 1 - depth];
+
+      if (t->kind == ENT_INT)
+        {
+          snprintf (e, n, "%s", t->e);
+          return;
+        }
+
+      x = t->e;
+    }
+  else
+    snprintf (v, sizeof (v), "vm->stack[vm->sp - %zu]", depth - c->sl + 1);
+
+  a_deopt (c, k);
+  put (c, "  if (!sf_aot_isint (%s))", x);
+  put (c, "    goto D%zu;", k);
+  snprintf (e, n, "%s->v.o_const.v.v.c_int.v", x);
+}
+
+/* e into a new temporary, in place of the n values on top */
+static void
+a_result (ac_t *c, int kind, const char *e, size_t n)
+{
+  char t[24];
+
+  snprintf (t, sizeof (t), "t%zu", c->nt++);
+  put (c, "  %s = %s;", t, e);
+
+  for (; n > 0; n--)
+    if (c->sl)
+      c->sl--;
+    else
+      {
+        put (c, "  o = sf_aot_pop (vm);");
+        put (c, "  DR (o, vm);");
+      }
+
+  a_push (c, kind, -1, t);
+}
+
+static void
+a_generic (ac_t *c, size_t k)
+{
+  a_flush (c);
+  put (c, "  sf_vm_step (vm, %zu);", k);
+}
+
+/* the value on top into o, holding a reference */
+static void
+a_pop_obj (ac_t *c)
+{
+  if (c->sl)
+    {
+      ent_t *t = &c->st[--c->sl];
+
+      if (t->kind == ENT_INT || t->kind == ENT_BOOL)
+        put (c, "  o = sf_aot_%s (%s);", t->kind == ENT_INT ? "int" : "bool",
+             t->e);
+      else
+        {
+          put (c, "  o = %s;", t->e);
+          put (c, "  if (o != NULL)");
+          put (c, "    IR (o);");
+        }
+    }
+  else
+    put (c, "  o = sf_aot_pop (vm);");
+}
+
+/* before a store to var, the values still borrowing it go on the stack */
+static void
+a_unborrow (ac_t *c, int kind, int var)
+{
+  for (size_t s = 0; s < c->sl; s++)
+    if (c->st[s].kind == kind && c->st[s].var == var)
+      {
+        a_flush (c);
+        return;
+      }
+}
+
+static int
+a_in (ac_t *c, size_t ip)
+{
+  return ip >= c->lp && ip < c->end && !c->skip[ip - c->lp];
+}
+
+static void
+a_cmp (char *e, size_t n, int cmp, const char *l, const char *r)
+{
+  static const char *const ops[]
+      = { [CMP_EQEQ] = "==", [CMP_NEQ] = "!=", [CMP_LE] = "<",
+          [CMP_GE] = ">",    [CMP_LEQ] = "<=", [CMP_GEQ] = ">=" };
+
+  /* ints are ordered as floats, as sf_obj_le and the rest do */
+  if (cmp == CMP_EQEQ || cmp == CMP_NEQ)
+    snprintf (e, n, "%s %s %s", l, ops[cmp], r);
+  else
+    snprintf (e, n, "(float)%s %s (float)%s", l, ops[cmp], r);
+}
+
+/* instruction k */
+static void
+a_inst (ac_t *c, size_t k)
+{
+  vm_t *vm = c->vm;
+  instr_t i = vm->insts[k];
+  char e[256], l[96], r[96];
+
+  switch (i.op)
+    {
+    case OP_LOAD_CONST:
+      {
+        const_t *d = &vm->map_consts[i.a];
+
+        if (d->type == CONST_INT)
+          {
+            if (d->v.c_int.v == INT_MIN)
+              snprintf (e, sizeof (e), "(-%d - 1)", INT_MAX);
+            else
+              snprintf (e, sizeof (e), d->v.c_int.v < 0 ? "(%d)" : "%d",
+                        d->v.c_int.v);
+
+            a_push (c, ENT_INT, -1, e);
+          }
+        else if (d->type == CONST_BOOL)
+          a_push (c, ENT_BOOL, -1, d->v.c_bool.v ? "1" : "0");
+        else
+          a_generic (c, k);
+      }
+      break;
+
+    case OP_LOAD_FAST:
+      if (!c->fast)
+        a_generic (c, k);
+      else if (c->ints[i.a] == 1)
+        {
+          snprintf (e, sizeof (e), "i%d", i.a);
+          a_result (c, ENT_INT, e, 0);
+        }
+      else
+        {
+          snprintf (e, sizeof (e), "l%d", i.a);
+          a_push (c, ENT_LOCAL, i.a, e);
+        }
+      break;
+
+    case OP_STORE_FAST:
+      if (!c->fast)
+        a_generic (c, k);
+      else if (c->ints[i.a] == 1)
+        {
+          /* only ints ever get here, or the local is an object after all */
+          if (c->sl && c->st[c->sl - 1].kind == ENT_INT)
+            put (c, "  i%d = %s;", i.a, c->st[--c->sl].e);
+          else
+            {
+              c->ints[i.a] = 0;
+              c->demote = 1;
+            }
+        }
+      else
+        {
+          a_pop_obj (c);
+          a_unborrow (c, ENT_LOCAL, i.a);
+          put (c, "  if (l%d != NULL)", i.a);
+          put (c, "    DR (l%d, vm);", i.a);
+          put (c, "  l%d = o;", i.a);
+        }
+      break;
+
+    case OP_LOAD:
+      snprintf (e, sizeof (e), "vm->globals[%d]", i.a);
+      a_push (c, ENT_GLOBAL, i.a, e);
+      break;
+
+    case OP_STORE:
+      a_pop_obj (c);
+      a_unborrow (c, ENT_GLOBAL, i.a);
+      put (c, "  if (vm->globals[%d] != NULL)", i.a);
+      put (c, "    DR (vm->globals[%d], vm);", i.a);
+      put (c, "  vm->globals[%d] = o;", i.a);
+      break;
+
+    case OP_DUP:
+      if (c->sl)
+        {
+          ent_t t = c->st[c->sl - 1];
+          a_push (c, t.kind, t.var, t.e);
+        }
+      else
+        a_generic (c, k);
+      break;
+
+    case OP_ADD_1:
+      if (a_isbool (c, 0))
+        a_generic (c, k);
+      else
+        {
+          a_int (c, k, 0, l, sizeof (l));
+          snprintf (e, sizeof (e), "(int)((unsigned)%s + 1u)", l);
+          a_result (c, ENT_INT, e, 1);
+        }
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+      if (a_isbool (c, 0) || a_isbool (c, 1))
+        a_generic (c, k);
+      else
+        {
+          a_int (c, k, 1, l, sizeof (l));
+          a_int (c, k, 0, r, sizeof (r));
+          snprintf (e, sizeof (e), "(int)((unsigned)%s %c (unsigned)%s)", l,
+                    i.op == OP_ADD   ? '+'
+                    : i.op == OP_SUB ? '-'
+                                     : '*',
+                    r);
+          a_result (c, ENT_INT, e, 2);
+        }
+      break;
+
+    case OP_CMP:
+      if (i.a < CMP_EQEQ || i.a > CMP_GEQ || a_isbool (c, 0)
+          || a_isbool (c, 1))
+        a_generic (c, k);
+      else
+        {
+          a_int (c, k, 1, l, sizeof (l));
+          a_int (c, k, 0, r, sizeof (r));
+          a_cmp (e, sizeof (e), i.a, l, r);
+          a_result (c, ENT_BOOL, e, 2);
+        }
+      break;
+
+    case OP_JUMP_IF_FALSE:
+      if (c->sl && (c->st[c->sl - 1].kind == ENT_INT
+                     || c->st[c->sl - 1].kind == ENT_BOOL))
+        {
+          ent_t t = c->st[--c->sl];
+
+          a_flush (c);
+          put (c, "  if (!(%s))", t.e);
+        }
+      else
+        {
+          a_flush (c);
+          put (c, "  if (!sf_aot_cond (vm))");
+        }
+      put (c, "    goto L%d;", i.a);
+      break;
+
+    case OP_CMP_JUMP:
+      if (i.b < CMP_EQEQ || i.b > CMP_GEQ || a_isbool (c, 0)
+          || a_isbool (c, 1))
+        {
+          a_flush (c);
+          put (c, "  if (sf_vm_step (vm, %zu) == %d)", k, i.a);
+        }
+      else
+        {
+          a_int (c, k, 1, l, sizeof (l));
+          a_int (c, k, 0, r, sizeof (r));
+          a_cmp (e, sizeof (e), i.b, l, r);
+          a_result (c, ENT_BOOL, e, 2);
+
+          ent_t t = c->st[--c->sl];
+
+          a_flush (c);
+          put (c, "  if (!(%s))", t.e);
+        }
+      put (c, "    goto L%d;", i.a);
+      break;
+
+    case OP_JUMP:
+      a_flush (c);
+      put (c, "  goto L%d;", i.a);
+      break;
+
+    case OP_RETURN:
+      a_flush (c);
+
+      if (i.a != 1)
+        {
+          put (c, "  o = sf_objstore_req_forconst (");
+          put (c, "      &(const_t){ .type = CONST_NONE });");
+          put (c, "  sf_aot_push (vm, o);");
+          put (c, "  IR (o);");
+        }
+
+      for (size_t j = 0; c->fast && j < c->nl; j++)
+        if (c->ints[j] == 0)
+          put (c, "  sf_aot_keep (vm, %zu, l%zu);", j, j);
+
+      put (c, "  return SF_VM_RETURN;");
+      break;
+
+    case OP_CALL:
+      {
+        instr_t p = k > c->lp ? vm->insts[k - 1] : i;
+        size_t lp;
+
+        a_flush (c);
+
+        /* a global bound to one function only, called straight */
+        if (k > c->lp && a_in (c, k - 1) && p.op == OP_LOAD
+            && c->known[p.a] != 0 && c->known[p.a] != SIZE_MAX)
+          {
+            lp = c->known[p.a] - 1;
+            put (c,
+                 "  if ((o = sf_aot_enter (vm, %zu, %d, %d, %zu)) != NULL)",
+                 k, i.a, i.b, lp);
+            put (c, "    sf_aot_leave (vm, o, aot_%zu (vm, %zu));", lp, lp);
+            put (c, "  else");
+            put (c, "    sf_vm_step (vm, %zu);", k);
+          }
+        else
+          put (c, "  sf_vm_step (vm, %zu);", k);
+      }
+      break;
+
+    case OP_TAIL_CALL:
+      a_flush (c);
+
+      /* the frame drops its locals as it starts over, ours too */
+      for (size_t j = 0; c->fast && j < c->nl; j++)
+        if (c->ints[j] == 0)
+          put (c, "  sf_aot_keep (vm, %zu, l%zu);", j, j);
+
+      put (c, "  ip = sf_vm_step (vm, %zu);", k);
+      put (c, "  if (ip == SF_VM_STEP_END)");
+      put (c, "    return SF_VM_RETURN;");
+
+      /* calling itself goes back to the top, anything else goes back
+         to sf_vm_exec_single_frame (), which runs the callee's code in
+         the same frame */
+      put (c, "  if (ip != %zu)", c->lp);
+      put (c, "    return SF_VM_TAIL;");
+
+      for (size_t j = 0; c->fast && j < c->nl; j++)
+        if (c->ints[j] == 1)
+          put (c, "  i%zu = 0;", j);
+        else if (c->ints[j] == 0)
+          put (c, "  l%zu = NULL;", j);
+
+      put (c, "  goto L%zu;", c->lp);
+      break;
+
+    case OP_LOAD_ITER_NEXT:
+      a_flush (c);
+      put (c, "  if (sf_vm_step (vm, %zu) == %d)", k, i.a);
+      put (c, "    goto L%d;", i.a);
+      break;
+
+    case OP_LOAD_BUILDCLASS_END:
+    case OP_IMPORT_ALIAS:
+      /* only ever run inside what their opening instruction runs */
+      c->fail = 1;
+      break;
+
+    default:
+      /* LOAD_BUILDCLASS and IMPORT run what they skip over themselves */
+      a_generic (c, k);
+      break;
+    }
+}
+
+/* finds what [lp, end) skips and jumps to, 0 if it cannot be done */
+static int
+a_scan (ac_t *c)
+{
+  vm_t *vm = c->vm;
+  size_t n = c->end - c->lp;
+
+  for (size_t k = c->lp; k < c->end; k++)
+    {
+      instr_t i = vm->insts[k];
+
+      if (i.op == OP_LOAD_FUNC_CODED && (size_t)i.a >= c->lp
+          && (size_t)i.a < k)
+        memset (c->skip + (i.a - c->lp), 1, k - i.a);
+      else if (i.op == OP_LOAD_BUILDCLASS && (size_t)i.a > k
+               && (size_t)i.a < c->end)
+        memset (c->skip + (k + 1 - c->lp), 1, i.a - k);
+      else if (i.op == OP_IMPORT && k + 1 < c->end)
+        c->skip[k + 1 - c->lp] = 1;
+    }
+
+  for (size_t k = c->lp; k < c->end; k++)
+    {
+      instr_t i = vm->insts[k];
+
+      if (c->skip[k - c->lp])
+        continue;
+
+      switch (i.op)
+        {
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_CMP_JUMP:
+        case OP_LOAD_ITER_NEXT:
+          if (i.a < 0 || !a_in (c, i.a))
+            return 0;
+          c->target[i.a - c->lp] = 1;
+          break;
+
+        case OP_TAIL_CALL:
+          /* calling itself goes back to the top */
+          c->target[0] = 1;
+          break;
+
+        case OP_LOAD_FAST:
+        case OP_STORE_FAST:
+          if (c->fast && i.b != 0 && i.op == OP_LOAD_FAST)
+            return 0;
+          if (i.a < 0)
+            return 0;
+          if ((size_t)i.a >= c->nl)
+            {
+              c->ints = SFREALLOC (c->ints, (i.a + 1) * sizeof (*c->ints));
+              for (size_t j = c->nl; j <= (size_t)i.a; j++)
+                c->ints[j] = -1;
+              c->nl = i.a + 1;
+            }
+          c->ints[i.a] = 1;
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  return n > 0;
+}
+
+/* translates into c->b, 0 if it cannot be done */
+static int
+a_func (ac_t *c)
+{
+  if (!a_scan (c))
+    return 0;
+
+  do
+    {
+      c->b.l = 0;
+      c->d.l = 0;
+      c->d.s[0] = '\0';
+      c->deopt = 0;
+      c->sl = 0;
+      c->nt = 0;
+      c->demote = 0;
+
+      for (size_t k = c->lp; k < c->end && !c->fail; k++)
+        {
+          if (c->skip[k - c->lp])
+            continue;
+
+          if (c->target[k - c->lp])
+            {
+              a_flush (c);
+              put (c, "L%zu:;", k);
+            }
+
+          a_inst (c, k);
+        }
+    }
+  while (c->demote && !c->fail);
+
+  return !c->fail;
+}
+
+static void
+emit_str (FILE *out, const char *s)
+{
+  fputc ('"', out);
+
+  for (; *s; s++)
+    {
+      unsigned char ch = (unsigned char)*s;
+
+      if (ch == '"' || ch == '\\')
+        fprintf (out, "\\%c", ch);
+      else if (ch < 0x20 || ch >= 0x7f)
+        fprintf (out, "\\%03o", ch);
+      else
+        fputc (ch, out);
+    }
+
+  fputc ('"', out);
+}
+
+static void
+emit_fn (FILE *out, ac_t *c)
+{
+  fprintf (out, "static int\naot_%zu (vm_t *vm, size_t ip)\n{\n", c->lp);
+  fprintf (out, "  obj_t *o = NULL;\n");
+
+  for (size_t j = 0; c->fast && j < c->nl; j++)
+    if (c->ints[j] == 1)
+      fprintf (out, "  int i%zu = 0;\n", j);
+    else if (c->ints[j] == 0)
+      fprintf (out, "  obj_t *l%zu = NULL;\n", j);
+
+  for (size_t t = 0; t < c->nt; t++)
+    fprintf (out, "%s t%zu%s", t % 8 ? "," : "  int", t,
+             t % 8 == 7 || t + 1 == c->nt ? ";\n" : "");
+
+  fprintf (out, "\n  (void)ip;\n  (void)o;\n\n%s", c->b.s);
+
+  /* codegen ends every body with a RETURN, this is never reached */
+  fprintf (out, "  vm->ip = %zu;\n  return SF_VM_NEXT;\n", c->end);
+  fprintf (out, "%s}\n\n", c->d.s);
+}
+
+static int
+cmp_size (const void *a, const void *b)
+{
+  size_t x = *(const size_t *)a, y = *(const size_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Writes the C program for what vm holds, the script's own code
+ * starting at start. Returns 0, or -1 if out could not be written.
+ */
+SF_API int
+sf_aot_emit (vm_t *vm, size_t start, FILE *out)
+{
+  size_t n = vm->inst_len;
+  size_t *known = SFMALLOC ((vm->meta.g_slot + 1) * sizeof (*known));
+  size_t *fl
+      = SFMALLOC ((n + vm->mod_store->el + 2) * 2 * sizeof (*fl));
+  size_t nf = 0;
+  int fast = 1;
+
+  memset (known, 0, (vm->meta.g_slot + 1) * sizeof (*known));
+
+  for (size_t k = 0; k < n; k++)
+    {
+      instr_t i = vm->insts[k];
+
+      /* an enclosing frame's locals, read straight out of the frame */
+      if (i.op == OP_LOAD_FAST && i.b != 0)
+        fast = 0;
+
+      if (i.op == OP_LOAD_FUNC_CODED)
+        {
+          fl[nf * 2] = i.a;
+          fl[nf++ * 2 + 1] = k;
+        }
+
+      if (i.op == OP_STORE && (size_t)i.a < vm->meta.g_slot)
+        {
+          size_t f = k > 0 && vm->insts[k - 1].op == OP_DUP ? 2 : 1;
+          size_t v = SIZE_MAX;
+
+          if (k >= f && vm->insts[k - f].op == OP_LOAD_FUNC_CODED)
+            v = vm->insts[k - f].a + 1;
+
+          known[i.a] = known[i.a] == 0 || known[i.a] == v ? v : SIZE_MAX;
+        }
+    }
+
+  /* each unit's top level runs up to where the next unit starts */
+  size_t *units = SFMALLOC ((vm->mod_store->el + 2) * sizeof (*units));
+  size_t ul = 0;
+
+  units[ul++] = start;
+  for (size_t m = 0; m < vm->mod_store->el; m++)
+    if (vm->mod_store->ents[m].code < n)
+      units[ul++] = vm->mod_store->ents[m].code;
+
+  qsort (units, ul, sizeof (*units), cmp_size);
+
+  for (size_t u = 0; u < ul; u++)
+    {
+      fl[(nf + u) * 2] = units[u];
+      fl[(nf + u) * 2 + 1] = u + 1 < ul ? units[u + 1] : n;
+    }
+
+  fprintf (out, "/* written by sunflower-aot, do not edit */\n\n");
+  fprintf (out, "#include <sunflower.h>\n\n");
+
+  fprintf (out, "static const instr_t aot_insts[] = {\n");
+  for (size_t k = 0; k < n; k++)
+    {
+      instr_t i = vm->insts[k];
+
+      fprintf (out, "  { %s, %d, %d, ", sf_vm_op_name (i.op), i.a, i.b);
+
+      /* range steps are the one integer kept in c */
+      if (i.op == OP_RANGE_FAST)
+        fprintf (out, "(char *)%d", (int)(intptr_t)i.c);
+      else if (i.c != NULL)
+        emit_str (out, i.c);
+      else
+        fprintf (out, "NULL");
+      fprintf (out, " },\n");
+    }
+  fprintf (out, "  { OP_RETURN, 0, 0, NULL },\n};\n\n");
+
+  fprintf (out, "static const const_t aot_consts[] = {\n");
+  for (size_t k = 0; k < vm->s_ml; k++)
+    {
+      const_t d = vm->map_consts[k];
+
+      switch (d.type)
+        {
+        case CONST_INT:
+          fprintf (out, "  { .type = CONST_INT, .v.c_int.v = %d },\n",
+                   d.v.c_int.v);
+          break;
+
+        case CONST_FLOAT:
+          fprintf (out, "  { .type = CONST_FLOAT, .v.c_float.v = %a },\n",
+                   (double)d.v.c_float.v);
+          break;
+
+        case CONST_STRING:
+          fprintf (out, "  { .type = CONST_STRING, .v.c_str.v = ");
+          emit_str (out, d.v.c_str.v);
+          fprintf (out, " },\n");
+          break;
+
+        case CONST_BOOL:
+          fprintf (out, "  { .type = CONST_BOOL, .v.c_bool.v = %d },\n",
+                   d.v.c_bool.v);
+          break;
+
+        default:
+          fprintf (out, "  { .type = CONST_NONE },\n");
+          break;
+        }
+    }
+  fprintf (out, "  { .type = CONST_NONE },\n};\n\n");
+
+  for (size_t f = 0; f < nf + ul; f++)
+    fprintf (out, "static int aot_%zu (vm_t *, size_t);\n", fl[f * 2]);
+  fprintf (out, "\n");
+
+  char *ok = SFMALLOC (nf + ul);
+  ac_t c = { .vm = vm, .known = known };
+
+  c.b.c = c.d.c = 4096;
+  c.b.s = SFMALLOC (c.b.c);
+  c.d.s = SFMALLOC (c.d.c);
+  c.to = &c.b;
+
+  for (size_t f = 0; f < nf + ul; f++)
+    {
+      c.lp = fl[f * 2];
+      c.end = fl[f * 2 + 1];
+      c.fast = fast && f < nf;
+      c.skip = SFMALLOC (c.end - c.lp + 1);
+      c.target = SFMALLOC (c.end - c.lp + 1);
+      memset (c.skip, 0, c.end - c.lp + 1);
+      memset (c.target, 0, c.end - c.lp + 1);
+      c.ints = NULL;
+      c.nl = 0;
+      c.fail = 0;
+
+      ok[f] = (char)a_func (&c);
+
+      if (ok[f])
+        emit_fn (out, &c);
+      else
+        /* called straight all the same, then the interpreter runs it */
+        fprintf (out,
+                 "static int\naot_%zu (vm_t *vm, size_t ip)\n{\n"
+                 "  (void)vm;\n  (void)ip;\n  return SF_VM_NEXT;\n}\n\n",
+                 c.lp);
+
+      SFFREE (c.skip);
+      SFFREE (c.target);
+      SFFREE (c.ints);
+    }
+
+  fprintf (out, "static const aot_fn_t aot_fns[] = {\n");
+  for (size_t f = 0; f < nf + ul; f++)
+    if (ok[f])
+      fprintf (out, "  { %zu, %zu, aot_%zu },\n", fl[f * 2], fl[f * 2 + 1],
+               fl[f * 2]);
+  fprintf (out, "  { 0, 0, NULL },\n};\n\n");
+
+  size_t ml = 0;
+
+  fprintf (out, "static const aot_mod_t aot_mods[] = {\n");
+  for (size_t m = 0; m < vm->mod_store->el; m++)
+    {
+      modent_t *e = &vm->mod_store->ents[m];
+
+      if (e->code >= n)
+        continue;
+
+      fprintf (out, "  { ");
+      emit_str (out, e->path);
+      fprintf (out, ", %zu },\n", e->code);
+      ml++;
+    }
+  fprintf (out, "  { NULL, 0 },\n};\n\n");
+
+  size_t okl = 0;
+  for (size_t f = 0; f < nf + ul; f++)
+    okl += ok[f] != 0;
+
+  fprintf (out,
+           "int\nmain (void)\n{\n"
+           "  static const aot_prog_t prog = {\n"
+           "    .start = %zu,\n"
+           "    .g_slot = %zu,\n"
+           "    .insts = aot_insts,\n"
+           "    .il = %zu,\n"
+           "    .consts = aot_consts,\n"
+           "    .cl = %zu,\n"
+           "    .fns = aot_fns,\n"
+           "    .fl = %zu,\n"
+           "    .mods = aot_mods,\n"
+           "    .ml = %zu,\n"
+           "  };\n\n"
+           "  return sf_aot_main (&prog);\n}\n",
+           start, vm->meta.g_slot, n, vm->s_ml, okl, ml);
+
+  SFFREE (c.b.s);
+  SFFREE (c.d.s);
+  SFFREE (ok);
+  SFFREE (units);
+  SFFREE (fl);
+  SFFREE (known);
+
+  return ferror (out) ? -1 : 0;
+}
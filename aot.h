@@ -0,0 +1,130 @@
+#if !defined(AOT_H)
+#define AOT_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "jit.h"
+#include "malloc.h"
+#include "object.h"
+
+/**
+ * Ahead-of-time compilation to C. sunflower-aot compiles a script and
+ * the modules it imports, then writes out a translation unit holding
+ * the whole program's instructions and constants, plus a C function per
+ * coded function and per compilation unit's top level. Built against
+ * libsunflower, it runs like the interpreter would, with the functions
+ * installed in the VM's native code table (see jit.h) so every way of
+ * entering them lands in C.
+ *
+ * Locals that only ever hold ints are plain C ints, and int arithmetic,
+ * comparisons and branches are C, with a guard on every operand not
+ * already known to be an int. A guard that fails hands the function to
+ * the interpreter right there, its locals moved into the frame. Other
+ * locals are C pointers holding a reference, handed to the frame when
+ * the function returns. A call to a global bound once to a coded
+ * function is a direct C call, guarded on the callee. Everything else
+ * (containers, attributes, natives, classes, imports) goes through
+ * sf_vm_step, on the VM stack.
+ *
+ * Programs where a function reads the locals of an enclosing frame keep
+ * all locals in their frames. Imported modules are looked up by file
+ * as always, so they still have to be there when the program runs.
+ */
+typedef struct
+{
+  size_t lp, end;
+  jit_code_t code;
+
+} aot_fn_t;
+
+typedef struct
+{
+  const char *path; /* canonical, as the compiler found it */
+  size_t code;
+
+} aot_mod_t;
+
+typedef struct
+{
+  size_t start; /* ip of the script's own code */
+  size_t g_slot;
+
+  const instr_t *insts;
+  size_t il;
+  const const_t *consts;
+  size_t cl;
+
+  const aot_fn_t *fns;
+  size_t fl;
+  const aot_mod_t *mods;
+  size_t ml;
+
+} aot_prog_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API int sf_aot_emit (vm_t *, size_t, FILE *);
+  SF_API int sf_aot_main (const aot_prog_t *);
+
+  SF_API obj_t *sf_aot_int (int);
+  SF_API obj_t *sf_aot_bool (int);
+  SF_API obj_t *sf_aot_enter (vm_t *, size_t, int, int, size_t);
+  SF_API void sf_aot_leave (vm_t *, obj_t *, int);
+  SF_API void sf_aot_keep (vm_t *, int, obj_t *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+/* what generated code inlines, the VM stack as bytecode.c treats it */
+
+static inline void
+sf_aot_push (vm_t *vm, obj_t *o)
+{
+  if (vm->sp >= vm->stack_cap)
+    {
+      vm->stack_cap += SF_VM_STACK_CAP;
+      vm->stack = SFREALLOC (vm->stack, vm->stack_cap * sizeof (*vm->stack));
+    }
+
+  vm->stack[vm->sp++] = o;
+}
+
+static inline obj_t *
+sf_aot_pop (vm_t *vm)
+{
+  return vm->stack[--vm->sp];
+}
+
+/* o with a reference of its own */
+static inline void
+sf_aot_push_ref (vm_t *vm, obj_t *o)
+{
+  sf_aot_push (vm, o);
+
+  if (o != NULL)
+    IR (o);
+}
+
+static inline int
+sf_aot_isint (obj_t *o)
+{
+  return o != NULL && o->type == OBJ_CONST
+         && o->v.o_const.v.type == CONST_INT;
+}
+
+/* pops the condition of a JUMP_IF_FALSE, nonzero if it holds */
+static inline int
+sf_aot_cond (vm_t *vm)
+{
+  obj_t *p = sf_aot_pop (vm);
+  int rc = !sf_obj_isfalse (*p);
+
+  DR (p, vm);
+  return rc;
+}
+
+#endif // AOT_H
@@ -0,0 +1,56 @@
+#include "sunflower.h"
+
+/**
+ * sunflower-aot SCRIPT [OUT]
+ *
+ * Compiles SCRIPT and every module it imports, and writes the C program
+ * for it (see aot.h) to OUT, or stdout. Imports resolve against the
+ * working directory, as they do when the script runs.
+ */
+int
+main (int argc, char const *argv[])
+{
+  if (argc < 2 || argc > 3)
+    {
+      fprintf (stderr, "usage: %s SCRIPT [OUT]\n", argv[0]);
+      return 2;
+    }
+
+  sf_objstore_init ();
+
+  vm_t vm = sf_vm_new ();
+  sf_natives_add_tovm (&vm);
+
+  /* the translator finds the int locals on its own, in plain locals, and
+     calls coded functions directly (tail calls excepted) */
+  vm.opt &= ~(SF_OPT_TYPES | SF_OPT_INLINE);
+
+  size_t start = vm.inst_len;
+
+  vm.fp = 1;
+  sf_fishc_compile (&vm, argv[1]);
+  vm.fp = 0;
+
+  sf_imports_compile (&vm, start, 1);
+
+  FILE *out = argc == 3 ? fopen (argv[2], "w") : stdout;
+
+  if (out == NULL)
+    {
+      perror (argv[2]);
+      return 1;
+    }
+
+  int r = sf_aot_emit (&vm, start, out);
+
+  if (out != stdout && fclose (out) != 0)
+    r = -1;
+
+  if (r != 0)
+    {
+      fprintf (stderr, "%s: could not write the program\n", argv[0]);
+      return 1;
+    }
+
+  return 0;
+}
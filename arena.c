@@ -0,0 +1,129 @@
+#include "arena.h"
+
+#define ALIGN_UP(X)                                                           \
+  (((X) + SF_ARENA_ALIGN - 1) & ~(size_t)(SF_ARENA_ALIGN - 1))
+
+static arena_chunk_t *
+chunk_new (arena_chunk_t *prev, size_t need)
+{
+  /* each chunk doubles the last one, big requests get their own */
+  size_t cap = prev != NULL ? prev->cap << 1 : SF_ARENA_CHUNK;
+
+  if (cap > SF_ARENA_CHUNK * 64)
+    cap = SF_ARENA_CHUNK * 64;
+
+  if (cap < need)
+    cap = ALIGN_UP (need);
+
+  arena_chunk_t *c = SFMALLOC (sizeof (*c) + cap);
+  c->prev = prev;
+  c->cap = cap;
+  c->used = 0;
+
+  return c;
+}
+
+SF_API void
+sf_arena_init (arena_t *a)
+{
+  a->head = NULL;
+  a->last = NULL;
+}
+
+SF_API void
+sf_arena_free (arena_t *a)
+{
+  arena_chunk_t *c = a->head;
+
+  while (c != NULL)
+    {
+      arena_chunk_t *p = c->prev;
+      SFFREE (c);
+      c = p;
+    }
+
+  a->head = NULL;
+  a->last = NULL;
+}
+
+/* bytes handed out so far */
+SF_API size_t
+sf_arena_size (arena_t *a)
+{
+  size_t n = 0;
+
+  for (arena_chunk_t *c = a->head; c != NULL; c = c->prev)
+    n += c->used;
+
+  return n;
+}
+
+SF_API void *
+sf_arena_alloc (arena_t *a, size_t n)
+{
+  arena_chunk_t *c = a->head;
+  n = ALIGN_UP (n ? n : 1);
+
+  if (c == NULL || c->cap - c->used < n)
+    c = a->head = chunk_new (c, n);
+
+  void *p = c->mem + c->used;
+  c->used += n;
+  a->last = p;
+
+  return p;
+}
+
+/**
+ * Resizes p, which holds old bytes. The last allocation grows in place
+ * while its chunk has room, anything else is copied and the old bytes
+ * stay behind until the arena goes.
+ */
+SF_API void *
+sf_arena_grow (arena_t *a, void *p, size_t old, size_t n)
+{
+  if (p == NULL)
+    return sf_arena_alloc (a, n);
+
+  arena_chunk_t *c = a->head;
+
+  if (p == a->last)
+    {
+      size_t at = (char *)p - c->mem;
+
+      if (c->cap - at >= ALIGN_UP (n))
+        {
+          c->used = at + ALIGN_UP (n);
+          return p;
+        }
+    }
+
+  void *q = sf_arena_alloc (a, n);
+  memcpy (q, p, old < n ? old : n);
+
+  return q;
+}
+
+SF_API arena_mark_t
+sf_arena_mark (arena_t *a)
+{
+  return (arena_mark_t){ .head = a->head,
+                         .used = a->head != NULL ? a->head->used : 0 };
+}
+
+/* drops everything allocated since the mark was taken */
+SF_API void
+sf_arena_release (arena_t *a, arena_mark_t m)
+{
+  while (a->head != m.head)
+    {
+      arena_chunk_t *p = a->head->prev;
+      SFFREE (a->head);
+      a->head = p;
+    }
+
+  if (a->head != NULL)
+    a->head->used = m.used;
+
+  a->last = NULL;
+}
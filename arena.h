@@ -0,0 +1,59 @@
+#if !defined(ARENA_H)
+#define ARENA_H
+
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Bump allocator for data that dies all at once, like the AST of one
+ * compilation. Allocations are carved out of chunks that only grow;
+ * nothing is freed on its own, sf_arena_free releases every chunk and
+ * sf_arena_release whatever came after a mark.
+ */
+#define SF_ARENA_CHUNK (16 * 1024)
+#define SF_ARENA_ALIGN (16)
+
+typedef struct _arena_chunk_s
+{
+  struct _arena_chunk_s *prev;
+  size_t cap;
+  size_t used;
+
+  _Alignas (SF_ARENA_ALIGN) char mem[];
+
+} arena_chunk_t;
+
+typedef struct
+{
+  arena_chunk_t *head;
+  void *last; /* most recent allocation, it can grow in place */
+
+} arena_t;
+
+typedef struct
+{
+  arena_chunk_t *head;
+  size_t used;
+
+} arena_mark_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_arena_init (arena_t *);
+  SF_API void sf_arena_free (arena_t *);
+  SF_API size_t sf_arena_size (arena_t *);
+
+  SF_API void *sf_arena_alloc (arena_t *, size_t);
+  SF_API void *sf_arena_grow (arena_t *, void *, size_t, size_t);
+
+  SF_API arena_mark_t sf_arena_mark (arena_t *);
+  SF_API void sf_arena_release (arena_t *, arena_mark_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // ARENA_H
@@ -1,39 +1,68 @@
 #include "ast.h"
 
-size_t
-get_tbsp (token_t *curr, token_t *start)
+/* +1 for an opening bracket, -1 for a closing one */
+static inline int
+op_nesting (const char *op)
 {
-  token_t t;
-  int gb = 0;
-
-  while (curr - start > -1)
+  switch (*op)
     {
-      t = *curr--;
-      // sf_token_print (t);
+    case '(':
+    case '[':
+    case '{':
+      return 1;
+
+    case ')':
+    case ']':
+    case '}':
+      return -1;
+
+    default:
+      break;
+    }
 
-      if (t.type == TOK_OPERATOR)
-        {
-          const char *op = t.v.t_operator.value;
+  return 0;
+}
 
-          if (strstr ("({[", op) != NULL)
-            gb++;
+/**
+ * The tree of one sf_ast_gen call lives in its arena. sf_expr_gen takes
+ * no arena, so the one being filled is per thread, and so is the stack
+ * each block gathers its statements on before they are copied into the
+ * arena at their final size.
+ */
+typedef struct
+{
+  arena_t *arena;
 
-          if (strstr (")}]", op) != NULL)
-            gb--;
-        }
+  stmt_t *stmts;
+  size_t sl, sc;
 
-      if (t.type == TOK_SPACE && !gb)
-        {
-          return t.v.space.v;
-        }
+} ast_ctx_t;
 
-      if (t.type == TOK_NEWLINE && !gb)
-        {
-          break;
-        }
+static _Thread_local ast_ctx_t ast_ctx;
+
+static inline void *
+ast_alloc (size_t n)
+{
+  return sf_arena_alloc (ast_ctx.arena, n);
+}
+
+static inline void *
+ast_grow (void *p, size_t old, size_t n)
+{
+  return sf_arena_grow (ast_ctx.arena, p, old, n);
+}
+
+static inline void
+ast_push (stmt_t st)
+{
+  if (ast_ctx.sl >= ast_ctx.sc)
+    {
+      ast_ctx.sc = ast_ctx.sc ? ast_ctx.sc << 1 : STMT_SM_VALS_CAP;
+      ast_ctx.stmts = SFREALLOC (ast_ctx.stmts,
+                                 ast_ctx.sc * sizeof (*ast_ctx.stmts));
     }
 
-  return 0;
+  ast_ctx.stmts[ast_ctx.sl++] = st;
 }
 
 token_t *
@@ -50,11 +79,7 @@ get_block (token_t *start, size_t tbsp)
         {
           const char *op = t.v.t_operator.value;
 
-          if (strstr ("({[", op) != NULL)
-            gb++;
-
-          if (strstr (")}]", op) != NULL)
-            gb--;
+          gb += op_nesting (op);
         }
 
       if (gb)
@@ -87,25 +112,153 @@ get_block (token_t *start, size_t tbsp)
   return --e;
 }
 
-SF_API StmtSM *
-sf_ast_gen (TokenSM *smt)
+/**
+ * Logical lines of the token stream, found in one pass before parsing.
+ * A line starts after a run of newlines outside brackets and is
+ * indented by the space token that follows. Open lines sit on an
+ * indentation stack; a new line pops every line indented at least as
+ * deep and becomes their `next`, which is where a block opened on them
+ * ends. Blocks at every depth then find their end without rescanning.
+ */
+typedef struct
 {
-  StmtSM *res = SFMALLOC (sizeof (*res));
-  res->vc = STMT_SM_VALS_CAP;
-  res->vl = 0;
-  res->vals = SFMALLOC (res->vc * sizeof (*res->vals));
+  int32_t term; /* last newline before the line, -1 for the first */
+  int32_t ind;
+  int32_t next; /* next line indented no deeper, -1 for none */
 
-  token_t *smtv = smt->vals;
-  token_t tok = *smtv++;
+} ast_line_t;
 
-  while (tok.type != TOK_EOF)
+typedef struct
+{
+  token_t *base;
+  size_t n; /* tokens before EOF */
+
+  int32_t *of; /* line of each token */
+  ast_line_t *lines;
+  size_t ll, lc;
+
+  int32_t *stack;
+  size_t sl;
+
+} ast_lines_t;
+
+static int32_t
+ast_line_open (ast_lines_t *lt, int32_t term, int32_t ind)
+{
+  if (lt->ll >= lt->lc)
+    {
+      lt->lc <<= 1;
+      lt->lines = SFREALLOC (lt->lines, lt->lc * sizeof (*lt->lines));
+      lt->stack = SFREALLOC (lt->stack, lt->lc * sizeof (*lt->stack));
+    }
+
+  int32_t l = (int32_t)lt->ll++;
+
+  while (lt->sl && lt->lines[lt->stack[lt->sl - 1]].ind >= ind)
+    lt->lines[lt->stack[--lt->sl]].next = l;
+
+  lt->lines[l] = (ast_line_t){ .term = term, .ind = ind, .next = -1 };
+  lt->stack[lt->sl++] = l;
+
+  return l;
+}
+
+static void
+ast_lines_build (ast_lines_t *lt, token_t *vals)
+{
+  size_t n = 0;
+
+  while (vals[n].type != TOK_EOF)
+    n++;
+
+  lt->base = vals;
+  lt->n = n;
+  lt->of = SFMALLOC ((n + 1) * sizeof (*lt->of));
+  lt->lc = 64;
+  lt->ll = 0;
+  lt->lines = SFMALLOC (lt->lc * sizeof (*lt->lines));
+  lt->stack = SFMALLOC (lt->lc * sizeof (*lt->stack));
+  lt->sl = 0;
+
+  int32_t cur = ast_line_open (
+      lt, -1, vals[0].type == TOK_SPACE ? (int32_t)vals[0].v.space.v : 0);
+  int gb = 0;
+
+  for (size_t i = 0; i < n; i++)
     {
-      if (res->vl >= res->vc)
+      token_t *t = &vals[i];
+      lt->of[i] = cur;
+
+      if (t->type == TOK_OPERATOR)
+        gb += op_nesting (t->v.t_operator.value);
+
+      else if (t->type == TOK_NEWLINE && !gb)
         {
-          res->vc += STMT_SM_VALS_CAP;
-          res->vals = SFREALLOC (res->vals, res->vc * sizeof (*res->vals));
+          while (vals[i + 1].type == TOK_NEWLINE)
+            lt->of[++i] = cur;
+
+          token_t *x = &vals[i + 1];
+          cur = ast_line_open (lt, (int32_t)i,
+                               x->type == TOK_SPACE ? (int32_t)x->v.space.v
+                                                    : 0);
         }
+    }
+
+  lt->of[n] = cur;
+  SFFREE (lt->stack);
+}
 
+/* indentation of the line tok is on */
+static inline size_t
+ast_tbsp (ast_lines_t *lt, token_t *tok)
+{
+  return lt->lines[lt->of[tok - lt->base]].ind;
+}
+
+/* the newline that starts tok's line, or first if the line began earlier */
+static inline token_t *
+ast_line_start (ast_lines_t *lt, token_t *tok, token_t *first)
+{
+  int32_t term = lt->lines[lt->of[tok - lt->base]].term;
+
+  if (term < 0 || lt->base + term < first)
+    return first;
+
+  return lt->base + term;
+}
+
+/**
+ * get_block (start, tb) for a block opened on the line of kw: the last
+ * token before the next line indented tb or less.
+ */
+static token_t *
+ast_block (ast_lines_t *lt, token_t *kw, token_t *start, size_t tb)
+{
+  int32_t l = lt->lines[lt->of[kw - lt->base]].next;
+
+  while (l != -1 && lt->lines[l].ind > (int32_t)tb)
+    l = lt->lines[l].next;
+
+  token_t *e = l == -1 ? lt->base + lt->n - 1 : lt->base + lt->lines[l].term;
+
+  /* a body that is not indented at all, only a scan gets that right */
+  if (e < start)
+    return get_block (start, tb);
+
+  return e;
+}
+
+/* statements of one block, *n of them, the last is STMT_EOF */
+static stmt_t *
+ast_gen (ast_lines_t *lt, TokenSM *smt, size_t *n)
+{
+  size_t base = ast_ctx.sl;
+
+  token_t *smtv = smt->vals;
+  token_t tok = *smtv++;
+
+  while (tok.type != TOK_EOF)
+    {
       switch (tok.type)
         {
         case TOK_OPERATOR:
@@ -114,45 +267,12 @@ sf_ast_gen (TokenSM *smt)
 
             if (*op == '=' && !op[1])
               {
-                token_t *smt_back = smtv;
+                token_t *smt_back = ast_line_start (lt, smtv - 1, smt->vals);
                 token_t *smt_front = smtv;
 
                 int gb = 0;
                 token_t t;
 
-                while (smt_back > smt->vals)
-                  {
-                    t = *--smt_back;
-
-                    switch (t.type)
-                      {
-                      case TOK_OPERATOR:
-                        {
-                          const char *op = t.v.t_operator.value;
-
-                          if (strstr ("({[", op) != NULL)
-                            gb++;
-
-                          if (strstr (")}]", op) != NULL)
-                            gb--;
-                        }
-                        break;
-
-                      case TOK_NEWLINE:
-                        {
-                          if (!gb)
-                            goto l2;
-                        }
-                        break;
-
-                      default:
-                        break;
-                      }
-                  }
-
-              l2:;
-                gb = 0;
-
                 while (smt_front->type != TOK_EOF)
                   {
                     t = *smt_front++;
@@ -163,11 +283,7 @@ sf_ast_gen (TokenSM *smt)
                         {
                           const char *op = t.v.t_operator.value;
 
-                          if (strstr ("({[", op) != NULL)
-                            gb++;
-
-                          if (strstr (")}]", op) != NULL)
-                            gb--;
+                          gb += op_nesting (op);
                         }
                         break;
 
@@ -196,7 +312,7 @@ sf_ast_gen (TokenSM *smt)
                 st.v.s_vardecl.name = sf_expr_gen (smt_back, smtv - 1);
                 st.v.s_vardecl.val = sf_expr_gen (smtv, smt_front - 1);
 
-                res->vals[res->vl++] = st;
+                ast_push (st);
                 smtv = smt_front - 1;
               }
 
@@ -205,42 +321,11 @@ sf_ast_gen (TokenSM *smt)
                 token_t *smt_front = smtv;
                 token_t *smt_back = --smtv; // come to '('
 
+                smt_back = ast_line_start (lt, smt_back, smt->vals);
+
                 int gb = 0;
                 token_t t;
 
-                while (smt_back > smt->vals)
-                  {
-                    t = *--smt_back;
-
-                    switch (t.type)
-                      {
-                      case TOK_OPERATOR:
-                        {
-                          const char *op = t.v.t_operator.value;
-
-                          if (strstr ("({[", op) != NULL)
-                            gb++;
-
-                          if (strstr (")}]", op) != NULL)
-                            gb--;
-                        }
-                        break;
-
-                      case TOK_NEWLINE:
-                        {
-                          if (!gb)
-                            goto l3;
-                        }
-                        break;
-
-                      default:
-                        break;
-                      }
-                  }
-
-              l3:;
-                gb = 0;
-
                 expr_t **args = NULL;
                 size_t argc = 0;
 
@@ -259,19 +344,11 @@ sf_ast_gen (TokenSM *smt)
 
                           if (*op == ')' && !gb)
                             {
-                              if (args == NULL)
-                                {
-                                  if (smt_front - 1 != left)
-                                    args = SFMALLOC (sizeof (*args));
-                                }
-                              else
-                                {
-                                  args = SFREALLOC (
-                                      args, (argc + 1) * sizeof (*args));
-                                }
-
                               if (smt_front - 1 != left)
                                 {
+                                  args = ast_grow (
+                                      args, argc * sizeof (*args),
+                                      (argc + 1) * sizeof (*args));
                                   args[argc++]
                                       = sf_expr_gen (left, smt_front - 1);
                                   left = smt_front;
@@ -282,27 +359,16 @@ sf_ast_gen (TokenSM *smt)
 
                           if (*op == ',' && !gb)
                             {
-                              if (args == NULL)
-                                {
-                                  args = SFMALLOC (sizeof (*args));
-                                }
-                              else
-                                {
-                                  args = SFREALLOC (
-                                      args, (argc + 1) * sizeof (*args));
-                                }
+                              args = ast_grow (args, argc * sizeof (*args),
+                                               (argc + 1) * sizeof (*args));
 
-                              D (sf_token_print (*left));
+                              // D (sf_token_print (*left));
 
                               args[argc++] = sf_expr_gen (left, smt_front - 1);
                               left = smt_front;
                             }
 
-                          if (strstr ("({[", op) != NULL)
-                            gb++;
-
-                          if (strstr (")}]", op) != NULL)
-                            gb--;
+                          gb += op_nesting (op);
                         }
                         break;
 
@@ -324,7 +390,7 @@ sf_ast_gen (TokenSM *smt)
                 st.v.s_funcall.args = args;
                 st.v.s_funcall.argc = argc;
 
-                res->vals[res->vl++] = st;
+                ast_push (st);
                 smtv = smt_front - 1;
               }
           }
@@ -333,10 +399,11 @@ sf_ast_gen (TokenSM *smt)
         case TOK_KEYWORD:
           {
             const char *kw = tok.v.t_keyword.value;
+            token_t *kwp = smtv - 1;
 
             if (!strcmp (kw, "if"))
               {
-                size_t tb = get_tbsp (smtv, smt->vals);
+                size_t tb = ast_tbsp (lt, kwp);
                 // sf_token_print (*smtv);
                 // D (printf ("tabspace: %lu\n", tb));
 
@@ -352,11 +419,7 @@ sf_ast_gen (TokenSM *smt)
                       {
                         const char *op = t.v.t_operator.value;
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
 
                     if (t.type == TOK_NEWLINE && !gb)
@@ -364,7 +427,7 @@ sf_ast_gen (TokenSM *smt)
                   }
 
                 expr_t *cond = sf_expr_gen (l1, --l2);
-                token_t *block_end = get_block (++l2, tb);
+                token_t *block_end = ast_block (lt, kwp, ++l2, tb);
 
                 TokenSM tsmt;
                 tsmt.vals = l2;
@@ -379,7 +442,8 @@ sf_ast_gen (TokenSM *smt)
                 token_t bep = *block_end;
                 block_end->type = TOK_EOF;
 
-                StmtSM *body_smt = sf_ast_gen (&tsmt);
+                size_t bl;
+                stmt_t *body = ast_gen (lt, &tsmt, &bl);
                 *block_end = bep;
 
                 while (block_end->type != TOK_EOF)
@@ -395,17 +459,19 @@ sf_ast_gen (TokenSM *smt)
 
                 stmt_t st;
                 st.type = STMT_IFBLOCK;
-                st.v.s_ifblock.body = body_smt->vals;
-                st.v.s_ifblock.bl = body_smt->vl;
+                st.v.s_ifblock.body = body;
+                st.v.s_ifblock.bl = bl;
                 st.v.s_ifblock.cond = cond;
                 st.v.s_ifblock.else_bl = 0;
                 st.v.s_ifblock.else_body = NULL;
                 smtv = block_end;
 
                 if (block_end->type == TOK_KEYWORD
-                    && !strcmp (block_end->v.t_identifier.value, "else"))
+                    && !strcmp (block_end->v.t_keyword.value, "else"))
                   {
-                    token_t *ebe = get_block (++block_end, tb);
+                    token_t *ebe
+                        = ast_block (lt, block_end, block_end + 1, tb);
+                    block_end++;
                     // sf_token_print (*ebe);
 
                     TokenSM tsmt;
@@ -419,14 +485,14 @@ sf_ast_gen (TokenSM *smt)
                     token_t bep = *ebe;
                     ebe->type = TOK_EOF;
 
-                    StmtSM *eb_smt = sf_ast_gen (&tsmt);
+                    size_t ebl;
+                    stmt_t *eb = ast_gen (lt, &tsmt, &ebl);
                     *ebe = bep;
 
-                    st.v.s_ifblock.else_body = eb_smt->vals;
-                    st.v.s_ifblock.else_bl = eb_smt->vl;
+                    st.v.s_ifblock.else_body = eb;
+                    st.v.s_ifblock.else_bl = ebl;
                     smtv = ebe;
 
-                    SFFREE (eb_smt);
                   }
 
                 if (cond->type == EXPR_CONST)
@@ -441,14 +507,7 @@ sf_ast_gen (TokenSM *smt)
                             if (ifb[i].type == STMT_EOF)
                               break;
 
-                            if (res->vl >= res->vc)
-                              {
-                                res->vc += STMT_SM_VALS_CAP;
-                                res->vals = SFREALLOC (
-                                    res->vals, res->vc * sizeof (*res->vals));
-                              }
-
-                            res->vals[res->vl++] = ifb[i];
+                            ast_push (ifb[i]);
                           }
                       }
                     else
@@ -461,29 +520,18 @@ sf_ast_gen (TokenSM *smt)
                             if (elb[i].type == STMT_EOF)
                               break;
 
-                            if (res->vl >= res->vc)
-                              {
-                                res->vc += STMT_SM_VALS_CAP;
-                                res->vals = SFREALLOC (
-                                    res->vals, res->vc * sizeof (*res->vals));
-                              }
-
-                            res->vals[res->vl++] = elb[i];
+                            ast_push (elb[i]);
                           }
                       }
 
-                    SFFREE (cond);
                   }
                 else
-                  res->vals[res->vl++] = st;
+                  ast_push (st);
 
-                SFFREE (body_smt);
-                // for (int i = 0; i < body_smt->vl; i++)
-                //   sf_stmt_print (body_smt->vals[i]);
               }
             else if (!strcmp (kw, "while"))
               {
-                size_t tb = get_tbsp (smtv, smt->vals);
+                size_t tb = ast_tbsp (lt, kwp);
                 // sf_token_print (*smtv);
                 // D (printf ("tabspace: %lu\n", tb));
 
@@ -499,11 +547,7 @@ sf_ast_gen (TokenSM *smt)
                       {
                         const char *op = t.v.t_operator.value;
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
 
                     if (t.type == TOK_NEWLINE && !gb)
@@ -511,7 +555,7 @@ sf_ast_gen (TokenSM *smt)
                   }
 
                 expr_t *cond = sf_expr_gen (l1, --l2);
-                token_t *block_end = get_block (++l2, tb);
+                token_t *block_end = ast_block (lt, kwp, ++l2, tb);
 
                 TokenSM tsmt;
                 tsmt.vals = l2;
@@ -526,7 +570,8 @@ sf_ast_gen (TokenSM *smt)
                 token_t bep = *block_end;
                 block_end->type = TOK_EOF;
 
-                StmtSM *body_smt = sf_ast_gen (&tsmt);
+                size_t bl;
+                stmt_t *body = ast_gen (lt, &tsmt, &bl);
                 *block_end = bep;
 
                 while (block_end->type != TOK_EOF)
@@ -543,17 +588,16 @@ sf_ast_gen (TokenSM *smt)
                 stmt_t st;
                 st.type = STMT_WHILE;
                 st.v.s_while.cond = cond;
-                st.v.s_while.body = body_smt->vals;
-                st.v.s_while.bl = body_smt->vl;
+                st.v.s_while.body = body;
+                st.v.s_while.bl = bl;
 
                 smtv = block_end;
-                res->vals[res->vl++] = st;
+                ast_push (st);
 
-                SFFREE (body_smt);
               }
             else if (!strcmp (kw, "for"))
               {
-                size_t tb = get_tbsp (smtv, smt->vals);
+                size_t tb = ast_tbsp (lt, kwp);
                 // sf_token_print (*smtv);
                 // D (printf ("tabspace: %lu\n", tb));
 
@@ -561,7 +605,7 @@ sf_ast_gen (TokenSM *smt)
                 token_t *l2 = smtv;
                 token_t *l3 = smtv;
 
-                expr_t **vars = SFMALLOC (64 * sizeof (*vars));
+                expr_t **vars = ast_alloc (64 * sizeof (*vars));
                 size_t vc = 64;
                 size_t vl = 0;
 
@@ -574,18 +618,15 @@ sf_ast_gen (TokenSM *smt)
                       {
                         const char *op = t.v.t_operator.value;
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
 
                         if (*op == ',' && !gb)
                           {
                             if (vl >= vc)
                               {
                                 vc += 64;
-                                vars = SFREALLOC (vars, vc * sizeof (*vars));
+                                vars = ast_grow (vars, vl * sizeof (*vars),
+                                                 vc * sizeof (*vars));
                               }
 
                             vars[vl++] = sf_expr_gen (l3, l2 - 1);
@@ -602,7 +643,8 @@ sf_ast_gen (TokenSM *smt)
                             if (vl >= vc)
                               {
                                 vc += 64;
-                                vars = SFREALLOC (vars, vc * sizeof (*vars));
+                                vars = ast_grow (vars, vl * sizeof (*vars),
+                                                 vc * sizeof (*vars));
                               }
 
                             vars[vl++] = sf_expr_gen (l3, l2 - 1);
@@ -623,11 +665,7 @@ sf_ast_gen (TokenSM *smt)
                       {
                         const char *op = t.v.t_operator.value;
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
 
                     if (t.type == TOK_NEWLINE && !gb)
@@ -643,7 +681,7 @@ sf_ast_gen (TokenSM *smt)
                 //   }
 
                 expr_t *cond = sf_expr_gen (l2, --l1);
-                token_t *block_end = get_block (l1, tb);
+                token_t *block_end = ast_block (lt, kwp, l1, tb);
 
                 TokenSM tsmt;
                 tsmt.vals = l1;
@@ -653,7 +691,8 @@ sf_ast_gen (TokenSM *smt)
                 token_t bep = *block_end;
                 block_end->type = TOK_EOF;
 
-                StmtSM *body_smt = sf_ast_gen (&tsmt);
+                size_t bl;
+                stmt_t *body = ast_gen (lt, &tsmt, &bl);
                 *block_end = bep;
 
                 while (block_end->type != TOK_EOF)
@@ -669,29 +708,28 @@ sf_ast_gen (TokenSM *smt)
 
                 stmt_t st;
                 st.type = STMT_FOR;
-                st.v.s_for.bl = body_smt->vl;
-                st.v.s_for.body = body_smt->vals;
+                st.v.s_for.bl = bl;
+                st.v.s_for.body = body;
                 st.v.s_for.vars = vars;
                 st.v.s_for.vl = vl;
                 st.v.s_for.cond = cond;
 
                 smtv = block_end;
-                res->vals[res->vl++] = st;
+                ast_push (st);
 
-                SFFREE (body_smt);
               }
             else if (!strcmp (kw, "fun"))
               {
-                size_t tb = get_tbsp (smtv, smt->vals);
+                size_t tb = ast_tbsp (lt, kwp);
                 token_t tok_name = *smtv++;
                 assert (tok_name.type == TOK_IDENTIFIER);
 
-                const char *name = tok_name.v.t_identifier.value;
+                const char *name = sf_token_name (&tok_name);
 
                 token_t *x = ++smtv; /* first arg, after '(' */
                 token_t *y = x;
 
-                expr_t **args = SFMALLOC (8 * sizeof (*args));
+                expr_t **args = ast_alloc (8 * sizeof (*args));
                 size_t ac = 8;
                 size_t al = 0;
 
@@ -714,8 +752,8 @@ sf_ast_gen (TokenSM *smt)
                                 if (al >= ac)
                                   {
                                     ac += 8;
-                                    args = SFREALLOC (args,
-                                                      ac * sizeof (*args));
+                                    args = ast_grow (args, al * sizeof (*args),
+                                                     ac * sizeof (*args));
                                   }
 
                                 args[al++] = sf_expr_gen (x, y);
@@ -729,24 +767,21 @@ sf_ast_gen (TokenSM *smt)
                             if (al >= ac)
                               {
                                 ac += 8;
-                                args = SFREALLOC (args, ac * sizeof (*args));
+                                args = ast_grow (args, al * sizeof (*args),
+                                                 ac * sizeof (*args));
                               }
 
                             args[al++] = sf_expr_gen (x, y);
                             x = ++smtv;
                           }
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
 
                     y = ++smtv;
                   }
 
-                token_t *block_end = get_block (++smtv, tb);
+                token_t *block_end = ast_block (lt, kwp, ++smtv, tb);
 
                 TokenSM tsmt;
                 tsmt.vals = smtv;
@@ -761,7 +796,8 @@ sf_ast_gen (TokenSM *smt)
                 token_t bep = *block_end;
                 block_end->type = TOK_EOF;
 
-                StmtSM *body_smt = sf_ast_gen (&tsmt);
+                size_t bl;
+                stmt_t *body = ast_gen (lt, &tsmt, &bl);
                 *block_end = bep;
 
                 while (block_end->type != TOK_EOF)
@@ -779,14 +815,13 @@ sf_ast_gen (TokenSM *smt)
                 st.type = STMT_FUNDECL;
                 st.v.s_fundecl.argc = al;
                 st.v.s_fundecl.args = args;
-                st.v.s_fundecl.body = body_smt->vals;
-                st.v.s_fundecl.bl = body_smt->vl;
+                st.v.s_fundecl.body = body;
+                st.v.s_fundecl.bl = bl;
                 st.v.s_fundecl.name = name;
 
                 smtv = block_end;
-                res->vals[res->vl++] = st;
+                ast_push (st);
 
-                SFFREE (body_smt);
               }
             else if (!strcmp (kw, "return"))
               {
@@ -797,11 +832,11 @@ sf_ast_gen (TokenSM *smt)
                     /* return none */
                     stmt_t st;
                     st.type = STMT_RETURN;
-                    expr_t *re = SFMALLOC (sizeof (*re));
+                    expr_t *re = ast_alloc (sizeof (*re));
                     re->type = EXPR_CONST;
                     re->v.e_const.v.type = CONST_NONE;
                     st.v.s_return.v = re;
-                    res->vals[res->vl++] = st;
+                    ast_push (st);
                   }
                 else
                   {
@@ -816,11 +851,7 @@ sf_ast_gen (TokenSM *smt)
                           {
                             const char *op = y->v.t_operator.value;
 
-                            if (strstr ("({[", op) != NULL)
-                              gb++;
-
-                            if (strstr (")}]", op) != NULL)
-                              gb--;
+                            gb += op_nesting (op);
                           }
 
                         if (t.type == TOK_NEWLINE && !gb)
@@ -834,21 +865,21 @@ sf_ast_gen (TokenSM *smt)
                     stmt_t st;
                     st.type = STMT_RETURN;
                     st.v.s_return.v = re;
-                    res->vals[res->vl++] = st;
+                    ast_push (st);
 
                     smtv = --y;
                   }
               }
             else if (!strcmp (kw, "class"))
               {
-                size_t tb = get_tbsp (smtv, smt->vals);
+                size_t tb = ast_tbsp (lt, kwp);
 
                 token_t *t_name = smtv;
                 assert (t_name->type == TOK_IDENTIFIER);
 
-                const char *name = t_name->v.t_identifier.value;
+                const char *name = sf_token_name (t_name);
 
-                token_t *block_end = get_block (++smtv, tb);
+                token_t *block_end = ast_block (lt, kwp, ++smtv, tb);
 
                 TokenSM tsmt;
                 tsmt.vals = smtv;
@@ -863,7 +894,8 @@ sf_ast_gen (TokenSM *smt)
                 token_t bep = *block_end;
                 block_end->type = TOK_EOF;
 
-                StmtSM *body_smt = sf_ast_gen (&tsmt);
+                size_t bl;
+                stmt_t *body = ast_gen (lt, &tsmt, &bl);
                 *block_end = bep;
 
                 while (block_end->type != TOK_EOF)
@@ -880,18 +912,19 @@ sf_ast_gen (TokenSM *smt)
                 stmt_t st;
                 st.type = STMT_CLASSDECL;
                 st.v.s_classdecl.name = name;
-                st.v.s_classdecl.body = body_smt->vals;
-                st.v.s_classdecl.bl = body_smt->vl;
+                st.v.s_classdecl.body = body;
+                st.v.s_classdecl.bl = bl;
 
-                res->vals[res->vl++] = st;
+                ast_push (st);
                 smtv = block_end;
 
-                SFFREE (body_smt);
               }
             else if (!strcmp (kw, "import"))
               {
                 assert (smtv->type == TOK_STRING);
-                const char *path = smtv->v.t_string.value;
+                char *raw_path = sf_token_string (smtv);
+                const char *path = sf_intern (raw_path, strlen (raw_path));
+                SFFREE (raw_path);
 
                 tok = *++smtv;
                 assert (tok.type == TOK_KEYWORD
@@ -899,14 +932,14 @@ sf_ast_gen (TokenSM *smt)
 
                 tok = *++smtv;
                 assert (tok.type == TOK_IDENTIFIER);
-                const char *alias = tok.v.t_identifier.value;
+                const char *alias = sf_token_name (&tok);
 
                 stmt_t st;
                 st.type = STMT_IMPORT;
                 st.v.s_import.alias = alias;
                 st.v.s_import.path = path;
 
-                res->vals[res->vl++] = st;
+                ast_push (st);
               }
           }
           break;
@@ -920,18 +953,57 @@ sf_ast_gen (TokenSM *smt)
 
   stmt_t st;
   st.type = STMT_EOF;
+  ast_push (st);
 
-  if (res->vl >= res->vc)
-    {
-      res->vc += STMT_SM_VALS_CAP;
-      res->vals = SFREALLOC (res->vals, res->vc * sizeof (*res->vals));
-    }
+  *n = ast_ctx.sl - base;
+  stmt_t *vals = ast_alloc (*n * sizeof (*vals));
+  memcpy (vals, ast_ctx.stmts + base, *n * sizeof (*vals));
+
+  ast_ctx.sl = base;
+  return vals;
+}
+
+SF_API StmtSM *
+sf_ast_gen (TokenSM *smt)
+{
+  StmtSM *res = SFMALLOC (sizeof (*res));
+  sf_arena_init (&res->arena);
+
+  assert (ast_ctx.arena == NULL);
+  ast_ctx.arena = &res->arena;
 
-  res->vals[res->vl++] = st;
+  ast_lines_t lt;
+  ast_lines_build (&lt, smt->vals);
+
+  res->vals = ast_gen (&lt, smt, &res->vl);
+  res->vc = res->vl;
+
+  SFFREE (lt.of);
+  SFFREE (lt.lines);
+  SFFREE (ast_ctx.stmts);
+  ast_ctx = (ast_ctx_t){ 0 };
 
   return res;
 }
 
+/* the whole tree goes in one call, codegen keeps nothing of it */
+SF_API void
+sf_ast_free (StmtSM *stt)
+{
+  sf_arena_free (&stt->arena);
+  SFFREE (stt);
+}
+
+/* one bound of a slice, NULL when it was left out (a[:n], a[::2]) */
+static expr_t *
+slice_part (token_t *start, token_t *end)
+{
+  if (start == end)
+    return NULL;
+
+  return sf_expr_gen (start, end);
+}
+
 SF_API expr_t *
 sf_expr_gen (token_t *start, token_t *end)
 {
@@ -957,10 +1029,10 @@ sf_expr_gen (token_t *start, token_t *end)
         {
         case TOK_IDENTIFIER:
           {
-            const char *id = t.v.t_identifier.value;
+            const char *id = sf_token_name (&t);
 
             e.type = EXPR_VAR;
-            e.v.e_var.v = SFSTRDUP (id);
+            e.v.e_var.v = id;
           }
           break;
 
@@ -984,7 +1056,8 @@ sf_expr_gen (token_t *start, token_t *end)
           {
             e.type = EXPR_CONST;
             e.v.e_const.v.type = CONST_STRING;
-            e.v.e_const.v.v.c_str.v = SFSTRDUP (t.v.t_string.value);
+            e.v.e_const.v.v.c_str.v
+                = sf_token_string_to (&t, ast_alloc (t.len + 1));
           }
           break;
 
@@ -1013,9 +1086,9 @@ sf_expr_gen (token_t *start, token_t *end)
                 size_t nc = 8;
                 size_t nl = 0;
 
-                arith_node_t *nodes = SFMALLOC (nc * sizeof (*nodes));
+                arith_node_t *nodes = ast_alloc (nc * sizeof (*nodes));
 
-                expr_t *em = SFMALLOC (sizeof (*em));
+                expr_t *em = ast_alloc (sizeof (*em));
                 *em = e;
                 nodes[nl++]
                     = (arith_node_t){ .type = ARITH_NODE_E_O, .v.expr = em };
@@ -1036,11 +1109,7 @@ sf_expr_gen (token_t *start, token_t *end)
                       {
                         const char *op = t.v.t_operator.value;
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
 
                         if (strstr ("+-*/%", (char *)(char[]){ *op, '\0' })
                             && op[1] == '\0' && !gb)
@@ -1048,8 +1117,8 @@ sf_expr_gen (token_t *start, token_t *end)
                             if (nl >= nc)
                               {
                                 nc += 8;
-                                nodes
-                                    = SFREALLOC (nodes, nc * sizeof (*nodes));
+                                nodes = ast_grow (nodes, nl * sizeof (*nodes),
+                                                  nc * sizeof (*nodes));
                               }
 
                             nodes[nl++]
@@ -1076,7 +1145,8 @@ sf_expr_gen (token_t *start, token_t *end)
                 if (nl >= nc)
                   {
                     nc += 8;
-                    nodes = SFREALLOC (nodes, nc * sizeof (*nodes));
+                    nodes = ast_grow (nodes, nl * sizeof (*nodes),
+                                      nc * sizeof (*nodes));
                   }
 
                 nodes[nl++]
@@ -1100,8 +1170,6 @@ sf_expr_gen (token_t *start, token_t *end)
                   {
                     e.type = EXPR_ADD_1;
                     e.v.e_add_one.v = nodes[0].v.expr;
-
-                    SFFREE (nodes);
                   }
                 else if (!all_consts && nl == 3
                          && nodes[1].type == ARITH_NODE_OPERATOR
@@ -1113,8 +1181,6 @@ sf_expr_gen (token_t *start, token_t *end)
                   {
                     e.type = EXPR_ADD_1;
                     e.v.e_add_one.v = nodes[2].v.expr;
-
-                    SFFREE (nodes);
                   }
                 else
                   {
@@ -1123,14 +1189,19 @@ sf_expr_gen (token_t *start, token_t *end)
 
                     if (all_consts)
                       {
-
                         expr_t _e = sf_arith_eval_consttree (nodes, nl);
+                        const_t *c = &_e.v.e_const.v;
+
+                        /* a folded string comes back on the heap */
+                        if (_e.type == EXPR_CONST && c->type == CONST_STRING)
+                          {
+                            char *hs = c->v.c_str.v;
+                            size_t hl = strlen (hs) + 1;
 
-                        for (int i = 0; i < nl; i++)
-                          if (nodes[i].type == ARITH_NODE_E_O)
-                            SFFREE (nodes[i].v.expr);
+                            c->v.c_str.v = memcpy (ast_alloc (hl), hs, hl);
+                            SFFREE (hs);
+                          }
 
-                        SFFREE (nodes);
                         // sf_expr_print (_e);
 
                         e = _e;
@@ -1189,19 +1260,15 @@ sf_expr_gen (token_t *start, token_t *end)
                             left = start;
                           }
 
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
                   }
 
                 assert (_end && "syntax error");
-                r.v.e_funcall.name = SFMALLOC (sizeof (*r.v.e_funcall.name));
+                r.v.e_funcall.name = ast_alloc (sizeof (*r.v.e_funcall.name));
                 *r.v.e_funcall.name = e;
                 r.v.e_funcall.al = al;
-                r.v.e_funcall.args = SFMALLOC (r.v.e_funcall.al
+                r.v.e_funcall.args = ast_alloc (r.v.e_funcall.al
                                                * sizeof (*r.v.e_funcall.args));
 
                 for (size_t i = 0; i < al; i++)
@@ -1213,7 +1280,7 @@ sf_expr_gen (token_t *start, token_t *end)
               {
                 expr_t re;
                 re.type = EXPR_CMP;
-                re.v.e_cmp.left = SFMALLOC (sizeof (*re.v.e_cmp.left));
+                re.v.e_cmp.left = ast_alloc (sizeof (*re.v.e_cmp.left));
                 *re.v.e_cmp.left = e;
 
                 if (*op == '=')
@@ -1241,7 +1308,7 @@ sf_expr_gen (token_t *start, token_t *end)
               {
                 expr_t re;
                 re.type = EXPR_CMP;
-                re.v.e_cmp.left = SFMALLOC (sizeof (*re.v.e_cmp.left));
+                re.v.e_cmp.left = ast_alloc (sizeof (*re.v.e_cmp.left));
                 *re.v.e_cmp.left = e;
 
                 if (*op == '<')
@@ -1257,16 +1324,89 @@ sf_expr_gen (token_t *start, token_t *end)
                 e = re;
                 goto end;
               }
+            else if (*op == '{' && e.type == -1)
+              {
+                size_t kc = 8;
+                size_t kl = 0;
+                expr_t **keys = ast_alloc (kc * sizeof (*keys));
+                expr_t **vals = ast_alloc (kc * sizeof (*vals));
+
+                token_t *left = start;
+                token_t *colon = NULL;
+                int gb = 0;
+                int _end = 0;
+
+                while (start <= end)
+                  {
+                    token_t u = *start++;
+
+                    if (u.type != TOK_OPERATOR)
+                      continue;
+
+                    const char *op = u.v.t_operator.value;
+
+                    if ((*op == '}' || *op == ',') && !gb)
+                      {
+                        if (*op == '}')
+                          _end = 1;
+
+                        /* {} and a trailing comma add nothing */
+                        if (left == start - 1 && colon == NULL)
+                          {
+                            if (_end)
+                              break;
+
+                            continue;
+                          }
+
+                        assert (colon != NULL && "syntax error");
+
+                        if (kl == kc)
+                          {
+                            kc *= 2;
+                            keys = ast_grow (keys, kl * sizeof (*keys),
+                                             kc * sizeof (*keys));
+                            vals = ast_grow (vals, kl * sizeof (*vals),
+                                             kc * sizeof (*vals));
+                          }
+
+                        keys[kl] = sf_expr_gen (left, colon);
+                        vals[kl++] = sf_expr_gen (colon + 1, start - 1);
+
+                        left = start;
+                        colon = NULL;
+
+                        if (_end)
+                          break;
+
+                        continue;
+                      }
+
+                    if (*op == ':' && !gb)
+                      {
+                        assert (colon == NULL && "syntax error");
+                        colon = start - 1;
+                      }
+
+                    gb += op_nesting (op);
+                  }
+
+                assert (_end && "syntax error");
+
+                e.type = EXPR_DICT;
+                e.v.e_dict.keys = keys;
+                e.v.e_dict.vals = vals;
+                e.v.e_dict.vl = kl;
+              }
             else if (*op == '.')
               {
                 assert (start->type == TOK_IDENTIFIER);
 
                 expr_t re;
                 re.type = EXPR_DOT_ACCESS;
-                re.v.e_dota.left = SFMALLOC (sizeof (*re.v.e_dota.left));
+                re.v.e_dota.left = ast_alloc (sizeof (*re.v.e_dota.left));
                 *re.v.e_dota.left = e;
-                re.v.e_dota.right
-                    = (char *)SFSTRDUP (start->v.t_identifier.value);
+                re.v.e_dota.right = (char *)sf_token_name (start);
 
                 e = re;
                 start++;
@@ -1275,7 +1415,7 @@ sf_expr_gen (token_t *start, token_t *end)
               {
                 if (e.type == -1)
                   {
-                    expr_t **args = SFMALLOC (64 * sizeof (*args));
+                    expr_t **args = ast_alloc (64 * sizeof (*args));
                     size_t ac = 64;
                     size_t al = 0;
 
@@ -1293,7 +1433,8 @@ sf_expr_gen (token_t *start, token_t *end)
                         if (al >= ac)
                           {
                             ac += 64;
-                            args = SFREALLOC (args, ac * sizeof (*args));
+                            args = ast_grow (args, al * sizeof (*args),
+                                             ac * sizeof (*args));
                           }
 
                         if (u.type == TOK_OPERATOR)
@@ -1320,11 +1461,7 @@ sf_expr_gen (token_t *start, token_t *end)
                                 left = start;
                               }
 
-                            if (strstr ("({[", op) != NULL)
-                              gb++;
-
-                            if (strstr (")}]", op) != NULL)
-                              gb--;
+                            gb += op_nesting (op);
                           }
                       }
 
@@ -1339,6 +1476,8 @@ sf_expr_gen (token_t *start, token_t *end)
                     int gb = 0;
                     int _end = 0;
                     token_t *stp = start;
+                    token_t *colons[2];
+                    int nc = 0;
 
                     while (start <= end)
                       {
@@ -1354,22 +1493,43 @@ sf_expr_gen (token_t *start, token_t *end)
                                 break;
                               }
 
-                            if (strstr ("({[", op) != NULL)
-                              gb++;
+                            if (*op == ':' && !gb)
+                              {
+                                assert (nc < 2 && "syntax error");
+                                colons[nc++] = start - 1;
+                              }
 
-                            if (strstr (")}]", op) != NULL)
-                              gb--;
+                            gb += op_nesting (op);
                           }
                       }
 
                     assert (_end && "syntax error");
 
                     expr_t ep = e;
-                    e.type = EXPR_SQUARE_ACCESS;
-                    e.v.e_sqr_access.idx = sf_expr_gen (stp, start);
-                    e.v.e_sqr_access.parent
-                        = SFMALLOC (sizeof (*e.v.e_sqr_access.parent));
-                    *e.v.e_sqr_access.parent = ep;
+
+                    if (nc)
+                      {
+                        token_t *rb = start - 1;
+
+                        e.type = EXPR_SLICE;
+                        e.v.e_slice.parent
+                            = ast_alloc (sizeof (*e.v.e_slice.parent));
+                        *e.v.e_slice.parent = ep;
+
+                        e.v.e_slice.lo = slice_part (stp, colons[0]);
+                        e.v.e_slice.hi = slice_part (
+                            colons[0] + 1, nc > 1 ? colons[1] : rb);
+                        e.v.e_slice.step
+                            = nc > 1 ? slice_part (colons[1] + 1, rb) : NULL;
+                      }
+                    else
+                      {
+                        e.type = EXPR_SQUARE_ACCESS;
+                        e.v.e_sqr_access.idx = sf_expr_gen (stp, start);
+                        e.v.e_sqr_access.parent
+                            = ast_alloc (sizeof (*e.v.e_sqr_access.parent));
+                        *e.v.e_sqr_access.parent = ep;
+                      }
                   }
               }
           }
@@ -1385,7 +1545,7 @@ sf_expr_gen (token_t *start, token_t *end)
                 e.type = EXPR_TO_STEP;
 
                 e.v.e_to_step.lval
-                    = SFMALLOC (1 * sizeof (*e.v.e_to_step.lval));
+                    = ast_alloc (1 * sizeof (*e.v.e_to_step.lval));
                 *e.v.e_to_step.lval = ep;
 
                 int gb = 0;
@@ -1399,11 +1559,7 @@ sf_expr_gen (token_t *start, token_t *end)
                     if (u.type == TOK_OPERATOR)
                       {
                         const char *op = u.v.t_operator.value;
-                        if (strstr ("({[", op) != NULL)
-                          gb++;
-
-                        if (strstr (")}]", op) != NULL)
-                          gb--;
+                        gb += op_nesting (op);
                       }
 
                     if (u.type == TOK_KEYWORD && !gb)
@@ -1438,7 +1594,7 @@ sf_expr_gen (token_t *start, token_t *end)
     }
 
 end:;
-  expr_t *ee = SFMALLOC (sizeof (*ee));
+  expr_t *ee = ast_alloc (sizeof (*ee));
   *ee = e;
   return ee;
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ extern "C"
 
   SF_API expr_t *sf_expr_gen (token_t *, token_t *);
   SF_API StmtSM *sf_ast_gen (TokenSM *);
+  SF_API void sf_ast_free (StmtSM *);
 
 #if defined(__cplusplus)
 }
@@ -1,12 +1,24 @@
 #include "bytecode.h"
 #include "ast.h"
 #include "codegen.h"
+#include "fishc.h"
+#include "jit.h"
 #include "mod.h"
 #include "natives.h"
+#include "opt.h"
+#include "reg.h"
 #include "token.h"
+#include "verify.h"
 
 static const_t __sf_none_obj = (const_t){ .type = CONST_NONE };
 
+/* the step is inlined into the interpreter loop as well as sf_vm_step */
+#if defined(__GNUC__)
+#define VM_STEP_INLINE inline __attribute__ ((always_inline))
+#else
+#define VM_STEP_INLINE inline
+#endif // __GNUC__
+
 SF_API vm_t
 sf_vm_new ()
 {
@@ -14,14 +26,11 @@ sf_vm_new ()
 
   v.globals_cap = SF_VM_GLOBALS_CAP;
   v.globals = SFMALLOC (v.globals_cap * sizeof (*v.globals));
-  v.htc = SF_VM_HT_CAP;
-  v.htl = 0;
-  v.hts = SFMALLOC (v.htc * sizeof (*v.hts));
-
-  for (size_t i = 0; i < v.htc; i++)
-    v.hts[i] = NULL;
-
-  v.hts[v.htl++] = sf_ht_new ();
+  v.scc = SF_VM_SCOPES_CAP;
+  v.scl = 0;
+  v.scopes = SFMALLOC (v.scc * sizeof (*v.scopes));
+  sf_arena_init (&v.cg_arena);
+  sf_scope_open (&v.scopes[v.scl++], &v.cg_arena);
   v.inst_cap = 64;
   v.inst_len = 0;
   v.insts = SFMALLOC (v.inst_cap * sizeof (*v.insts));
@@ -40,6 +49,13 @@ sf_vm_new ()
   v.meta.l_slot = 0;
   v.meta.n_slot = 0;
   v.mod_store = sf_modstore_new ();
+  v.opt = sf_opt_parse (getenv ("SF_OPT"), SF_OPT_DEFAULT);
+  v.inline_len = sf_opt_parse_len (getenv ("SF_INLINE"), SF_INLINE_LEN);
+  v.jit = sf_jit_new (sf_jit_parse (getenv ("SF_JIT"), SF_JIT_ON));
+  v.reg = NULL;
+  v.verify = sf_verify_new (sf_verify_parse (getenv ("SF_VERIFY"), 1));
+  sf_reg_use (&v, sf_reg_parse (getenv ("SF_VM"), SF_TIER_STACK));
+  v.cg_loop = NULL;
 
   for (int i = 0; i < v.globals_cap; i++)
     v.globals[i] = NULL;
@@ -47,110 +63,69 @@ sf_vm_new ()
   return v;
 }
 
+static const char *const op_names[] = {
+  [OP_LOAD_CONST] = "OP_LOAD_CONST",
+  [OP_LOAD_FAST] = "OP_LOAD_FAST",
+  [OP_LOAD] = "OP_LOAD",
+  [OP_LOAD_NAME] = "OP_LOAD_NAME",
+  [OP_STORE] = "OP_STORE",
+  [OP_STORE_FAST] = "OP_STORE_FAST",
+  [OP_RETURN] = "OP_RETURN",
+  [OP_CALL] = "OP_CALL",
+  [OP_ADD_1] = "OP_ADD_1",
+  [OP_ADD] = "OP_ADD",
+  [OP_SUB] = "OP_SUB",
+  [OP_MUL] = "OP_MUL",
+  [OP_DIV] = "OP_DIV",
+  [OP_JUMP] = "OP_JUMP",
+  [OP_JUMP_IF_FALSE] = "OP_JUMP_IF_FALSE",
+  [OP_LOAD_FUNC_CODED] = "OP_LOAD_FUNC_CODED",
+  [OP_CMP] = "OP_CMP",
+  [OP_LOAD_BUILDCLASS] = "OP_LOAD_BUILDCLASS",
+  [OP_LOAD_BUILDCLASS_END] = "OP_LOAD_BUILDCLASS_END",
+  [OP_STORE_NAME] = "OP_STORE_NAME",
+  [OP_DOT_ACCESS] = "OP_DOT_ACCESS",
+  [OP_LOAD_ARRAY] = "OP_LOAD_ARRAY",
+  [OP_SQR_ACCESS] = "OP_SQR_ACCESS",
+  [OP_STORE_SQR] = "OP_STORE_SQR",
+  [OP_RANGE_FAST] = "OP_RANGE_FAST",
+  [OP_GET_ITER] = "OP_GET_ITER",
+  [OP_LOAD_ITER_NEXT] = "OP_LOAD_ITER_NEXT",
+  [OP_IMPORT] = "OP_IMPORT",
+  [OP_IMPORT_ALIAS] = "OP_IMPORT_ALIAS",
+  [OP_SLICE] = "OP_SLICE",
+  [OP_LOAD_DICT] = "OP_LOAD_DICT",
+  [OP_DUP] = "OP_DUP",
+  [OP_LOAD_I] = "OP_LOAD_I",
+  [OP_STORE_I] = "OP_STORE_I",
+  [OP_CONST_I] = "OP_CONST_I",
+  [OP_ADD_I] = "OP_ADD_I",
+  [OP_SUB_I] = "OP_SUB_I",
+  [OP_MUL_I] = "OP_MUL_I",
+  [OP_ADD_1_I] = "OP_ADD_1_I",
+  [OP_CMP_I] = "OP_CMP_I",
+  [OP_CMP_JUMP_I] = "OP_CMP_JUMP_I",
+  [OP_DUP_I] = "OP_DUP_I",
+  [OP_GUARD_FN] = "OP_GUARD_FN",
+  [OP_GUARD_METHOD] = "OP_GUARD_METHOD",
+  [OP_TAIL_CALL] = "OP_TAIL_CALL",
+  [OP_CMP_JUMP] = "OP_CMP_JUMP",
+};
+
+SF_API const char *
+sf_vm_op_name (opcode_t op)
+{
+  if ((size_t)op >= sizeof (op_names) / sizeof (*op_names)
+      || op_names[op] == NULL)
+    return "UNKNOWN";
+
+  return op_names[op];
+}
+
 SF_API void
 sf_vm_print_inst (instr_t i)
 {
-  switch (i.op)
-    {
-    case OP_LOAD_CONST:
-      fputs ("OP_LOAD_CONST:", stdout);
-      break;
-    case OP_LOAD_FAST:
-      fputs ("OP_LOAD_FAST:", stdout);
-      break;
-    case OP_LOAD:
-      fputs ("OP_LOAD:", stdout);
-      break;
-    case OP_LOAD_NAME:
-      printf ("OP_LOAD_NAME: '%s' ", i.c);
-      break;
-    case OP_STORE:
-      fputs ("OP_STORE:", stdout);
-      break;
-    case OP_STORE_FAST:
-      fputs ("OP_STORE_FAST:", stdout);
-      break;
-    case OP_RETURN:
-      fputs ("OP_RETURN:", stdout);
-      break;
-    case OP_CALL:
-      fputs ("OP_CALL:", stdout);
-      break;
-    case OP_ADD_1:
-      fputs ("OP_ADD_1:", stdout);
-      break;
-    case OP_ADD:
-      fputs ("OP_ADD:", stdout);
-      break;
-    case OP_SUB:
-      fputs ("OP_SUB:", stdout);
-      break;
-    case OP_MUL:
-      fputs ("OP_MUL:", stdout);
-      break;
-    case OP_DIV:
-      fputs ("OP_DIV:", stdout);
-      break;
-    case OP_JUMP:
-      fputs ("OP_JUMP:", stdout);
-      break;
-    case OP_JUMP_IF_FALSE:
-      fputs ("OP_JUMP_IF_FALSE:", stdout);
-      break;
-    case OP_LOAD_FUNC_CODED:
-      fputs ("OP_LOAD_FUNC_CODED:", stdout);
-      break;
-    case OP_CMP:
-      fputs ("OP_CMP:", stdout);
-      break;
-    case OP_LOAD_BUILDCLASS:
-      fputs ("OP_LOAD_BUILDCLASS:", stdout);
-      break;
-    case OP_LOAD_BUILDCLASS_END:
-      fputs ("OP_LOAD_BUILDCLASS_END:", stdout);
-      break;
-    case OP_STORE_NAME:
-      printf ("OP_STORE_NAME: '%s'", i.c);
-      break;
-    case OP_DOT_ACCESS:
-      printf ("OP_DOT_ACCESS: '%s'", i.c);
-      break;
-    case OP_LOAD_ARRAY:
-      printf ("OP_LOAD_ARRAY: ");
-      break;
-    case OP_SQR_ACCESS:
-      printf ("OP_SQR_ACCESS: ");
-      break;
-    case OP_STORE_SQR:
-      printf ("OP_STORE_SQR: ");
-      break;
-    case OP_RANGE_FAST:
-      printf ("OP_RANGE_FAST: ");
-      break;
-    case OP_GET_ITER:
-      printf ("OP_GET_ITER: ");
-      break;
-    case OP_LOAD_ITER_NEXT:
-      printf ("OP_LOAD_ITER_NEXT: ");
-      break;
-    case OP_IMPORT:
-      printf ("OP_IMPORT: '%s' ", i.c);
-      break;
-    case OP_IMPORT_ALIAS:
-      printf ("OP_IMPORT_ALIAS: '%s' ", i.c);
-      break;
-    // case OP_STACK_POP:
-    //   fputs ("OP_STACK_POP:", stdout);
-    //   break;
-    // case OP_STACK_PUSH:
-    //   fputs ("OP_STACK_PUSH:", stdout);
-    //   break;
-    default:
-      fputs ("UNKNOWN:", stdout);
-      break;
-    }
-
-  printf (" %d %d\n", i.a, i.b);
+  printf ("%s: %d %d\n", sf_vm_op_name (i.op), i.a, i.b);
 }
 
 SF_API void
@@ -163,10 +138,15 @@ sf_vm_print_b (vm_t *vm)
     }
 }
 
+/**
+ * The stack as vm_step sees it. Code the verifier passed (see verify.h)
+ * has room for its deepest stack made on entry and never pops what is
+ * not there, it runs with checked 0 and goes without the checks.
+ */
 static inline void
-push (vm_t *vm, obj_t *obj)
+push (vm_t *vm, obj_t *obj, int checked)
 {
-  if (vm->sp >= vm->stack_cap)
+  if (checked && vm->sp >= vm->stack_cap)
     {
       vm->stack_cap += SF_VM_STACK_CAP;
       vm->stack = SFREALLOC (vm->stack, vm->stack_cap * sizeof (*vm->stack));
@@ -176,9 +156,9 @@ push (vm_t *vm, obj_t *obj)
 }
 
 static inline obj_t *
-pop (vm_t *vm)
+pop (vm_t *vm, int checked)
 {
-  if (!vm->sp)
+  if (checked && !vm->sp)
     {
       D (printf ("vm_ip: %lu\n", vm->ip));
       D (printf ("error: popping from empty stack\n"));
@@ -188,1685 +168,1906 @@ pop (vm_t *vm)
   return vm->stack[--vm->sp];
 }
 
-SF_API void
-sf_vm_exec_single_frame (vm_t *vm)
+/* none, for what an op does not handle: its result still takes the slot
+   on the stack the verifier counts on */
+static inline void
+push_none (vm_t *vm, int checked)
 {
-  frame_t *fr = &vm->frames[vm->fp - 1];
-  instr_t i = vm->insts[vm->ip];
+  obj_t *o = sf_objstore_req_forconst (&__sf_none_obj);
 
-  if (vm->meta.g_slot >= vm->globals_cap)
+  IR (o);
+  push (vm, o, checked);
+}
+
+/* call args are popped last-first, natives take them in source order */
+static inline void
+native_args_inorder (obj_t **args, size_t al)
+{
+  for (size_t i = 0; i < al / 2; i++)
     {
-      vm->globals_cap += SF_VM_GLOBALS_CAP;
-      vm->globals
-          = SFREALLOC (vm->globals, vm->globals_cap * sizeof (*vm->globals));
+      obj_t *t = args[i];
+      args[i] = args[al - 1 - i];
+      args[al - 1 - i] = t;
     }
+}
 
-start:;
-  while (1)
+/* whether o is the coded function at lp */
+static int
+coded_at (obj_t *o, size_t lp)
+{
+  return o != NULL && o->type == OBJ_FUNC
+         && o->v.o_fun.v->type == FUN_CODED && o->v.o_fun.v->v.coded.lp == lp;
+}
+
+/* whether name on o is the coded method at lp, where container_access
+   would find it, and calling it needs no frame of the class's module */
+static int
+method_at (obj_t *o, const char *name, size_t lp)
+{
+  if (o == NULL || o->type != OBJ_COBJ)
+    return 0;
+
+  cobj_t *c = o->v.o_cobj.v;
+
+  if (c->p->par_fr != NULL)
+    return 0;
+
+  for (size_t i = 0; i < c->svl; i++)
+    if (c->slots[i] != NULL && !strcmp (c->slots[i], name))
+      return 0;
+
+  for (size_t i = 0; i < c->p->svl; i++)
+    if (c->p->slots[i] != NULL && !strcmp (c->p->slots[i], name))
+      return coded_at (c->p->vals[i], lp);
+
+  return 0;
+}
+
+/* what OP_CMP of type finds for l and r */
+static int
+cmp_obj (int type, obj_t *l, obj_t *r)
+{
+  switch (type)
     {
-      // D (printf ("%lu\n", vm->ip));
-      switch (i.op)
+    case CMP_EQEQ:
+      return sf_obj_eqeq (l, r);
+    case CMP_GE:
+      return sf_obj_ge (l, r);
+    case CMP_GEQ:
+      return sf_obj_geq (l, r);
+    case CMP_LE:
+      return sf_obj_le (l, r);
+    case CMP_LEQ:
+      return sf_obj_leq (l, r);
+    case CMP_NEQ:
+      return sf_obj_neq (l, r);
+    default:
+      return 0;
+    }
+}
+
+static inline void
+push_i (vm_t *vm, int v, int checked)
+{
+  push (vm, SF_VM_RAW (v), checked);
+}
+
+static inline int
+pop_i (vm_t *vm, int checked)
+{
+  return SF_VM_UNRAW (pop (vm, checked));
+}
+
+/* v as an object with a reference of its own, where b asks for that */
+static inline void
+push_i_as (vm_t *vm, int v, int b, int checked)
+{
+  if (!b)
+    {
+      push_i (vm, v, checked);
+      return;
+    }
+
+  obj_t *o = sf_objstore_box (
+      &(const_t){ .type = CONST_INT, .v.c_int.v = v });
+
+  IR (o);
+  push (vm, o, checked);
+}
+
+/* what OP_CMP of type finds for the ints l and r, ordered as floats
+   like sf_obj_le and friends */
+static inline int
+cmp_int (int type, int l, int r)
+{
+  switch (type)
+    {
+    case CMP_EQEQ:
+      return l == r;
+    case CMP_NEQ:
+      return l != r;
+    case CMP_LE:
+      return (float)l < (float)r;
+    case CMP_GE:
+      return (float)l > (float)r;
+    case CMP_LEQ:
+      return (float)l <= (float)r;
+    case CMP_GEQ:
+      return (float)l >= (float)r;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * OP_CMP_I and OP_CMP_JUMP_I. An operand that is an object is guarded
+ * on being an int, one that is not gets the raw one boxed and goes to
+ * the comparisons OP_CMP uses.
+ */
+static int
+cmp_i (vm_t *vm, int b, int checked)
+{
+  obj_t *ro = pop (vm, checked), *lo = pop (vm, checked);
+  int type = SF_CMP_I (b), rc;
+  int lint = !(b & SF_CMP_L_OBJ)
+             || (lo->type == OBJ_CONST
+                 && lo->v.o_const.v.type == CONST_INT);
+  int rint = !(b & SF_CMP_R_OBJ)
+             || (ro->type == OBJ_CONST
+                 && ro->v.o_const.v.type == CONST_INT);
+
+  if (lint && rint)
+    {
+      int l = b & SF_CMP_L_OBJ ? lo->v.o_const.v.v.c_int.v
+                               : SF_VM_UNRAW (lo);
+      int r = b & SF_CMP_R_OBJ ? ro->v.o_const.v.v.c_int.v
+                               : SF_VM_UNRAW (ro);
+
+      rc = cmp_int (type, l, r);
+    }
+  else
+    {
+      if (!(b & SF_CMP_L_OBJ))
         {
-        case OP_RETURN:
-          {
-            obj_t *o = NULL;
-            if (i.a == 1)
-              {
-                /* user wrote a return statement */
-                /* already pushed to stack */
-              }
-            else
-              push (vm, o = sf_objstore_req_forconst (&__sf_none_obj));
+          lo = sf_objstore_box (&(const_t){
+              .type = CONST_INT, .v.c_int.v = SF_VM_UNRAW (lo) });
+          IR (lo);
+        }
 
-            if (o != NULL)
-              IR (o);
+      if (!(b & SF_CMP_R_OBJ))
+        {
+          ro = sf_objstore_box (&(const_t){
+              .type = CONST_INT, .v.c_int.v = SF_VM_UNRAW (ro) });
+          IR (ro);
+        }
 
-            goto end;
-          }
-          break;
+      rc = cmp_obj (type, lo, ro);
+      b |= SF_CMP_L_OBJ | SF_CMP_R_OBJ;
+    }
 
-        case OP_LOAD_CONST:
-          {
-            const_t d = vm->map_consts[i.a];
+  if (b & SF_CMP_L_OBJ)
+    DR (lo, vm);
+  if (b & SF_CMP_R_OBJ)
+    DR (ro, vm);
 
-            obj_t *d_obj = sf_objstore_req_forconst (&d);
+  return rc;
+}
 
-            if (d_obj == NULL)
-              {
-                d_obj = sf_objstore_req ();
-                d_obj->type = OBJ_CONST;
-                d_obj->v.o_const.v = d;
-              }
+/**
+ * Runs instruction i of the frame fr. Jumps leave vm->ip one before
+ * their target, the caller moves on to vm->ip + 1 after SF_VM_NEXT.
+ */
+static VM_STEP_INLINE int
+vm_step (vm_t *vm, frame_t *fr, instr_t i, int checked)
+{
+  int tail = 0;
 
-            IR (d_obj);
-            push (vm, d_obj);
+  switch (i.op)
+    {
+    case OP_RETURN:
+      {
+        obj_t *o = NULL;
+        if (i.a == 1)
+          {
+            /* user wrote a return statement */
+            /* already pushed to stack */
           }
-          break;
+        else
+          push (vm, o = sf_objstore_req_forconst (&__sf_none_obj), checked);
 
-        case OP_JUMP_IF_FALSE:
-          {
-            obj_t *p = pop (vm);
+        if (o != NULL)
+          IR (o);
 
-            if (sf_obj_isfalse (*p))
-              vm->ip = i.a - 1;
+        return SF_VM_RETURN;
+      }
+      break;
 
-            DR (p, vm);
-          }
-          break;
+    case OP_LOAD_CONST:
+      {
+        const_t d = vm->map_consts[i.a];
 
-        case OP_JUMP:
+        obj_t *d_obj = sf_objstore_req_forconst (&d);
+
+        if (d_obj == NULL)
           {
-            vm->ip = i.a - 1;
+            d_obj = sf_objstore_req ();
+            d_obj->type = OBJ_CONST;
+            d_obj->v.o_const.v = d;
           }
-          break;
 
-        case OP_STORE:
-          {
-            obj_t *val = pop (vm);
-            // IR (val);
-            // D (sf_obj_print (*val));
-            // D (printf ("%d\n", val->meta.ref_count));
+        IR (d_obj);
+        push (vm, d_obj, checked);
+      }
+      break;
 
-            if (vm->globals[i.a] != NULL)
-              {
-                // D (sf_obj_print (*vm->globals[i.a]));
-                // D (printf ("%d\n", vm->globals[i.a]->meta.ref_count));
-                DR (vm->globals[i.a], vm);
-              }
-            vm->globals[i.a] = val;
+    case OP_JUMP_IF_FALSE:
+      {
+        obj_t *p = pop (vm, checked);
+        size_t from = vm->ip;
 
-            // push (vm, val);
-          }
-          break;
+        if (sf_obj_isfalse (*p))
+          vm->ip = i.a - 1;
 
-        case OP_STORE_FAST:
-          {
-            obj_t *val = pop (vm);
-            // IR (val);
+        DR (p, vm);
 
-            if (i.a >= fr->l.locals_cap)
-              {
-                fr->l.locals_cap += SF_FRAME_LOCALS_CAP;
+        /* jump threading can leave a loop's back edge here */
+        if (vm->jit != NULL && vm->ip != from && (size_t)i.a <= from)
+          return sf_jit_loop (vm, i.a, from + 1);
+      }
+      break;
 
-                fr->l.locals = SFREALLOC (
-                    fr->l.locals, fr->l.locals_cap * sizeof (*fr->l.locals));
+    case OP_JUMP:
+      {
+        size_t from = vm->ip;
+        vm->ip = i.a - 1;
 
-                for (size_t j = fr->l.locals_count; j < fr->l.locals_cap; j++)
-                  fr->l.locals[j] = NULL;
-              }
+        /* a loop that keeps coming back goes on natively */
+        if (vm->jit != NULL && (size_t)i.a <= from)
+          return sf_jit_loop (vm, i.a, from + 1);
+      }
+      break;
 
-            if (i.a >= fr->l.locals_count)
-              fr->l.locals_count = i.a + 1;
+    case OP_DUP:
+      {
+        obj_t *o = vm->stack[vm->sp - 1];
+        push (vm, o, checked);
 
-            if (fr->l.locals[i.a] != NULL)
-              DR (fr->l.locals[i.a], vm);
-            fr->l.locals[i.a] = val;
+        if (o != NULL)
+          IR (o);
+      }
+      break;
 
-            // push (vm, val);
-          }
-          break;
+    case OP_LOAD_I:
+      push_i_as (vm, fr->ints[i.a], i.b, checked);
+      break;
 
-        case OP_STORE_NAME:
-          {
-            obj_t *val = pop (vm);
+    case OP_STORE_I:
+      fr->ints[i.a] = pop_i (vm, checked);
+      break;
 
-            if (i.b == 0)
-              {
-                if (i.a >= fr->n.nvc)
-                  {
-                    fr->n.nvc += SF_FRAME_LOCALS_CAP;
+    case OP_CONST_I:
+      push_i (vm, i.a, checked);
+      break;
 
-                    fr->n.names = SFREALLOC (
-                        fr->n.names, fr->n.nvc * sizeof (*fr->n.names));
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+      {
+        unsigned l = (unsigned)pop_i (vm, checked);
+        unsigned r = (unsigned)pop_i (vm, checked);
 
-                    fr->n.vals = SFREALLOC (fr->n.vals,
-                                            fr->n.nvc * sizeof (*fr->n.vals));
+        /* wraps around, where OP_ADD and friends overflow */
+        unsigned e = i.op == OP_ADD_I   ? r + l
+                     : i.op == OP_SUB_I ? r - l
+                                        : r * l;
 
-                    for (size_t j = fr->n.nvl; j < fr->n.nvc; j++)
-                      fr->n.vals[j] = NULL;
-                  }
+        push_i_as (vm, (int)e, i.b, checked);
+      }
+      break;
 
-                if (i.a >= fr->n.nvl)
-                  fr->n.nvl = i.a + 1;
+    case OP_ADD_1_I:
+      push_i_as (vm, (int)((unsigned)pop_i (vm, checked) + 1u), i.b, checked);
+      break;
 
-                if (fr->n.vals[i.a] != NULL)
-                  DR (fr->n.vals[i.a], vm);
+    case OP_DUP_I:
+      {
+        /* either copy can be boxed, the one below in bit 0 */
+        int v = pop_i (vm, checked);
 
-                fr->n.vals[i.a] = val;
-                fr->n.names[i.a] = i.c;
-              }
-            else if (i.b == 1)
-              {
-                /* pop from stack again, val is now the key */
-                obj_t *vv = pop (vm);
+        push_i_as (vm, v, i.b & 1, checked);
+        push_i_as (vm, v, i.b & 2, checked);
+      }
+      break;
 
-                container_set (val, i.c, vv, vm);
-                // D (sf_obj_print (*val));
-                // D (printf ("%d\n", val->meta.ref_count));
-                DR (val, vm);
-              }
-          }
-          break;
+    case OP_CMP_I:
+      {
+        int rc = cmp_i (vm, i.b, checked);
+        obj_t *o = sf_objstore_box (
+            &(const_t){ .type = CONST_BOOL, .v.c_bool.v = rc });
+
+        IR (o);
+        push (vm, o, checked);
+      }
+      break;
+
+    case OP_CMP_JUMP_I:
+      {
+        size_t from = vm->ip;
+
+        if (!cmp_i (vm, i.b, checked))
+          vm->ip = i.a - 1;
+
+        if (vm->jit != NULL && vm->ip != from && (size_t)i.a <= from)
+          return sf_jit_loop (vm, i.a, from + 1);
+      }
+      break;
+
+    case OP_CMP_JUMP:
+      {
+        obj_t *r = pop (vm, checked), *l = pop (vm, checked);
+        size_t from = vm->ip;
+        int rc;
+
+        /* the bool OP_CMP would make is never needed */
+        if (l->type == OBJ_CONST && r->type == OBJ_CONST
+            && l->v.o_const.v.type == CONST_INT
+            && r->v.o_const.v.type == CONST_INT)
+          rc = cmp_int (i.b, l->v.o_const.v.v.c_int.v,
+                        r->v.o_const.v.v.c_int.v);
+        else
+          rc = cmp_obj (i.b, l, r);
+
+        if (!rc)
+          vm->ip = i.a - 1;
+
+        DR (l, vm);
+        DR (r, vm);
 
-        case OP_STORE_SQR:
+        if (vm->jit != NULL && vm->ip != from && (size_t)i.a <= from)
+          return sf_jit_loop (vm, i.a, from + 1);
+      }
+      break;
+
+    case OP_GUARD_FN:
+      {
+        /* the inlined copy runs without the callee, the call keeps it */
+        if (!coded_at (vm->stack[vm->sp - 1], i.b))
+          vm->ip = i.a - 1;
+        else
+          DR (pop (vm, checked), vm);
+      }
+      break;
+
+    case OP_GUARD_METHOD:
+      if (!method_at (vm->stack[vm->sp - 1], i.c, i.b))
+        vm->ip = i.a - 1;
+      break;
+
+    case OP_TAIL_CALL:
+      {
+        obj_t *name = vm->stack[vm->sp - 1];
+        obj_t *fo = name->type == OBJ_HFF ? name->v.o_hff.f : name;
+
+        /* anything but a coded function is called and returned from */
+        if (fr->type != FRAME_LOCAL || fo->type != OBJ_FUNC
+            || fo->v.o_fun.v->type != FUN_CODED)
           {
-            obj_t *par = pop (vm);
-            obj_t *idx = pop (vm);
-            obj_t *val = pop (vm);
+            tail = 1;
+            goto call;
+          }
+
+        fun_t *f = fo->v.o_fun.v;
+        obj_t *args[64];
+        size_t al = 0;
+
+        pop (vm, checked);
+
+        while (al < (size_t)i.a)
+          args[al++] = pop (vm, checked);
+
+        if (name->type == OBJ_HFF)
+          for (size_t j = 0; j < name->v.o_hff.al; j++)
+            {
+              args[al++] = name->v.o_hff.args[j];
+              IR (args[al - 1]);
+            }
+
+        assert (f->argl == al);
+        vm->ip = f->v.coded.lp;
+        DR (name, vm);
+
+        /* the frame starts over as the callee's, as OP_CALL sets one up */
+        for (size_t j = 0; j < fr->l.locals_cap; j++)
+          if (fr->l.locals[j] != NULL)
+            {
+              DR (fr->l.locals[j], vm);
+              fr->l.locals[j] = NULL;
+            }
+
+        fr->l.locals_count = 0;
+        memset (fr->ints, 0, sizeof (fr->ints));
+
+        for (size_t j = 0; j < al; j++)
+          push (vm, args[j], checked);
+
+        fr->stack_base = vm->sp;
+        return SF_VM_TAIL;
+      }
 
-            sqr_set (par, idx, val, vm);
+    case OP_STORE:
+      {
+        obj_t *val = pop (vm, checked);
+        // IR (val);
+        // D (sf_obj_print (*val));
+        // D (printf ("%d\n", val->meta.ref_count));
+
+        if (vm->globals[i.a] != NULL)
+          {
+            // D (sf_obj_print (*vm->globals[i.a]));
+            // D (printf ("%d\n", vm->globals[i.a]->meta.ref_count));
+            DR (vm->globals[i.a], vm);
           }
-          break;
+        vm->globals[i.a] = val;
+
+        // push (vm, val, checked);
+      }
+      break;
 
-        case OP_LOAD:
+    case OP_STORE_FAST:
+      {
+        obj_t *val = pop (vm, checked);
+        // IR (val);
+
+        if (checked && i.a >= fr->l.locals_cap)
           {
-            obj_t *o = NULL;
-            push (vm, o = vm->globals[i.a]);
+            fr->l.locals_cap += SF_FRAME_LOCALS_CAP;
+
+            fr->l.locals = SFREALLOC (
+                fr->l.locals, fr->l.locals_cap * sizeof (*fr->l.locals));
 
-            if (o != NULL)
-              IR (o);
+            for (size_t j = fr->l.locals_count; j < fr->l.locals_cap; j++)
+              fr->l.locals[j] = NULL;
           }
-          break;
 
-        case OP_LOAD_NAME:
-          {
-            obj_t *o = NULL;
+        if (checked && i.a >= fr->l.locals_count)
+          fr->l.locals_count = i.a + 1;
 
-            if (i.b == 0)
-              o = fr->n.vals[i.a];
-            else
+        if (fr->l.locals[i.a] != NULL)
+          DR (fr->l.locals[i.a], vm);
+        fr->l.locals[i.a] = val;
+
+        // push (vm, val, checked);
+      }
+      break;
+
+    case OP_STORE_NAME:
+      {
+        obj_t *val = pop (vm, checked);
+
+        if (i.b == 0)
+          {
+            if (i.a >= fr->n.nvc)
               {
-                int j = vm->fp - 1;
-                frame_t *ff = &vm->frames[j];
+                fr->n.nvc += SF_FRAME_LOCALS_CAP;
 
-                while (j > -1 && ff->type != FRAME_NAME)
-                  ff = &vm->frames[--j];
+                fr->n.names = SFREALLOC (
+                    fr->n.names, fr->n.nvc * sizeof (*fr->n.names));
 
-                if (ff == NULL || j == -1)
-                  {
-                    printf ("name '%s' not found.", i.c);
-                    exit (EXIT_FAILURE);
-                  }
+                fr->n.vals = SFREALLOC (fr->n.vals,
+                                        fr->n.nvc * sizeof (*fr->n.vals));
 
-                o = ff->n.vals[i.a];
+                for (size_t j = fr->n.nvl; j < fr->n.nvc; j++)
+                  fr->n.vals[j] = NULL;
               }
 
-            assert (o != NULL);
-            push (vm, o);
+            if (i.a >= fr->n.nvl)
+              fr->n.nvl = i.a + 1;
 
-            IR (o);
-          }
-          break;
+            if (fr->n.vals[i.a] != NULL)
+              DR (fr->n.vals[i.a], vm);
 
-        case OP_LOAD_FAST:
+            fr->n.vals[i.a] = val;
+            fr->n.names[i.a] = i.c;
+          }
+        else if (i.b == 1)
           {
-            obj_t *o = NULL;
+            /* pop from stack again, val is now the key */
+            obj_t *vv = pop (vm, checked);
 
-            if (i.a >= fr->l.locals_cap)
-              {
-                fr->l.locals_cap += SF_FRAME_LOCALS_CAP;
+            container_set (val, i.c, vv, vm);
+            // D (sf_obj_print (*val));
+            // D (printf ("%d\n", val->meta.ref_count));
+            DR (val, vm);
+          }
+      }
+      break;
 
-                fr->l.locals = SFREALLOC (
-                    fr->l.locals, fr->l.locals_cap * sizeof (*fr->l.locals));
-              }
+    case OP_STORE_SQR:
+      {
+        obj_t *par = pop (vm, checked);
+        obj_t *idx = pop (vm, checked);
+        obj_t *val = pop (vm, checked);
 
-            if (i.a >= fr->l.locals_count)
-              fr->l.locals_count = i.a + 1;
+        sqr_set (par, idx, val, vm);
 
-            if (i.b == 0)
-              push (vm, o = fr->l.locals[i.a]);
-            else
-              {
-                /* number of levels to go up is less than number of frames */
-                assert (i.b < vm->fp);
+        DR (idx, vm);
+        DR (par, vm);
+      }
+      break;
 
-                push (vm, o = vm->frames[i.b].l.locals[i.a]);
+    case OP_LOAD:
+      {
+        obj_t *o = NULL;
+        push (vm, o = vm->globals[i.a], checked);
+
+        if (o != NULL)
+          IR (o);
+      }
+      break;
+
+    case OP_LOAD_NAME:
+      {
+        obj_t *o = NULL;
+
+        if (i.b == 0)
+          o = fr->n.vals[i.a];
+        else
+          {
+            int j = vm->fp - 1;
+            frame_t *ff = &vm->frames[j];
+
+            while (j > -1 && ff->type != FRAME_NAME)
+              ff = &vm->frames[--j];
+
+            if (ff == NULL || j == -1)
+              {
+                printf ("name '%s' not found.", i.c);
+                exit (EXIT_FAILURE);
               }
 
-            if (o != NULL)
-              IR (o);
+            o = ff->n.vals[i.a];
           }
-          break;
 
-        case OP_LOAD_FUNC_CODED:
+        assert (o != NULL);
+        push (vm, o, checked);
+
+        IR (o);
+      }
+      break;
+
+    case OP_LOAD_FAST:
+      {
+        obj_t *o = NULL;
+
+        if (checked && i.a >= fr->l.locals_cap)
           {
-            obj_t *o = sf_objstore_req ();
-            o->type = OBJ_FUNC;
-            o->v.o_fun.v = sf_fun_new (FUN_CODED);
-            o->v.o_fun.v->v.coded.lp = i.a;
-            o->v.o_fun.v->argc = o->v.o_fun.v->argl = i.b;
+            fr->l.locals_cap += SF_FRAME_LOCALS_CAP;
 
-            IR (o);
-            push (vm, o);
+            fr->l.locals = SFREALLOC (
+                fr->l.locals, fr->l.locals_cap * sizeof (*fr->l.locals));
+          }
+
+        if (checked && i.a >= fr->l.locals_count)
+          fr->l.locals_count = i.a + 1;
+
+        if (i.b == 0)
+          push (vm, o = fr->l.locals[i.a], checked);
+        else
+          {
+            /* number of levels to go up is less than number of frames */
+            assert (i.b < vm->fp);
 
-            // obj_t *o = sf_objstore_req (&__sf_none_obj);
-            // IR (o);
-            // push (vm, o);
+            push (vm, o = vm->frames[i.b].l.locals[i.a], checked);
           }
-          break;
 
-        case OP_CALL:
+        if (o != NULL)
+          IR (o);
+      }
+      break;
+
+    case OP_LOAD_FUNC_CODED:
+      {
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_FUNC;
+        o->v.o_fun.v = sf_fun_new (FUN_CODED);
+        o->v.o_fun.v->v.coded.lp = i.a;
+        o->v.o_fun.v->argl = i.b;
+
+        /* the body runs from i.a up to this instruction */
+        if (vm->verify != NULL)
+          sf_verify_func (vm, i.a, vm->ip);
+
+        if (vm->jit != NULL)
+          sf_jit_func (vm, i.a, vm->ip);
+        else if (vm->reg != NULL)
+          sf_reg_func (vm, i.a, vm->ip);
+
+        IR (o);
+        push (vm, o, checked);
+
+        // obj_t *o = sf_objstore_req (&__sf_none_obj);
+        // IR (o);
+        // push (vm, o, checked);
+      }
+      break;
+
+    case OP_CALL:
+    call:
+      {
+        size_t argc = i.a;
+        obj_t *name = pop (vm, checked);
+        int saw_modwrap = 0;
+        obj_t *ppres = NULL;
+
+        if (name->type == OBJ_MODWRAP)
           {
-            size_t argc = i.a;
-            obj_t *name = pop (vm);
-            int saw_modwrap = 0;
-            obj_t *ppres = NULL;
+            saw_modwrap = 1;
+            sf_vm_addframe (vm, *name->v.o_mw.v);
+            ppres = name;
+            name = name->v.o_mw.f;
+          }
 
-            if (name->type == OBJ_MODWRAP)
-              {
-                saw_modwrap = 1;
-                sf_vm_addframe (vm, *name->v.o_mw.v);
-                ppres = name;
-                name = name->v.o_mw.f;
-              }
+        // IR (name);
 
-            // IR (name);
+        obj_t *args[64];
+        size_t al = 0;
 
-            obj_t *args[64];
-            size_t al = 0;
+        while (al < argc)
+          {
+            args[al++] = pop (vm, checked);
+            // sf_obj_print (*args[al - 1]);
+            // IR (args[al++]);
+          }
 
-            while (al < argc)
-              {
-                args[al++] = pop (vm);
-                // sf_obj_print (*args[al - 1]);
-                // IR (args[al++]);
-              }
+        switch (name->type)
+          {
+          case OBJ_FUNC:
+            {
+              fun_t *f = name->v.o_fun.v;
+              assert (f->argl == argc);
 
-            switch (name->type)
-              {
-              case OBJ_FUNC:
+              switch (f->type)
                 {
-                  fun_t *f = name->v.o_fun.v;
-                  assert (f->argl == argc);
+                case FUN_NATIVE:
+                  {
+                    native_args_inorder (args, al);
 
-                  switch (f->type)
-                    {
-                    case FUN_NATIVE:
+                    switch (f->v.native.nf_type)
                       {
-                        switch (f->v.native.nf_type)
-                          {
-                          case NF_ARG_1:
-                            {
-                              obj_t *r = f->v.native.v.f_onearg (args[0]);
+                      case NF_ARG_1:
+                        {
+                          obj_t *r = f->v.native.v.f_onearg (args[0]);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-
-                                      push (vm, o);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_2:
+                          else
                             {
-                              obj_t *r
-                                  = f->v.native.v.f_twoarg (args[0], args[1]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
+
+                      case NF_ARG_2:
+                        {
+                          obj_t *r
+                              = f->v.native.v.f_twoarg (args[0], args[1]);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_3:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_threearg (
-                                  args[0], args[1], args[2]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_3:
+                        {
+                          obj_t *r = f->v.native.v.f_threearg (
+                              args[0], args[1], args[2]);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_ANY:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_anyarg (args, al);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_ANY:
+                        {
+                          obj_t *r = f->v.native.v.f_anyarg (args, al);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          default:
-                            break;
-                          }
+                          else
+                            {
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                        for (size_t i = 0; i < al; i++)
-                          DR (args[i], vm);
+                      default:
+                        break;
                       }
-                      break;
 
-                    case FUN_CODED:
+                    for (size_t i = 0; i < al; i++)
+                      DR (args[i], vm);
+                  }
+                  break;
+
+                case FUN_CODED:
+                  {
+                    size_t lp = f->v.coded.lp;
+
+                    for (size_t i = 0; i < al; i++)
                       {
-                        size_t lp = f->v.coded.lp;
-
-                        for (size_t i = 0; i < al; i++)
-                          {
-                            push (vm, args[i]);
-                            // IR (args[i]);
-                          }
-
-                        frame_t frt = sf_frame_new_local ();
-                        frt.return_ip = vm->ip;
-                        // D (printf ("%d\n", fr.return_ip));
-                        frt.stack_base = vm->sp;
-
-                        // fr = &vm->frames[vm->fp - 1];
-                        vm->ip = lp;
-
-                        if (i.b == 1)
-                          frt.pop_ret_val = 0; /* need return value */
-                        else
-                          frt.pop_ret_val
-                              = 1; /* dont need return value (stmt call) */
-
-                        sf_vm_addframe (vm, frt);
-                        sf_vm_exec_single_frame (vm);
-                        sf_vm_popframe (vm);
+                        push (vm, args[i], checked);
+                        // IR (args[i]);
                       }
-                      break;
 
-                    default:
-                      break;
-                    }
+                    frame_t frt = sf_frame_new_local ();
+                    frt.return_ip = vm->ip;
+                    // D (printf ("%d\n", fr.return_ip));
+                    frt.stack_base = vm->sp;
+
+                    // fr = &vm->frames[vm->fp - 1];
+                    vm->ip = lp;
+
+                    if (i.b == 1)
+                      frt.pop_ret_val = 0; /* need return value */
+                    else
+                      frt.pop_ret_val
+                          = 1; /* dont need return value (stmt call) */
+
+                    sf_vm_addframe (vm, frt);
+                    sf_vm_exec_single_frame (vm);
+                    sf_vm_popframe (vm);
+                  }
+                  break;
+
+                default:
+                  break;
                 }
-                break;
+            }
+            break;
 
-              case OBJ_HFF:
-                {
-                  size_t hf_al = name->v.o_hff.al;
-                  obj_t **hf_args = name->v.o_hff.args;
-                  obj_t *hf_fo = name->v.o_hff.f;
+          case OBJ_HFF:
+            {
+              size_t hf_al = name->v.o_hff.al;
+              obj_t **hf_args = name->v.o_hff.args;
+              obj_t *hf_fo = name->v.o_hff.f;
 
-                  assert (hf_fo->type == OBJ_FUNC);
-                  fun_t *f = hf_fo->v.o_fun.v;
+              assert (hf_fo->type == OBJ_FUNC);
+              fun_t *f = hf_fo->v.o_fun.v;
 
-                  // for (int j = al - 1; j > -1; j--)
-                  //   {
-                  //     args[j + hf_al] = args[j];
-                  //   }
+              // for (int j = al - 1; j > -1; j--)
+              //   {
+              //     args[j + hf_al] = args[j];
+              //   }
 
-                  // for (size_t j = 0; j < hf_al; j++)
-                  //   {
-                  //     args[j] = hf_args[j];
-                  //   }
+              // for (size_t j = 0; j < hf_al; j++)
+              //   {
+              //     args[j] = hf_args[j];
+              //   }
 
-                  for (size_t j = 0; j < hf_al; j++)
-                    {
-                      args[al++] = hf_args[j];
-                      IR (hf_args[j]);
-                    }
+              for (size_t j = 0; j < hf_al; j++)
+                {
+                  args[al++] = hf_args[j];
+                  IR (hf_args[j]);
+                }
 
-                  // al += hf_al;
-                  assert (al == f->argl);
+              // al += hf_al;
+              assert (al == f->argl);
 
-                  switch (f->type)
-                    {
-                    case FUN_NATIVE:
+              switch (f->type)
+                {
+                case FUN_NATIVE:
+                  {
+                    native_args_inorder (args, al);
+
+                    switch (f->v.native.nf_type)
                       {
-                        switch (f->v.native.nf_type)
-                          {
-                          case NF_ARG_1:
-                            {
-                              obj_t *r = f->v.native.v.f_onearg (args[0]);
+                      case NF_ARG_1:
+                        {
+                          obj_t *r = f->v.native.v.f_onearg (args[0]);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-
-                                      push (vm, o);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_2:
+                          else
                             {
-                              obj_t *r
-                                  = f->v.native.v.f_twoarg (args[0], args[1]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_2:
+                        {
+                          obj_t *r
+                              = f->v.native.v.f_twoarg (args[0], args[1]);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_3:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_threearg (
-                                  args[0], args[1], args[2]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_3:
+                        {
+                          obj_t *r = f->v.native.v.f_threearg (
+                              args[0], args[1], args[2]);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_ANY:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_anyarg (args, al);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_ANY:
+                        {
+                          obj_t *r = f->v.native.v.f_anyarg (args, al);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          default:
-                            break;
-                          }
+                          else
+                            {
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                        for (size_t i = 0; i < al; i++)
-                          DR (args[i], vm);
+                      default:
+                        break;
                       }
-                      break;
 
-                    case FUN_CODED:
+                    for (size_t i = 0; i < al; i++)
+                      DR (args[i], vm);
+                  }
+                  break;
+
+                case FUN_CODED:
+                  {
+                    size_t lp = f->v.coded.lp;
+
+                    for (size_t i = 0; i < al; i++)
                       {
-                        size_t lp = f->v.coded.lp;
-
-                        for (size_t i = 0; i < al; i++)
-                          {
-                            push (vm, args[i]);
-                            // IR (args[i]);
-                          }
-
-                        frame_t frt = sf_frame_new_local ();
-                        frt.return_ip = vm->ip;
-                        // D (printf ("%d\n", fr.return_ip));
-                        frt.stack_base = vm->sp;
-
-                        vm->ip = lp;
-
-                        if (i.b == 1)
-                          frt.pop_ret_val = 0; /* need return value */
-                        else
-                          frt.pop_ret_val
-                              = 1; /* dont need return value (stmt call) */
-
-                        sf_vm_addframe (vm, frt);
-                        sf_vm_exec_single_frame (vm);
-                        sf_vm_popframe (vm);
+                        push (vm, args[i], checked);
+                        // IR (args[i]);
                       }
-                      break;
 
-                    default:
-                      break;
-                    }
+                    frame_t frt = sf_frame_new_local ();
+                    frt.return_ip = vm->ip;
+                    // D (printf ("%d\n", fr.return_ip));
+                    frt.stack_base = vm->sp;
+
+                    vm->ip = lp;
+
+                    if (i.b == 1)
+                      frt.pop_ret_val = 0; /* need return value */
+                    else
+                      frt.pop_ret_val
+                          = 1; /* dont need return value (stmt call) */
+
+                    sf_vm_addframe (vm, frt);
+                    sf_vm_exec_single_frame (vm);
+                    sf_vm_popframe (vm);
+                  }
+                  break;
+
+                default:
+                  break;
                 }
-                break;
+            }
+            break;
 
-              case OBJ_MODHF:
-                {
-                  sf_vm_addframe (vm, *name->v.o_modhf.v->v.o_mod.v->fr);
+          case OBJ_MODHF:
+            {
+              sf_vm_addframe (vm, *name->v.o_modhf.v->v.o_mod.v->fr);
 
-                  fun_t *f = name->v.o_modhf.f->v.o_fun.v;
-                  assert (f->argl == argc);
+              fun_t *f = name->v.o_modhf.f->v.o_fun.v;
+              assert (f->argl == argc);
 
-                  switch (f->type)
-                    {
-                    case FUN_NATIVE:
+              switch (f->type)
+                {
+                case FUN_NATIVE:
+                  {
+                    native_args_inorder (args, al);
+
+                    switch (f->v.native.nf_type)
                       {
-                        switch (f->v.native.nf_type)
-                          {
-                          case NF_ARG_1:
-                            {
-                              obj_t *r = f->v.native.v.f_onearg (args[0]);
+                      case NF_ARG_1:
+                        {
+                          obj_t *r = f->v.native.v.f_onearg (args[0]);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-
-                                      push (vm, o);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_2:
+                          else
                             {
-                              obj_t *r
-                                  = f->v.native.v.f_twoarg (args[0], args[1]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
+
+                      case NF_ARG_2:
+                        {
+                          obj_t *r
+                              = f->v.native.v.f_twoarg (args[0], args[1]);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_3:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_threearg (
-                                  args[0], args[1], args[2]);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                              if (r != NULL)
+                      case NF_ARG_3:
+                        {
+                          obj_t *r = f->v.native.v.f_threearg (
+                              args[0], args[1], args[2]);
+
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          case NF_ARG_ANY:
+                          else
                             {
-                              obj_t *r = f->v.native.v.f_anyarg (args, al);
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
+
+                      case NF_ARG_ANY:
+                        {
+                          obj_t *r = f->v.native.v.f_anyarg (args, al);
 
-                              if (r != NULL)
+                          if (r != NULL)
+                            {
+                              if (i.b != 1)
                                 {
-                                  if (i.b != 1)
-                                    {
-                                      DR (r, vm);
-                                    }
-                                  else
-                                    {
-                                      push (vm, r);
-                                    }
+                                  DR (r, vm);
                                 }
                               else
                                 {
-                                  if (i.b == 1)
-                                    {
-                                      obj_t *o = sf_objstore_req_forconst (
-                                          &__sf_none_obj);
-                                    }
+                                  push (vm, r, checked);
                                 }
                             }
-                            break;
-
-                          default:
-                            break;
-                          }
+                          else
+                            {
+                              if (i.b == 1)
+                                push_none (vm, checked);
+                            }
+                        }
+                        break;
 
-                        for (size_t i = 0; i < al; i++)
-                          DR (args[i], vm);
+                      default:
+                        break;
                       }
-                      break;
 
-                    case FUN_CODED:
+                    for (size_t i = 0; i < al; i++)
+                      DR (args[i], vm);
+                  }
+                  break;
+
+                case FUN_CODED:
+                  {
+                    size_t lp = f->v.coded.lp;
+
+                    for (size_t i = 0; i < al; i++)
                       {
-                        size_t lp = f->v.coded.lp;
-
-                        for (size_t i = 0; i < al; i++)
-                          {
-                            push (vm, args[i]);
-                            // IR (args[i]);
-                          }
-
-                        frame_t frt = sf_frame_new_local ();
-                        frt.return_ip = vm->ip;
-                        // D (printf ("%d\n", fr.return_ip));
-                        frt.stack_base = vm->sp;
-
-                        // fr = &vm->frames[vm->fp - 1];
-                        vm->ip = lp;
-
-                        if (i.b == 1)
-                          frt.pop_ret_val = 0; /* need return value */
-                        else
-                          frt.pop_ret_val
-                              = 1; /* dont need return value (stmt call) */
-
-                        sf_vm_addframe (vm, frt);
-                        sf_vm_exec_single_frame (vm);
-                        sf_vm_popframe (vm);
+                        push (vm, args[i], checked);
+                        // IR (args[i]);
                       }
-                      break;
-
-                    default:
-                      break;
-                    }
 
-                  vm->fp--;
-                }
-                break;
+                    frame_t frt = sf_frame_new_local ();
+                    frt.return_ip = vm->ip;
+                    // D (printf ("%d\n", fr.return_ip));
+                    frt.stack_base = vm->sp;
 
-              case OBJ_MODHC:
-                {
-                  sf_vm_addframe (vm, *name->v.o_modcf.v->v.o_mod.v->fr);
+                    // fr = &vm->frames[vm->fp - 1];
+                    vm->ip = lp;
 
-                  class_t *c = name->v.o_modcf.f->v.o_class.v;
-                  cobj_t *co = sf_cobj_new (c);
+                    if (i.b == 1)
+                      frt.pop_ret_val = 0; /* need return value */
+                    else
+                      frt.pop_ret_val
+                          = 1; /* dont need return value (stmt call) */
 
-                  obj_t *o = sf_objstore_req ();
-                  o->type = OBJ_COBJ;
-                  o->v.o_cobj.v = co;
+                    sf_vm_addframe (vm, frt);
+                    sf_vm_exec_single_frame (vm);
+                    sf_vm_popframe (vm);
+                  }
+                  break;
 
-                  if (i.b == 1)
-                    {
-                      push (vm, o);
-                      IR (o);
-                    }
-                  // else
-                  //   sf_cobj_free (co);
+                default:
+                  break;
+                }
 
-                  obj_t *_init_method = container_access (o, "_init");
-                  if (_init_method != NULL)
-                    {
-                      int smw = 0;
-                      obj_t *ppres = NULL;
+              vm->fp--;
+            }
+            break;
 
-                      if (_init_method->type == OBJ_MODWRAP)
-                        {
-                          smw = 1;
-                          sf_vm_addframe (vm, *_init_method->v.o_mw.v);
-                          ppres = _init_method;
-                          _init_method = _init_method->v.o_mw.f;
-                        }
+          case OBJ_MODHC:
+            {
+              sf_vm_addframe (vm, *name->v.o_modcf.v->v.o_mod.v->fr);
 
-                      assert (_init_method->type == OBJ_HFF);
-                      obj_t *hfo = _init_method->v.o_hff.f;
+              class_t *c = name->v.o_modcf.f->v.o_class.v;
+              cobj_t *co = sf_cobj_new (c);
 
-                      assert (hfo->type == OBJ_FUNC);
-                      fun_t *f = hfo->v.o_fun.v;
+              obj_t *o = sf_objstore_req ();
+              o->type = OBJ_COBJ;
+              o->v.o_cobj.v = co;
 
-                      if (f->type == FUN_CODED)
-                        {
-                          assert (f->argl == al + 1);
-                          size_t lp = f->v.coded.lp;
+              if (i.b == 1)
+                {
+                  push (vm, o, checked);
+                  IR (o);
+                }
+              // else
+              //   sf_cobj_free (co);
 
-                          for (size_t i = 0; i < al; i++)
-                            {
-                              push (vm, args[i]);
-                              // IR (args[i]);
-                            }
+              obj_t *_init_method = container_access (o, "_init");
+              if (_init_method != NULL)
+                {
+                  int smw = 0;
+                  obj_t *ppres = NULL;
 
-                          push (vm, o);
-                          IR (o);
+                  if (_init_method->type == OBJ_MODWRAP)
+                    {
+                      smw = 1;
+                      sf_vm_addframe (vm, *_init_method->v.o_mw.v);
+                      ppres = _init_method;
+                      _init_method = _init_method->v.o_mw.f;
+                    }
 
-                          frame_t frt = sf_frame_new_local ();
-                          frt.return_ip = vm->ip;
-                          // D (printf ("%d\n", fr.return_ip));
-                          frt.stack_base = vm->sp;
-                          frt.pop_ret_val = 1;
+                  assert (_init_method->type == OBJ_HFF);
+                  obj_t *hfo = _init_method->v.o_hff.f;
 
-                          sf_vm_addframe (vm, frt);
-                          vm->ip = lp;
+                  assert (hfo->type == OBJ_FUNC);
+                  fun_t *f = hfo->v.o_fun.v;
 
-                          sf_vm_exec_single_frame (vm);
-                          sf_vm_popframe (vm);
-                        }
-                      else if (f->type == FUN_NATIVE)
-                        {
-                          D (printf ("[TODO] native function as an _init"));
-                        }
+                  if (f->type == FUN_CODED)
+                    {
+                      assert (f->argl == al + 1);
+                      size_t lp = f->v.coded.lp;
 
-                      if (smw)
+                      for (size_t i = 0; i < al; i++)
                         {
-                          _init_method = ppres;
-                          vm->fp--;
+                          push (vm, args[i], checked);
+                          // IR (args[i]);
                         }
 
-                      /* resolve r-values */
-                      IR (_init_method);
-                      DR (_init_method, vm);
-                    }
-
-                  vm->fp--;
-                }
-                break;
+                      push (vm, o, checked);
+                      IR (o);
 
-              case OBJ_CLASS:
-                {
-                  class_t *c = name->v.o_class.v;
-                  cobj_t *co = sf_cobj_new (c);
+                      frame_t frt = sf_frame_new_local ();
+                      frt.return_ip = vm->ip;
+                      // D (printf ("%d\n", fr.return_ip));
+                      frt.stack_base = vm->sp;
+                      frt.pop_ret_val = 1;
 
-                  obj_t *o = sf_objstore_req ();
-                  o->type = OBJ_COBJ;
-                  o->v.o_cobj.v = co;
+                      sf_vm_addframe (vm, frt);
+                      vm->ip = lp;
 
-                  if (i.b == 1)
+                      sf_vm_exec_single_frame (vm);
+                      sf_vm_popframe (vm);
+                    }
+                  else if (f->type == FUN_NATIVE)
                     {
-                      push (vm, o);
-                      IR (o);
+                      D (printf ("[TODO] native function as an _init"));
                     }
-                  // else
-                  //   sf_cobj_free (co);
 
-                  obj_t *_init_method = container_access (o, "_init");
-                  if (_init_method != NULL)
+                  if (smw)
                     {
-                      int smw = 0;
-                      obj_t *ppres = NULL;
+                      _init_method = ppres;
+                      vm->fp--;
+                    }
 
-                      if (_init_method->type == OBJ_MODWRAP)
-                        {
-                          smw = 1;
-                          sf_vm_addframe (vm, *_init_method->v.o_mw.v);
-                          ppres = _init_method;
-                          _init_method = _init_method->v.o_mw.f;
-                        }
+                  /* resolve r-values */
+                  IR (_init_method);
+                  DR (_init_method, vm);
+                }
 
-                      assert (_init_method->type == OBJ_HFF);
-                      obj_t *hfo = _init_method->v.o_hff.f;
+              vm->fp--;
+            }
+            break;
 
-                      assert (hfo->type == OBJ_FUNC);
-                      fun_t *f = hfo->v.o_fun.v;
+          case OBJ_CLASS:
+            {
+              class_t *c = name->v.o_class.v;
+              cobj_t *co = sf_cobj_new (c);
 
-                      if (f->type == FUN_CODED)
-                        {
-                          assert (f->argl == al + 1);
-                          size_t lp = f->v.coded.lp;
+              obj_t *o = sf_objstore_req ();
+              o->type = OBJ_COBJ;
+              o->v.o_cobj.v = co;
 
-                          for (size_t i = 0; i < al; i++)
-                            {
-                              push (vm, args[i]);
-                              // IR (args[i]);
-                            }
+              if (i.b == 1)
+                {
+                  push (vm, o, checked);
+                  IR (o);
+                }
+              // else
+              //   sf_cobj_free (co);
 
-                          push (vm, o);
-                          IR (o);
+              obj_t *_init_method = container_access (o, "_init");
+              if (_init_method != NULL)
+                {
+                  int smw = 0;
+                  obj_t *ppres = NULL;
 
-                          frame_t frt = sf_frame_new_local ();
-                          frt.return_ip = vm->ip;
-                          // D (printf ("%d\n", fr.return_ip));
-                          frt.stack_base = vm->sp;
-                          frt.pop_ret_val = 1;
+                  if (_init_method->type == OBJ_MODWRAP)
+                    {
+                      smw = 1;
+                      sf_vm_addframe (vm, *_init_method->v.o_mw.v);
+                      ppres = _init_method;
+                      _init_method = _init_method->v.o_mw.f;
+                    }
 
-                          sf_vm_addframe (vm, frt);
-                          vm->ip = lp;
+                  assert (_init_method->type == OBJ_HFF);
+                  obj_t *hfo = _init_method->v.o_hff.f;
 
-                          sf_vm_exec_single_frame (vm);
-                          sf_vm_popframe (vm);
-                        }
-                      else if (f->type == FUN_NATIVE)
-                        {
-                          D (printf ("[TODO] native function as an _init"));
-                        }
+                  assert (hfo->type == OBJ_FUNC);
+                  fun_t *f = hfo->v.o_fun.v;
+
+                  if (f->type == FUN_CODED)
+                    {
+                      assert (f->argl == al + 1);
+                      size_t lp = f->v.coded.lp;
 
-                      if (smw)
+                      for (size_t i = 0; i < al; i++)
                         {
-                          _init_method = ppres;
-                          vm->fp--;
+                          push (vm, args[i], checked);
+                          // IR (args[i]);
                         }
 
-                      /* resolve r-values */
-                      IR (_init_method);
-                      DR (_init_method, vm);
-                    }
-                }
-                break;
-
-              default:
-                break;
-              }
-
-            if (saw_modwrap)
-              {
-                name = ppres;
-                vm->fp--;
-              }
-
-            DR (name, vm);
-
-            // for (size_t i = 0; i < al; i++)
-            //   {
-            //     DR (args[i], vm);
-            //   }
-          }
-          break;
+                      push (vm, o, checked);
+                      IR (o);
 
-        case OP_ADD_1:
-          {
-            obj_t *p = pop (vm);
-            // IR (p);
+                      frame_t frt = sf_frame_new_local ();
+                      frt.return_ip = vm->ip;
+                      // D (printf ("%d\n", fr.return_ip));
+                      frt.stack_base = vm->sp;
+                      frt.pop_ret_val = 1;
 
-            if (p->type == OBJ_CONST && p->v.o_const.v.type == CONST_INT)
-              {
-                int r = p->v.o_const.v.v.c_int.v + 1;
+                      sf_vm_addframe (vm, frt);
+                      vm->ip = lp;
 
-                obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
-                    { .type = CONST_INT, .v.c_int.v = r } });
+                      sf_vm_exec_single_frame (vm);
+                      sf_vm_popframe (vm);
+                    }
+                  else if (f->type == FUN_NATIVE)
+                    {
+                      D (printf ("[TODO] native function as an _init"));
+                    }
 
-                if (o == NULL)
-                  {
-                    o = sf_objstore_req ();
-                    o->type = OBJ_CONST;
-                    o->v.o_const.v.type = CONST_INT;
-                    o->v.o_const.v.v.c_int.v = r;
-                  }
+                  if (smw)
+                    {
+                      _init_method = ppres;
+                      vm->fp--;
+                    }
 
-                push (vm, o);
-                IR (o);
-              }
+                  /* resolve r-values */
+                  IR (_init_method);
+                  DR (_init_method, vm);
+                }
+            }
+            break;
 
-            DR (p, vm);
+          default:
+            break;
           }
-          break;
 
-        case OP_ADD:
+        if (saw_modwrap)
           {
-            obj_t *l = pop (vm);
-            obj_t *r = pop (vm);
-
-            // IR (l);
-            // IR (r);
-
-            if (r->type == l->type && l->type == OBJ_CONST
-                && l->v.o_const.v.type == r->v.o_const.v.type
-                && l->v.o_const.v.type == CONST_INT)
-              {
-                int e = r->v.o_const.v.v.c_int.v + l->v.o_const.v.v.c_int.v;
-
-                obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
-                    { .type = CONST_INT, .v.c_int.v = e } });
-
-                if (o == NULL)
-                  {
-                    o = sf_objstore_req ();
-                    o->type = OBJ_CONST;
-                    o->v.o_const.v.type = CONST_INT;
-                    o->v.o_const.v.v.c_int.v = e;
-                  }
-
-                push (vm, o);
-                IR (o);
-              }
-
-            DR (l, vm);
-            DR (r, vm);
+            name = ppres;
+            vm->fp--;
           }
-          break;
-
-        case OP_SUB:
-          {
-            obj_t *l = pop (vm);
-            obj_t *r = pop (vm);
-
-            // IR (l);
-            // IR (r);
 
-            if (r->type == l->type && l->type == OBJ_CONST
-                && l->v.o_const.v.type == r->v.o_const.v.type
-                && l->v.o_const.v.type == CONST_INT)
-              {
-                int e = r->v.o_const.v.v.c_int.v - l->v.o_const.v.v.c_int.v;
-
-                obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
-                    { .type = CONST_INT, .v.c_int.v = e } });
-
-                if (o == NULL)
-                  {
-                    o = sf_objstore_req ();
-                    o->type = OBJ_CONST;
-                    o->v.o_const.v.type = CONST_INT;
-                    o->v.o_const.v.v.c_int.v = e;
-                  }
+        DR (name, vm);
 
-                push (vm, o);
-                IR (o);
-              }
+        // for (size_t i = 0; i < al; i++)
+        //   {
+        //     DR (args[i], vm);
+        //   }
+      }
+      break;
 
-            DR (l, vm);
-            DR (r, vm);
-          }
-          break;
+    case OP_ADD_1:
+      {
+        obj_t *p = pop (vm, checked);
+        // IR (p);
 
-        case OP_MUL:
+        if (p->type == OBJ_CONST && p->v.o_const.v.type == CONST_INT)
           {
-            obj_t *l = pop (vm);
-            obj_t *r = pop (vm);
+            int r = p->v.o_const.v.v.c_int.v + 1;
 
-            // IR (l);
-            // IR (r);
+            obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
+                { .type = CONST_INT, .v.c_int.v = r } });
 
-            if (r->type == l->type && l->type == OBJ_CONST
-                && l->v.o_const.v.type == r->v.o_const.v.type
-                && l->v.o_const.v.type == CONST_INT)
+            if (o == NULL)
               {
-                int e = r->v.o_const.v.v.c_int.v * l->v.o_const.v.v.c_int.v;
-
-                obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
-                    { .type = CONST_INT, .v.c_int.v = e } });
-
-                if (o == NULL)
-                  {
-                    o = sf_objstore_req ();
-                    o->type = OBJ_CONST;
-                    o->v.o_const.v.type = CONST_INT;
-                    o->v.o_const.v.v.c_int.v = e;
-                  }
-
-                push (vm, o);
-                IR (o);
+                o = sf_objstore_req ();
+                o->type = OBJ_CONST;
+                o->v.o_const.v.type = CONST_INT;
+                o->v.o_const.v.v.c_int.v = r;
               }
 
-            DR (l, vm);
-            DR (r, vm);
+            push (vm, o, checked);
+            IR (o);
           }
-          break;
-
-        case OP_CMP:
-          {
-            obj_t *r = pop (vm);
-            obj_t *l = pop (vm);
-
-            // IR (l);
-            // IR (r);
-
-            int rc = 0;
-
-            switch (i.a)
-              {
-              case CMP_EQEQ:
-                {
-                  rc = sf_obj_eqeq (l, r);
-                }
-                break;
-
-              case CMP_GE:
-                {
-                  rc = sf_obj_ge (l, r);
-                }
-                break;
-
-              case CMP_GEQ:
-                {
-                  rc = sf_obj_geq (l, r);
-                }
-                break;
-
-              case CMP_LE:
-                {
-                  rc = sf_obj_le (l, r);
-                }
-                break;
+        else
+          push_none (vm, checked);
 
-              case CMP_LEQ:
-                {
-                  rc = sf_obj_leq (l, r);
-                }
-                break;
+        DR (p, vm);
+      }
+      break;
 
-              case CMP_NEQ:
-                {
-                  rc = sf_obj_neq (l, r);
-                }
-                break;
+    case OP_ADD:
+      {
+        obj_t *l = pop (vm, checked);
+        obj_t *r = pop (vm, checked);
 
-              default:
-                break;
-              }
+        // IR (l);
+        // IR (r);
 
-            const_t bc = (const_t){ .type = CONST_BOOL, .v.c_bool.v = rc };
+        if (r->type == l->type && l->type == OBJ_CONST
+            && l->v.o_const.v.type == r->v.o_const.v.type
+            && l->v.o_const.v.type == CONST_INT)
+          {
+            int e = r->v.o_const.v.v.c_int.v + l->v.o_const.v.v.c_int.v;
 
-            obj_t *o_bc = sf_objstore_req_forconst (&bc);
+            obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
+                { .type = CONST_INT, .v.c_int.v = e } });
 
-            if (o_bc == NULL)
+            if (o == NULL)
               {
-                o_bc = sf_objstore_req ();
-
-                o_bc->type = OBJ_CONST;
-                o_bc->v.o_const.v = bc;
+                o = sf_objstore_req ();
+                o->type = OBJ_CONST;
+                o->v.o_const.v.type = CONST_INT;
+                o->v.o_const.v.v.c_int.v = e;
               }
 
-            push (vm, o_bc);
-            IR (o_bc);
-
-            DR (l, vm);
-            DR (r, vm);
+            push (vm, o, checked);
+            IR (o);
           }
-          break;
+        else
+          push_none (vm, checked);
 
-        case OP_LOAD_BUILDCLASS:
-          {
-            frame_t nf = sf_frame_new_name ();
+        DR (l, vm);
+        DR (r, vm);
+      }
+      break;
 
-            nf.return_ip = i.a; /* buildclass_end location */
-            sf_vm_addframe (vm, nf);
+    case OP_SUB:
+      {
+        obj_t *l = pop (vm, checked);
+        obj_t *r = pop (vm, checked);
 
-            vm->ip++;
-            sf_vm_exec_single_frame (vm);
-          }
-          break;
+        // IR (l);
+        // IR (r);
 
-        case OP_LOAD_BUILDCLASS_END:
+        if (r->type == l->type && l->type == OBJ_CONST
+            && l->v.o_const.v.type == r->v.o_const.v.type
+            && l->v.o_const.v.type == CONST_INT)
           {
-            frame_t f = vm->frames[vm->fp - 1];
-            assert (f.type == FRAME_NAME);
-
-            class_t *cl = sf_class_new ();
+            int e = r->v.o_const.v.v.c_int.v - l->v.o_const.v.v.c_int.v;
 
-            cl->svl = f.n.nvl;
-            cl->svc = f.n.nvl;
+            obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
+                { .type = CONST_INT, .v.c_int.v = e } });
 
-            frame_t *ff = &vm->frames[vm->fp - 2];
-            if (ff->type == FRAME_NAME && ff->is_mod)
-              {
-                cl->par_fr = ff;
-              }
-
-            // cl->slots = SFMALLOC (sizeof (*cl->slots));
-            // cl->vals = SFMALLOC (sizeof (*cl->vals));
-
-            // for (size_t j = 0; j < f.n.nvl; j++)
-            //   {
-            //     cl->vals[j] = f.n.vals[j];
-            //     cl->slots[j] = f.n.names[j];
-            //   }
-
-            cl->slots = SFMALLOC (f.n.nvl * sizeof (*cl->slots));
-            cl->vals = SFMALLOC (f.n.nvl * sizeof (*cl->vals));
-
-            for (size_t j = 0; j < f.n.nvl; j++)
+            if (o == NULL)
               {
-                if (f.n.names[j] == NULL)
-                  continue;
-
-                cl->slots[j] = SFSTRDUP (f.n.names[j]);
-                cl->vals[j] = f.n.vals[j];
-                IR (f.n.vals[j]);
+                o = sf_objstore_req ();
+                o->type = OBJ_CONST;
+                o->v.o_const.v.type = CONST_INT;
+                o->v.o_const.v.v.c_int.v = e;
               }
 
-            cl->name = SFSTRDUP (vm->insts[i.a].c);
-
-            obj_t *o = sf_objstore_req ();
-            o->type = OBJ_CLASS;
-            o->v.o_class.v = cl;
-
-            push (vm, o);
+            push (vm, o, checked);
             IR (o);
+          }
+        else
+          push_none (vm, checked);
+
+        DR (l, vm);
+        DR (r, vm);
+      }
+      break;
 
-            sf_vm_popframe (vm);
+    case OP_MUL:
+      {
+        obj_t *l = pop (vm, checked);
+        obj_t *r = pop (vm, checked);
 
-            goto end2;
-          }
-          break;
+        // IR (l);
+        // IR (r);
 
-        case OP_DOT_ACCESS:
+        if (r->type == l->type && l->type == OBJ_CONST
+            && l->v.o_const.v.type == r->v.o_const.v.type
+            && l->v.o_const.v.type == CONST_INT)
           {
-            obj_t *l = pop (vm);
-            // D (sf_obj_print (*l); printf ("%d\n", l->meta.ref_count));
-            char *name = i.c;
-            // D (printf ("%s\n", name));
+            int e = r->v.o_const.v.v.c_int.v * l->v.o_const.v.v.c_int.v;
 
-            obj_t *o = container_access (l, name);
+            obj_t *o = sf_objstore_req_forconst ((const_t *)(const_t[]){
+                { .type = CONST_INT, .v.c_int.v = e } });
 
             if (o == NULL)
               {
-                printf ("member '%s' does not exist.\n", name);
-                exit (EXIT_FAILURE);
+                o = sf_objstore_req ();
+                o->type = OBJ_CONST;
+                o->v.o_const.v.type = CONST_INT;
+                o->v.o_const.v.v.c_int.v = e;
               }
 
-            push (vm, o);
+            push (vm, o, checked);
             IR (o);
-            DR (l, vm);
           }
-          break;
-
-        case OP_LOAD_ARRAY:
-          {
-            array_t *ar = sf_array_withsize (i.a);
-            // for (int j = i.a - 1; j >= 0; j--)
-            //   {
-            //     ar->vals[c++] = pop (vm);
-            //   }
+        else
+          push_none (vm, checked);
 
-            for (int j = i.a - 1; j > -1; j--)
-              ar->vals[j] = pop (vm);
+        DR (l, vm);
+        DR (r, vm);
+      }
+      break;
 
-            obj_t *o = sf_objstore_req ();
-            o->type = OBJ_ARRAY;
-            o->v.o_array.v = ar;
+    case OP_CMP:
+      {
+        obj_t *r = pop (vm, checked);
+        obj_t *l = pop (vm, checked);
 
-            push (vm, o);
-            IR (o);
-          }
-          break;
+        // IR (l);
+        // IR (r);
 
-        case OP_SQR_ACCESS:
-          {
-            obj_t *idx = pop (vm);
-            obj_t *par = pop (vm);
+        int rc = cmp_obj (i.a, l, r);
 
-            obj_t *o = sqr_access (par, idx);
-            push (vm, o);
-            IR (o);
+        const_t bc = (const_t){ .type = CONST_BOOL, .v.c_bool.v = rc };
 
-            DR (idx, vm);
-            DR (par, vm);
-          }
-          break;
+        obj_t *o_bc = sf_objstore_req_forconst (&bc);
 
-        case OP_RANGE_FAST:
+        if (o_bc == NULL)
           {
-            int lv = i.a;
-            int rv = i.b;
-            int step = (int)i.c;
+            o_bc = sf_objstore_req ();
 
-            if (lv < rv)
-              {
-                array_t *a = sf_array_withsize (((rv - 1 - lv) / step) + 1);
+            o_bc->type = OBJ_CONST;
+            o_bc->v.o_const.v = bc;
+          }
 
-                int c = 0;
-                for (int j = lv; j < rv; j += step)
-                  {
-                    obj_t *o
-                        = sf_objstore_req_forconst ((const_t *)(const_t[]){ {
-                            .type = CONST_INT,
-                            .v.c_int.v = j,
-                        } });
+        push (vm, o_bc, checked);
+        IR (o_bc);
 
-                    if (o == NULL)
-                      {
-                        o = sf_objstore_req ();
-                        o->type = OBJ_CONST;
-                        o->v.o_const.v.type = CONST_INT;
-                        o->v.o_const.v.v.c_int.v = j;
-                      }
+        DR (l, vm);
+        DR (r, vm);
+      }
+      break;
 
-                    a->vals[c++] = o;
-                    IR (o);
-                  }
+    case OP_LOAD_BUILDCLASS:
+      {
+        frame_t nf = sf_frame_new_name ();
 
-                if (a->len != c)
-                  a->len = c;
+        nf.return_ip = i.a; /* buildclass_end location */
+        sf_vm_addframe (vm, nf);
 
-                obj_t *o = sf_objstore_req ();
-                o->type = OBJ_ARRAY;
-                o->v.o_array.v = a;
+        vm->ip++;
+        sf_vm_exec_single_frame (vm);
+      }
+      break;
 
-                push (vm, o);
-                IR (o);
-              }
-          }
-          break;
+    case OP_LOAD_BUILDCLASS_END:
+      {
+        frame_t f = vm->frames[vm->fp - 1];
+        assert (f.type == FRAME_NAME);
 
-        case OP_GET_ITER:
-          {
-            obj_t *v = pop (vm);
+        class_t *cl = sf_class_new ();
 
-            obj_t *o = sf_objstore_req ();
-            o->type = OBJ_ITER;
-            o->v.o_iter.v = sf_iter_new (v);
+        cl->svl = f.n.nvl;
+        cl->svc = f.n.nvl;
 
-            push (vm, o);
-            IR (o);
+        frame_t *ff = &vm->frames[vm->fp - 2];
+        if (ff->type == FRAME_NAME && ff->is_mod)
+          {
+            cl->par_fr = ff;
           }
-          break;
 
-        case OP_LOAD_ITER_NEXT:
-          {
-            obj_t *iter = pop (vm);
+        // cl->slots = SFMALLOC (sizeof (*cl->slots));
+        // cl->vals = SFMALLOC (sizeof (*cl->vals));
+
+        // for (size_t j = 0; j < f.n.nvl; j++)
+        //   {
+        //     cl->vals[j] = f.n.vals[j];
+        //     cl->slots[j] = f.n.names[j];
+        //   }
 
-            assert (iter->type == OBJ_ITER);
-            obj_t *n = sf_iter_next (&iter->v.o_iter.v);
+        cl->slots = SFMALLOC (f.n.nvl * sizeof (*cl->slots));
+        cl->vals = SFMALLOC (f.n.nvl * sizeof (*cl->vals));
 
-            if (n == NULL)
+        for (size_t j = 0; j < f.n.nvl; j++)
+          {
+            if (f.n.names[j] == NULL)
               {
-                vm->ip = i.a - 1;
-                DR (iter, vm);
+                cl->slots[j] = NULL;
+                cl->vals[j] = NULL;
+                continue;
               }
-            else
-              {
-                push (vm, iter);
-                if (i.b == 1) /* just push the value */
-                  {
-                    push (vm, n);
-                    IR (n);
-                  }
-                else
-                  {
-                    /* split the nth iterable */
-                    switch (n->type)
-                      {
-                      case OBJ_ARRAY:
-                        {
-                          array_t *na = n->v.o_array.v;
-                          assert (na->len == i.b
-                                  && "Insufficient values to unpack");
-
-                          for (int j = i.b - 1; j > -1; j--)
-                            {
-                              obj_t *ji = na->vals[j];
-                              IR (ji);
-                              push (vm, ji);
-                            }
-                        }
-                        break;
 
-                      default:
-                        break;
-                      }
-                  }
-              }
+            cl->slots[j] = SFSTRDUP (f.n.names[j]);
+            cl->vals[j] = f.n.vals[j];
+            IR (f.n.vals[j]);
           }
-          break;
 
-        case OP_IMPORT:
-          {
-            const char *path = i.c;
-            const char *alias = vm->insts[++vm->ip].c;
-
-            if (sf_modstore_haskey (vm->mod_store, vm->ip))
-              {
-                obj_t *mg = sf_modstore_get (vm->mod_store, vm->ip);
+        cl->name = SFSTRDUP (vm->insts[i.a].c);
 
-                IR (mg);
-                push (vm, mg);
-                goto end3;
-              }
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_CLASS;
+        o->v.o_class.v = cl;
 
-            FILE *f = fopen (path, "r");
-            if (f == NULL)
-              {
-                perror ("error reading file");
-                exit (EXIT_FAILURE);
-              }
+        push (vm, o, checked);
+        IR (o);
 
-            fseek (f, 0, SEEK_END);
-            long pos = ftell (f);
+        sf_vm_popframe (vm);
 
-            // D (printf ("file size: %zu\n", pos));
-            fseek (f, 0, SEEK_SET);
+        return SF_VM_CLASS_END;
+      }
+      break;
 
-            char *buf = SFMALLOC ((pos + 2) * sizeof (char));
-            fread (buf, sizeof (char), pos, f);
+    case OP_DOT_ACCESS:
+      {
+        obj_t *l = pop (vm, checked);
+        // D (sf_obj_print (*l); printf ("%d\n", l->meta.ref_count));
+        char *name = i.c;
+        // D (printf ("%s\n", name));
 
-            buf[pos++] = '\n';
-            buf[pos] = '\0';
+        obj_t *o = container_access (l, name);
 
-            fclose (f);
+        if (o == NULL)
+          {
+            printf ("member '%s' does not exist.\n", name);
+            exit (EXIT_FAILURE);
+          }
 
-            TokenSM *smt = sf_statem_token_new (buf);
-            //   printf ("%s\n", smt->raw);
-            sf_token_gen (smt);
-            token_t *vp = smt->vals;
+        push (vm, o, checked);
+        IR (o);
+        DR (l, vm);
+      }
+      break;
 
-            // for (int i = 0; i < smt->vl; i++)
-            //   {
-            //     sf_token_print (smt->vals[i]);
-            //   }
+    case OP_LOAD_ARRAY:
+      {
+        array_t *ar = sf_array_withsize (i.a);
+        // for (int j = i.a - 1; j >= 0; j--)
+        //   {
+        //     ar->vals[c++] = pop (vm, checked);
+        //   }
 
-            // frame_t *frms = vm->frames;
-            // size_t frc = vm->frame_cap;
-            // size_t vmfp = vm->fp;
+        for (int j = i.a - 1; j > -1; j--)
+          ar->vals[j] = pop (vm, checked);
 
-            // obj_t **gp = vm->globals;
-            // hashtable_t **hts = vm->hts;
-            // size_t htl = vm->htl;
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_ARRAY;
+        o->v.o_array.v = ar;
 
-            // vm->globals = SFMALLOC (vm->globals_cap * sizeof
-            // (*vm->globals));
+        push (vm, o, checked);
+        IR (o);
+      }
+      break;
 
-            // for (size_t i = 0; i < vm->globals_cap; i++)
-            //   vm->globals[i] = NULL;
+    case OP_LOAD_DICT:
+      {
+        size_t n = i.a;
+        dict_t *d = sf_dict_new ();
 
-            // vm->htl = 1;
-            // vm->hts = SFMALLOC (vm->htc * sizeof (*vm->hts));
-            // vm->hts[0] = sf_ht_new ();
+        /* pairs come off the stack last-first, insert them in source
+           order so a repeated key keeps its last value */
+        obj_t **kv = SFMALLOC ((2 * n + 1) * sizeof (*kv));
 
-            // for (size_t i = vm->htl; i < vm->htc; i++)
-            //   vm->hts[i] = NULL;
+        for (size_t j = 2 * n; j > 0; j--)
+          kv[j - 1] = pop (vm, checked);
 
-            // vm->frames = SFMALLOC (vm->frame_cap * sizeof (*vm->frames));
-            // vm->fp = 0;
+        for (size_t j = 0; j < n; j++)
+          {
+            sf_dict_set (d, kv[2 * j], kv[2 * j + 1], vm);
+            DR (kv[2 * j], vm);
+          }
 
-            // sf_natives_add_tovm (vm);
+        SFFREE (kv);
 
-            StmtSM *stt = sf_ast_gen (smt);
-            stmt_t *stt_vals = stt->vals;
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_DICT;
+        o->v.o_dict.v = d;
 
-            // approach 0
-            if (0)
-              {
-                // D (printf ("%lu\n", stt->vl));
-                // for (size_t i = 0; i < stt->vl; i++)
-                //   sf_stmt_print (stt->vals[i]);
+        push (vm, o, checked);
+        IR (o);
+      }
+      break;
 
-                // vm_t mm = sf_vm_new ();
-                // mm.meta.slot = SF_VM_SLOT_NAME;
-                // sf_natives_add_tovm (&mm);
+    case OP_SQR_ACCESS:
+      {
+        obj_t *idx = pop (vm, checked);
+        obj_t *par = pop (vm, checked);
 
-                // mm.fp = 1;
-                // sf_vm_gen_bytecode (&mm, stt);
-                // mm.fp = 0;
+        obj_t *o = sqr_access (par, idx);
+        push (vm, o, checked);
+        IR (o);
 
-                // // for (int i = 0; i < mm.inst_len; i++)
-                // //   sf_vm_print_inst (mm.insts[i]);
+        DR (idx, vm);
+        DR (par, vm);
+      }
+      break;
 
-                // frame_t top = sf_frame_new_name ();
-                // top.pop_ret_val = 0;
-                // top.return_ip = mm.inst_len - 1;
-                // top.stack_base = mm.sp;
+    case OP_SLICE:
+      {
+        obj_t *parts[3] = { NULL, NULL, NULL }; /* lo, hi, step */
+        int64_t v[3] = { 0, 0, 1 };
 
-                // sf_vm_addframe (&mm, top);
-                // sf_vm_exec_single_frame (&mm);
+        for (int j = 2; j >= 0; j--)
+          {
+            if (!(i.a & (1 << j)))
+              continue;
 
-                // frame_t *bf = &mm.frames[mm.fp - 1];
+            parts[j] = pop (vm, checked);
 
-                // // // D (printf ("%lu\n", bf->n.nvl));
-                // // // for (int i = 0; i < bf->n.nvl; i++)
-                // // //   printf ("%s\n", bf->n.names[i]);
+            if (parts[j]->type != OBJ_CONST)
+              {
+                printf ("slice bounds must be integers.\n");
+                exit (EXIT_FAILURE);
+              }
 
-                // mod_t *mod = sf_mod_new ();
+            const_t *c = &parts[j]->v.o_const.v;
 
-                // mod->name = SFSTRDUP (alias);
-                // mod->slots = SFMALLOC (bf->n.nvc * sizeof (*mod->slots));
-                // mod->vals = SFMALLOC (bf->n.nvc * sizeof (*mod->vals));
+            /* a[lo:hi:none] is the same as leaving the part out */
+            if (c->type == CONST_NONE)
+              {
+                DR (parts[j], vm);
+                parts[j] = NULL;
+                continue;
+              }
 
-                // for (int i = 0; i < bf->n.nvl; i++)
-                //   {
-                //     mod->slots[i] = SFSTRDUP (bf->n.names[i]);
-                //     mod->vals[i] = bf->n.vals[i];
-                //     IR (mod->vals[i]);
-                //   }
+            if (c->type != CONST_INT)
+              {
+                printf ("slice bounds must be integers.\n");
+                exit (EXIT_FAILURE);
+              }
 
-                // mod->svc = bf->n.nvc;
-                // mod->svl = bf->n.nvl;
+            v[j] = c->v.c_int.v;
+            DR (parts[j], vm);
+          }
 
-                // obj_t *o = sf_objstore_req ();
-                // o->type = OBJ_MOD;
-                // o->v.o_mod.v = mod;
+        obj_t *par = pop (vm, checked);
+        size_t off, len;
 
-                // push (vm, o);
-                // IR (o);
+        sf_view_bounds (sf_view_plen (par), parts[0] ? &v[0] : NULL,
+                        parts[1] ? &v[1] : NULL, v[2], &off, &len);
 
-                // sf_vm_framefree (bf, &mm);
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_VIEW;
+        o->v.o_view.v = sf_view_new (par, off, len, v[2]);
 
-                // for (int i = 0; i < mm.globals_cap; i++)
-                //   {
-                //     if (mm.globals[i] != NULL)
-                //       {
-                //         DR (mm.globals[i], vm);
-                //       }
-                //   }
+        push (vm, o, checked);
+        IR (o);
 
-                // SFFREE (mm.globals);
+        DR (par, vm);
+      }
+      break;
 
-                // for (int i = 0; i < mm.htc; i++)
-                //   {
-                //     if (mm.hts[i] != NULL)
-                //       sf_ht_free (mm.hts[i]);
-                //   }
+    case OP_RANGE_FAST:
+      {
+        int lv = i.a;
+        int rv = i.b;
+        int step = (int)i.c;
 
-                // SFFREE (mm.hts);
-                // SFFREE (mm.insts);
-                // SFFREE (mm.map_consts);
-                // SFFREE (mm.stack);
-                // SFFREE (mm.frames);
-              }
+        if (lv < rv)
+          {
+            array_t *a = sf_array_withsize (((rv - 1 - lv) / step) + 1);
 
-            // approach 1
-            size_t ip = vm->inst_len;
+            int c = 0;
+            for (int j = lv; j < rv; j += step)
+              {
+                obj_t *o
+                    = sf_objstore_req_forconst ((const_t *)(const_t[]){ {
+                        .type = CONST_INT,
+                        .v.c_int.v = j,
+                    } });
 
-            PRESERVE (vm);
-            vm->meta.slot = SF_VM_SLOT_NAME;
-            sf_vm_gen_bytecode (vm, stt);
+                if (o == NULL)
+                  {
+                    o = sf_objstore_req ();
+                    o->type = OBJ_CONST;
+                    o->v.o_const.v.type = CONST_INT;
+                    o->v.o_const.v.v.c_int.v = j;
+                  }
 
-            // for (size_t i = ip; i < vm->inst_len; i++)
-            //   sf_vm_print_inst (vm->insts[i]);
+                a->vals[c++] = o;
+                IR (o);
+              }
 
-            RESTORE (vm);
+            if (a->len != c)
+              a->len = c;
 
-            frame_t fr = sf_frame_new_name ();
-            fr.is_mod = 1;
-            fr.pop_ret_val = 1;
-            fr.return_ip = vm->ip;
-            fr.stack_base = vm->sp;
+            obj_t *o = sf_objstore_req ();
+            o->type = OBJ_ARRAY;
+            o->v.o_array.v = a;
 
-            vm->ip = ip;
+            push (vm, o, checked);
+            IR (o);
+          }
+      }
+      break;
 
-            sf_vm_addframe (vm, fr);
-            sf_vm_exec_single_frame (vm);
+    case OP_GET_ITER:
+      {
+        obj_t *v = pop (vm, checked);
 
-            frame_t *bf = &vm->frames[vm->fp - 1];
+        obj_t *o = sf_objstore_req ();
+        o->type = OBJ_ITER;
+        o->v.o_iter.v = sf_iter_new (v);
 
-            // // D (printf ("%lu\n", bf->n.nvl));
-            // // for (int i = 0; i < bf->n.nvl; i++)
-            // //   printf ("%s\n", bf->n.names[i]);
+        push (vm, o, checked);
+        IR (o);
+      }
+      break;
 
-            mod_t *mod = sf_mod_new ();
+    case OP_LOAD_ITER_NEXT:
+      {
+        obj_t *iter = pop (vm, checked);
 
-            mod->name = SFSTRDUP (alias);
-            mod->slots = SFMALLOC (bf->n.nvc * sizeof (*mod->slots));
-            mod->vals = SFMALLOC (bf->n.nvc * sizeof (*mod->vals));
+        assert (!checked || iter->type == OBJ_ITER);
+        obj_t *n = sf_iter_next (&iter->v.o_iter.v);
 
-            for (int i = 0; i < bf->n.nvl; i++)
+        if (n == NULL)
+          {
+            vm->ip = i.a - 1;
+            DR (iter, vm);
+          }
+        else
+          {
+            push (vm, iter, checked);
+            if (i.b == 1) /* just push the value */
               {
-                if (bf->n.names[i] == NULL)
-                  continue;
+                push (vm, n, checked);
+                IR (n);
+              }
+            else
+              {
+                /* split the nth iterable */
+                switch (n->type)
+                  {
+                  case OBJ_ARRAY:
+                    {
+                      array_t *na = n->v.o_array.v;
+                      assert (na->len == i.b
+                              && "Insufficient values to unpack");
+
+                      for (int j = i.b - 1; j > -1; j--)
+                        {
+                          obj_t *ji = na->vals[j];
+                          IR (ji);
+                          push (vm, ji, checked);
+                        }
+                    }
+                    break;
 
-                mod->slots[i] = SFSTRDUP (bf->n.names[i]);
-                mod->vals[i] = bf->n.vals[i];
-                IR (mod->vals[i]);
+                  default:
+                    break;
+                  }
               }
+          }
+      }
+      break;
 
-            mod->svc = bf->n.nvc;
-            mod->svl = bf->n.nvl;
+    case OP_IMPORT:
+      {
+        const char *path = i.c;
+        const char *alias = vm->insts[++vm->ip].c;
+        obj_t *mg = sf_vm_import (vm, path, alias);
 
-            obj_t *o = sf_objstore_req ();
-            o->type = OBJ_MOD;
-            o->v.o_mod.v = mod;
+        IR (mg);
+        push (vm, mg, checked);
+      }
+      break;
 
-            push (vm, o);
-            IR (o);
+    case OP_IMPORT_ALIAS:
+      {
+        assert (
+            0 && "control shouldn't reach here (possible ip corruption)");
+      }
+      break;
 
-            IR (o);
-            sf_modstore_add (vm->mod_store, vm->ip, o);
+    default:
+      break;
+    }
 
-            vm->fp--;
-            mod->fr = bf;
+  /* a tail call that made a call returns what it got, like RETURN 1 */
+  return tail ? SF_VM_RETURN : SF_VM_NEXT;
+}
 
-            // for (size_t i = 0; i < mod->fr->n.nvl; i++)
-            //   D (printf ("%s\n", mod->fr->n.names[i]));
+/**
+ * Whether fr, about to run from vm->ip, runs a body the verifier passed.
+ * If so it gets the room on the stack and the locals the body was
+ * verified against, so vm_step can go without checking for them.
+ */
+static int
+verified_enter (vm_t *vm, frame_t *fr)
+{
+  const verify_fn_t *vf = sf_verify_get (vm->verify, vm->ip);
 
-            // vm->frames = frms;
-            // vm->frame_cap = frc;
-            // vm->fp = vmfp;
-            // vm->globals = gp;
-            // vm->hts = hts;
-            // vm->htl = htl;
+  if (vf == NULL || fr->type != FRAME_LOCAL
+      || fr->l.locals_cap < (size_t)vf->nl)
+    return 0;
 
-            SFFREE (buf);
+  if (vm->sp + vf->depth > vm->stack_cap)
+    {
+      vm->stack_cap = vm->sp + vf->depth + SF_VM_STACK_CAP;
+      vm->stack = SFREALLOC (vm->stack, vm->stack_cap * sizeof (*vm->stack));
+    }
 
-            for (size_t i = 0; i < stt->vl; i++)
-              sf_stmt_free (&stt_vals[i]);
+  if (fr->l.locals_count < (size_t)vf->nl)
+    fr->l.locals_count = vf->nl;
 
-            SFFREE (stt_vals);
-            SFFREE (stt);
+  return 1;
+}
 
-            for (size_t i = 0; i < smt->vc; i++)
-              {
-                if (vp[i].type != -1)
-                  sf_token_free (&vp[i]);
-              }
+SF_API void
+sf_vm_exec_single_frame (vm_t *vm)
+{
+  frame_t *fr = &vm->frames[vm->fp - 1];
+  int r = SF_VM_NEXT;
 
-            SFFREE (vp);
-            SFFREE (smt);
-          }
-          break;
+  if (vm->meta.g_slot >= vm->globals_cap)
+    {
+      vm->globals_cap += SF_VM_GLOBALS_CAP;
+      vm->globals
+          = SFREALLOC (vm->globals, vm->globals_cap * sizeof (*vm->globals));
+    }
 
-        case OP_IMPORT_ALIAS:
-          {
-            assert (
-                0 && "control shouldn't reach here (possible ip corruption)");
-          }
-          break;
+  /* a tail call starts the frame over, at another function */
+  do
+    {
+      int checked = !verified_enter (vm, fr);
 
-        default:
-          break;
-        }
+      /* hot functions run as native code, which may hand back mid-frame */
+      if (vm->jit != NULL)
+        r = sf_jit_run (vm);
+      else if (vm->reg != NULL)
+        r = sf_reg_run (vm);
+      else
+        r = SF_VM_NEXT;
 
-    end3:;
-      i = vm->insts[++vm->ip];
+      if (checked)
+        {
+          while (r == SF_VM_NEXT)
+            if ((r = vm_step (vm, fr, vm->insts[vm->ip], 1)) == SF_VM_NEXT)
+              vm->ip++;
+        }
+      else
+        {
+          while (r == SF_VM_NEXT)
+            if ((r = vm_step (vm, fr, vm->insts[vm->ip], 0)) == SF_VM_NEXT)
+              vm->ip++;
+        }
     }
+  while (r == SF_VM_TAIL);
+
+  if (r == SF_VM_CLASS_END)
+    goto end2;
 
-end:;
   if (fr->pop_ret_val)
     {
-      obj_t *p = pop (vm);
+      obj_t *p = pop (vm, 1);
       if (p != NULL)
         DR (p, vm);
     }
@@ -1875,6 +2076,28 @@ end2:;
   vm->ip = fr->return_ip;
 }
 
+/**
+ * Runs the instruction at ip of the top frame, for native code handing
+ * an instruction back to the interpreter. Returns the ip to go on at,
+ * or SF_VM_STEP_END once the frame returned.
+ */
+SF_API size_t
+sf_vm_step (vm_t *vm, size_t ip)
+{
+  int r;
+
+  vm->ip = ip;
+  r = vm_step (vm, &vm->frames[vm->fp - 1], vm->insts[ip], 1);
+
+  /* a class body is run by its BUILDCLASS, never by native code */
+  assert (r != SF_VM_CLASS_END);
+
+  if (r == SF_VM_TAIL)
+    return vm->ip;
+
+  return r == SF_VM_RETURN ? SF_VM_STEP_END : vm->ip + 1;
+}
+
 SF_API void
 sf_vm_exec_frame_top (vm_t *vm)
 {
@@ -1906,7 +2129,7 @@ end:;
 
   if (fr->pop_ret_val)
     {
-      DR (pop (vm), vm);
+      DR (pop (vm, 1), vm);
     }
   else
     {
@@ -1969,6 +2192,94 @@ end:;
     goto start;
 }
 
+/**
+ * The module at path, compiled and run on first use. Every import of
+ * the same file shares one module object, which the store keeps a
+ * reference to. Calling this before the program starts pre-warms it.
+ */
+SF_API obj_t *
+sf_vm_import (vm_t *vm, const char *path, const char *name)
+{
+  modent_t *e = sf_modstore_find (vm->mod_store, path);
+  obj_t *o;
+
+  if (e != NULL && e->mod != NULL)
+    return e->mod;
+
+  size_t ip = vm->inst_len;
+
+  /* sf_imports_compile may have compiled it already */
+  if (e != NULL && e->code != SF_MOD_NOCODE)
+    ip = e->code;
+  else
+    {
+      /* module names go in a scope of their own, the importer's stay put */
+      PRESERVE (vm);
+      sf_vm_push_scope (vm);
+      vm->meta.slot = SF_VM_SLOT_NAME;
+      sf_fishc_compile (vm, path);
+      sf_vm_pop_scope (vm);
+      RESTORE (vm);
+    }
+
+  frame_t fr = sf_frame_new_name ();
+  fr.is_mod = 1;
+  fr.pop_ret_val = 1;
+  fr.return_ip = vm->ip;
+  fr.stack_base = vm->sp;
+
+  vm->ip = ip;
+
+  sf_vm_addframe (vm, fr);
+  sf_vm_exec_single_frame (vm);
+
+  frame_t *bf = &vm->frames[vm->fp - 1];
+  mod_t *mod = sf_mod_new ();
+
+  mod->name = SFSTRDUP (name != NULL ? name : path);
+  mod->slots = SFMALLOC (bf->n.nvc * sizeof (*mod->slots));
+  mod->vals = SFMALLOC (bf->n.nvc * sizeof (*mod->vals));
+
+  for (size_t i = 0; i < bf->n.nvl; i++)
+    {
+      if (bf->n.names[i] == NULL)
+        {
+          mod->slots[i] = NULL;
+          mod->vals[i] = NULL;
+          continue;
+        }
+
+      mod->slots[i] = SFSTRDUP (bf->n.names[i]);
+      mod->vals[i] = bf->n.vals[i];
+      IR (mod->vals[i]);
+    }
+
+  mod->svc = bf->n.nvc;
+  mod->svl = bf->n.nvl;
+
+  /**
+   * The frame slot is reused once the module is done, so the module and
+   * the classes it defined point at a copy of their own.
+   */
+  mod->fr = SFMALLOC (sizeof (*mod->fr));
+  *mod->fr = *bf;
+  vm->fp--;
+
+  for (size_t i = 0; i < mod->svl; i++)
+    if (mod->vals[i] != NULL && mod->vals[i]->type == OBJ_CLASS
+        && mod->vals[i]->v.o_class.v->par_fr == bf)
+      mod->vals[i]->v.o_class.v->par_fr = mod->fr;
+
+  o = sf_objstore_req ();
+  o->type = OBJ_MOD;
+  o->v.o_mod.v = mod;
+
+  IR (o);
+  sf_modstore_add (vm->mod_store, path, o);
+
+  return o;
+}
+
 SF_API frame_t
 sf_frame_new_local ()
 {
@@ -1980,6 +2291,7 @@ sf_frame_new_local ()
   f.l.locals = SFMALLOC (f.l.locals_cap * sizeof (*f.l.locals));
   f.stack_base = 0;
   f.is_mod = 0;
+  memset (f.ints, 0, sizeof (f.ints));
 
   for (int i = 0; i < f.l.locals_cap; i++)
     f.l.locals[i] = NULL;
@@ -2001,7 +2313,10 @@ sf_frame_new_name ()
   f.is_mod = 0;
 
   for (int i = 0; i < f.n.nvc; i++)
-    f.n.vals[i] = NULL;
+    {
+      f.n.vals[i] = NULL;
+      f.n.names[i] = NULL;
+    }
 
   return f;
 }
@@ -2102,7 +2417,7 @@ container_access (obj_t *o, char *name)
         if (c->par_fr == NULL)
           {
             for (int i = 0; i < c->svl; i++)
-              if (!strcmp (c->slots[i], name))
+              if (c->slots[i] != NULL && !strcmp (c->slots[i], name))
                 return c->vals[i];
           }
         else
@@ -2111,7 +2426,7 @@ container_access (obj_t *o, char *name)
 
             for (int i = 0; i < c->svl; i++)
               {
-                if (!strcmp (c->slots[i], name))
+                if (c->slots[i] != NULL && !strcmp (c->slots[i], name))
                   {
                     r = c->vals[i];
                     break;
@@ -2195,7 +2510,7 @@ container_access (obj_t *o, char *name)
         for (size_t i = 0; i < mo->svl; i++)
           {
             // D (printf ("(%s)\n", mo->slots[i]));
-            if (!strcmp (mo->slots[i], name))
+            if (mo->slots[i] != NULL && !strcmp (mo->slots[i], name))
               {
                 r = mo->vals[i];
                 break;
@@ -2304,6 +2619,46 @@ sqr_access (obj_t *p, obj_t *v)
       }
       break;
 
+    case OBJ_TARRAY:
+      {
+        assert (v->type == OBJ_CONST && v->v.o_const.v.type == CONST_INT);
+        int idx = v->v.o_const.v.v.c_int.v;
+
+        tarray_t *t = p->v.o_tarray.v;
+
+        assert (idx >= 0 && t->len > idx);
+
+        /* the element escapes into the VM here, box it */
+        r = sf_tarray_box (t, idx);
+      }
+      break;
+
+    case OBJ_DICT:
+      {
+        r = sf_dict_get (p->v.o_dict.v, v);
+
+        if (r == NULL)
+          {
+            printf ("key '");
+            sf_obj_print (*v);
+            printf ("' not found in dict.\n");
+            exit (EXIT_FAILURE);
+          }
+      }
+      break;
+
+    case OBJ_VIEW:
+      {
+        assert (v->type == OBJ_CONST && v->v.o_const.v.type == CONST_INT);
+        int idx = v->v.o_const.v.v.c_int.v;
+
+        view_t *w = p->v.o_view.v;
+
+        assert (idx >= 0 && w->len > idx);
+        r = sf_view_get (w, idx);
+      }
+      break;
+
     default:
       break;
     }
@@ -2330,6 +2685,40 @@ sqr_set (obj_t *p, obj_t *i, obj_t *val, vm_t *vm)
       }
       break;
 
+    case OBJ_TARRAY:
+      {
+        assert (i->type == OBJ_CONST && i->v.o_const.v.type == CONST_INT);
+
+        int idx = i->v.o_const.v.v.c_int.v;
+        tarray_t *t = p->v.o_tarray.v;
+
+        assert (idx >= 0 && t->len > idx);
+
+        if (val->type != OBJ_CONST)
+          {
+            printf ("cannot store non-numeric value in %s array.\n",
+                    sf_tarray_typename (t->type));
+            exit (EXIT_FAILURE);
+          }
+
+        /* unbox straight into the buffer, the array keeps no reference */
+        sf_tarray_set (t, idx, val->v.o_const.v);
+        DR (val, vm);
+      }
+      break;
+
+    case OBJ_DICT:
+      sf_dict_set (p->v.o_dict.v, i, val, vm);
+      break;
+
+    case OBJ_VIEW:
+      {
+        /* writes never reach the parent, the view gets its own copy */
+        sf_view_materialize (p, vm);
+        sqr_set (p, i, val, vm);
+      }
+      break;
+
     default:
       break;
     }
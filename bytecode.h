@@ -6,9 +6,9 @@
 #include "const.h"
 #include "expr.h"
 #include "header.h"
-#include "ht.h"
 #include "iter.h"
 #include "object.h"
+#include "scope.h"
 #include "stmt.h"
 
 typedef enum OpcodeType
@@ -44,6 +44,29 @@ typedef enum OpcodeType
   OP_RETURN = 26,
   OP_IMPORT = 27,
   OP_IMPORT_ALIAS = 28,
+  OP_SLICE = 29,
+  OP_LOAD_DICT = 30,
+  OP_DUP = 31,
+
+  /* typed ints, see the types pass in opt.h */
+  OP_LOAD_I = 32,     /* int slot a, boxed when b is 1 */
+  OP_STORE_I = 33,    /* into int slot a */
+  OP_CONST_I = 34,    /* the int a */
+  OP_ADD_I = 35,      /* result boxed when b is 1, as for the next ones */
+  OP_SUB_I = 36,
+  OP_MUL_I = 37,
+  OP_ADD_1_I = 38,
+  OP_CMP_I = 39,      /* SF_CMP_I (b), pushes a bool object */
+  OP_CMP_JUMP_I = 40, /* CMP_I b; JUMP_IF_FALSE a */
+  OP_DUP_I = 41,      /* b & 1 boxes the copy below, b & 2 the top */
+
+  /* guards of inlined calls, see the inline pass in opt.h */
+  OP_GUARD_FN = 42,     /* callee on top coded at b, or jump to a */
+  OP_GUARD_METHOD = 43, /* c of the object on top coded at b, or jump */
+
+  OP_TAIL_CALL = 44, /* CALL a 1; RETURN 1 in the caller's frame */
+
+  OP_CMP_JUMP = 45, /* CMP b; JUMP_IF_FALSE a, no bool in between */
 
 } opcode_t;
 
@@ -56,6 +79,27 @@ typedef struct _inst_s
 
 } instr_t;
 
+/* ops whose a is an absolute ip, code that moves has to rebase it */
+#define SF_OP_HAS_IP(X)                                                       \
+  ((X) == OP_JUMP || (X) == OP_JUMP_IF_FALSE || (X) == OP_LOAD_FUNC_CODED     \
+   || (X) == OP_LOAD_ITER_NEXT || (X) == OP_LOAD_BUILDCLASS                   \
+   || (X) == OP_LOAD_BUILDCLASS_END || (X) == OP_CMP_JUMP_I                   \
+   || (X) == OP_GUARD_FN || (X) == OP_GUARD_METHOD || (X) == OP_CMP_JUMP)
+
+/**
+ * Typed ops keep ints on the VM stack as they are, in place of an
+ * object pointer. Codegen never leaves one there across a jump, so only
+ * typed ops ever see them. The b of OP_CMP_I and OP_CMP_JUMP_I is the
+ * comparison, plus which operands are objects after all (the others
+ * are ints).
+ */
+#define SF_VM_RAW(V) ((obj_t *)(intptr_t)(V))
+#define SF_VM_UNRAW(O) ((int)(intptr_t)(O))
+
+#define SF_CMP_L_OBJ (1 << 4)
+#define SF_CMP_R_OBJ (1 << 5)
+#define SF_CMP_I(B) ((B) & 15)
+
 enum FrameType
 {
   FRAME_LOCAL,
@@ -63,6 +107,9 @@ enum FrameType
   FRAME_NAME,
 };
 
+/* int slots of a local frame */
+#define SF_FRAME_INTS (16)
+
 typedef struct _frame_s
 {
   int type;
@@ -92,17 +139,12 @@ typedef struct _frame_s
   int pop_ret_val; // 1: yes, 0: no
   int is_mod;
 
+  int ints[SF_FRAME_INTS]; /* locals the types pass unboxed */
+
 } frame_t;
 
 #define SF_FRAME_LOCALS_CAP (64)
 
-typedef struct
-{
-  size_t pos;
-  int slot;
-
-} vval_t;
-
 typedef struct _vm_s
 {
   size_t ip;
@@ -114,9 +156,10 @@ typedef struct _vm_s
   size_t s_ml;
   size_t s_mc;
 
-  hashtable_t **hts;
-  size_t htl;
-  size_t htc;
+  scope_t *scopes; /* codegen scopes, innermost last */
+  size_t scl;
+  size_t scc;
+  arena_t cg_arena;
 
   obj_t **globals; /* var name -> slot; globals[slot] = var_value */
   size_t globals_cap;
@@ -130,6 +173,12 @@ typedef struct _vm_s
   size_t frame_cap;
 
   modstore_t *mod_store;
+  int opt; /* SF_OPT_* passes run over newly compiled code */
+  size_t inline_len; /* callees the inline pass copies, in instructions */
+  struct _jit_s *jit; /* native code of hot functions, NULL without */
+  struct _reg_s *reg; /* register code of functions, NULL without */
+  struct _verify_s *verify; /* functions run unchecked, NULL without */
+  struct _cg_loop_s *cg_loop; /* loops codegen is inside, innermost first */
 
   struct
   {
@@ -144,24 +193,38 @@ typedef struct _vm_s
 #define SF_VM_GLOBALS_CAP (512)
 #define SF_VM_STACK_CAP (128)
 #define SF_VM_FRAME_CAP (500)
-#define SF_VM_HT_CAP (8)
+#define SF_VM_SCOPES_CAP (8)
 #define SF_VM_NAME_CAP (8)
 
 #define SF_VM_SLOT_GLOBAL (0)
 #define SF_VM_SLOT_LOCAL (1)
 #define SF_VM_SLOT_NAME (2) // class
 
+/* how an instruction left its frame */
+enum VmStep
+{
+  SF_VM_NEXT,      /* go on at vm->ip + 1 */
+  SF_VM_RETURN,    /* the frame returned */
+  SF_VM_CLASS_END, /* a class body is done */
+  SF_VM_TAIL,      /* the frame goes on with another function at vm->ip */
+};
+
+#define SF_VM_STEP_END ((size_t)-1)
+
 #if defined(__cplusplus)
 extern "C"
 {
 #endif // __cplusplus
 
   SF_API vm_t sf_vm_new ();
+  SF_API const char *sf_vm_op_name (opcode_t);
   SF_API void sf_vm_print_inst (instr_t);
   SF_API void sf_vm_print_b (vm_t *);
 
   SF_API void sf_vm_exec_frame_top (vm_t *);
   SF_API void sf_vm_exec_single_frame (vm_t *);
+  SF_API size_t sf_vm_step (vm_t *, size_t);
+  SF_API obj_t *sf_vm_import (vm_t *, const char *, const char *);
   SF_API frame_t sf_frame_new_local ();
   SF_API frame_t sf_frame_new_name ();
   SF_API void sf_vm_addframe (vm_t *, frame_t);
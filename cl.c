@@ -31,7 +31,7 @@ sf_cobj_new (class_t *p)
 SF_API void
 sf_cobj_free (cobj_t *c)
 {
-  for (size_t i = 0; i < c->svc; i++)
+  for (size_t i = 0; i < c->svl; i++)
     if (c->slots[i] != NULL)
       SFFREE (c->slots[i]);
 
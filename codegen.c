@@ -60,27 +60,26 @@ add_inst (vm_t *vm, instr_t i)
   vm->insts[vm->inst_len++] = i;
 }
 
-hashtable_t *
-push_ht (vm_t *vm)
+SF_API scope_t *
+sf_vm_push_scope (vm_t *vm)
 {
-  if (vm->htl >= vm->htc)
+  if (vm->scl >= vm->scc)
     {
-      vm->htc += SF_VM_HT_CAP;
-      vm->hts = SFREALLOC (vm->hts, vm->htc * sizeof (*vm->hts));
+      vm->scc += SF_VM_SCOPES_CAP;
+      vm->scopes = SFREALLOC (vm->scopes, vm->scc * sizeof (*vm->scopes));
     }
 
-  vm->hts[vm->htl] = sf_ht_new ();
-  return vm->hts[vm->htl++];
+  sf_scope_open (&vm->scopes[vm->scl], &vm->cg_arena);
+  return &vm->scopes[vm->scl++];
 }
 
-void
-pop_ht (vm_t *vm)
+SF_API void
+sf_vm_pop_scope (vm_t *vm)
 {
-  if (!vm->htl)
+  if (!vm->scl)
     return;
 
-  sf_ht_free (vm->hts[--vm->htl]);
-  vm->hts[vm->htl] = NULL;
+  sf_scope_close (&vm->scopes[--vm->scl], &vm->cg_arena);
 }
 
 int
@@ -121,17 +120,16 @@ const_eqeq (const_t c, const_t d)
 static vval_t *
 get_var (vm_t *vm, const char *name, int *level_ptr)
 {
-  int gt = 0;
-  vval_t *v = sf_ht_get (vm->hts[vm->htl - 1], name, &gt);
-  int l = vm->htl - 1;
+  vval_t *v = sf_scope_get (&vm->scopes[vm->scl - 1], name);
+  int l = vm->scl - 1;
   int level = 0;
 
-  while (!gt)
+  while (v == NULL)
     {
       if (l < 1)
         break;
 
-      v = sf_ht_get (vm->hts[--l], name, &gt);
+      v = sf_scope_get (&vm->scopes[--l], name);
       level++;
     }
 
@@ -144,13 +142,7 @@ get_var (vm_t *vm, const char *name, int *level_ptr)
 static vval_t *
 get_var_look_top (vm_t *vm, const char *name)
 {
-  int gt = 0;
-  vval_t *v = sf_ht_get (vm->hts[vm->htl - 1], name, &gt);
-
-  if (!gt)
-    return NULL;
-
-  return v;
+  return sf_scope_get (&vm->scopes[vm->scl - 1], name);
 }
 
 static vval_t *
@@ -163,29 +155,710 @@ add_var (vm_t *vm, const char *name)
       return v;
     }
 
-  v = SFMALLOC (sizeof (*v));
-  v->slot = vm->meta.slot;
+  vval_t nv;
+  nv.slot = vm->meta.slot;
 
-  if (v->slot == SF_VM_SLOT_GLOBAL)
+  if (nv.slot == SF_VM_SLOT_GLOBAL)
     {
-      v->pos = vm->meta.g_slot++;
+      nv.pos = vm->meta.g_slot++;
     }
-  else if (v->slot == SF_VM_SLOT_LOCAL)
+  else if (nv.slot == SF_VM_SLOT_LOCAL)
     {
-      v->pos = vm->meta.l_slot++;
+      nv.pos = vm->meta.l_slot++;
     }
-  else if (v->slot == SF_VM_SLOT_NAME)
+  else if (nv.slot == SF_VM_SLOT_NAME)
     {
-      v->pos = vm->meta.n_slot++;
+      nv.pos = vm->meta.n_slot++;
     }
 
-  sf_ht_insert (vm->hts[vm->htl - 1], name, (void *)v);
-  return v;
+  return sf_scope_add (&vm->scopes[vm->scl - 1], &vm->cg_arena, name, nv);
+}
+
+/**
+ * Loop invariant code motion. Expressions in a loop that come out the
+ * same on every trip, arithmetic and comparisons over constants and
+ * variables the loop never assigns, are worked out once in a preheader
+ * and kept in hidden slots the loop loads instead. Attribute and item
+ * reads are hoisted too, but only out of loops that make no calls and
+ * store no attributes or items, since either could change the object.
+ *
+ * Only expressions every trip gets to are taken, the condition and the
+ * body up to the first statement that may return. The preheader sits
+ * behind a first copy of the loop test, so it runs once the loop is
+ * entered and never for a loop that does not run at all.
+ */
+#define SF_CG_HOIST_MAX (8)
+#define SF_CG_ASSIGNED_MAX (64)
+
+typedef struct
+{
+  expr_t e;
+  size_t lo, hi; /* which part of an arithmetic tree, in postfix order */
+  vval_t v;
+
+} cg_hoist_t;
+
+typedef struct _cg_loop_s
+{
+  struct _cg_loop_s *prev;
+
+  cg_hoist_t h[SF_CG_HOIST_MAX];
+  size_t n;
+
+  const char *asg[SF_CG_ASSIGNED_MAX]; /* names the loop assigns */
+  size_t al;
+  int calls;  /* calls or imports something */
+  int stores; /* stores to an attribute or an item */
+  int bail;
+
+} cg_loop_t;
+
+/* the child an expression alone owns, enough to tell AST nodes apart */
+static void *
+expr_node (expr_t *e)
+{
+  switch (e->type)
+    {
+    case EXPR_ADD_1:
+      return e->v.e_add_one.v;
+    case EXPR_ARITHMETIC:
+      return e->v.e_arith.tree;
+    case EXPR_CMP:
+      return e->v.e_cmp.left;
+    case EXPR_DOT_ACCESS:
+      return e->v.e_dota.left;
+    case EXPR_SQUARE_ACCESS:
+      return e->v.e_sqr_access.parent;
+    default:
+      return NULL;
+    }
+}
+
+static void
+loop_assigns (cg_loop_t *l, const char *name)
+{
+  for (size_t i = 0; i < l->al; i++)
+    if (!strcmp (l->asg[i], name))
+      return;
+
+  if (l->al >= SF_CG_ASSIGNED_MAX)
+    {
+      l->bail = 1;
+      return;
+    }
+
+  l->asg[l->al++] = name;
+}
+
+static void loop_walk_expr (cg_loop_t *, expr_t *);
+
+static void
+loop_walk_arith (cg_loop_t *l, expr_t *e)
+{
+  for (size_t i = 0; i < e->v.e_arith.tl; i++)
+    if (e->v.e_arith.tree[i].type != ARITH_NODE_OPERATOR)
+      loop_walk_expr (l, e->v.e_arith.tree[i].v.expr);
+}
+
+static void
+loop_walk_expr (cg_loop_t *l, expr_t *e)
+{
+  if (e == NULL)
+    return;
+
+  switch (e->type)
+    {
+    case EXPR_ADD_1:
+      loop_walk_expr (l, e->v.e_add_one.v);
+      break;
+
+    case EXPR_ARITHMETIC:
+      loop_walk_arith (l, e);
+      break;
+
+    case EXPR_FUNCALL:
+      l->calls = 1;
+      loop_walk_expr (l, e->v.e_funcall.name);
+      for (size_t i = 0; i < e->v.e_funcall.al; i++)
+        loop_walk_expr (l, e->v.e_funcall.args[i]);
+      break;
+
+    case EXPR_CMP:
+      loop_walk_expr (l, e->v.e_cmp.left);
+      loop_walk_expr (l, e->v.e_cmp.right);
+      break;
+
+    case EXPR_DOT_ACCESS:
+      loop_walk_expr (l, e->v.e_dota.left);
+      break;
+
+    case EXPR_ARRAY:
+      for (size_t i = 0; i < e->v.e_array.vl; i++)
+        loop_walk_expr (l, e->v.e_array.vals[i]);
+      break;
+
+    case EXPR_DICT:
+      for (size_t i = 0; i < e->v.e_dict.vl; i++)
+        {
+          loop_walk_expr (l, e->v.e_dict.keys[i]);
+          loop_walk_expr (l, e->v.e_dict.vals[i]);
+        }
+      break;
+
+    case EXPR_SQUARE_ACCESS:
+      loop_walk_expr (l, e->v.e_sqr_access.parent);
+      loop_walk_expr (l, e->v.e_sqr_access.idx);
+      break;
+
+    case EXPR_SLICE:
+      loop_walk_expr (l, e->v.e_slice.parent);
+      loop_walk_expr (l, e->v.e_slice.lo);
+      loop_walk_expr (l, e->v.e_slice.hi);
+      loop_walk_expr (l, e->v.e_slice.step);
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* what a block assigns, calls and stores, nested blocks included */
+static void
+loop_walk (cg_loop_t *l, stmt_t *body, size_t bl)
+{
+  for (size_t i = 0; i < bl && body[i].type != STMT_EOF; i++)
+    {
+      stmt_t *s = &body[i];
+
+      switch (s->type)
+        {
+        case STMT_VARDECL:
+          {
+            expr_t *name = s->v.s_vardecl.name;
+
+            if (name->type == EXPR_VAR)
+              loop_assigns (l, name->v.e_var.v);
+            else
+              {
+                l->stores = 1;
+                loop_walk_expr (l, name);
+              }
+
+            loop_walk_expr (l, s->v.s_vardecl.val);
+          }
+          break;
+
+        case STMT_FUNCALL:
+          l->calls = 1;
+          loop_walk_expr (l, s->v.s_funcall.name);
+          for (size_t j = 0; j < s->v.s_funcall.argc; j++)
+            loop_walk_expr (l, s->v.s_funcall.args[j]);
+          break;
+
+        case STMT_IFBLOCK:
+          loop_walk_expr (l, s->v.s_ifblock.cond);
+          loop_walk (l, s->v.s_ifblock.body, s->v.s_ifblock.bl);
+          loop_walk (l, s->v.s_ifblock.else_body, s->v.s_ifblock.else_bl);
+          break;
+
+        case STMT_WHILE:
+          loop_walk_expr (l, s->v.s_while.cond);
+          loop_walk (l, s->v.s_while.body, s->v.s_while.bl);
+          break;
+
+        case STMT_FOR:
+          for (size_t j = 0; j < s->v.s_for.vl; j++)
+            loop_assigns (l, s->v.s_for.vars[j]->v.e_var.v);
+          loop_walk_expr (l, s->v.s_for.cond);
+          loop_walk (l, s->v.s_for.body, s->v.s_for.bl);
+          break;
+
+        case STMT_FUNDECL:
+          /* the body runs in a scope of its own, and only when called */
+          loop_assigns (l, s->v.s_fundecl.name);
+          break;
+
+        case STMT_RETURN:
+          loop_walk_expr (l, s->v.s_return.v);
+          break;
+
+        case STMT_IMPORT:
+          l->calls = 1;
+          loop_assigns (l, s->v.s_import.alias);
+          break;
+
+        default:
+          /* class bodies run in place, leave such loops alone */
+          l->bail = 1;
+          break;
+        }
+    }
+}
+
+static int
+loop_invariant (cg_loop_t *l, expr_t *e)
+{
+  switch (e->type)
+    {
+    case EXPR_CONST:
+      return 1;
+
+    case EXPR_VAR:
+      for (size_t i = 0; i < l->al; i++)
+        if (!strcmp (l->asg[i], e->v.e_var.v))
+          return 0;
+      return 1;
+
+    case EXPR_ADD_1:
+      return loop_invariant (l, e->v.e_add_one.v);
+
+    case EXPR_ARITHMETIC:
+      for (size_t i = 0; i < e->v.e_arith.tl; i++)
+        if (e->v.e_arith.tree[i].type != ARITH_NODE_OPERATOR
+            && !loop_invariant (l, e->v.e_arith.tree[i].v.expr))
+          return 0;
+      return 1;
+
+    case EXPR_CMP:
+      return loop_invariant (l, e->v.e_cmp.left)
+             && loop_invariant (l, e->v.e_cmp.right);
+
+    case EXPR_DOT_ACCESS:
+      return !l->calls && !l->stores && loop_invariant (l, e->v.e_dota.left);
+
+    case EXPR_SQUARE_ACCESS:
+      return !l->calls && !l->stores
+             && loop_invariant (l, e->v.e_sqr_access.parent)
+             && loop_invariant (l, e->v.e_sqr_access.idx);
+
+    default:
+      return 0;
+    }
+}
+
+static void
+loop_add (cg_loop_t *l, expr_t *e, size_t lo, size_t hi)
+{
+  for (size_t i = 0; i < l->n; i++)
+    if (l->h[i].e.type == e->type && expr_node (&l->h[i].e) == expr_node (e)
+        && l->h[i].lo == lo)
+      return;
+
+  if (l->n < SF_CG_HOIST_MAX)
+    l->h[l->n++] = (cg_hoist_t){ .e = *e, .lo = lo, .hi = hi };
+}
+
+static void loop_hoist_expr (cg_loop_t *, expr_t *);
+
+/* tree[lo, hi] of e, one operand or a whole subexpression */
+static void
+loop_hoist_part (cg_loop_t *l, expr_t *e, size_t lo, size_t hi, int inv)
+{
+  if (lo == hi)
+    loop_hoist_expr (l, e->v.e_arith.tree[lo].v.expr);
+  else if (inv)
+    loop_add (l, e, lo, hi);
+}
+
+/**
+ * An arithmetic tree is one flat postfix list, so its subexpressions,
+ * like k * 3 in s + k * 3, are runs of it and get hoisted as such.
+ */
+static void
+loop_hoist_arith (cg_loop_t *l, expr_t *e)
+{
+  arith_node_t *tree = e->v.e_arith.tree;
+  size_t tl = e->v.e_arith.tl;
+
+  size_t at[64]; /* where each operand on the stack starts */
+  int inv[64];
+  size_t sp = 0;
+
+  if (tl > 64)
+    return;
+
+  for (size_t i = 0; i < tl; i++)
+    {
+      if (tree[i].type != ARITH_NODE_OPERATOR)
+        {
+          at[sp] = i;
+          inv[sp++] = loop_invariant (l, tree[i].v.expr);
+          continue;
+        }
+
+      if (sp < 2 || strchr ("+-*", *tree[i].v.op) == NULL)
+        return;
+
+      size_t r = --sp;
+
+      if (!inv[r - 1] || !inv[r])
+        {
+          loop_hoist_part (l, e, at[r - 1], at[r] - 1, inv[r - 1]);
+          loop_hoist_part (l, e, at[r], i - 1, inv[r]);
+          inv[r - 1] = 0;
+        }
+    }
+
+  if (sp == 1)
+    loop_hoist_part (l, e, at[0], tl - 1, inv[0]);
+}
+
+/* takes the largest invariant parts of e worth a slot of their own */
+static void
+loop_hoist_expr (cg_loop_t *l, expr_t *e)
+{
+  if (e == NULL || l->n >= SF_CG_HOIST_MAX)
+    return;
+
+  if (expr_node (e) != NULL && loop_invariant (l, e))
+    {
+      loop_add (l, e, 0,
+                e->type == EXPR_ARITHMETIC ? e->v.e_arith.tl - 1 : 0);
+      return;
+    }
+
+  switch (e->type)
+    {
+    case EXPR_ADD_1:
+      loop_hoist_expr (l, e->v.e_add_one.v);
+      break;
+
+    case EXPR_ARITHMETIC:
+      loop_hoist_arith (l, e);
+      break;
+
+    case EXPR_FUNCALL:
+      for (size_t i = 0; i < e->v.e_funcall.al; i++)
+        loop_hoist_expr (l, e->v.e_funcall.args[i]);
+      loop_hoist_expr (l, e->v.e_funcall.name);
+      break;
+
+    case EXPR_CMP:
+      loop_hoist_expr (l, e->v.e_cmp.left);
+      loop_hoist_expr (l, e->v.e_cmp.right);
+      break;
+
+    case EXPR_DOT_ACCESS:
+      loop_hoist_expr (l, e->v.e_dota.left);
+      break;
+
+    case EXPR_ARRAY:
+      for (size_t i = 0; i < e->v.e_array.vl; i++)
+        loop_hoist_expr (l, e->v.e_array.vals[i]);
+      break;
+
+    case EXPR_DICT:
+      for (size_t i = 0; i < e->v.e_dict.vl; i++)
+        {
+          loop_hoist_expr (l, e->v.e_dict.keys[i]);
+          loop_hoist_expr (l, e->v.e_dict.vals[i]);
+        }
+      break;
+
+    case EXPR_SQUARE_ACCESS:
+      loop_hoist_expr (l, e->v.e_sqr_access.parent);
+      loop_hoist_expr (l, e->v.e_sqr_access.idx);
+      break;
+
+    case EXPR_SLICE:
+      loop_hoist_expr (l, e->v.e_slice.parent);
+      loop_hoist_expr (l, e->v.e_slice.lo);
+      loop_hoist_expr (l, e->v.e_slice.hi);
+      loop_hoist_expr (l, e->v.e_slice.step);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static int
+block_returns (stmt_t *body, size_t bl)
+{
+  for (size_t i = 0; i < bl && body[i].type != STMT_EOF; i++)
+    switch (body[i].type)
+      {
+      case STMT_RETURN:
+        return 1;
+
+      case STMT_IFBLOCK:
+        if (block_returns (body[i].v.s_ifblock.body, body[i].v.s_ifblock.bl)
+            || block_returns (body[i].v.s_ifblock.else_body,
+                              body[i].v.s_ifblock.else_bl))
+          return 1;
+        break;
+
+      case STMT_WHILE:
+        if (block_returns (body[i].v.s_while.body, body[i].v.s_while.bl))
+          return 1;
+        break;
+
+      case STMT_FOR:
+        if (block_returns (body[i].v.s_for.body, body[i].v.s_for.bl))
+          return 1;
+        break;
+
+      default:
+        break;
+      }
+
+  return 0;
+}
+
+/* the expressions every trip evaluates, up to the first possible return */
+static void
+loop_hoist_body (cg_loop_t *l, stmt_t *body, size_t bl)
+{
+  for (size_t i = 0; i < bl && body[i].type != STMT_EOF; i++)
+    {
+      stmt_t *s = &body[i];
+
+      switch (s->type)
+        {
+        case STMT_VARDECL:
+          {
+            expr_t *name = s->v.s_vardecl.name;
+
+            loop_hoist_expr (l, s->v.s_vardecl.val);
+
+            if (name->type == EXPR_DOT_ACCESS)
+              loop_hoist_expr (l, name->v.e_dota.left);
+            else if (name->type == EXPR_SQUARE_ACCESS)
+              {
+                loop_hoist_expr (l, name->v.e_sqr_access.idx);
+                loop_hoist_expr (l, name->v.e_sqr_access.parent);
+              }
+          }
+          break;
+
+        case STMT_FUNCALL:
+          for (size_t j = 0; j < s->v.s_funcall.argc; j++)
+            loop_hoist_expr (l, s->v.s_funcall.args[j]);
+          loop_hoist_expr (l, s->v.s_funcall.name);
+          break;
+
+        case STMT_IFBLOCK:
+          loop_hoist_expr (l, s->v.s_ifblock.cond);
+          break;
+
+        case STMT_WHILE:
+          loop_hoist_expr (l, s->v.s_while.cond);
+          break;
+
+        case STMT_FOR:
+          loop_hoist_expr (l, s->v.s_for.cond);
+          break;
+
+        case STMT_RETURN:
+          loop_hoist_expr (l, s->v.s_return.v);
+          return;
+
+        default:
+          break;
+        }
+
+      if (block_returns (s, 1))
+        return;
+    }
+}
+
+/* what an enclosing loop hoisted of e starting at lo, if anything */
+static cg_hoist_t *
+hoisted (vm_t *vm, expr_t *e, size_t lo)
+{
+  void *node = expr_node (e);
+
+  if (node == NULL)
+    return NULL;
+
+  for (cg_loop_t *l = vm->cg_loop; l != NULL; l = l->prev)
+    for (size_t i = 0; i < l->n; i++)
+      if (l->h[i].e.type == e->type && expr_node (&l->h[i].e) == node
+          && l->h[i].lo == lo)
+        return &l->h[i];
+
+  return NULL;
+}
+
+/**
+ * Fills l with what can leave the loop with the given condition (NULL
+ * for a for loop, whose iterable is evaluated once anyway), vars the
+ * names a for loop binds. Returns the number of hoisted expressions.
+ */
+static size_t
+loop_init (vm_t *vm, cg_loop_t *l, expr_t *cond, expr_t **vars, size_t vl,
+           stmt_t *body, size_t bl)
+{
+  memset (l, 0, sizeof (*l));
+
+  if (!(vm->opt & SF_OPT_LICM) || vm->meta.slot == SF_VM_SLOT_NAME)
+    return 0;
+
+  for (size_t i = 0; i < vl; i++)
+    loop_assigns (l, vars[i]->v.e_var.v);
+
+  loop_walk_expr (l, cond);
+  loop_walk (l, body, bl);
+
+  if (l->bail)
+    return 0;
+
+  loop_hoist_expr (l, cond);
+  loop_hoist_body (l, body, bl);
+
+  /* an enclosing loop may have taken some already */
+  size_t n = 0;
+
+  for (size_t i = 0; i < l->n; i++)
+    if (hoisted (vm, &l->h[i].e, l->h[i].lo) == NULL)
+      l->h[n++] = l->h[i];
+
+  return l->n = n;
+}
+
+static void
+gen_load_hoisted (vm_t *vm, cg_hoist_t *h)
+{
+  if (h->v.slot == SF_VM_SLOT_GLOBAL)
+    add_inst (vm, (instr_t){
+                      .op = OP_LOAD,
+                      .a = h->v.pos,
+                      .b = 0,
+                  });
+  else
+    add_inst (vm, (instr_t){
+                      .op = OP_LOAD_FAST,
+                      .a = h->v.pos,
+                      .b = 0,
+                  });
+}
+
+static int
+gen_hoisted (vm_t *vm, expr_t *e)
+{
+  cg_hoist_t *h = hoisted (vm, e, 0);
+
+  if (h == NULL
+      || (e->type == EXPR_ARITHMETIC && h->hi != e->v.e_arith.tl - 1))
+    return 0;
+
+  gen_load_hoisted (vm, h);
+  return 1;
+}
+
+/**
+ * The test of an if or a while, its target left for the caller to
+ * patch. A comparison branches on its operands with OP_CMP_JUMP and
+ * never makes the bool OP_CMP would, anything else is a value for
+ * OP_JUMP_IF_FALSE. Returns where the branch is.
+ */
+static size_t
+gen_branch (vm_t *vm, expr_t *cond)
+{
+  if (cond->type == EXPR_CMP
+      && (vm->cg_loop == NULL || hoisted (vm, cond, 0) == NULL))
+    {
+      sf_vm_gen_b_fromexpr (vm, *cond->v.e_cmp.left);
+      sf_vm_gen_b_fromexpr (vm, *cond->v.e_cmp.right);
+
+      add_inst (vm, (instr_t){
+                        .op = OP_CMP_JUMP,
+                        .a = 0,
+                        .b = cond->v.e_cmp.type,
+                    });
+    }
+  else
+    {
+      sf_vm_gen_b_fromexpr (vm, *cond);
+
+      add_inst (vm, (instr_t){
+                        .op = OP_JUMP_IF_FALSE,
+                        .a = 0,
+                        .b = 0,
+                    });
+    }
+
+  return vm->inst_len - 1;
+}
+
+/* tree[lo, hi] of an arithmetic expression, in postfix order */
+static void
+gen_arith (vm_t *vm, expr_t *e, size_t lo, size_t hi)
+{
+  arith_node_t *tree = e->v.e_arith.tree;
+
+  for (size_t i = lo; i <= hi; i++)
+    {
+      arith_node_t n = tree[i];
+      cg_hoist_t *h = vm->cg_loop != NULL ? hoisted (vm, e, i) : NULL;
+
+      if (h != NULL && h->hi <= hi)
+        {
+          gen_load_hoisted (vm, h);
+          i = h->hi;
+        }
+      else if (n.type != ARITH_NODE_OPERATOR)
+        sf_vm_gen_b_fromexpr (vm, *n.v.expr);
+      else if (*n.v.op == '+')
+        add_inst (vm, (instr_t){
+                          .op = OP_ADD,
+                          .a = 0,
+                          .b = 0,
+                      });
+      else if (*n.v.op == '-')
+        add_inst (vm, (instr_t){
+                          .op = OP_SUB,
+                          .a = 0,
+                          .b = 0,
+                      });
+      else if (*n.v.op == '*')
+        add_inst (vm, (instr_t){
+                          .op = OP_MUL,
+                          .a = 0,
+                          .b = 0,
+                      });
+    }
+}
+
+/* the preheader: works each hoisted expression out into a fresh slot */
+static void
+loop_preheader (vm_t *vm, cg_loop_t *l)
+{
+  for (size_t i = 0; i < l->n; i++)
+    {
+      cg_hoist_t *h = &l->h[i];
+      vval_t *v = &h->v;
+
+      if (h->e.type == EXPR_ARITHMETIC)
+        gen_arith (vm, &h->e, h->lo, h->hi);
+      else
+        sf_vm_gen_b_fromexpr (vm, h->e);
+
+      v->slot = vm->meta.slot;
+
+      if (v->slot == SF_VM_SLOT_GLOBAL)
+        {
+          v->pos = vm->meta.g_slot++;
+          add_inst (vm, (instr_t){ .op = OP_STORE, .a = v->pos, .b = 0 });
+        }
+      else
+        {
+          v->pos = vm->meta.l_slot++;
+          add_inst (vm,
+                    (instr_t){ .op = OP_STORE_FAST, .a = v->pos, .b = 0 });
+        }
+    }
+
+  l->prev = vm->cg_loop;
+  vm->cg_loop = l;
 }
 
 SF_API void
 sf_vm_gen_b_fromexpr (vm_t *vm, expr_t e)
 {
+  if (vm->cg_loop != NULL && gen_hoisted (vm, &e))
+    return;
+
   switch (e.type)
     {
     case EXPR_VAR:
@@ -284,55 +957,7 @@ sf_vm_gen_b_fromexpr (vm_t *vm, expr_t e)
       break;
 
     case EXPR_ARITHMETIC:
-      {
-        size_t tl = e.v.e_arith.tl;
-        arith_node_t *tree = e.v.e_arith.tree;
-        size_t x = 0, y = 0;
-
-        for (size_t i = 0; i < tl; i++)
-          {
-            arith_node_t n = tree[i];
-
-            if (n.type == ARITH_NODE_OPERATOR)
-              {
-                y = i;
-                while (x < y)
-                  {
-                    sf_vm_gen_b_fromexpr (vm, *tree[x].v.expr);
-                    x++;
-                  }
-
-                const char *op = n.v.op;
-
-                if (*op == '+')
-                  {
-                    add_inst (vm, (instr_t){
-                                      .op = OP_ADD,
-                                      .a = 0,
-                                      .b = 0,
-                                  });
-                  }
-                else if (*op == '-')
-                  {
-                    add_inst (vm, (instr_t){
-                                      .op = OP_SUB,
-                                      .a = 0,
-                                      .b = 0,
-                                  });
-                  }
-                else if (*op == '*')
-                  {
-                    add_inst (vm, (instr_t){
-                                      .op = OP_MUL,
-                                      .a = 0,
-                                      .b = 0,
-                                  });
-                  }
-
-                x++;
-              }
-          }
-      }
+      gen_arith (vm, &e, 0, e.v.e_arith.tl - 1);
       break;
 
     case EXPR_FUNCALL:
@@ -389,6 +1014,22 @@ sf_vm_gen_b_fromexpr (vm_t *vm, expr_t e)
       }
       break;
 
+    case EXPR_DICT:
+      {
+        for (size_t i = 0; i < e.v.e_dict.vl; i++)
+          {
+            sf_vm_gen_b_fromexpr (vm, *e.v.e_dict.keys[i]);
+            sf_vm_gen_b_fromexpr (vm, *e.v.e_dict.vals[i]);
+          }
+
+        add_inst (vm, (instr_t){
+                          .op = OP_LOAD_DICT,
+                          .a = e.v.e_dict.vl,
+                          .b = 0,
+                      });
+      }
+      break;
+
     case EXPR_SQUARE_ACCESS:
       {
         sf_vm_gen_b_fromexpr (vm, *e.v.e_sqr_access.parent);
@@ -402,6 +1043,39 @@ sf_vm_gen_b_fromexpr (vm_t *vm, expr_t e)
       }
       break;
 
+    case EXPR_SLICE:
+      {
+        /* a: which of lo (1), hi (2), step (4) were pushed */
+        int parts = 0;
+
+        sf_vm_gen_b_fromexpr (vm, *e.v.e_slice.parent);
+
+        if (e.v.e_slice.lo != NULL)
+          {
+            sf_vm_gen_b_fromexpr (vm, *e.v.e_slice.lo);
+            parts |= 1;
+          }
+
+        if (e.v.e_slice.hi != NULL)
+          {
+            sf_vm_gen_b_fromexpr (vm, *e.v.e_slice.hi);
+            parts |= 2;
+          }
+
+        if (e.v.e_slice.step != NULL)
+          {
+            sf_vm_gen_b_fromexpr (vm, *e.v.e_slice.step);
+            parts |= 4;
+          }
+
+        add_inst (vm, (instr_t){
+                          .op = OP_SLICE,
+                          .a = parts,
+                          .b = 0,
+                      });
+      }
+      break;
+
     case EXPR_TO_STEP:
       {
         expr_t *lval = e.v.e_to_step.lval;
@@ -440,6 +1114,49 @@ sf_vm_gen_b_fromexpr (vm_t *vm, expr_t e)
     }
 }
 
+/* LOAD_ITER_NEXT of a for loop and the stores to its names */
+static size_t
+gen_iter_next (vm_t *vm, stmt_t *s)
+{
+  size_t jl = vm->inst_len;
+
+  add_inst (vm,
+            (instr_t){
+                .op = OP_LOAD_ITER_NEXT,
+                .a = 0, /* this a stores the value to jump to if
+                           iterable is exhausted */
+                .b = s->v.s_for.vl, /* this stores the number of ways you
+                           want to split any value of an iterable into
+                           (typically number of decomposition variables) */
+            });
+
+  for (size_t p = 0; p < s->v.s_for.vl; p++)
+    {
+      expr_t *name = s->v.s_for.vars[p];
+      vval_t *v = add_var (vm, (char *)name->v.e_var.v);
+
+      if (v->slot == SF_VM_SLOT_LOCAL)
+        add_inst (vm, (instr_t){
+                          .op = OP_STORE_FAST,
+                          .a = v->pos,
+                          .b = 0,
+                      });
+      else if (v->slot == SF_VM_SLOT_GLOBAL)
+        add_inst (vm, (instr_t){
+                          .op = OP_STORE,
+                          .a = v->pos,
+                          .b = 0,
+                      });
+      else if (v->slot == SF_VM_SLOT_NAME)
+        add_inst (vm, (instr_t){ .op = OP_STORE_NAME,
+                                 .a = v->pos,
+                                 .b = 0,
+                                 .c = (char *)SFSTRDUP (name->v.e_var.v) });
+    }
+
+  return jl;
+}
+
 SF_API void
 sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
 {
@@ -546,15 +1263,7 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             size_t ebl = s->v.s_ifblock.else_bl;
             stmt_t *else_body = s->v.s_ifblock.else_body;
 
-            sf_vm_gen_b_fromexpr (vm, *cond);
-
-            add_inst (vm, (instr_t){
-                              .op = OP_JUMP_IF_FALSE,
-                              .a = 0,
-                              .b = 0,
-                          });
-
-            size_t pl = vm->inst_len - 1;
+            size_t pl = gen_branch (vm, cond);
 
             StmtSM smt;
             smt.vals = body;
@@ -570,11 +1279,7 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
                           });
 
             size_t ql = vm->inst_len - 1;
-            vm->insts[pl] = (instr_t){
-              .op = OP_JUMP_IF_FALSE,
-              .a = vm->inst_len,
-              .b = 0,
-            };
+            vm->insts[pl].a = vm->inst_len;
 
             if (ebl)
               {
@@ -599,25 +1304,39 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             stmt_t *body = s->v.s_while.body;
             expr_t *cond = s->v.s_while.cond;
 
-            size_t vl = vm->inst_len;
+            cg_loop_t lp;
+            size_t gl = 0, hl = 0;
 
-            // write condition to check
-            sf_vm_gen_b_fromexpr (vm, *cond);
+            if (loop_init (vm, &lp, cond, NULL, 0, body, bl))
+              {
+                /**
+                 * first test, then the preheader, then into the body
+                 * past the test the loop goes back to
+                 */
+                gl = gen_branch (vm, cond);
 
-            // jump to end of loop if condition is false
-            add_inst (vm, (instr_t){
-                              .op = OP_JUMP_IF_FALSE,
-                              .a = 0,
-                              .b = 0,
-                          });
+                loop_preheader (vm, &lp);
+                add_inst (vm, (instr_t){
+                                  .op = OP_JUMP,
+                                  .a = 0,
+                                  .b = 0,
+                              });
+                hl = vm->inst_len - 1;
+              }
 
-            size_t il = vm->inst_len - 1;
+            size_t vl = vm->inst_len;
+
+            // check the condition, to the end of the loop if false
+            size_t il = gen_branch (vm, cond);
             /**
              * ! DO NOT TAKE REFERENCE OF LAST INSTRUCTION
              * ! IF vm->insts IS REALLOCED THEN REFERENCES BECOME
              * ! MEANINGLESS
              */
 
+            if (lp.n)
+              vm->insts[hl].a = vm->inst_len;
+
             StmtSM smt;
             smt.vals = body;
             smt.vc = smt.vl = bl;
@@ -639,12 +1358,14 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
                           });
 
             // D (printf ("%d\n", vm->inst_len));
-            vm->insts[il] = (instr_t){
-              .op = OP_JUMP_IF_FALSE,
-              .a = vm->inst_len,
-              .b = 0,
-            };
+            vm->insts[il].a = vm->inst_len;
             // D (printf ("%d %d\n", p->a, p->op));
+
+            if (lp.n)
+              {
+                vm->insts[gl].a = vm->inst_len;
+                vm->cg_loop = lp.prev;
+              }
           }
           break;
 
@@ -664,10 +1385,10 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             // hashtable_t *ht_pres = vm->ht;
             // vm->ht = ht;
 
-            vval_t *vlt[128];
+            vval_t vlt[128];
             size_t vltc = 0;
 
-            push_ht (vm);
+            sf_vm_push_scope (vm);
 
             vm->meta.slot = SF_VM_SLOT_LOCAL;
             for (size_t i = 0; i < argc; i++)
@@ -678,7 +1399,7 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
                   {
                     const char *n = arg->v.e_var.v;
 
-                    vlt[vltc++] = add_var (vm, n);
+                    vlt[vltc++] = *add_var (vm, n);
                   }
               }
 
@@ -699,7 +1420,7 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
               {
                 add_inst (vm, (instr_t){
                                   .op = OP_STORE_FAST,
-                                  .a = vlt[i]->pos,
+                                  .a = vlt[i].pos,
                                   .b = 0,
                               });
               }
@@ -707,7 +1428,7 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             sf_vm_gen_bytecode (vm, &smt);
             /* no eating return here, because we need return */
 
-            pop_ht (vm);
+            sf_vm_pop_scope (vm);
 
             vm->insts[pl] = (instr_t){
               .op = OP_JUMP,
@@ -784,13 +1505,13 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
 
             PRESERVE (vm);
 
-            push_ht (vm);
+            sf_vm_push_scope (vm);
             vm->meta.slot = SF_VM_SLOT_NAME;
 
             sf_vm_gen_bytecode (vm, &csm);
             vm->inst_len--;
 
-            pop_ht (vm);
+            sf_vm_pop_scope (vm);
 
             RESTORE (vm);
 
@@ -834,6 +1555,12 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             stmt_t *body = s->v.s_for.body;
             size_t bl = s->v.s_for.bl;
 
+            cg_loop_t lp;
+            size_t fl = 0, hl = 0;
+
+            loop_init (vm, &lp, NULL, s->v.s_for.vars, s->v.s_for.vl, body,
+                       bl);
+
             sf_vm_gen_b_fromexpr (vm, *s->v.s_for.cond);
 
             add_inst (vm, (instr_t){
@@ -842,46 +1569,25 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
                               .b = 0,
                           });
 
-            size_t jl = vm->inst_len;
-
-            add_inst (
-                vm,
-                (instr_t){
-                    .op = OP_LOAD_ITER_NEXT,
-                    .a = 0, /* this a stores the value to jump to if
-                               iterable is exhausted */
-                    .b = s->v.s_for.vl, /* this stores the number of ways you
-                               want to split any value of an iterable into
-                               (typically number of decomposition variables) */
-                });
-
-            size_t il = vm->inst_len;
-
-            for (size_t p = 0; p < s->v.s_for.vl; p++)
+            if (lp.n)
               {
-                expr_t *name = s->v.s_for.vars[p];
-                vval_t *v = add_var (vm, (char *)name->v.e_var.v);
+                /* first trip, then the preheader, then into the body */
+                fl = gen_iter_next (vm, s);
+                loop_preheader (vm, &lp);
 
-                if (v->slot == SF_VM_SLOT_LOCAL)
-                  add_inst (vm, (instr_t){
-                                    .op = OP_STORE_FAST,
-                                    .a = v->pos,
-                                    .b = 0,
-                                });
-                else if (v->slot == SF_VM_SLOT_GLOBAL)
-                  add_inst (vm, (instr_t){
-                                    .op = OP_STORE,
-                                    .a = v->pos,
-                                    .b = 0,
-                                });
-                else if (v->slot == SF_VM_SLOT_NAME)
-                  add_inst (vm, (instr_t){
-                                    .op = OP_STORE_NAME,
-                                    .a = v->pos,
-                                    .b = 0,
-                                    .c = (char *)SFSTRDUP (name->v.e_var.v) });
+                add_inst (vm, (instr_t){
+                                  .op = OP_JUMP,
+                                  .a = 0,
+                                  .b = 0,
+                              });
+                hl = vm->inst_len - 1;
               }
 
+            size_t jl = gen_iter_next (vm, s);
+
+            if (lp.n)
+              vm->insts[hl].a = vm->inst_len;
+
             StmtSM smt;
             smt.vals = body;
             smt.vc = smt.vl = bl;
@@ -905,6 +1611,12 @@ sf_vm_gen_bytecode (vm_t *vm, StmtSM *smt)
             // D (printf ("%d\n", vm->inst_len));
 
             vm->insts[jl].a = vm->inst_len;
+
+            if (lp.n)
+              {
+                vm->insts[fl].a = vm->inst_len;
+                vm->cg_loop = lp.prev;
+              }
           }
           break;
 
@@ -6,8 +6,8 @@
 #include "const.h"
 #include "expr.h"
 #include "header.h"
-#include "ht.h"
 #include "object.h"
+#include "opt.h"
 #include "stmt.h"
 
 #if !defined(PRESERVE)
@@ -35,6 +35,8 @@ extern "C"
 
   SF_API void sf_vm_gen_b_fromexpr (vm_t *, expr_t);
   SF_API void sf_vm_gen_bytecode (vm_t *, StmtSM *);
+  SF_API scope_t *sf_vm_push_scope (vm_t *);
+  SF_API void sf_vm_pop_scope (vm_t *);
 
 #if defined(__cplusplus)
 }
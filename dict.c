@@ -0,0 +1,133 @@
+#include "dict.h"
+#include "object.h"
+
+#define DICT_MIN_CAP (4)
+
+/* drop deleted entries and rebuild the index with room for one more */
+static void
+dict_grow (dict_t *d)
+{
+  size_t w = 0;
+
+  for (size_t i = 0; i < d->el; i++)
+    if (d->ents[i].key != NULL)
+      d->ents[w++] = d->ents[i];
+
+  d->el = w;
+
+  if (d->el == d->ec)
+    {
+      d->ec <<= 1;
+      d->ents = SFREALLOC (d->ents, d->ec * sizeof (*d->ents));
+    }
+
+  sf_swiss_free (&d->idx);
+  sf_swiss_init (&d->idx, d->el * 2 > d->ec ? d->el * 2 : d->ec);
+
+  for (size_t i = 0; i < d->el; i++)
+    sf_swiss_insert (&d->idx, d->ents[i].hash, (int32_t)i);
+}
+
+SF_API dict_t *
+sf_dict_new (void)
+{
+  dict_t *d = SFMALLOC (sizeof (*d));
+  d->ec = DICT_MIN_CAP;
+  d->el = 0;
+  d->len = 0;
+  d->ents = SFMALLOC (d->ec * sizeof (*d->ents));
+
+  sf_swiss_init (&d->idx, 0);
+  return d;
+}
+
+SF_API void
+sf_dict_free (dict_t *d, struct _vm_s *vm)
+{
+  for (size_t i = 0; i < d->el; i++)
+    {
+      if (d->ents[i].key == NULL)
+        continue;
+
+      DR (d->ents[i].key, vm);
+      DR (d->ents[i].val, vm);
+    }
+
+  sf_swiss_free (&d->idx);
+  SFFREE (d->ents);
+  SFFREE (d);
+}
+
+static dictent_t *
+dict_find (dict_t *d, obj_t *key, uint64_t h, swiss_iter_t *it)
+{
+  int32_t i;
+  sf_swiss_find (&d->idx, h, it);
+
+  while ((i = sf_swiss_next (&d->idx, it)) != -1)
+    {
+      dictent_t *e = &d->ents[i];
+
+      if (e->hash == h && e->key != NULL
+          && (e->key == key || sf_obj_eqeq (e->key, key)))
+        return e;
+    }
+
+  return NULL;
+}
+
+SF_API obj_t *
+sf_dict_get (dict_t *d, obj_t *key)
+{
+  swiss_iter_t it;
+  dictent_t *e = dict_find (d, key, sf_obj_hash (key), &it);
+
+  return e != NULL ? e->val : NULL;
+}
+
+/* takes over the caller's reference to val, the key gets its own */
+SF_API void
+sf_dict_set (dict_t *d, obj_t *key, obj_t *val, struct _vm_s *vm)
+{
+  uint64_t h = sf_obj_hash (key);
+  swiss_iter_t it;
+  dictent_t *e = dict_find (d, key, h, &it);
+
+  if (e != NULL)
+    {
+      DR (e->val, vm);
+      e->val = val;
+      return;
+    }
+
+  if (d->el == d->ec || sf_swiss_full (&d->idx))
+    dict_grow (d);
+
+  IR (key);
+  d->ents[d->el] = (dictent_t){ .hash = h, .key = key, .val = val };
+  sf_swiss_insert (&d->idx, h, (int32_t)d->el++);
+  d->len++;
+}
+
+/* hands the caller the dict's reference to the value, NULL if key was
+   not there; the entry stays behind as a tombstone until a grow */
+SF_API obj_t *
+sf_dict_del (dict_t *d, obj_t *key, struct _vm_s *vm)
+{
+  swiss_iter_t it;
+  dictent_t *e = dict_find (d, key, sf_obj_hash (key), &it);
+
+  if (e == NULL)
+    return NULL;
+
+  obj_t *v = e->val;
+
+  DR (e->key, vm);
+  e->key = NULL;
+  e->val = NULL;
+
+  sf_swiss_erase (&d->idx, &it);
+  d->len--;
+
+  return v;
+}
@@ -0,0 +1,55 @@
+#if !defined(DICT_H)
+#define DICT_H
+
+#include "header.h"
+#include "malloc.h"
+#include "swiss.h"
+
+/**
+ * Dictionaries keyed by arbitrary objects. Entries live in a dense
+ * array in insertion order, a swiss index maps hashes to entry
+ * positions. Hashes are cached in the entries so resizing and probing
+ * never rehash a key.
+ */
+struct object_s;
+struct _vm_s;
+
+typedef struct
+{
+  uint64_t hash;
+  struct object_s *key; /* NULL once deleted */
+  struct object_s *val;
+
+} dictent_t;
+
+typedef struct __dict_s
+{
+  dictent_t *ents;
+  size_t el; /* entries used, deleted ones included */
+  size_t ec;
+
+  swiss_t idx;
+
+  size_t len; /* live entries */
+
+} dict_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API dict_t *sf_dict_new (void);
+  SF_API void sf_dict_free (dict_t *, struct _vm_s *);
+
+  SF_API struct object_s *sf_dict_get (dict_t *, struct object_s *);
+  SF_API void sf_dict_set (dict_t *, struct object_s *, struct object_s *,
+                           struct _vm_s *);
+  SF_API struct object_s *sf_dict_del (dict_t *, struct object_s *,
+                                       struct _vm_s *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // DICT_H
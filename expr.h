@@ -17,6 +17,8 @@ enum ExprType
   EXPR_ARRAY = 7,
   EXPR_SQUARE_ACCESS = 8,
   EXPR_TO_STEP = 9,
+  EXPR_SLICE = 10,
+  EXPR_DICT = 11,
   EXPR_COUNT
 };
 
@@ -107,6 +109,23 @@ typedef struct __expr_s
 
     } e_to_step;
 
+    struct
+    {
+      struct __expr_s *parent;
+      struct __expr_s *lo; /* lo, hi and step are NULL when omitted */
+      struct __expr_s *hi;
+      struct __expr_s *step;
+
+    } e_slice;
+
+    struct
+    {
+      struct __expr_s **keys;
+      struct __expr_s **vals;
+      size_t vl;
+
+    } e_dict;
+
   } v;
 
 } expr_t;
@@ -121,7 +140,6 @@ extern "C"
 
   SF_API void sf_expr_print (expr_t);
   SF_API int sf_expr_tobool (expr_t);
-  SF_API void sf_expr_free (expr_t *);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,590 @@
+#include "fishc.h"
+#include "ast.h"
+#include "codegen.h"
+#include "intern.h"
+#include "mut.h"
+#include "opt.h"
+#include "token.h"
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#define realpath(P, R) _fullpath ((R), (P), 0)
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define FNV_SEED (14695981039346656037ULL)
+
+/* tells apart the temp files of units saved at once on several threads */
+static sfmutex_t tmp_lock = SF_MUTEX_INIT;
+static unsigned long tmp_seq = 0;
+
+static inline uint64_t
+fnv1a (uint64_t h, const void *p, size_t n)
+{
+  const unsigned char *s = p;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      h ^= s[i];
+      h *= 1099511628211ULL;
+    }
+
+  return h;
+}
+
+static uint32_t
+fishc_abi (void)
+{
+  const uint16_t one = 1;
+
+  return (uint32_t)sizeof (instr_t) | (uint32_t)sizeof (const_t) << 8
+         | (uint32_t)sizeof (void *) << 16
+         | (uint32_t)(*(const unsigned char *)&one) << 24;
+}
+
+/**
+ * What codegen could have looked up while compiling the unit: every
+ * name visible in the scope stack, the slot counters and the passes
+ * that ran, with their limits. A unit only comes out of the cache when
+ * this matches.
+ */
+static uint64_t
+ctx_hash (vm_t *vm)
+{
+  uint64_t h = FNV_SEED;
+  size_t meta[] = { vm->scl,         vm->meta.slot,   vm->meta.g_slot,
+                    vm->meta.l_slot, vm->meta.n_slot, vm->opt,
+                    vm->inline_len };
+
+  h = fnv1a (h, meta, sizeof (meta));
+
+  for (size_t i = 0; i < vm->scl; i++)
+    {
+      scope_t *sc = &vm->scopes[i];
+
+      for (size_t j = 0; j < sc->el; j++)
+        {
+          h = fnv1a (h, sc->ents[j].name, strlen (sc->ents[j].name) + 1);
+          h = fnv1a (h, &sc->ents[j].v.pos, sizeof (sc->ents[j].v.pos));
+          h = fnv1a (h, &sc->ents[j].v.slot, sizeof (sc->ents[j].v.slot));
+        }
+    }
+
+  return h;
+}
+
+/**
+ * Where the cache of src lives, NULL when caching is off. Without
+ * $SF_FISHC_DIR it sits next to the source with a .fishc extension;
+ * in the directory it is named after the source and a hash of its
+ * full path.
+ */
+SF_API char *
+sf_fishc_path (const char *src)
+{
+  const char *off = getenv ("SF_FISHC");
+  const char *dir = getenv ("SF_FISHC_DIR");
+
+  if (off != NULL && !strcmp (off, "0"))
+    return NULL;
+
+  const char *base = strrchr (src, '/');
+  base = base != NULL ? base + 1 : src;
+
+  const char *ext = strrchr (base, '.');
+  size_t stem = ext != NULL && ext != base ? (size_t)(ext - base)
+                                           : strlen (base);
+
+  if (dir == NULL || *dir == '\0')
+    {
+      size_t n = (base - src) + stem;
+      char *p = SFMALLOC (n + sizeof (".fishc"));
+
+      memcpy (p, src, n);
+      strcpy (p + n, ".fishc");
+
+      return p;
+    }
+
+  char *full = realpath (src, NULL);
+  uint64_t h = fnv1a (FNV_SEED, full != NULL ? full : src,
+                      strlen (full != NULL ? full : src));
+  free (full);
+
+  size_t n = strlen (dir) + stem + 32;
+  char *p = SFMALLOC (n);
+
+  snprintf (p, n, "%s/%.*s-%016llx.fishc", dir, (int)stem, base,
+            (unsigned long long)h);
+
+  return p;
+}
+
+/* the whole file plus a newline and a terminator, as the lexer wants */
+static char *
+read_source (const char *path, size_t *len)
+{
+  FILE *f = fopen (path, "r");
+
+  if (f == NULL)
+    {
+      perror ("error reading file");
+      exit (EXIT_FAILURE);
+    }
+
+  fseek (f, 0, SEEK_END);
+  long pos = ftell (f);
+  fseek (f, 0, SEEK_SET);
+
+  char *buf = SFMALLOC ((pos + 2) * sizeof (char));
+  pos = fread (buf, sizeof (char), pos, f);
+
+  buf[pos] = '\n';
+  buf[pos + 1] = '\0';
+  *len = pos;
+
+  fclose (f);
+
+  return buf;
+}
+
+/**
+ * Maps the cache read-write and private, so strings the VM points into
+ * may be written without touching the file. The mapping of a loaded
+ * unit is never released; its strings are referenced until exit.
+ */
+static char *
+map_file (const char *path, size_t *len)
+{
+#if defined(_WIN32)
+  FILE *f = fopen (path, "rb");
+
+  if (f == NULL)
+    return NULL;
+
+  fseek (f, 0, SEEK_END);
+  *len = ftell (f);
+  fseek (f, 0, SEEK_SET);
+
+  char *m = SFMALLOC (*len ? *len : 1);
+
+  if (fread (m, 1, *len, f) != *len)
+    {
+      SFFREE (m);
+      m = NULL;
+    }
+
+  fclose (f);
+  return m;
+#else
+  int fd = open (path, O_RDONLY);
+  struct stat st;
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat (fd, &st) != 0 || st.st_size == 0)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  *len = st.st_size;
+  char *m = mmap (NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  return m != MAP_FAILED ? m : NULL;
+#endif // _WIN32
+}
+
+static void
+unmap_file (char *m, size_t len)
+{
+#if defined(_WIN32)
+  (void)len;
+  SFFREE (m);
+#else
+  munmap (m, len);
+#endif // _WIN32
+}
+
+static int
+fishc_fresh (fishc_header_t *h, const char *src, struct stat *st)
+{
+  if (h->src_size != (uint64_t)st->st_size)
+    return 0;
+
+  if (h->src_mtime == (int64_t)st->st_mtime)
+    return 1;
+
+  /* touched but maybe not edited, the contents decide */
+  size_t len;
+  char *buf = read_source (src, &len);
+  int r = fnv1a (FNV_SEED, buf, len) == h->src_hash;
+  SFFREE (buf);
+
+  return r;
+}
+
+/* every relocation and string offset must stay inside the file */
+static int
+fishc_sane (fishc_header_t *h)
+{
+  instr_t *insts = (instr_t *)(h + 1);
+  const_t *consts = (const_t *)(insts + h->il);
+  fishc_reloc_t *rels = (fishc_reloc_t *)(consts + h->cl);
+  fishc_name_t *names = (fishc_name_t *)(rels + h->rl);
+  char *strs = (char *)(names + h->nl);
+
+  if (h->sl && strs[h->sl - 1] != '\0')
+    return 0;
+
+  for (size_t i = 0; i < h->rl; i++)
+    {
+      uint32_t at = rels[i].at;
+
+      switch (rels[i].type)
+        {
+        case FISHC_R_IP:
+          if (at >= h->il || insts[at].a < 0
+              || (uint64_t)insts[at].a > h->il)
+            return 0;
+          break;
+
+        case FISHC_R_CONST:
+          if (at >= h->il || insts[at].a < 0
+              || (uint64_t)insts[at].a >= h->cl)
+            return 0;
+          break;
+
+        case FISHC_R_STR:
+          if (at >= h->il || (uintptr_t)insts[at].c >= h->sl)
+            return 0;
+          break;
+
+        case FISHC_R_CSTR:
+          if (at >= h->cl || consts[at].type != CONST_STRING
+              || (uintptr_t)consts[at].v.c_str.v >= h->sl)
+            return 0;
+          break;
+
+        default:
+          return 0;
+        }
+    }
+
+  for (size_t i = 0; i < h->nl; i++)
+    if (names[i].name >= h->sl)
+      return 0;
+
+  return 1;
+}
+
+/* appends the unit cached in cpath to vm, 0 if it is missing or stale */
+static int
+fishc_load (vm_t *vm, const char *cpath, const char *src, struct stat *st,
+            uint64_t ctx)
+{
+  size_t len;
+  char *m = map_file (cpath, &len);
+
+  if (m == NULL)
+    return 0;
+
+  fishc_header_t *h = (fishc_header_t *)m;
+
+  if (len < sizeof (*h) || memcmp (h->magic, SF_FISHC_MAGIC, 8)
+      || h->version != SF_FISHC_VERSION || h->abi != fishc_abi ()
+      || h->ctx_hash != ctx
+      || len != sizeof (*h) + h->il * sizeof (instr_t)
+                    + h->cl * sizeof (const_t) + h->rl * sizeof (fishc_reloc_t)
+                    + h->nl * sizeof (fishc_name_t) + h->sl
+      || !fishc_sane (h) || !fishc_fresh (h, src, st))
+    {
+      unmap_file (m, len);
+      return 0;
+    }
+
+  instr_t *insts = (instr_t *)(h + 1);
+  const_t *consts = (const_t *)(insts + h->il);
+  fishc_reloc_t *rels = (fishc_reloc_t *)(consts + h->cl);
+  fishc_name_t *names = (fishc_name_t *)(rels + h->rl);
+  char *strs = (char *)(names + h->nl);
+
+  size_t ip = vm->inst_len;
+  size_t cb = vm->s_ml;
+
+  if (vm->inst_len + h->il > vm->inst_cap)
+    {
+      vm->inst_cap = vm->inst_len + h->il + 64;
+      vm->insts = SFREALLOC (vm->insts, vm->inst_cap * sizeof (*vm->insts));
+    }
+
+  if (vm->s_ml + h->cl > vm->s_mc)
+    {
+      vm->s_mc = vm->s_ml + h->cl + 64;
+      vm->map_consts
+          = SFREALLOC (vm->map_consts, vm->s_mc * sizeof (*vm->map_consts));
+    }
+
+  memcpy (vm->insts + ip, insts, h->il * sizeof (instr_t));
+  memcpy (vm->map_consts + cb, consts, h->cl * sizeof (const_t));
+  vm->inst_len += h->il;
+  vm->s_ml += h->cl;
+
+  instr_t *in = vm->insts + ip;
+  const_t *cn = vm->map_consts + cb;
+
+  for (size_t i = 0; i < h->rl; i++)
+    {
+      uint32_t at = rels[i].at;
+
+      switch (rels[i].type)
+        {
+        case FISHC_R_IP:
+          in[at].a += ip;
+          break;
+
+        case FISHC_R_CONST:
+          in[at].a += cb;
+          break;
+
+        case FISHC_R_STR:
+          in[at].c = strs + (uintptr_t)in[at].c;
+          break;
+
+        case FISHC_R_CSTR:
+          cn[at].v.c_str.v = strs + (uintptr_t)cn[at].v.c_str.v;
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  scope_t *top = &vm->scopes[vm->scl - 1];
+
+  for (size_t i = 0; i < h->nl; i++)
+    {
+      const char *n = strs + names[i].name;
+
+      sf_scope_add (top, &vm->cg_arena, sf_intern (n, strlen (n)),
+                    (vval_t){ .pos = names[i].pos, .slot = names[i].slot });
+    }
+
+  vm->meta.g_slot = h->g_slot;
+  vm->meta.l_slot = h->l_slot;
+  vm->meta.n_slot = h->n_slot;
+
+  return 1;
+}
+
+typedef struct
+{
+  char *s;
+  size_t len, cap;
+
+} strtab_t;
+
+static uint64_t
+strtab_add (strtab_t *t, const char *s)
+{
+  size_t n = strlen (s) + 1;
+  uint64_t off = t->len;
+
+  if (t->len + n > t->cap)
+    {
+      t->cap = (t->len + n) * 2;
+      t->s = SFREALLOC (t->s, t->cap);
+    }
+
+  memcpy (t->s + t->len, s, n);
+  t->len += n;
+
+  return off;
+}
+
+/**
+ * Writes insts[ip, inst_len) and the names added to the top scope from
+ * entry el on. Constants are renumbered to the ones the unit uses, the
+ * pool may hold constants of earlier units. The file is written aside
+ * and renamed over the old one; failing to write only loses the cache.
+ */
+static void
+fishc_save (vm_t *vm, const char *cpath, struct stat *st, uint64_t hash,
+            uint64_t ctx, size_t ip, size_t el)
+{
+  size_t il = vm->inst_len - ip;
+  scope_t *top = &vm->scopes[vm->scl - 1];
+
+  instr_t *insts = SFMALLOC ((il ? il : 1) * sizeof (*insts));
+  const_t *consts = SFMALLOC ((vm->s_ml ? vm->s_ml : 1) * sizeof (*consts));
+  fishc_reloc_t *rels = SFMALLOC ((3 * il + vm->s_ml + 1) * sizeof (*rels));
+  fishc_name_t *names
+      = SFMALLOC ((top->el - el + 1) * sizeof (*names));
+  size_t *cmap = SFMALLOC ((vm->s_ml ? vm->s_ml : 1) * sizeof (*cmap));
+  size_t cl = 0, rl = 0, nl = 0;
+  strtab_t strs = { NULL, 0, 0 };
+
+  for (size_t i = 0; i < vm->s_ml; i++)
+    cmap[i] = (size_t)-1;
+
+  for (size_t i = 0; i < il; i++)
+    {
+      instr_t in = vm->insts[ip + i];
+
+      memset (&insts[i], 0, sizeof (insts[i]));
+      insts[i].op = in.op;
+      insts[i].a = in.a;
+      insts[i].b = in.b;
+
+      if (SF_OP_HAS_IP (in.op))
+        {
+          assert (in.a >= (int)ip && "jump out of the unit");
+          insts[i].a = in.a - ip;
+          rels[rl++] = (fishc_reloc_t){ .at = i, .type = FISHC_R_IP };
+        }
+      else if (in.op == OP_LOAD_CONST)
+        {
+          if (cmap[in.a] == (size_t)-1)
+            {
+              const_t c = vm->map_consts[in.a];
+
+              memset (&consts[cl], 0, sizeof (consts[cl]));
+              consts[cl].type = c.type;
+              consts[cl].v = c.v;
+
+              if (c.type == CONST_STRING)
+                {
+                  consts[cl].v.c_str.v
+                      = (char *)(uintptr_t)strtab_add (&strs, c.v.c_str.v);
+                  rels[rl++] = (fishc_reloc_t){ .at = cl,
+                                                .type = FISHC_R_CSTR };
+                }
+
+              cmap[in.a] = cl++;
+            }
+
+          insts[i].a = cmap[in.a];
+          rels[rl++] = (fishc_reloc_t){ .at = i, .type = FISHC_R_CONST };
+        }
+
+      /* range steps are the one integer kept in c */
+      if (in.c != NULL && in.op != OP_RANGE_FAST)
+        {
+          insts[i].c = (char *)(uintptr_t)strtab_add (&strs, in.c);
+          rels[rl++] = (fishc_reloc_t){ .at = i, .type = FISHC_R_STR };
+        }
+      else
+        insts[i].c = in.c;
+    }
+
+  for (size_t i = el; i < top->el; i++)
+    {
+      scope_ent_t *e = &top->ents[i];
+
+      names[nl++] = (fishc_name_t){ .name = strtab_add (&strs, e->name),
+                                    .pos = e->v.pos,
+                                    .slot = e->v.slot };
+    }
+
+  fishc_header_t h;
+  memset (&h, 0, sizeof (h));
+  memcpy (h.magic, SF_FISHC_MAGIC, 8);
+  h.version = SF_FISHC_VERSION;
+  h.abi = fishc_abi ();
+  h.src_mtime = st->st_mtime;
+  h.src_size = st->st_size;
+  h.src_hash = hash;
+  h.ctx_hash = ctx;
+  h.il = il;
+  h.cl = cl;
+  h.rl = rl;
+  h.nl = nl;
+  h.sl = strs.len;
+  h.g_slot = vm->meta.g_slot;
+  h.l_slot = vm->meta.l_slot;
+  h.n_slot = vm->meta.n_slot;
+
+  sf_mutex_lock (&tmp_lock);
+  unsigned long seq = tmp_seq++;
+  sf_mutex_unlock (&tmp_lock);
+
+  size_t tl = strlen (cpath) + 48;
+  char *tmp = SFMALLOC (tl);
+  snprintf (tmp, tl, "%s.%ld.%lu.tmp", cpath, (long)getpid (), seq);
+
+  FILE *f = fopen (tmp, "wb");
+
+  if (f != NULL)
+    {
+      int ok = fwrite (&h, sizeof (h), 1, f) == 1
+               && fwrite (insts, sizeof (*insts), il, f) == il
+               && fwrite (consts, sizeof (*consts), cl, f) == cl
+               && fwrite (rels, sizeof (*rels), rl, f) == rl
+               && fwrite (names, sizeof (*names), nl, f) == nl
+               && fwrite (strs.s, 1, strs.len, f) == strs.len;
+
+      if (fclose (f) != 0 || !ok || rename (tmp, cpath) != 0)
+        remove (tmp);
+    }
+
+  SFFREE (tmp);
+  SFFREE (strs.s);
+  SFFREE (cmap);
+  SFFREE (names);
+  SFFREE (rels);
+  SFFREE (consts);
+  SFFREE (insts);
+}
+
+/**
+ * Compiles the script at path onto the end of vm->insts, from its
+ * cache when that is fresh and was built against the same scopes.
+ * Either way the unit's names end up in the top scope.
+ */
+SF_API void
+sf_fishc_compile (vm_t *vm, const char *path)
+{
+  struct stat st;
+
+  if (stat (path, &st) != 0)
+    {
+      perror ("error reading file");
+      exit (EXIT_FAILURE);
+    }
+
+  uint64_t ctx = ctx_hash (vm);
+  char *cpath = sf_fishc_path (path);
+
+  if (cpath != NULL && fishc_load (vm, cpath, path, &st, ctx))
+    {
+      SFFREE (cpath);
+      return;
+    }
+
+  size_t len;
+  char *buf = read_source (path, &len);
+  size_t ip = vm->inst_len;
+  size_t el = vm->scopes[vm->scl - 1].el;
+
+  TokenSM *smt = sf_statem_token_new (buf);
+  sf_token_gen (smt);
+
+  StmtSM *stt = sf_ast_gen (smt);
+  sf_vm_gen_bytecode (vm, stt);
+  sf_opt_run (vm, ip, vm->opt);
+
+  if (cpath != NULL)
+    fishc_save (vm, cpath, &st, fnv1a (FNV_SEED, buf, len), ctx, ip, el);
+
+  sf_ast_free (stt);
+  sf_statem_token_free (smt);
+  SFFREE (buf);
+  SFFREE (cpath);
+}
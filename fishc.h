@@ -0,0 +1,80 @@
+#if !defined(FISHC_H)
+#define FISHC_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Compiled scripts are cached as .fishc files, next to the source or in
+ * $SF_FISHC_DIR, and SF_FISHC=0 turns the cache off. A file holds the
+ * instructions and constants of one compilation unit in the in-memory
+ * layout, so loading one is a bulk copy out of a mapping plus a short
+ * relocation table for jump targets, constant indices and strings.
+ *
+ * Bump SF_FISHC_VERSION whenever opcodes or the code codegen emits
+ * change; files of other versions are ignored and rewritten.
+ */
+#define SF_FISHC_MAGIC "FISHC\r\n\032"
+#define SF_FISHC_VERSION (7)
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t abi; /* layout of instr_t and const_t */
+
+  int64_t src_mtime;
+  uint64_t src_size;
+  uint64_t src_hash; /* FNV-1a of the source */
+  uint64_t ctx_hash; /* codegen scopes the unit was compiled against */
+
+  uint64_t il; /* instructions */
+  uint64_t cl; /* constants */
+  uint64_t rl; /* relocations */
+  uint64_t nl; /* names the unit added to its scope */
+  uint64_t sl; /* string table bytes */
+
+  uint64_t g_slot;
+  uint64_t l_slot;
+  uint64_t n_slot;
+
+} fishc_header_t;
+
+enum FishcRelocType
+{
+  FISHC_R_IP,    /* insts[at].a is a unit relative ip */
+  FISHC_R_CONST, /* insts[at].a is a unit relative constant */
+  FISHC_R_STR,   /* insts[at].c is a string table offset */
+  FISHC_R_CSTR,  /* consts[at] string is a string table offset */
+};
+
+typedef struct
+{
+  uint32_t at;
+  uint32_t type;
+
+} fishc_reloc_t;
+
+typedef struct
+{
+  uint64_t name; /* string table offset */
+  int64_t pos;
+  int32_t slot;
+  int32_t _pad;
+
+} fishc_name_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_fishc_compile (vm_t *, const char *);
+  SF_API char *sf_fishc_path (const char *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // FISHC_H
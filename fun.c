@@ -10,6 +10,9 @@ sf_fun_new (int type)
   f->args = SFMALLOC (f->argc * sizeof (*f->args));
   f->name = NULL;
 
+  for (size_t i = 0; i < f->argc; i++)
+    f->args[i] = NULL;
+
   if (f->type == FUN_NATIVE)
     {
       f->v.native.scc = 0;
@@ -25,6 +28,9 @@ sf_fun_addarg (fun_t *f, char *n)
     {
       f->argc += 4;
       f->args = SFREALLOC (f->args, f->argc * sizeof (*f->args));
+
+      for (size_t i = f->argl; i < f->argc; i++)
+        f->args[i] = NULL;
     }
 
   f->args[f->argl++] = SFSTRDUP (n);
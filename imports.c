@@ -0,0 +1,218 @@
+#include "imports.h"
+#include "codegen.h"
+#include "fishc.h"
+#include "mod.h"
+#include "mut.h"
+
+/* marks entries queued in the current wave */
+#define CODE_PENDING ((size_t)-2)
+
+typedef struct
+{
+  const char *path; /* the entry's canonical path */
+  size_t ent;
+  vm_t vm; /* compile state of the unit alone */
+
+} unit_t;
+
+typedef struct
+{
+  vm_t *vm;
+  unit_t *units;
+  size_t ul;
+
+  size_t next;
+  sfmutex_t lock;
+
+} pool_t;
+
+/**
+ * A unit compiles against the scopes the module would see at its
+ * import, the importer's plus one of its own. The importer's scopes are
+ * shared and only read, codegen writes to the innermost scope alone.
+ */
+static void
+unit_init (unit_t *u, vm_t *vm)
+{
+  vm_t *v = &u->vm;
+
+  memset (v, 0, sizeof (*v));
+  v->scc = vm->scl + SF_VM_SCOPES_CAP;
+  v->scopes = SFMALLOC (v->scc * sizeof (*v->scopes));
+  memcpy (v->scopes, vm->scopes, vm->scl * sizeof (*v->scopes));
+  v->scl = vm->scl;
+  sf_arena_init (&v->cg_arena);
+
+  v->meta = vm->meta;
+  v->opt = vm->opt;
+  v->inline_len = vm->inline_len;
+  sf_vm_push_scope (v);
+  v->meta.slot = SF_VM_SLOT_NAME;
+}
+
+static void
+unit_free (unit_t *u)
+{
+  vm_t *v = &u->vm;
+
+  sf_vm_pop_scope (v);
+  sf_arena_free (&v->cg_arena);
+
+  SFFREE (v->scopes);
+  SFFREE (v->insts);
+  SFFREE (v->map_consts);
+}
+
+static void *
+worker (void *arg)
+{
+  pool_t *p = arg;
+
+  for (;;)
+    {
+      sf_mutex_lock (&p->lock);
+      size_t i = p->next++;
+      sf_mutex_unlock (&p->lock);
+
+      if (i >= p->ul)
+        break;
+
+      sf_fishc_compile (&p->units[i].vm, p->units[i].path);
+    }
+
+  return NULL;
+}
+
+/**
+ * Moves the unit's code and constants onto the end of the VM's, its
+ * jump targets and constant indices shifted to match. Strings in c and
+ * in the constants change hands as they are.
+ */
+static size_t
+unit_link (vm_t *vm, unit_t *u)
+{
+  vm_t *v = &u->vm;
+  size_t base = vm->inst_len, cbase = vm->s_ml;
+
+  if (vm->inst_len + v->inst_len > vm->inst_cap)
+    {
+      vm->inst_cap = vm->inst_len + v->inst_len + 64;
+      vm->insts = SFREALLOC (vm->insts, vm->inst_cap * sizeof (*vm->insts));
+    }
+
+  if (vm->s_ml + v->s_ml > vm->s_mc)
+    {
+      vm->s_mc = vm->s_ml + v->s_ml + 64;
+      vm->map_consts
+          = SFREALLOC (vm->map_consts, vm->s_mc * sizeof (*vm->map_consts));
+    }
+
+  for (size_t i = 0; i < v->inst_len; i++)
+    {
+      instr_t in = v->insts[i];
+
+      if (SF_OP_HAS_IP (in.op))
+        in.a += base;
+      else if (in.op == OP_LOAD_CONST)
+        in.a += cbase;
+
+      vm->insts[vm->inst_len++] = in;
+    }
+
+  memcpy (vm->map_consts + vm->s_ml, v->map_consts,
+          v->s_ml * sizeof (*v->map_consts));
+  vm->s_ml += v->s_ml;
+
+  return base;
+}
+
+/* queues the modules imported by insts[ip, end) that have no code yet */
+static void
+queue_imports (vm_t *vm, size_t ip, size_t end, unit_t **q, size_t *ql,
+               size_t *qc)
+{
+  for (size_t i = ip; i < end; i++)
+    {
+      if (vm->insts[i].op != OP_IMPORT)
+        continue;
+
+      modent_t *e = sf_modstore_put (vm->mod_store, vm->insts[i].c);
+
+      /* missing files fail at the import, as they always have */
+      if (e == NULL || e->mod != NULL || e->code != SF_MOD_NOCODE)
+        continue;
+
+      e->code = CODE_PENDING;
+
+      if (*ql == *qc)
+        {
+          *qc = *qc ? *qc << 1 : 8;
+          *q = SFREALLOC (*q, *qc * sizeof (**q));
+        }
+
+      (*q)[(*ql)++] = (unit_t){ .ent = e - vm->mod_store->ents };
+    }
+}
+
+/**
+ * Compiles the modules imported from insts[ip, inst_len) and all they
+ * import in turn on up to threads threads, 0 for one per CPU. Runs
+ * after the importer is compiled and before it runs.
+ */
+SF_API void
+sf_imports_compile (vm_t *vm, size_t ip, int threads)
+{
+  unit_t *q = NULL;
+  size_t ql = 0, qc = 0;
+
+  if (threads <= 0)
+    threads = sf_thread_ncpu ();
+
+  if (threads > SF_IMPORTS_MAX_THREADS)
+    threads = SF_IMPORTS_MAX_THREADS;
+
+  queue_imports (vm, ip, vm->inst_len, &q, &ql, &qc);
+
+  while (ql)
+    {
+      /* the store is not touched again until the wave is joined */
+      for (size_t i = 0; i < ql; i++)
+        {
+          q[i].path = vm->mod_store->ents[q[i].ent].path;
+          unit_init (&q[i], vm);
+        }
+
+      pool_t p = { .vm = vm, .units = q, .ul = ql, .next = 0 };
+      sfthread_t th[SF_IMPORTS_MAX_THREADS];
+      int tl = 0;
+
+      p.lock = sf_mutex_new ();
+
+      for (int i = 1; i < threads && (size_t)i < ql; i++)
+        if (!sf_thread_new (&th[tl], worker, &p))
+          tl++;
+
+      worker (&p);
+
+      for (int i = 0; i < tl; i++)
+        sf_thread_join (&th[i]);
+
+      /* linking in queue order keeps the layout the same every run */
+      size_t from = vm->inst_len, n = ql;
+      unit_t *wave = q;
+
+      q = NULL;
+      ql = qc = 0;
+
+      for (size_t i = 0; i < n; i++)
+        {
+          vm->mod_store->ents[wave[i].ent].code = unit_link (vm, &wave[i]);
+          unit_free (&wave[i]);
+        }
+
+      queue_imports (vm, from, vm->inst_len, &q, &ql, &qc);
+      SFFREE (wave);
+    }
+
+  SFFREE (q);
+}
@@ -0,0 +1,30 @@
+#if !defined(IMPORTS_H)
+#define IMPORTS_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Compiling imports ahead of time. Once the main program is compiled,
+ * the modules it imports, and the ones those import, are compiled on a
+ * pool of threads, a level of the import graph at a time, and linked
+ * onto the end of vm->insts. The modules still run at their import
+ * statement, they just skip the compiler there.
+ *
+ * Every import the scan finds is compiled, even ones that never run.
+ */
+#define SF_IMPORTS_MAX_THREADS (64)
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_imports_compile (vm_t *, size_t, int);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // IMPORTS_H
@@ -0,0 +1,88 @@
+#include "intern.h"
+#include "mut.h"
+#include "swiss.h"
+
+typedef struct
+{
+  uint64_t hash;
+  char *s;
+  size_t len;
+
+} symbol_t;
+
+static symbol_t *syms = NULL;
+static size_t sl = 0, sc = 0;
+static swiss_t idx;
+static sfmutex_t lock = SF_MUTEX_INIT; /* modules are parsed in parallel */
+
+static inline uint64_t
+fnv1a_span (const char *s, size_t n)
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      h ^= (unsigned char)s[i];
+      h *= 1099511628211ULL;
+    }
+
+  return h;
+}
+
+static void
+intern_grow (void)
+{
+  sc = sc ? sc << 1 : 64;
+
+  syms = SFREALLOC (syms, sc * sizeof (*syms));
+
+  sf_swiss_free (&idx);
+  sf_swiss_init (&idx, sc);
+
+  for (size_t i = 0; i < sl; i++)
+    sf_swiss_insert (&idx, syms[i].hash, (int32_t)i);
+}
+
+SF_API const char *
+sf_intern (const char *s, size_t n)
+{
+  uint64_t h = fnv1a_span (s, n);
+  swiss_iter_t it;
+  int32_t i;
+
+  sf_mutex_lock (&lock);
+
+  if (sc)
+    {
+      sf_swiss_find (&idx, h, &it);
+
+      while ((i = sf_swiss_next (&idx, &it)) != -1)
+        if (syms[i].hash == h && syms[i].len == n
+            && !memcmp (syms[i].s, s, n))
+          {
+            const char *r = syms[i].s;
+
+            sf_mutex_unlock (&lock);
+            return r;
+          }
+    }
+
+  if (sl == sc)
+    intern_grow ();
+
+  char *p = SFMALLOC (n + 1);
+  memcpy (p, s, n);
+  p[n] = '\0';
+
+  syms[sl] = (symbol_t){ .hash = h, .s = p, .len = n };
+  sf_swiss_insert (&idx, h, (int32_t)sl++);
+
+  sf_mutex_unlock (&lock);
+  return p;
+}
+
+SF_API size_t
+sf_intern_count (void)
+{
+  return sl;
+}
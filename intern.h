@@ -0,0 +1,25 @@
+#if !defined(INTERN_H)
+#define INTERN_H
+
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Process-wide symbol table. Names come out of the lexer as spans into
+ * the source; the parser interns them here when it needs a C string.
+ * Interned strings are unique per spelling and live until exit. The
+ * table takes a lock, imported modules are parsed on several threads.
+ */
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API const char *sf_intern (const char *, size_t);
+  SF_API size_t sf_intern_count (void);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // INTERN_H
@@ -29,6 +29,45 @@ sf_iter_next (iter_t *i)
       }
       break;
 
+    case OBJ_TARRAY:
+      {
+        tarray_t *t = i->o->v.o_tarray.v;
+
+        if (t->len <= i->meta.next_idx)
+          return NULL;
+
+        /* boxed on the way out, small ints come from the const cache */
+        return sf_tarray_box (t, i->meta.next_idx++);
+      }
+      break;
+
+    case OBJ_DICT:
+      {
+        dict_t *d = i->o->v.o_dict.v;
+
+        /* keys in insertion order, skipping deleted entries */
+        while (i->meta.next_idx < d->el
+               && d->ents[i->meta.next_idx].key == NULL)
+          i->meta.next_idx++;
+
+        if (d->el <= i->meta.next_idx)
+          return NULL;
+
+        return d->ents[i->meta.next_idx++].key;
+      }
+      break;
+
+    case OBJ_VIEW:
+      {
+        view_t *v = i->o->v.o_view.v;
+
+        if (v->len <= i->meta.next_idx)
+          return NULL;
+
+        return sf_view_get (v, i->meta.next_idx++);
+      }
+      break;
+
     default:
       break;
     }
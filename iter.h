@@ -11,7 +11,7 @@ typedef struct __iter_s
 
   struct
   {
-    size_t next_idx; /* for arrays */
+    size_t next_idx; /* for arrays, typed arrays, views and dicts */
 
   } meta;
 
@@ -0,0 +1,1430 @@
+#include "jit.h"
+
+#if defined(SF_JIT_X64)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // SF_JIT_X64
+
+SF_API int
+sf_jit_parse (const char *s, int mode)
+{
+  if (s == NULL)
+    return mode;
+
+  if (!strcmp (s, "off") || !strcmp (s, "0"))
+    return SF_JIT_OFF;
+
+  if (!strcmp (s, "on") || !strcmp (s, "1"))
+    return SF_JIT_ON;
+
+  if (!strcmp (s, "always"))
+    return SF_JIT_ALWAYS;
+
+  fprintf (stderr, "SF_JIT: unknown mode '%s'\n", s);
+  return mode;
+}
+
+SF_API jit_t *
+sf_jit_new (int mode)
+{
+  if (mode == SF_JIT_OFF)
+    return NULL;
+
+  jit_t *j = SFMALLOC (sizeof (*j));
+
+  j->mode = mode;
+  j->hot = mode == SF_JIT_ALWAYS ? 1 : SF_JIT_HOT;
+  j->loop_hot = mode == SF_JIT_ALWAYS ? 1 : SF_JIT_LOOP_HOT;
+  j->fns = NULL;
+  j->fl = 0;
+  j->fc = 0;
+  j->at = NULL;
+  j->osr = NULL;
+  j->al = 0;
+
+  return j;
+}
+
+SF_API void
+sf_jit_free (jit_t *j)
+{
+  if (j == NULL)
+    return;
+
+#if defined(SF_JIT_X64)
+  for (size_t i = 0; i < j->fl; i++)
+    if (j->fns[i].map != NULL)
+      munmap (j->fns[i].map, j->fns[i].maplen);
+#endif // SF_JIT_X64
+
+  SFFREE (j->fns);
+  SFFREE (j->at);
+  SFFREE (j->osr);
+  SFFREE (j);
+}
+
+/* the code at [lp, end), found from lp through ix (at or osr) */
+static void
+jit_add (vm_t *vm, uint32_t **ix, size_t lp, size_t end)
+{
+  jit_t *j = vm->jit;
+
+  if (lp >= j->al)
+    {
+      size_t al = j->al;
+
+      j->al = vm->inst_len > lp ? vm->inst_len : lp + 1;
+      j->at = SFREALLOC (j->at, j->al * sizeof (*j->at));
+      j->osr = SFREALLOC (j->osr, j->al * sizeof (*j->osr));
+      memset (j->at + al, 0, (j->al - al) * sizeof (*j->at));
+      memset (j->osr + al, 0, (j->al - al) * sizeof (*j->osr));
+    }
+
+  if (j->fl == j->fc)
+    {
+      j->fc = j->fc ? j->fc << 1 : 16;
+      j->fns = SFREALLOC (j->fns, j->fc * sizeof (*j->fns));
+    }
+
+  j->fns[j->fl++] = (jit_fn_t){ .lp = lp, .end = end };
+  (*ix)[lp] = j->fl;
+}
+
+/* a coded function at [lp, end) was defined, run by OP_LOAD_FUNC_CODED */
+SF_API void
+sf_jit_func (vm_t *vm, size_t lp, size_t end)
+{
+  jit_t *j = vm->jit;
+
+  if (lp < j->al && j->at[lp])
+    return;
+
+  jit_add (vm, &j->at, lp, end);
+}
+
+/* code compiled elsewhere (see aot.h) for the function at [lp, end) */
+SF_API void
+sf_jit_install (vm_t *vm, size_t lp, size_t end, jit_code_t code)
+{
+  jit_t *j = vm->jit;
+
+  if (lp >= j->al || !j->at[lp])
+    jit_add (vm, &j->at, lp, end);
+
+  j->fns[j->at[lp] - 1].code = code;
+}
+
+#if defined(SF_JIT_X64)
+
+enum
+{
+  RAX,
+  RCX,
+  RDX,
+  RBX,
+  RSP,
+  RBP,
+  RSI,
+  RDI,
+  R8,
+  R9,
+  R10,
+  R11,
+  R12,
+  R13,
+  R14,
+  R15,
+};
+
+/* x86 condition codes */
+enum
+{
+  CC_B = 0x2,
+  CC_AE = 0x3,
+  CC_E = 0x4,
+  CC_NE = 0x5,
+  CC_BE = 0x6,
+  CC_A = 0x7,
+  CC_G = 0xf,
+};
+
+#define O_VM(F) ((int32_t)offsetof (vm_t, F))
+#define O_FR(F) ((int32_t)offsetof (frame_t, F))
+#define O_OBJ(F) ((int32_t)offsetof (obj_t, F))
+
+#define O_RC O_OBJ (meta.ref_count)
+#define O_CTYPE O_OBJ (v.o_const.v.type)
+#define O_CINT O_OBJ (v.o_const.v.v.c_int.v)
+#define O_INTS(A) (O_FR (ints) + 4 * (int32_t)(A))
+
+/**
+ * Native code keeps vm in rbx, the frame in r12 and the frame's offset
+ * in vm->frames in r13 (frames move when they grow, so r12 is reloaded
+ * after every call). r14 and r15 hold operands across calls, [rsp] is
+ * a spill slot.
+ */
+typedef struct
+{
+  vm_t *vm;
+  size_t lp, n;
+
+  uint8_t *b;
+  size_t bl, bc;
+
+  long *lab; /* label -> offset, -1 until placed */
+  size_t ll, lc;
+
+  struct
+  {
+    size_t at;
+    size_t lab;
+  } *fix;
+  size_t fl, fc;
+
+  struct
+  {
+    size_t lab;
+    size_t k;
+  } *slow;
+  size_t sl, sc;
+
+  size_t table_imm; /* movabs operand of the dispatch table */
+
+  size_t l_dispatch, l_return, l_tier, l_epi;
+
+} jc_t;
+
+#define JC_GROW(P, L, C)                                                      \
+  if ((L) == (C))                                                             \
+    {                                                                         \
+      (C) = (C) ? (C) << 1 : 64;                                              \
+      (P) = SFREALLOC ((P), (C) * sizeof (*(P)));                             \
+    }
+
+static void
+e_byte (jc_t *c, int x)
+{
+  JC_GROW (c->b, c->bl, c->bc);
+  c->b[c->bl++] = (uint8_t)x;
+}
+
+static void
+e_u32 (jc_t *c, uint32_t x)
+{
+  for (int i = 0; i < 4; i++)
+    e_byte (c, x >> (i * 8));
+}
+
+static void
+e_u64 (jc_t *c, uint64_t x)
+{
+  for (int i = 0; i < 8; i++)
+    e_byte (c, x >> (i * 8));
+}
+
+static size_t
+lab_new (jc_t *c)
+{
+  JC_GROW (c->lab, c->ll, c->lc);
+  c->lab[c->ll] = -1;
+
+  return c->ll++;
+}
+
+static void
+lab_here (jc_t *c, size_t l)
+{
+  c->lab[l] = c->bl;
+}
+
+/* rel32 to l at the end of the current code */
+static void
+e_rel (jc_t *c, size_t l)
+{
+  JC_GROW (c->fix, c->fl, c->fc);
+  c->fix[c->fl].at = c->bl;
+  c->fix[c->fl++].lab = l;
+  e_u32 (c, 0);
+}
+
+static void
+e_jmp (jc_t *c, size_t l)
+{
+  e_byte (c, 0xe9);
+  e_rel (c, l);
+}
+
+static void
+e_jcc (jc_t *c, int cc, size_t l)
+{
+  e_byte (c, 0x0f);
+  e_byte (c, 0x80 | cc);
+  e_rel (c, l);
+}
+
+/* op reg, [base + idx * 8 + disp], idx < 0 for none */
+static void
+e_mem (jc_t *c, int w, const char *op, int reg, int base, int idx,
+       int32_t disp)
+{
+  int rex = 0x40 | (w ? 8 : 0) | (reg & 8 ? 4 : 0)
+            | (idx >= 0 && (idx & 8) ? 2 : 0) | (base & 8 ? 1 : 0);
+
+  if (rex != 0x40)
+    e_byte (c, rex);
+
+  while (*op)
+    e_byte (c, (uint8_t)*op++);
+
+  if (idx < 0 && (base & 7) != RSP)
+    e_byte (c, 0x80 | (reg & 7) << 3 | (base & 7));
+  else
+    {
+      e_byte (c, 0x80 | (reg & 7) << 3 | RSP);
+      e_byte (c, idx < 0 ? 0x24 : 0xc0 | (idx & 7) << 3 | (base & 7));
+    }
+
+  e_u32 (c, (uint32_t)disp);
+}
+
+/* op reg, rm between registers */
+static void
+e_reg (jc_t *c, int w, const char *op, int reg, int rm)
+{
+  int rex = 0x40 | (w ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0);
+
+  if (rex != 0x40)
+    e_byte (c, rex);
+
+  while (*op)
+    e_byte (c, (uint8_t)*op++);
+
+  e_byte (c, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+static void
+e_load (jc_t *c, int dst, int base, int32_t disp)
+{
+  e_mem (c, 1, "\x8b", dst, base, -1, disp);
+}
+
+static void
+e_store (jc_t *c, int base, int32_t disp, int src)
+{
+  e_mem (c, 1, "\x89", src, base, -1, disp);
+}
+
+static void
+e_mov (jc_t *c, int dst, int src)
+{
+  if (dst != src)
+    e_reg (c, 1, "\x89", src, dst);
+}
+
+static void
+e_imm (jc_t *c, int dst, uint64_t x)
+{
+  if (x <= UINT32_MAX)
+    {
+      if (dst & 8)
+        e_byte (c, 0x41);
+      e_byte (c, 0xb8 | (dst & 7));
+      e_u32 (c, (uint32_t)x);
+    }
+  else
+    {
+      e_byte (c, 0x48 | (dst & 8 ? 1 : 0));
+      e_byte (c, 0xb8 | (dst & 7));
+      e_u64 (c, x);
+    }
+}
+
+/* cmp qword/dword [base + disp], x */
+static void
+e_cmpm (jc_t *c, int w, int base, int32_t disp, int32_t x)
+{
+  e_mem (c, w, "\x81", 7, base, -1, disp);
+  e_u32 (c, (uint32_t)x);
+}
+
+static void
+e_test (jc_t *c, int w, int r)
+{
+  e_reg (c, w, "\x85", r, r);
+}
+
+static void
+e_reload (jc_t *c)
+{
+  e_load (c, R12, RBX, O_VM (frames));
+  e_reg (c, 1, "\x01", R13, R12);
+}
+
+static void
+e_call (jc_t *c, void *fn)
+{
+  e_imm (c, RAX, (uint64_t)(uintptr_t)fn);
+  e_byte (c, 0xff);
+  e_byte (c, 0xd0);
+  e_reload (c);
+}
+
+/* continue at ip, anything outside the function goes through dispatch */
+static void
+e_goto (jc_t *c, size_t ip)
+{
+  if (ip >= c->lp && ip <= c->lp + c->n)
+    e_jmp (c, ip - c->lp);
+  else
+    {
+      e_imm (c, RAX, ip);
+      e_jmp (c, c->l_dispatch);
+    }
+}
+
+/* the out of line interpreter fallback of instruction k */
+static size_t
+slow_of (jc_t *c, size_t k)
+{
+  JC_GROW (c->slow, c->sl, c->sc);
+  c->slow[c->sl].lab = lab_new (c);
+  c->slow[c->sl].k = k;
+
+  return c->slow[c->sl++].lab;
+}
+
+static void
+e_ir (jc_t *c, int r)
+{
+  e_byte (c, 0xf0);
+  e_mem (c, 0, "\x83", 0, r, -1, O_RC);
+  e_byte (c, 1);
+}
+
+static void
+e_ir_nonnull (jc_t *c, int r)
+{
+  size_t l = lab_new (c);
+
+  e_test (c, 1, r);
+  e_jcc (c, CC_E, l);
+  e_ir (c, r);
+  lab_here (c, l);
+}
+
+/* drops a reference to the object in r, which is not NULL */
+static void
+e_dr (jc_t *c, int r)
+{
+  size_t l = lab_new (c);
+
+  e_byte (c, 0xf0);
+  e_mem (c, 0, "\x83", 5, r, -1, O_RC);
+  e_byte (c, 1);
+  e_jcc (c, CC_G, l);
+  e_mov (c, RDI, r);
+  e_mov (c, RSI, RBX);
+  e_call (c, (void *)sf_obj_free);
+  lab_here (c, l);
+}
+
+/* room for n more on the stack */
+static void
+e_room (jc_t *c, int n, size_t slow)
+{
+  e_load (c, RCX, RBX, O_VM (sp));
+  e_reg (c, 1, "\x83", 0, RCX);
+  e_byte (c, n);
+  e_mem (c, 1, "\x3b", RCX, RBX, -1, O_VM (stack_cap));
+  e_jcc (c, CC_A, slow);
+}
+
+/* at least n on the stack */
+static void
+e_depth (jc_t *c, int n, size_t slow)
+{
+  e_cmpm (c, 1, RBX, O_VM (sp), n);
+  e_jcc (c, CC_B, slow);
+}
+
+static void
+e_push (jc_t *c, int r)
+{
+  e_load (c, RCX, RBX, O_VM (sp));
+  e_load (c, RDX, RBX, O_VM (stack));
+  e_mem (c, 1, "\x89", r, RDX, RCX, 0);
+  e_reg (c, 1, "\xff", 0, RCX);
+  e_store (c, RBX, O_VM (sp), RCX);
+}
+
+/* the object depth down from the top of the stack, 1 is the top */
+static void
+e_peek (jc_t *c, int r, int depth)
+{
+  e_load (c, RCX, RBX, O_VM (sp));
+  e_load (c, RDX, RBX, O_VM (stack));
+  e_mem (c, 1, "\x8b", r, RDX, RCX, -8 * depth);
+}
+
+static void
+e_drop (jc_t *c, int n)
+{
+  e_mem (c, 1, "\x83", 5, RBX, -1, O_VM (sp));
+  e_byte (c, n);
+}
+
+static void
+e_isint (jc_t *c, int r, size_t slow)
+{
+  e_test (c, 1, r);
+  e_jcc (c, CC_E, slow);
+  e_cmpm (c, 0, r, O_OBJ (type), OBJ_CONST);
+  e_jcc (c, CC_NE, slow);
+  e_cmpm (c, 0, r, O_CTYPE, CONST_INT);
+  e_jcc (c, CC_NE, slow);
+}
+
+static void
+jit_push_const (vm_t *vm, int type, int v)
+{
+  const_t k = (const_t){ .type = type };
+
+  if (type == CONST_BOOL)
+    k.v.c_bool.v = v;
+  else
+    k.v.c_int.v = v;
+
+  obj_t *o = sf_objstore_box (&k);
+
+  if (vm->sp >= vm->stack_cap)
+    {
+      vm->stack_cap += SF_VM_STACK_CAP;
+      vm->stack = SFREALLOC (vm->stack, vm->stack_cap * sizeof (*vm->stack));
+    }
+
+  vm->stack[vm->sp++] = o;
+  IR (o);
+}
+
+/* pushes the int or bool spilled to [rsp] */
+static void
+e_push_spill (jc_t *c, int type)
+{
+  e_mov (c, RDI, RBX);
+  e_imm (c, RSI, type);
+  e_mem (c, 0, "\x8b", RDX, RSP, -1, 0);
+  e_call (c, (void *)jit_push_const);
+}
+
+/* hands instruction k to the interpreter */
+static void
+e_generic (jc_t *c, size_t k, int inline_)
+{
+  e_mov (c, RDI, RBX);
+  e_imm (c, RSI, c->lp + k);
+  e_call (c, (void *)sf_vm_step);
+  e_reg (c, 1, "\x81", 7, RAX);
+  e_u32 (c, (uint32_t)(c->lp + k + 1));
+
+  if (inline_)
+    e_jcc (c, CC_NE, c->l_dispatch);
+  else
+    {
+      e_jcc (c, CC_E, k + 1);
+      e_jmp (c, c->l_dispatch);
+    }
+}
+
+static void
+e_load_fast (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+
+  e_cmpm (c, 1, R12, O_FR (l.locals_count), i.a);
+  e_jcc (c, CC_BE, slow);
+  e_room (c, 1, slow);
+  e_load (c, RDX, R12, O_FR (l.locals));
+  e_load (c, RAX, RDX, i.a * 8);
+  e_push (c, RAX);
+  e_ir_nonnull (c, RAX);
+}
+
+static void
+e_store_fast (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+  size_t l = lab_new (c);
+
+  e_cmpm (c, 1, R12, O_FR (l.locals_count), i.a);
+  e_jcc (c, CC_BE, slow);
+  e_depth (c, 1, slow);
+  e_peek (c, R14, 1);
+  e_drop (c, 1);
+  e_load (c, RDX, R12, O_FR (l.locals));
+  e_load (c, RDI, RDX, i.a * 8);
+  e_test (c, 1, RDI);
+  e_jcc (c, CC_E, l);
+  e_dr (c, RDI);
+  lab_here (c, l);
+  e_load (c, RDX, R12, O_FR (l.locals));
+  e_store (c, RDX, i.a * 8, R14);
+}
+
+static void
+e_load_global (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+
+  e_cmpm (c, 1, RBX, O_VM (globals_cap), i.a);
+  e_jcc (c, CC_BE, slow);
+  e_room (c, 1, slow);
+  e_load (c, RDX, RBX, O_VM (globals));
+  e_load (c, RAX, RDX, i.a * 8);
+  e_push (c, RAX);
+  e_ir_nonnull (c, RAX);
+}
+
+static void
+e_store_global (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+  size_t l = lab_new (c);
+
+  e_cmpm (c, 1, RBX, O_VM (globals_cap), i.a);
+  e_jcc (c, CC_BE, slow);
+  e_depth (c, 1, slow);
+  e_peek (c, R14, 1);
+  e_drop (c, 1);
+  e_load (c, RDX, RBX, O_VM (globals));
+  e_load (c, RDI, RDX, i.a * 8);
+  e_test (c, 1, RDI);
+  e_jcc (c, CC_E, l);
+  e_dr (c, RDI);
+  lab_here (c, l);
+  e_load (c, RDX, RBX, O_VM (globals));
+  e_store (c, RDX, i.a * 8, R14);
+}
+
+/* the object the instruction i pushes, if it can be had without the stack */
+static int
+is_src (jc_t *c, instr_t i)
+{
+  return (i.op == OP_LOAD_FAST && i.b == 0) || i.op == OP_LOAD
+         || (i.op == OP_LOAD_CONST
+             && sf_objstore_req_forconst (&c->vm->map_consts[i.a]) != NULL);
+}
+
+/* loads what the source i would push into r, without a reference */
+static void
+e_src (jc_t *c, int r, instr_t i, size_t slow)
+{
+  if (i.op == OP_LOAD_CONST)
+    {
+      obj_t *o = sf_objstore_req_forconst (&c->vm->map_consts[i.a]);
+      e_imm (c, r, (uint64_t)(uintptr_t)o);
+      return;
+    }
+
+  if (i.op == OP_LOAD)
+    {
+      e_cmpm (c, 1, RBX, O_VM (globals_cap), i.a);
+      e_jcc (c, CC_BE, slow);
+      e_load (c, RDX, RBX, O_VM (globals));
+      e_load (c, r, RDX, i.a * 8);
+      return;
+    }
+
+  e_cmpm (c, 1, R12, O_FR (l.locals_count), i.a);
+  e_jcc (c, CC_BE, slow);
+  e_load (c, RDX, R12, O_FR (l.locals));
+  e_load (c, r, RDX, i.a * 8);
+}
+
+/**
+ * Int operands of the op at k into r15 (left) and r14 (right, or the
+ * only one), from the stack or straight from the nsrc sources in front
+ * of the op. Sources the op is fused with skip the stack and the
+ * reference counts, the variable or constant keeps the object alive.
+ */
+static void
+e_operands (jc_t *c, size_t k, int nargs, int nsrc, size_t slow)
+{
+  instr_t *i = &c->vm->insts[c->lp + k];
+
+  if (nsrc)
+    {
+      if (nargs == 2)
+        e_src (c, R15, i[-2], slow);
+      e_src (c, R14, i[-1], slow);
+    }
+  else
+    {
+      e_depth (c, nargs, slow);
+      e_peek (c, R14, 1);
+      if (nargs == 2)
+        e_peek (c, R15, 2);
+    }
+
+  e_isint (c, R14, slow);
+  if (nargs == 2)
+    e_isint (c, R15, slow);
+}
+
+/* drops the operands e_operands took off the stack */
+static void
+e_operands_done (jc_t *c, int nargs, int nsrc)
+{
+  if (nsrc)
+    return;
+
+  e_dr (c, R14);
+  if (nargs == 2)
+    e_dr (c, R15);
+}
+
+static obj_t *jit_small[5 + 255 + 1]; /* the cached ints, -5 to 255 */
+
+/* pushes the int in eax, the cached object if there is one */
+static void
+e_push_int (jc_t *c)
+{
+  size_t big = lab_new (c);
+  size_t done = lab_new (c);
+
+  e_mem (c, 0, "\x89", RAX, RSP, -1, 0);
+  e_room (c, 1, big);
+  e_mem (c, 0, "\x8b", RAX, RSP, -1, 0);
+  e_reg (c, 0, "\x83", 0, RAX);
+  e_byte (c, 5);
+  e_reg (c, 0, "\x81", 7, RAX);
+  e_u32 (c, 5 + 255);
+  e_jcc (c, CC_A, big);
+  e_imm (c, RDX, (uint64_t)(uintptr_t)jit_small);
+  e_mem (c, 1, "\x8b", RAX, RDX, RAX, 0);
+  e_push (c, RAX);
+  e_ir (c, RAX);
+  e_jmp (c, done);
+
+  lab_here (c, big);
+  e_push_spill (c, CONST_INT);
+  lab_here (c, done);
+}
+
+/* ints are compared as floats, like sf_obj_le and friends do */
+static int
+e_cmp_int (jc_t *c, int type)
+{
+  switch (type)
+    {
+    case CMP_EQEQ:
+    case CMP_NEQ:
+      e_mem (c, 0, "\x8b", RAX, R15, -1, O_CINT);
+      e_mem (c, 0, "\x3b", RAX, R14, -1, O_CINT);
+      return type == CMP_EQEQ ? CC_E : CC_NE;
+
+    case CMP_LE:
+    case CMP_GE:
+    case CMP_LEQ:
+    case CMP_GEQ:
+      e_byte (c, 0xf3);
+      e_mem (c, 0, "\x0f\x2a", 0, R15, -1, O_CINT);
+      e_byte (c, 0xf3);
+      e_mem (c, 0, "\x0f\x2a", 1, R14, -1, O_CINT);
+      e_byte (c, 0x0f);
+      e_byte (c, 0x2e);
+      e_byte (c, 0xc1);
+      return type == CMP_LE    ? CC_B
+             : type == CMP_GE  ? CC_A
+             : type == CMP_LEQ ? CC_BE
+                               : CC_AE;
+
+    default:
+      break;
+    }
+
+  return -1;
+}
+
+/**
+ * CMP at k, and the JUMP_IF_FALSE after it when there is one, or a
+ * CMP_JUMP
+ */
+static void
+e_cmp (jc_t *c, size_t k, int nsrc)
+{
+  instr_t i = c->vm->insts[c->lp + k];
+  size_t slow = slow_of (c, k - nsrc);
+  size_t to = 0, past = 0;
+  int cc;
+
+  if (i.op == OP_CMP_JUMP)
+    {
+      to = i.a;
+      past = c->lp + k + 1;
+    }
+  else if (k + 1 < c->n
+           && c->vm->insts[c->lp + k + 1].op == OP_JUMP_IF_FALSE)
+    {
+      to = c->vm->insts[c->lp + k + 1].a;
+      past = c->lp + k + 2;
+    }
+
+  e_operands (c, k, 2, nsrc, slow);
+  cc = e_cmp_int (c, i.op == OP_CMP_JUMP ? i.b : i.a);
+
+  /* setcc al; movzx eax, al; mov [rsp], eax */
+  e_byte (c, 0x0f);
+  e_byte (c, 0x90 | cc);
+  e_byte (c, 0xc0);
+  e_byte (c, 0x0f);
+  e_byte (c, 0xb6);
+  e_byte (c, 0xc0);
+  e_mem (c, 0, "\x89", RAX, RSP, -1, 0);
+
+  if (!nsrc)
+    e_drop (c, 2);
+
+  if (past)
+    {
+      size_t l = lab_new (c);
+
+      e_operands_done (c, 2, nsrc);
+      e_mem (c, 0, "\x8b", RAX, RSP, -1, 0);
+      e_test (c, 0, RAX);
+      e_jcc (c, CC_NE, l);
+      e_goto (c, to);
+      lab_here (c, l);
+      e_goto (c, past);
+      return;
+    }
+
+  e_push_spill (c, CONST_BOOL);
+  e_operands_done (c, 2, nsrc);
+
+  if (nsrc)
+    e_goto (c, c->lp + k + 1);
+}
+
+static void
+e_jump_if_false (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+  size_t l = lab_new (c);
+
+  e_depth (c, 1, slow);
+  e_peek (c, R14, 1);
+  e_test (c, 1, R14);
+  e_jcc (c, CC_E, slow);
+  e_cmpm (c, 0, R14, O_OBJ (type), OBJ_CONST);
+  e_jcc (c, CC_NE, slow);
+
+  /* bools and ints keep their value in the same place */
+  e_mem (c, 0, "\x8b", RAX, R14, -1, O_CTYPE);
+  e_reg (c, 0, "\x83", 7, RAX);
+  e_byte (c, CONST_BOOL);
+  e_jcc (c, CC_E, l);
+  e_reg (c, 0, "\x83", 7, RAX);
+  e_byte (c, CONST_INT);
+  e_jcc (c, CC_NE, slow);
+  lab_here (c, l);
+
+  e_mem (c, 0, "\x8b", R15, R14, -1, O_CINT);
+  e_drop (c, 1);
+  e_dr (c, R14);
+
+  size_t t = lab_new (c);
+
+  e_test (c, 0, R15);
+  e_jcc (c, CC_NE, t);
+  e_goto (c, i.a);
+  lab_here (c, t);
+}
+
+/* ADD_1, ADD, SUB or MUL of ints at k */
+static void
+e_arith (jc_t *c, size_t k, int nsrc)
+{
+  instr_t i = c->vm->insts[c->lp + k];
+  int nargs = i.op == OP_ADD_1 ? 1 : 2;
+
+  e_operands (c, k, nargs, nsrc, slow_of (c, k - nsrc));
+
+  if (nargs == 1)
+    {
+      e_mem (c, 0, "\x8b", RAX, R14, -1, O_CINT);
+      e_reg (c, 0, "\x83", 0, RAX);
+      e_byte (c, 1);
+    }
+  else
+    {
+      e_mem (c, 0, "\x8b", RAX, R15, -1, O_CINT);
+      e_mem (c, 0, "\x8b", RCX, R14, -1, O_CINT);
+
+      if (i.op == OP_ADD)
+        e_reg (c, 0, "\x01", RCX, RAX);
+      else if (i.op == OP_SUB)
+        e_reg (c, 0, "\x29", RCX, RAX);
+      else
+        e_reg (c, 0, "\x0f\xaf", RAX, RCX);
+    }
+
+  if (!nsrc)
+    e_drop (c, nargs);
+
+  e_push_int (c);
+  e_operands_done (c, nargs, nsrc);
+
+  if (nsrc)
+    e_goto (c, c->lp + k + 1);
+}
+
+/* pushes the int in eax as it is, or boxed when box is set */
+static void
+e_push_raw (jc_t *c, int box)
+{
+  if (box)
+    e_push_int (c);
+  else
+    e_push (c, RAX);
+}
+
+/* the comparison type of eax and ecx as it is, like e_cmp_int */
+static int
+e_cmp_raw (jc_t *c, int type)
+{
+  if (type == CMP_EQEQ || type == CMP_NEQ)
+    {
+      e_reg (c, 0, "\x39", RCX, RAX);
+      return type == CMP_EQEQ ? CC_E : CC_NE;
+    }
+
+  /* cvtsi2ss xmm0, eax; cvtsi2ss xmm1, ecx; ucomiss xmm0, xmm1 */
+  e_byte (c, 0xf3);
+  e_reg (c, 0, "\x0f\x2a", 0, RAX);
+  e_byte (c, 0xf3);
+  e_reg (c, 0, "\x0f\x2a", 1, RCX);
+  e_byte (c, 0x0f);
+  e_byte (c, 0x2e);
+  e_byte (c, 0xc1);
+
+  return type == CMP_LE    ? CC_B
+         : type == CMP_GE  ? CC_A
+         : type == CMP_LEQ ? CC_BE
+                           : CC_AE;
+}
+
+/* CMP_I or CMP_JUMP_I at k, operands that are objects guarded */
+static void
+e_cmp_i (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+
+  e_depth (c, 2, slow);
+  e_peek (c, R15, 2);
+  e_peek (c, R14, 1);
+
+  if (i.b & SF_CMP_L_OBJ)
+    e_isint (c, R15, slow);
+  if (i.b & SF_CMP_R_OBJ)
+    e_isint (c, R14, slow);
+
+  if (i.b & SF_CMP_L_OBJ)
+    e_mem (c, 0, "\x8b", RAX, R15, -1, O_CINT);
+  else
+    e_reg (c, 0, "\x89", R15, RAX);
+
+  if (i.b & SF_CMP_R_OBJ)
+    e_mem (c, 0, "\x8b", RCX, R14, -1, O_CINT);
+  else
+    e_reg (c, 0, "\x89", R14, RCX);
+
+  int cc = e_cmp_raw (c, SF_CMP_I (i.b));
+
+  /* setcc al; movzx eax, al; mov [rsp], eax */
+  e_byte (c, 0x0f);
+  e_byte (c, 0x90 | cc);
+  e_byte (c, 0xc0);
+  e_byte (c, 0x0f);
+  e_byte (c, 0xb6);
+  e_byte (c, 0xc0);
+  e_mem (c, 0, "\x89", RAX, RSP, -1, 0);
+
+  e_drop (c, 2);
+  if (i.b & SF_CMP_L_OBJ)
+    e_dr (c, R15);
+  if (i.b & SF_CMP_R_OBJ)
+    e_dr (c, R14);
+
+  if (i.op == OP_CMP_I)
+    {
+      e_push_spill (c, CONST_BOOL);
+      return;
+    }
+
+  size_t l = lab_new (c);
+
+  e_mem (c, 0, "\x8b", RAX, RSP, -1, 0);
+  e_test (c, 0, RAX);
+  e_jcc (c, CC_NE, l);
+  e_goto (c, i.a);
+  lab_here (c, l);
+}
+
+/* the typed ops (see the types pass in opt.h) but for comparisons */
+static void
+e_typed (jc_t *c, size_t k, instr_t i)
+{
+  size_t slow = slow_of (c, k);
+
+  switch (i.op)
+    {
+    case OP_CONST_I:
+      e_room (c, 1, slow);
+      e_imm (c, RAX, (uint32_t)i.a);
+      e_push (c, RAX);
+      break;
+
+    case OP_LOAD_I:
+      if (!i.b)
+        e_room (c, 1, slow);
+      e_mem (c, 0, "\x8b", RAX, R12, -1, O_INTS (i.a));
+      e_push_raw (c, i.b);
+      break;
+
+    case OP_STORE_I:
+      e_depth (c, 1, slow);
+      e_peek (c, RAX, 1);
+      e_drop (c, 1);
+      e_mem (c, 0, "\x89", RAX, R12, -1, O_INTS (i.a));
+      break;
+
+    case OP_ADD_1_I:
+      e_depth (c, 1, slow);
+      e_peek (c, RAX, 1);
+      e_drop (c, 1);
+      e_reg (c, 0, "\x83", 0, RAX);
+      e_byte (c, 1);
+      e_push_raw (c, i.b);
+      break;
+
+    case OP_DUP_I:
+      e_depth (c, 1, slow);
+      e_room (c, 1, slow);
+      e_peek (c, R14, 1);
+      e_drop (c, 1);
+      e_reg (c, 0, "\x89", R14, RAX);
+      e_push_raw (c, i.b & 1);
+      e_reg (c, 0, "\x89", R14, RAX);
+      e_push_raw (c, i.b & 2);
+      break;
+
+    default:
+      e_depth (c, 2, slow);
+      e_peek (c, RAX, 2);
+      e_peek (c, RCX, 1);
+      e_drop (c, 2);
+
+      if (i.op == OP_ADD_I)
+        e_reg (c, 0, "\x01", RCX, RAX);
+      else if (i.op == OP_SUB_I)
+        e_reg (c, 0, "\x29", RCX, RAX);
+      else
+        e_reg (c, 0, "\x0f\xaf", RAX, RCX);
+
+      e_push_raw (c, i.b);
+      break;
+    }
+}
+
+static int
+is_arith (instr_t i)
+{
+  return i.op == OP_ADD || i.op == OP_SUB || i.op == OP_MUL;
+}
+
+static int
+is_cmp (instr_t i)
+{
+  int type = i.op == OP_CMP_JUMP ? i.b : i.a;
+
+  return (i.op == OP_CMP || i.op == OP_CMP_JUMP)
+         && (type == CMP_EQEQ || type == CMP_NEQ || type == CMP_LE
+             || type == CMP_GE || type == CMP_LEQ || type == CMP_GEQ);
+}
+
+/**
+ * Sources and the op they feed, emitted as one template from k. The
+ * instructions after k keep templates of their own for jumps into the
+ * middle.
+ */
+static int
+e_fused (jc_t *c, size_t k)
+{
+  instr_t *i = &c->vm->insts[c->lp + k];
+
+  if (k + 2 < c->n && is_src (c, i[0]) && is_src (c, i[1]))
+    {
+      if (is_arith (i[2]))
+        {
+          e_arith (c, k + 2, 2);
+          return 1;
+        }
+
+      if (is_cmp (i[2]))
+        {
+          e_cmp (c, k + 2, 2);
+          return 1;
+        }
+    }
+
+  if (k + 1 < c->n && is_src (c, i[0]) && i[1].op == OP_ADD_1)
+    {
+      e_arith (c, k + 1, 1);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+e_inst (jc_t *c, size_t k)
+{
+  instr_t i = c->vm->insts[c->lp + k];
+
+  if (e_fused (c, k))
+    return;
+
+  switch (i.op)
+    {
+    case OP_LOAD_FAST:
+      if (i.b == 0)
+        {
+          e_load_fast (c, k, i);
+          return;
+        }
+      break;
+
+    case OP_STORE_FAST:
+      e_store_fast (c, k, i);
+      return;
+
+    case OP_LOAD:
+      e_load_global (c, k, i);
+      return;
+
+    case OP_STORE:
+      e_store_global (c, k, i);
+      return;
+
+    case OP_LOAD_CONST:
+      {
+        obj_t *o = sf_objstore_req_forconst (&c->vm->map_consts[i.a]);
+
+        if (o == NULL)
+          break;
+
+        e_room (c, 1, slow_of (c, k));
+        e_imm (c, RAX, (uint64_t)(uintptr_t)o);
+        e_push (c, RAX);
+        e_ir (c, RAX);
+      }
+      return;
+
+    case OP_DUP:
+      {
+        size_t slow = slow_of (c, k);
+
+        e_depth (c, 1, slow);
+        e_room (c, 1, slow);
+        e_peek (c, RAX, 1);
+        e_push (c, RAX);
+        e_ir_nonnull (c, RAX);
+      }
+      return;
+
+    case OP_JUMP:
+      e_goto (c, i.a);
+      return;
+
+    case OP_JUMP_IF_FALSE:
+      e_jump_if_false (c, k, i);
+      return;
+
+    case OP_CMP:
+    case OP_CMP_JUMP:
+      if (is_cmp (i))
+        {
+          e_cmp (c, k, 0);
+          return;
+        }
+      break;
+
+    case OP_ADD_1:
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+      e_arith (c, k, 0);
+      return;
+
+    case OP_CONST_I:
+    case OP_LOAD_I:
+    case OP_STORE_I:
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+    case OP_ADD_1_I:
+    case OP_DUP_I:
+      e_typed (c, k, i);
+      return;
+
+    case OP_CMP_I:
+    case OP_CMP_JUMP_I:
+      e_cmp_i (c, k, i);
+      return;
+
+    case OP_RETURN:
+      /* the value is on the stack already */
+      if (i.a == 1)
+        {
+          e_imm (c, RAX, SF_VM_RETURN);
+          e_jmp (c, c->l_epi);
+          return;
+        }
+      break;
+
+    default:
+      break;
+    }
+
+  e_generic (c, k, 1);
+}
+
+static void
+e_prologue (jc_t *c)
+{
+  static const int saved[] = { RBP, RBX, R12, R13, R14, R15 };
+
+  for (size_t i = 0; i < sizeof (saved) / sizeof (*saved); i++)
+    {
+      if (saved[i] & 8)
+        e_byte (c, 0x41);
+      e_byte (c, 0x50 | (saved[i] & 7));
+    }
+
+  /* sub rsp, 8 keeps calls 16 byte aligned */
+  e_reg (c, 1, "\x83", 5, RSP);
+  e_byte (c, 8);
+
+  e_mov (c, RBX, RDI);
+  e_load (c, RAX, RBX, O_VM (fp));
+  e_reg (c, 1, "\xff", 1, RAX);
+  e_reg (c, 1, "\x69", R13, RAX);
+  e_u32 (c, sizeof (frame_t));
+  e_reload (c);
+  e_mov (c, RAX, RSI);
+  e_jmp (c, c->l_dispatch);
+}
+
+/* rax holds the ip to go on at */
+static void
+e_dispatch (jc_t *c)
+{
+  static const int saved[] = { R15, R14, R13, R12, RBX, RBP };
+
+  lab_here (c, c->l_dispatch);
+  e_reg (c, 1, "\x83", 7, RAX);
+  e_byte (c, 0xff);
+  e_jcc (c, CC_E, c->l_return);
+  e_mov (c, RCX, RAX);
+  e_reg (c, 1, "\x81", 5, RCX);
+  e_u32 (c, (uint32_t)c->lp);
+  e_reg (c, 1, "\x81", 7, RCX);
+  e_u32 (c, (uint32_t)c->n);
+  e_jcc (c, CC_AE, c->l_tier);
+  e_byte (c, 0x48);
+  e_byte (c, 0xba);
+  c->table_imm = c->bl;
+  e_u64 (c, 0);
+  e_mem (c, 0, "\xff", 4, RDX, RCX, 0);
+
+  lab_here (c, c->l_return);
+  e_imm (c, RAX, SF_VM_RETURN);
+  e_jmp (c, c->l_epi);
+
+  /* leaves the rest of the frame to the interpreter */
+  lab_here (c, c->l_tier);
+  e_store (c, RBX, O_VM (ip), RAX);
+  e_imm (c, RAX, SF_VM_NEXT);
+
+  lab_here (c, c->l_epi);
+  e_reg (c, 1, "\x83", 0, RSP);
+  e_byte (c, 8);
+
+  for (size_t i = 0; i < sizeof (saved) / sizeof (*saved); i++)
+    {
+      if (saved[i] & 8)
+        e_byte (c, 0x41);
+      e_byte (c, 0x58 | (saved[i] & 7));
+    }
+
+  e_byte (c, 0xc3);
+}
+
+static int
+jit_compile (vm_t *vm, jit_fn_t *f)
+{
+  jc_t c = { .vm = vm, .lp = f->lp, .n = f->end - f->lp };
+  int ok = 0;
+
+  if (c.n == 0 || c.n > SF_JIT_MAXLEN || f->end >= INT32_MAX)
+    return 0;
+
+  if (jit_small[0] == NULL)
+    for (int v = -5; v <= 255; v++)
+      jit_small[v + 5] = sf_objstore_req_forconst (
+          &(const_t){ .type = CONST_INT, .v.c_int.v = v });
+
+  /* labels 0..n are the instructions and the end of the function */
+  for (size_t k = 0; k <= c.n; k++)
+    lab_new (&c);
+
+  c.l_dispatch = lab_new (&c);
+  c.l_return = lab_new (&c);
+  c.l_tier = lab_new (&c);
+  c.l_epi = lab_new (&c);
+
+  e_prologue (&c);
+
+  for (size_t k = 0; k < c.n; k++)
+    {
+      lab_here (&c, k);
+      e_inst (&c, k);
+    }
+
+  lab_here (&c, c.n);
+  e_imm (&c, RAX, c.lp + c.n);
+  e_jmp (&c, c.l_dispatch);
+
+  e_dispatch (&c);
+
+  for (size_t s = 0; s < c.sl; s++)
+    {
+      lab_here (&c, c.slow[s].lab);
+      e_generic (&c, c.slow[s].k, 0);
+    }
+
+  for (size_t i = 0; i < c.fl; i++)
+    {
+      int32_t rel = (int32_t)(c.lab[c.fix[i].lab] - (long)(c.fix[i].at + 4));
+      memcpy (c.b + c.fix[i].at, &rel, 4);
+    }
+
+  while (c.bl & 7)
+    e_byte (&c, 0xcc);
+
+  size_t table = c.bl;
+  size_t page = (size_t)sysconf (_SC_PAGESIZE);
+  size_t len = (table + c.n * sizeof (void *) + page - 1) & ~(page - 1);
+
+  uint8_t *m = mmap (NULL, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (m == MAP_FAILED)
+    goto end;
+
+  memcpy (m, c.b, c.bl);
+
+  for (size_t k = 0; k < c.n; k++)
+    ((uint8_t **)(m + table))[k] = m + c.lab[k];
+
+  uint64_t ta = (uint64_t)(uintptr_t)(m + table);
+  memcpy (m + c.table_imm, &ta, 8);
+
+  if (mprotect (m, len, PROT_READ | PROT_EXEC))
+    {
+      munmap (m, len);
+      goto end;
+    }
+
+  f->map = m;
+  f->maplen = len;
+  f->code = (jit_code_t)(void *)m;
+  ok = 1;
+
+end:;
+  SFFREE (c.b);
+  SFFREE (c.lab);
+  SFFREE (c.fix);
+  SFFREE (c.slow);
+
+  return ok;
+}
+
+#endif // SF_JIT_X64
+
+/* runs f from ip once it got hot, SF_VM_NEXT untouched until then */
+static int
+jit_enter (vm_t *vm, jit_fn_t *f, size_t ip, size_t hot)
+{
+  if (f->code == NULL)
+    {
+      if (f->failed || ++f->calls < hot)
+        return -1;
+
+      /* whatever cannot be compiled keeps running interpreted */
+#if defined(SF_JIT_X64)
+      if (!jit_compile (vm, f))
+#endif // SF_JIT_X64
+        {
+          f->failed = 1;
+          return -1;
+        }
+    }
+
+  return f->code (vm, ip);
+}
+
+/**
+ * Runs the frame on top from vm->ip natively if a hot function starts
+ * there. Returns how the frame was left, SF_VM_NEXT with vm->ip set if
+ * the interpreter has to go on (or do it all).
+ */
+SF_API int
+sf_jit_run (vm_t *vm)
+{
+  jit_t *j = vm->jit;
+  size_t ip = vm->ip;
+
+  if (ip >= j->al || !j->at[ip])
+    return SF_VM_NEXT;
+
+  int r = jit_enter (vm, &j->fns[j->at[ip] - 1], ip, j->hot);
+
+  return r < 0 ? SF_VM_NEXT : r;
+}
+
+/**
+ * A backward jump from end - 1 to the loop header at head was taken.
+ * Once the loop is hot, runs it natively from the header, on the state
+ * the interpreter left. Returns as sf_jit_run does, on SF_VM_NEXT the
+ * interpreter goes on at vm->ip + 1 (vm->ip is left alone if the loop
+ * did not run).
+ */
+SF_API int
+sf_jit_loop (vm_t *vm, size_t head, size_t end)
+{
+  jit_t *j = vm->jit;
+
+  if (head >= j->al || !j->osr[head])
+    jit_add (vm, &j->osr, head, end);
+
+  int r = jit_enter (vm, &j->fns[j->osr[head] - 1], head, j->loop_hot);
+
+  if (r < 0)
+    return SF_VM_NEXT;
+
+  if (r == SF_VM_NEXT)
+    vm->ip--;
+
+  return r;
+}
@@ -0,0 +1,95 @@
+#if !defined(JIT_H)
+#define JIT_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(_WIN32)
+#define SF_JIT_X64
+#endif // __GNUC__ && x86-64
+
+/**
+ * Baseline JIT. A coded function called SF_JIT_HOT times is translated
+ * one instruction at a time into x86-64: int arithmetic, locals,
+ * globals, constants, jumps and compare-and-branch get inline fast
+ * paths, every other instruction (and every fast path whose guard
+ * fails) calls back into the interpreter through sf_vm_step. Native
+ * code leaves for the interpreter whenever control goes outside the
+ * function, the interpreter picks up where it left.
+ *
+ * Loops get there too, so code that is never called (a script's top
+ * level, or a function called once) does not miss out. The interpreter
+ * counts each backward OP_JUMP against the loop header it targets, and
+ * after SF_JIT_LOOP_HOT trips the range from the header to the jump is
+ * compiled like a function body and entered at the header. Native code
+ * works on the VM's own stack, frames and globals, so the loop picks up
+ * the live state as it is, and leaving the range (the loop is done)
+ * hands the frame back to the interpreter at the exit.
+ *
+ * $SF_JIT is "on" (the default), "always" (compile on the first call
+ * or loop trip) or "off"/"0". Other targets compile nothing and only
+ * run code installed ahead of time.
+ */
+enum JitMode
+{
+  SF_JIT_OFF = 0,
+  SF_JIT_ON = 1,
+  SF_JIT_ALWAYS = 2,
+};
+
+#define SF_JIT_HOT (64)
+#define SF_JIT_LOOP_HOT (1024)
+
+/* functions with more instructions than this stay interpreted */
+#define SF_JIT_MAXLEN (1 << 14)
+
+typedef int (*jit_code_t) (vm_t *, size_t);
+
+typedef struct
+{
+  size_t lp, end; /* instructions [lp, end) */
+  size_t calls;   /* or trips, of a loop */
+  int failed;
+
+  jit_code_t code;
+  void *map;
+  size_t maplen;
+
+} jit_fn_t;
+
+typedef struct _jit_s
+{
+  int mode;
+  size_t hot, loop_hot;
+
+  jit_fn_t *fns;
+  size_t fl;
+  size_t fc;
+
+  /* ip -> index into fns + 1, 0 if none */
+  uint32_t *at;  /* functions starting there */
+  uint32_t *osr; /* loops with their header there */
+  size_t al;
+
+} jit_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API jit_t *sf_jit_new (int);
+  SF_API void sf_jit_free (jit_t *);
+  SF_API int sf_jit_parse (const char *, int);
+
+  SF_API void sf_jit_func (vm_t *, size_t, size_t);
+  SF_API void sf_jit_install (vm_t *, size_t, size_t, jit_code_t);
+  SF_API int sf_jit_run (vm_t *);
+  SF_API int sf_jit_loop (vm_t *, size_t, size_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // JIT_H
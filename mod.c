@@ -1,5 +1,8 @@
 #include "mod.h"
 #include "object.h"
+#include <sys/stat.h>
+
+#define MODSTORE_MIN_CAP (4)
 
 SF_API mod_t *
 sf_mod_new ()
@@ -9,7 +12,8 @@ sf_mod_new ()
   m->svl = 0;
   m->name = NULL;
   m->slots = NULL;
-  m->name = NULL;
+  m->vals = NULL;
+  m->fr = NULL;
 
   return m;
 }
@@ -27,6 +31,9 @@ sf_mod_free (mod_t *mod)
   if (mod->vals != NULL)
     SFFREE (mod->vals);
 
+  if (mod->fr != NULL)
+    SFFREE (mod->fr);
+
   SFFREE (mod);
 }
 
@@ -34,60 +41,164 @@ SF_API modstore_t *
 sf_modstore_new ()
 {
   modstore_t *md = SFMALLOC (sizeof (*md));
-  md->keys = NULL;
-  md->vals = NULL;
-  md->kl = 0;
-  md->kc = 0;
+  md->ec = MODSTORE_MIN_CAP;
+  md->el = 0;
+  md->ents = SFMALLOC (md->ec * sizeof (*md->ents));
 
+  sf_swiss_init (&md->idx, 0);
   return md;
 }
 
 SF_API void
 sf_modstore_free (modstore_t *md)
 {
-  if (md->keys != NULL)
-    SFFREE (md->keys);
-
-  if (md->vals != NULL)
-    SFFREE (md->vals);
+  for (size_t i = 0; i < md->el; i++)
+    SFFREE (md->ents[i].path);
 
+  sf_swiss_free (&md->idx);
+  SFFREE (md->ents);
   SFFREE (md);
 }
 
-SF_API int
-sf_modstore_haskey (modstore_t *md, int k)
+static inline uint64_t
+key_hash (uint64_t dev, uint64_t ino)
 {
-  for (size_t i = 0; i < md->kl; i++)
-    {
-      if (k == md->keys[i])
-        return 1;
-    }
+  uint64_t h = dev * 0x9e3779b97f4a7c15ULL ^ ino;
 
-  return 0;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+
+  return h;
 }
 
-SF_API obj_t *
-sf_modstore_get (modstore_t *md, int k)
+/* fills the key of the file at path, 0 if there is none */
+static int
+mod_key (const char *path, modent_t *k)
+{
+  struct stat st;
+
+  if (stat (path, &st) != 0)
+    return 0;
+
+  k->dev = st.st_dev;
+  k->ino = st.st_ino;
+
+#if defined(_WIN32)
+  /* no inode numbers here, the full path stands in for one */
+  char *full = _fullpath (NULL, path, 0);
+  const char *s = full != NULL ? full : path;
+
+  k->ino = 14695981039346656037ULL;
+  for (; *s; s++)
+    k->ino = (k->ino ^ (unsigned char)tolower (*s)) * 1099511628211ULL;
+
+  free (full);
+#endif // _WIN32
+
+  k->hash = key_hash (k->dev, k->ino);
+  return 1;
+}
+
+static modent_t *
+modstore_find (modstore_t *md, modent_t *k)
 {
-  for (size_t i = 0; i < md->kl; i++)
+  swiss_iter_t it;
+  int32_t i;
+
+  sf_swiss_find (&md->idx, k->hash, &it);
+
+  while ((i = sf_swiss_next (&md->idx, &it)) != -1)
     {
-      if (k == md->keys[i])
-        return md->vals[i];
+      modent_t *e = &md->ents[i];
+
+      if (e->hash == k->hash && e->dev == k->dev && e->ino == k->ino)
+        return e;
     }
 
   return NULL;
 }
 
-SF_API void
-sf_modstore_add (modstore_t *md, int k, struct object_s *v)
+/* the entry of the file at path, NULL if it has none */
+SF_API modent_t *
+sf_modstore_find (modstore_t *md, const char *path)
 {
-  if (md->kl >= md->kc)
+  modent_t k;
+
+  if (!mod_key (path, &k))
+    return NULL;
+
+  return modstore_find (md, &k);
+}
+
+/**
+ * The entry of the file at path, added empty if it has none yet. NULL
+ * only when there is no such file. Entries move as the store grows.
+ */
+SF_API modent_t *
+sf_modstore_put (modstore_t *md, const char *path)
+{
+  modent_t k;
+
+  if (!mod_key (path, &k))
+    return NULL;
+
+  modent_t *e = modstore_find (md, &k);
+
+  if (e != NULL)
+    return e;
+
+  if (md->el == md->ec || sf_swiss_full (&md->idx))
+    {
+      if (md->el == md->ec)
+        {
+          md->ec <<= 1;
+          md->ents = SFREALLOC (md->ents, md->ec * sizeof (*md->ents));
+        }
+
+      sf_swiss_free (&md->idx);
+      sf_swiss_init (&md->idx, md->el * 2 > md->ec ? md->el * 2 : md->ec);
+
+      for (size_t i = 0; i < md->el; i++)
+        sf_swiss_insert (&md->idx, md->ents[i].hash, (int32_t)i);
+    }
+
+#if defined(_WIN32)
+  k.path = _fullpath (NULL, path, 0);
+#else
+  k.path = realpath (path, NULL);
+#endif // _WIN32
+
+  if (k.path == NULL)
+    k.path = SFSTRDUP (path);
+  else
     {
-      md->kc += 8;
-      md->keys = SFREALLOC (md->keys, md->kc * sizeof (*md->keys));
-      md->vals = SFREALLOC (md->vals, md->kc * sizeof (*md->vals));
+      char *p = SFSTRDUP (k.path);
+      free (k.path);
+      k.path = p;
     }
 
-  md->keys[md->kl] = k;
-  md->vals[md->kl++] = v;
-}
\ No newline at end of file
+  k.mod = NULL;
+  k.code = SF_MOD_NOCODE;
+  md->ents[md->el] = k;
+  sf_swiss_insert (&md->idx, k.hash, (int32_t)md->el);
+
+  return &md->ents[md->el++];
+}
+
+SF_API obj_t *
+sf_modstore_get (modstore_t *md, const char *path)
+{
+  modent_t *e = sf_modstore_find (md, path);
+  return e != NULL ? e->mod : NULL;
+}
+
+/* takes over the caller's reference to v */
+SF_API void
+sf_modstore_add (modstore_t *md, const char *path, obj_t *v)
+{
+  modent_t *e = sf_modstore_put (md, path);
+
+  if (e != NULL)
+    e->mod = v;
+}
@@ -3,6 +3,7 @@
 
 #include "header.h"
 #include "malloc.h"
+#include "swiss.h"
 
 struct _frame_s;
 typedef struct __mod_s
@@ -13,16 +14,35 @@ typedef struct __mod_s
   struct object_s **vals;
   size_t svl;
   size_t svc;
-  struct _frame_s *fr;
+  struct _frame_s *fr; /* the module's own copy of its frame */
 
 } mod_t;
 
+typedef struct
+{
+  uint64_t hash;
+  uint64_t dev;
+  uint64_t ino;
+  char *path; /* canonical */
+  struct object_s *mod;
+  size_t code; /* ip of code linked ahead of time, or SF_MOD_NOCODE */
+
+} modent_t;
+
+#define SF_MOD_NOCODE ((size_t)-1)
+
+/**
+ * Modules a VM has loaded, one per file. They are keyed by device and
+ * inode, so every spelling of a path and every link to the file gets
+ * the same module object. The store holds a reference to each.
+ */
 typedef struct __modstore_s
 {
-  int *keys;
-  struct object_s **vals;
-  size_t kl;
-  size_t kc;
+  modent_t *ents;
+  size_t el;
+  size_t ec;
+
+  swiss_t idx;
 
 } modstore_t;
 
@@ -36,9 +56,11 @@ extern "C"
 
   SF_API modstore_t *sf_modstore_new ();
   SF_API void sf_modstore_free (modstore_t *);
-  SF_API int sf_modstore_haskey (modstore_t *, int);
-  SF_API struct object_s *sf_modstore_get (modstore_t *, int);
-  SF_API void sf_modstore_add (modstore_t *, int, struct object_s *);
+  SF_API modent_t *sf_modstore_find (modstore_t *, const char *);
+  SF_API modent_t *sf_modstore_put (modstore_t *, const char *);
+  SF_API struct object_s *sf_modstore_get (modstore_t *, const char *);
+  SF_API void sf_modstore_add (modstore_t *, const char *,
+                               struct object_s *);
 
 #if defined(__cplusplus)
 }
@@ -1,9 +1,14 @@
 #include "mut.h"
+#include "malloc.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif // _WIN32
 
 SF_API sfmutex_t
 sf_mutex_new ()
 {
-  sfmutex_t m;
+  sfmutex_t m = SF_MUTEX_INIT;
   return m;
 }
 
@@ -11,6 +16,7 @@ SF_API void
 sf_mutex_lock (sfmutex_t *m)
 {
 #if defined(_WIN32)
+  AcquireSRWLockExclusive (&m->mut);
 #else
   pthread_mutex_lock (&m->mut);
 #endif // _WIN32
@@ -20,7 +26,77 @@ SF_API void
 sf_mutex_unlock (sfmutex_t *m)
 {
 #if defined(_WIN32)
+  ReleaseSRWLockExclusive (&m->mut);
 #else
   pthread_mutex_unlock (&m->mut);
 #endif // _WIN32
-}
\ No newline at end of file
+}
+
+#if defined(_WIN32)
+typedef struct
+{
+  void *(*f) (void *);
+  void *arg;
+
+} thread_start_t;
+
+static DWORD WINAPI
+thread_start (LPVOID p)
+{
+  thread_start_t s = *(thread_start_t *)p;
+
+  SFFREE (p);
+  s.f (s.arg);
+
+  return 0;
+}
+#endif // _WIN32
+
+/* 0 on success */
+SF_API int
+sf_thread_new (sfthread_t *t, void *(*f) (void *), void *arg)
+{
+#if defined(_WIN32)
+  thread_start_t *s = SFMALLOC (sizeof (*s));
+  s->f = f;
+  s->arg = arg;
+
+  t->t = CreateThread (NULL, 0, thread_start, s, 0, NULL);
+
+  if (t->t == NULL)
+    {
+      SFFREE (s);
+      return -1;
+    }
+
+  return 0;
+#else
+  return pthread_create (&t->t, NULL, f, arg);
+#endif // _WIN32
+}
+
+SF_API void
+sf_thread_join (sfthread_t *t)
+{
+#if defined(_WIN32)
+  WaitForSingleObject (t->t, INFINITE);
+  CloseHandle (t->t);
+#else
+  pthread_join (t->t, NULL);
+#endif // _WIN32
+}
+
+SF_API int
+sf_thread_ncpu (void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO si;
+  GetSystemInfo (&si);
+
+  return si.dwNumberOfProcessors;
+#else
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (int)n : 1;
+#endif // _WIN32
+}
@@ -6,13 +6,30 @@
 typedef struct
 {
 #if defined(_WIN32)
-  HANDLE mut;
+  SRWLOCK mut;
 #else
   pthread_mutex_t mut;
 #endif // _WIN32
 
 } sfmutex_t;
 
+/* static initializer, for mutexes that exist before anything runs */
+#if defined(_WIN32)
+#define SF_MUTEX_INIT { SRWLOCK_INIT }
+#else
+#define SF_MUTEX_INIT { PTHREAD_MUTEX_INITIALIZER }
+#endif // _WIN32
+
+typedef struct
+{
+#if defined(_WIN32)
+  HANDLE t;
+#else
+  pthread_t t;
+#endif // _WIN32
+
+} sfthread_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -22,6 +39,10 @@ extern "C"
   SF_API void sf_mutex_lock (sfmutex_t *);
   SF_API void sf_mutex_unlock (sfmutex_t *);
 
+  SF_API int sf_thread_new (sfthread_t *, void *(*) (void *), void *);
+  SF_API void sf_thread_join (sfthread_t *);
+  SF_API int sf_thread_ncpu (void);
+
 #if defined(__cplusplus)
 }
 #endif // __cplusplus
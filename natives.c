@@ -1,5 +1,7 @@
 #include "natives.h"
 
+#include <limits.h>
+
 SF_API obj_t *
 sf_native_putln (obj_t *v)
 {
@@ -74,6 +76,467 @@ sf_native_write (obj_t **vals, size_t vl)
   return NULL;
 }
 
+static tarray_t *
+tarray_conv (int type, obj_t *v)
+{
+  tarray_t *t = NULL;
+
+  switch (v->type)
+    {
+    case OBJ_CONST:
+      {
+        if (v->v.o_const.v.type != CONST_INT || v->v.o_const.v.v.c_int.v < 0)
+          break;
+
+        t = sf_tarray_new (type, v->v.o_const.v.v.c_int.v);
+      }
+      break;
+
+    case OBJ_ARRAY:
+      {
+        array_t *a = v->v.o_array.v;
+        t = sf_tarray_new (type, a->len);
+
+        for (size_t i = 0; i < a->len; i++)
+          {
+            if (a->vals[i]->type != OBJ_CONST)
+              {
+                printf ("cannot store non-numeric value in %s array.\n",
+                        sf_tarray_typename (type));
+                exit (EXIT_FAILURE);
+              }
+
+            sf_tarray_set (t, i, a->vals[i]->v.o_const.v);
+          }
+      }
+      break;
+
+    case OBJ_TARRAY:
+      {
+        tarray_t *p = v->v.o_tarray.v;
+        t = sf_tarray_new (type, p->len);
+
+        for (size_t i = 0; i < p->len; i++)
+          sf_tarray_copyel (t, i, p, i);
+      }
+      break;
+
+    case OBJ_VIEW:
+      {
+        view_t *w = v->v.o_view.v;
+        t = sf_tarray_new (type, w->len);
+
+        for (size_t i = 0; i < w->len; i++)
+          {
+            size_t j = sf_view_idx (w, i);
+
+            if (w->parent->type == OBJ_TARRAY)
+              {
+                sf_tarray_copyel (t, i, w->parent->v.o_tarray.v, j);
+                continue;
+              }
+
+            obj_t *e = w->parent->v.o_array.v->vals[j];
+
+            if (e->type != OBJ_CONST)
+              {
+                printf ("cannot store non-numeric value in %s array.\n",
+                        sf_tarray_typename (type));
+                exit (EXIT_FAILURE);
+              }
+
+            sf_tarray_set (t, i, e->v.o_const.v);
+          }
+      }
+      break;
+
+    default:
+      break;
+    }
+
+  return t;
+}
+
+static obj_t *
+tarray_box (tarray_t *t)
+{
+  obj_t *o = sf_objstore_req ();
+  o->type = OBJ_TARRAY;
+  o->v.o_tarray.v = t;
+
+  IR (o);
+  return o;
+}
+
+static obj_t *
+tarray_from (int type, obj_t *v)
+{
+  tarray_t *t = tarray_conv (type, v);
+
+  if (t == NULL)
+    {
+      printf ("%sarray() expects a length, an array or a typed array.\n",
+              sf_tarray_typename (type));
+      exit (EXIT_FAILURE);
+    }
+
+  return tarray_box (t);
+}
+
+SF_API obj_t *
+sf_native_i32array (obj_t *v)
+{
+  return tarray_from (TARRAY_I32, v);
+}
+
+SF_API obj_t *
+sf_native_i64array (obj_t *v)
+{
+  return tarray_from (TARRAY_I64, v);
+}
+
+SF_API obj_t *
+sf_native_f64array (obj_t *v)
+{
+  return tarray_from (TARRAY_F64, v);
+}
+
+SF_API obj_t *
+sf_native_len (obj_t *v)
+{
+  int l = 0;
+
+  switch (v->type)
+    {
+    case OBJ_ARRAY:
+      l = v->v.o_array.v->len;
+      break;
+
+    case OBJ_TARRAY:
+      l = v->v.o_tarray.v->len;
+      break;
+
+    case OBJ_VIEW:
+      l = v->v.o_view.v->len;
+      break;
+
+    case OBJ_DICT:
+      l = v->v.o_dict.v->len;
+      break;
+
+    case OBJ_CONST:
+      {
+        if (v->v.o_const.v.type == CONST_STRING)
+          {
+            l = strlen (v->v.o_const.v.v.c_str.v);
+            break;
+          }
+      }
+      /* fallthrough */
+
+    default:
+      printf ("object has no len().\n");
+      exit (EXIT_FAILURE);
+    }
+
+  obj_t *o = sf_objstore_box (
+      (const_t *)(const_t[]){ { .type = CONST_INT, .v.c_int.v = l } });
+
+  IR (o);
+  return o;
+}
+
+static dict_t *
+dict_arg (obj_t *v, const char *fn)
+{
+  if (v->type != OBJ_DICT)
+    {
+      printf ("%s() expects a dict.\n", fn);
+      exit (EXIT_FAILURE);
+    }
+
+  return v->v.o_dict.v;
+}
+
+SF_API obj_t *
+sf_native_has (obj_t *d, obj_t *k)
+{
+  const_t c = { .type = CONST_BOOL };
+  c.v.c_bool.v = sf_dict_get (dict_arg (d, "has"), k) != NULL;
+
+  obj_t *o = sf_objstore_box (&c);
+  IR (o);
+  return o;
+}
+
+/**
+ * Removes k and returns its value, none if it was not there. The key
+ * the dict drops is k itself, which the caller still holds, or a
+ * number, string or function, so releasing it runs no destructor and
+ * needs no VM.
+ */
+SF_API obj_t *
+sf_native_del (obj_t *d, obj_t *k)
+{
+  /* NULL makes the call give none */
+  return sf_dict_del (dict_arg (d, "del"), k, NULL);
+}
+
+/**
+ * Kernel operands. Typed arrays and unit-stride views of them are used
+ * in place, anything else gets a temporary contiguous copy (plain arrays
+ * become i64, or f64 if any element is a float). The caller releases the
+ * result with vec_release.
+ */
+static tarray_t *
+vec_arg (obj_t *v, const char *fn)
+{
+  obj_t *src = v;
+
+  if (v->type == OBJ_TARRAY)
+    return v->v.o_tarray.v;
+
+  if (v->type == OBJ_VIEW)
+    {
+      tarray_t *t = sf_view_tarray (v->v.o_view.v);
+
+      if (t != NULL)
+        return t;
+
+      src = v->v.o_view.v->parent;
+
+      if (src->type == OBJ_TARRAY)
+        return tarray_conv (src->v.o_tarray.v->type, v);
+    }
+
+  if (src->type == OBJ_ARRAY)
+    {
+      array_t *a = src->v.o_array.v;
+      int type = TARRAY_I64;
+
+      for (size_t i = 0; i < a->len; i++)
+        if (a->vals[i]->type == OBJ_CONST
+            && a->vals[i]->v.o_const.v.type == CONST_FLOAT)
+          type = TARRAY_F64;
+
+      return tarray_conv (type, v);
+    }
+
+  printf ("%s() expects an array.\n", fn);
+  exit (EXIT_FAILURE);
+}
+
+static void
+vec_release (obj_t *v, tarray_t *t)
+{
+  if (v->type != OBJ_TARRAY)
+    sf_tarray_free (t);
+}
+
+static obj_t *
+vec_const (const_t c)
+{
+  obj_t *o = sf_objstore_box (&c);
+
+  IR (o);
+  return o;
+}
+
+static const_t
+vec_operand (obj_t *v, const char *fn)
+{
+  if (v->type != OBJ_CONST)
+    {
+      printf ("%s() expects a number.\n", fn);
+      exit (EXIT_FAILURE);
+    }
+
+  return v->v.o_const.v;
+}
+
+static int
+vec_pred (obj_t *v, const char *fn)
+{
+  int cmp = -1;
+
+  if (v->type == OBJ_CONST && v->v.o_const.v.type == CONST_STRING)
+    cmp = sf_vec_cmp_fromstr (v->v.o_const.v.v.c_str.v);
+
+  if (cmp == -1)
+    {
+      printf ("%s() expects one of \"<\", \"<=\", \">\", \">=\", \"==\", "
+              "\"!=\".\n",
+              fn);
+      exit (EXIT_FAILURE);
+    }
+
+  return cmp;
+}
+
+SF_API obj_t *
+sf_native_sum (obj_t *v)
+{
+  tarray_t *t = vec_arg (v, "sum");
+  const_t r = sf_vec_sum (t);
+
+  vec_release (v, t);
+  return vec_const (r);
+}
+
+SF_API obj_t *
+sf_native_min (obj_t *v)
+{
+  tarray_t *t = vec_arg (v, "min");
+  const_t r = sf_vec_min (t);
+
+  vec_release (v, t);
+  return vec_const (r);
+}
+
+SF_API obj_t *
+sf_native_max (obj_t *v)
+{
+  tarray_t *t = vec_arg (v, "max");
+  const_t r = sf_vec_max (t);
+
+  vec_release (v, t);
+  return vec_const (r);
+}
+
+SF_API obj_t *
+sf_native_dot (obj_t *a, obj_t *b)
+{
+  tarray_t *x = vec_arg (a, "dot");
+  tarray_t *y = vec_arg (b, "dot");
+  const_t r = sf_vec_dot (x, y);
+
+  vec_release (a, x);
+  vec_release (b, y);
+  return vec_const (r);
+}
+
+static obj_t *
+vec_arith (int op, obj_t *a, obj_t *b, const char *fn)
+{
+  tarray_t *x = vec_arg (a, fn);
+  tarray_t *r;
+
+  if (b->type == OBJ_ARRAY || b->type == OBJ_TARRAY || b->type == OBJ_VIEW)
+    {
+      tarray_t *y = vec_arg (b, fn);
+      r = sf_vec_elementwise (op, x, y);
+      vec_release (b, y);
+    }
+  else
+    r = sf_vec_scalar (op, x, vec_operand (b, fn));
+
+  vec_release (a, x);
+  return tarray_box (r);
+}
+
+SF_API obj_t *
+sf_native_add (obj_t *a, obj_t *b)
+{
+  return vec_arith (VEC_ADD, a, b, "add");
+}
+
+SF_API obj_t *
+sf_native_mul (obj_t *a, obj_t *b)
+{
+  return vec_arith (VEC_MUL, a, b, "mul");
+}
+
+SF_API obj_t *
+sf_native_count (obj_t *a, obj_t *op, obj_t *k)
+{
+  tarray_t *t = vec_arg (a, "count");
+  size_t c = sf_vec_count (t, vec_pred (op, "count"),
+                           vec_operand (k, "count"));
+
+  if (c > INT_MAX)
+    {
+      printf ("array kernel result %zu does not fit in an int.\n", c);
+      exit (EXIT_FAILURE);
+    }
+
+  vec_release (a, t);
+  return vec_const ((const_t){ .type = CONST_INT, .v.c_int.v = (int)c });
+}
+
+SF_API obj_t *
+sf_native_filter (obj_t *a, obj_t *op, obj_t *k)
+{
+  tarray_t *t = vec_arg (a, "filter");
+  tarray_t *r = sf_vec_filter (t, vec_pred (op, "filter"),
+                               vec_operand (k, "filter"));
+
+  vec_release (a, t);
+  return tarray_box (r);
+}
+
+/* the next global slot goes to name in the outermost codegen scope */
+static void
+natives_bind (vm_t *vm, const char *name)
+{
+  sf_scope_add (&vm->scopes[vm->scl - 1], &vm->cg_arena,
+                sf_intern (name, strlen (name)),
+                (vval_t){ .pos = vm->meta.g_slot, .slot = SF_VM_SLOT_GLOBAL });
+}
+
+static void
+natives_add (vm_t *vm, const char *name, fun_t *f)
+{
+  obj_t *o = sf_objstore_req ();
+  o->type = OBJ_FUNC;
+  o->v.o_fun.v = f;
+
+  IR (o);
+
+  natives_bind (vm, name);
+  vm->globals[vm->meta.g_slot++] = o;
+}
+
+static void
+natives_add_onearg (vm_t *vm, const char *name, obj_t *(*fn) (obj_t *))
+{
+  fun_t *f = sf_fun_new (FUN_NATIVE);
+  sf_fun_addarg (f, "a");
+  f->v.native.nf_type = NF_ARG_1;
+  f->v.native.v.f_onearg = fn;
+  f->v.native.scc = 0;
+
+  natives_add (vm, name, f);
+}
+
+static void
+natives_add_twoarg (vm_t *vm, const char *name,
+                    obj_t *(*fn) (obj_t *, obj_t *))
+{
+  fun_t *f = sf_fun_new (FUN_NATIVE);
+  sf_fun_addarg (f, "a");
+  sf_fun_addarg (f, "b");
+  f->v.native.nf_type = NF_ARG_2;
+  f->v.native.v.f_twoarg = fn;
+  f->v.native.scc = 0;
+
+  natives_add (vm, name, f);
+}
+
+static void
+natives_add_threearg (vm_t *vm, const char *name,
+                      obj_t *(*fn) (obj_t *, obj_t *, obj_t *))
+{
+  fun_t *f = sf_fun_new (FUN_NATIVE);
+  sf_fun_addarg (f, "a");
+  sf_fun_addarg (f, "b");
+  sf_fun_addarg (f, "c");
+  f->v.native.nf_type = NF_ARG_3;
+  f->v.native.v.f_threearg = fn;
+  f->v.native.scc = 0;
+
+  natives_add (vm, name, f);
+}
+
 SF_API void
 sf_natives_add_tovm (vm_t *vm)
 {
@@ -90,10 +553,7 @@ sf_natives_add_tovm (vm_t *vm)
 
     IR (putln_o);
 
-    vval_t *s = SFMALLOC (sizeof (*s));
-    s->pos = vm->meta.g_slot;
-    s->slot = SF_VM_SLOT_GLOBAL;
-    sf_ht_insert (vm->hts[vm->htl - 1], "putln", (void *)s);
+    natives_bind (vm, "putln");
     vm->globals[vm->meta.g_slot++] = putln_o;
   }
 
@@ -110,10 +570,25 @@ sf_natives_add_tovm (vm_t *vm)
 
     IR (put_o);
 
-    vval_t *s = SFMALLOC (sizeof (*s));
-    s->pos = vm->meta.g_slot;
-    s->slot = SF_VM_SLOT_GLOBAL;
-    sf_ht_insert (vm->hts[vm->htl - 1], "put", (void *)s);
+    natives_bind (vm, "put");
     vm->globals[vm->meta.g_slot++] = put_o;
   }
+
+  natives_add_onearg (vm, "i32array", sf_native_i32array);
+  natives_add_onearg (vm, "i64array", sf_native_i64array);
+  natives_add_onearg (vm, "f64array", sf_native_f64array);
+  natives_add_onearg (vm, "len", sf_native_len);
+
+  natives_add_twoarg (vm, "has", sf_native_has);
+  natives_add_twoarg (vm, "del", sf_native_del);
+
+  sf_vec_init ();
+  natives_add_onearg (vm, "sum", sf_native_sum);
+  natives_add_onearg (vm, "min", sf_native_min);
+  natives_add_onearg (vm, "max", sf_native_max);
+  natives_add_twoarg (vm, "dot", sf_native_dot);
+  natives_add_twoarg (vm, "add", sf_native_add);
+  natives_add_twoarg (vm, "mul", sf_native_mul);
+  natives_add_threearg (vm, "count", sf_native_count);
+  natives_add_threearg (vm, "filter", sf_native_filter);
 }
\ No newline at end of file
@@ -2,8 +2,10 @@
 #define NATIVES_H
 
 #include "bytecode.h"
+#include "intern.h"
 #include "header.h"
 #include "malloc.h"
+#include "vec.h"
 
 #if defined(__cplusplus)
 extern "C"
@@ -16,6 +18,22 @@ extern "C"
   SF_API obj_t *sf_native_put (obj_t *);
   SF_API obj_t *sf_native_write (obj_t **, size_t);
 
+  SF_API obj_t *sf_native_i32array (obj_t *);
+  SF_API obj_t *sf_native_i64array (obj_t *);
+  SF_API obj_t *sf_native_f64array (obj_t *);
+  SF_API obj_t *sf_native_len (obj_t *);
+  SF_API obj_t *sf_native_has (obj_t *, obj_t *);
+  SF_API obj_t *sf_native_del (obj_t *, obj_t *);
+
+  SF_API obj_t *sf_native_sum (obj_t *);
+  SF_API obj_t *sf_native_min (obj_t *);
+  SF_API obj_t *sf_native_max (obj_t *);
+  SF_API obj_t *sf_native_dot (obj_t *, obj_t *);
+  SF_API obj_t *sf_native_add (obj_t *, obj_t *);
+  SF_API obj_t *sf_native_mul (obj_t *, obj_t *);
+  SF_API obj_t *sf_native_count (obj_t *, obj_t *, obj_t *);
+  SF_API obj_t *sf_native_filter (obj_t *, obj_t *, obj_t *);
+
 #if defined(__cplusplus)
 }
 #endif // __cplusplus
@@ -11,7 +11,7 @@ static int64_t *os_freeidxs = NULL;
 size_t osfic = OBJSTORE_CAP;
 size_t osfil = 0;
 
-static sfmutex_t m1;
+static sfmutex_t m1 = SF_MUTEX_INIT;
 
 static void
 objstore_resize ()
@@ -97,6 +97,7 @@ sf_objstore_req ()
         *rr = SFMALLOC (sizeof (**rr));
 
       r = *rr;
+      r->meta.ref_count = 0;
       r->meta.active = 1;
       r->meta.index = osl - 1;
     }
@@ -104,6 +105,7 @@ sf_objstore_req ()
     {
       int64_t i = os_freeidxs[--osfil];
       r = objstore[i];
+      r->meta.ref_count = 0;
       r->meta.active = 1;
       r->meta.index = i;
     }
@@ -174,6 +176,24 @@ sf_obj_free (obj_t *o, vm_t *vm)
       SFFREE (a);
     }
 
+  if (o->type == OBJ_TARRAY)
+    {
+      sf_tarray_free (o->v.o_tarray.v);
+      o->v.o_tarray.v = NULL;
+    }
+
+  if (o->type == OBJ_VIEW)
+    {
+      sf_view_free (o->v.o_view.v, vm);
+      o->v.o_view.v = NULL;
+    }
+
+  if (o->type == OBJ_DICT)
+    {
+      sf_dict_free (o->v.o_dict.v, vm);
+      o->v.o_dict.v = NULL;
+    }
+
   if (o->type == OBJ_ITER)
     {
       DR (o->v.o_iter.v.o, vm);
@@ -186,7 +206,9 @@ sf_obj_free (obj_t *o, vm_t *vm)
       for (int i = 0; i < mo->svl; i++)
         {
           SFFREE (mo->slots[i]);
-          DR (mo->vals[i], vm);
+
+          if (mo->vals[i] != NULL)
+            DR (mo->vals[i], vm);
         }
 
       SFFREE (mo->slots);
@@ -205,7 +227,7 @@ sf_obj_free (obj_t *o, vm_t *vm)
         {
           if (c->vals != NULL)
             {
-              for (size_t i = 0; i < c->svc; i++)
+              for (size_t i = 0; i < c->svl; i++)
                 {
                   if (c->vals[i] != NULL)
                     {
@@ -278,7 +300,7 @@ sf_obj_free (obj_t *o, vm_t *vm)
             {
               if (c->vals != NULL)
                 {
-                  for (size_t i = 0; i < c->svc; i++)
+                  for (size_t i = 0; i < c->svl; i++)
                     {
                       if (c->vals[i] != NULL)
                         {
@@ -372,6 +394,31 @@ sf_objstore_req_forconst (const_t *c)
   return NULL;
 }
 
+SF_API obj_t *
+sf_objstore_box (const_t *c)
+{
+  obj_t *o = sf_objstore_req_forconst (c);
+
+  if (o == NULL)
+    {
+      o = sf_objstore_req ();
+      o->type = OBJ_CONST;
+      o->v.o_const.v = *c;
+    }
+
+  return o;
+}
+
+static void
+tarray_print_at (tarray_t *t, size_t i)
+{
+  if (t->type == TARRAY_F64)
+    printf ("%f", t->v.f64[i]);
+  else
+    printf ("%lld", (long long)(t->type == TARRAY_I32 ? t->v.i32[i]
+                                                       : t->v.i64[i]));
+}
+
 SF_API void
 sf_obj_print (obj_t o)
 {
@@ -434,6 +481,65 @@ sf_obj_print (obj_t o)
       }
       break;
 
+    case OBJ_TARRAY:
+      {
+        tarray_t *t = o.v.o_tarray.v;
+
+        putchar ('[');
+        for (size_t i = 0; i < t->len; i++)
+          {
+            tarray_print_at (t, i);
+
+            if (i != t->len - 1)
+              fprintf (stdout, ", ");
+          }
+        putchar (']');
+      }
+      break;
+
+    case OBJ_DICT:
+      {
+        dict_t *d = o.v.o_dict.v;
+        size_t n = 0;
+
+        putchar ('{');
+        for (size_t i = 0; i < d->el; i++)
+          {
+            if (d->ents[i].key == NULL)
+              continue;
+
+            sf_obj_print (*d->ents[i].key);
+            fprintf (stdout, ": ");
+            sf_obj_print (*d->ents[i].val);
+
+            if (++n != d->len)
+              fprintf (stdout, ", ");
+          }
+        putchar ('}');
+      }
+      break;
+
+    case OBJ_VIEW:
+      {
+        view_t *v = o.v.o_view.v;
+
+        putchar ('[');
+        for (size_t i = 0; i < v->len; i++)
+          {
+            size_t j = sf_view_idx (v, i);
+
+            if (v->parent->type == OBJ_TARRAY)
+              tarray_print_at (v->parent->v.o_tarray.v, j);
+            else
+              sf_obj_print (*v->parent->v.o_array.v->vals[j]);
+
+            if (i != v->len - 1)
+              fprintf (stdout, ", ");
+          }
+        putchar (']');
+      }
+      break;
+
     case OBJ_HFF:
       D (printf ("[hff]"));
       sf_obj_print (*o.v.o_hff.f);
@@ -498,6 +604,18 @@ sf_obj_isfalse (obj_t o)
       r = 0;
       break;
 
+    case OBJ_TARRAY:
+      r = o.v.o_tarray.v->len == 0;
+      break;
+
+    case OBJ_VIEW:
+      r = o.v.o_view.v->len == 0;
+      break;
+
+    case OBJ_DICT:
+      r = o.v.o_dict.v->len == 0;
+      break;
+
     default:
       break;
     }
@@ -505,6 +623,75 @@ sf_obj_isfalse (obj_t o)
   return r;
 }
 
+static inline uint64_t
+hash_mix (uint64_t x)
+{
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+
+  return x;
+}
+
+static inline uint64_t
+hash_float (float f)
+{
+  if (f >= -2147483648.0f && f < 2147483648.0f && f == (float)(int)f)
+    return hash_mix ((uint64_t)(int64_t)(int)f);
+
+  uint32_t bits;
+  memcpy (&bits, &f, sizeof (bits));
+
+  return hash_mix (bits ^ 0x9e3779b97f4a7c15ULL);
+}
+
+/**
+ * Consistent with sf_obj_eqeq: 1 and 1.0 hash alike, objects by
+ * identity. An int equals a float when it converts to that float, so
+ * ints hash by their float too: ints past 2^24 that round to the same
+ * float, like 16777217 and 16777216, share a hash.
+ */
+SF_API uint64_t
+sf_obj_hash (obj_t *o)
+{
+  if (o->type != OBJ_CONST)
+    return hash_mix ((uint64_t)(uintptr_t)o);
+
+  const_t *c = &o->v.o_const.v;
+
+  switch (c->type)
+    {
+    case CONST_INT:
+      return hash_float ((float)c->v.c_int.v);
+
+    case CONST_FLOAT:
+      return hash_float (c->v.c_float.v);
+
+    case CONST_BOOL:
+      return hash_mix (0x2545f4914f6cdd1dULL + !!c->v.c_bool.v);
+
+    case CONST_STRING:
+      {
+        uint64_t h = 14695981039346656037ULL;
+
+        for (const char *s = c->v.c_str.v; *s; s++)
+          {
+            h ^= (unsigned char)*s;
+            h *= 1099511628211ULL;
+          }
+
+        return h;
+      }
+
+    default:
+      break;
+    }
+
+  return 0x9e3779b97f4a7c15ULL;
+}
+
 SF_API int
 sf_obj_eqeq (obj_t *o, obj_t *p)
 {
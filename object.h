@@ -4,12 +4,15 @@
 #include "array.h"
 #include "cl.h"
 #include "const.h"
+#include "dict.h"
 #include "fun.h"
 #include "header.h"
 #include "iter.h"
 #include "malloc.h"
 #include "mod.h"
 #include "mut.h"
+#include "tarray.h"
+#include "view.h"
 
 struct _vm_s;
 
@@ -26,6 +29,9 @@ enum ObjectType
   OBJ_MODHF = 8,    /* function in a module */
   OBJ_MODHC = 9,    /* class in a module */
   OBJ_MODWRAP = 10, /* wrapped in a mod frame */
+  OBJ_TARRAY = 11,  /* unboxed numeric array */
+  OBJ_VIEW = 12,    /* slice of an array, shares its storage */
+  OBJ_DICT = 13,
 };
 
 typedef struct object_s
@@ -78,6 +84,24 @@ typedef struct object_s
 
     } o_iter;
 
+    struct
+    {
+      tarray_t *v;
+
+    } o_tarray;
+
+    struct
+    {
+      view_t *v;
+
+    } o_view;
+
+    struct
+    {
+      dict_t *v;
+
+    } o_dict;
+
     struct
     {
       mod_t *v;
@@ -135,6 +159,7 @@ extern "C"
   SF_API void sf_objstore_init ();
   SF_API obj_t *sf_objstore_req ();
   SF_API obj_t *sf_objstore_req_forconst (const_t *);
+  SF_API obj_t *sf_objstore_box (const_t *);
 
   SF_API obj_t sf_objnew (int);
   SF_API void sf_obj_rc_inc (obj_t *);
@@ -145,6 +170,7 @@ extern "C"
 
   SF_API int sf_obj_isfalse (obj_t);
 
+  SF_API uint64_t sf_obj_hash (obj_t *);
   SF_API int sf_obj_eqeq (obj_t *, obj_t *);
   SF_API int sf_obj_neq (obj_t *, obj_t *);
   SF_API int sf_obj_le (obj_t *, obj_t *);
@@ -0,0 +1,1899 @@
+#include "opt.h"
+
+typedef struct
+{
+  vm_t *vm;
+  instr_t *in; /* the unit's code, the tail of vm->insts */
+  size_t ip;   /* where it starts in vm->insts */
+  size_t n;
+  size_t n0;   /* as codegen left it */
+
+  unsigned char *del; /* dropped by the next compact () */
+  unsigned char *tgt; /* some op refers to it by ip */
+  size_t *map;        /* n + 1 entries of scratch */
+
+} opt_unit_t;
+
+/* replaces the unit's code with the n instructions of in */
+static void
+unit_set (opt_unit_t *u, const instr_t *in, size_t n)
+{
+  vm_t *vm = u->vm;
+
+  if (u->ip + n > vm->inst_cap)
+    {
+      vm->inst_cap = u->ip + n;
+      vm->insts = SFREALLOC (vm->insts, vm->inst_cap * sizeof (*vm->insts));
+    }
+
+  u->in = vm->insts + u->ip;
+  memcpy (u->in, in, n * sizeof (*in));
+  u->n = n;
+  vm->inst_len = u->ip + n;
+
+  u->del = SFREALLOC (u->del, 2 * n);
+  u->tgt = u->del + n;
+  u->map = SFREALLOC (u->map, (n + 1) * sizeof (*u->map));
+  memset (u->del, 0, n);
+}
+
+static inline size_t
+off (opt_unit_t *u, instr_t in)
+{
+  return (size_t)in.a - u->ip;
+}
+
+static void
+mark_targets (opt_unit_t *u)
+{
+  memset (u->tgt, 0, u->n);
+
+  for (size_t i = 0; i < u->n; i++)
+    if (SF_OP_HAS_IP (u->in[i].op))
+      u->tgt[off (u, u->in[i])] = 1;
+}
+
+/**
+ * Drops the instructions marked in del. A jump to one of them lands on
+ * the next one kept; the unit's last instruction, its RETURN, always
+ * stays, so there is one.
+ */
+static void
+compact (opt_unit_t *u)
+{
+  size_t j = 0;
+
+  assert (!u->del[u->n - 1]);
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      u->map[i] = j;
+      j += !u->del[i];
+    }
+
+  if (j == u->n)
+    return;
+
+  j = 0;
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      instr_t in = u->in[i];
+
+      if (u->del[i])
+        continue;
+
+      if (SF_OP_HAS_IP (in.op))
+        in.a = u->ip + u->map[off (u, in)];
+
+      u->in[j++] = in;
+    }
+
+  memset (u->del, 0, u->n);
+  u->n = j;
+  u->vm->inst_len = u->ip + j;
+}
+
+/* ops [at, at + n) of a unit to be replaced by the len of in */
+typedef struct
+{
+  size_t at, n;
+  instr_t *in; /* its jumps are from the start of in */
+  size_t len;
+
+} edit_t;
+
+/**
+ * Applies the edits ed, sorted by at and apart from each other. A jump
+ * to an op an edit replaces lands at the start of what replaced it.
+ */
+static void
+splice (opt_unit_t *u, const edit_t *ed, size_t ne)
+{
+  size_t nn = 0;
+
+  for (size_t i = 0, e = 0; i < u->n; i++)
+    {
+      u->map[i] = nn;
+
+      if (e < ne && ed[e].at == i)
+        {
+          for (size_t j = 1; j < ed[e].n; j++)
+            u->map[i + j] = nn;
+
+          nn += ed[e].len;
+          i += ed[e].n - 1;
+          e++;
+        }
+      else
+        nn++;
+    }
+
+  u->map[u->n] = nn;
+
+  instr_t *out = SFMALLOC (nn * sizeof (*out));
+
+  for (size_t i = 0, e = 0; i < u->n; i++)
+    {
+      instr_t in = u->in[i];
+
+      if (e < ne && ed[e].at == i)
+        {
+          for (size_t j = 0, o = u->map[i]; j < ed[e].len; j++)
+            {
+              in = ed[e].in[j];
+
+              if (SF_OP_HAS_IP (in.op))
+                in.a += (int)(u->ip + o);
+
+              out[o + j] = in;
+            }
+
+          i += ed[e].n - 1;
+          e++;
+          continue;
+        }
+
+      if (SF_OP_HAS_IP (in.op))
+        in.a = u->ip + u->map[off (u, in)];
+
+      out[u->map[i]] = in;
+    }
+
+  unit_set (u, out, nn);
+  SFFREE (out);
+}
+
+static int
+edit_cmp (const void *a, const void *b)
+{
+  size_t x = ((const edit_t *)a)->at, y = ((const edit_t *)b)->at;
+
+  return (x > y) - (x < y);
+}
+
+/* 1 or 0 as OP_JUMP_IF_FALSE would see c, -1 if it is not a constant */
+static int
+const_truth (const_t c)
+{
+  switch (c.type)
+    {
+    case CONST_INT:
+      return c.v.c_int.v != 0;
+    case CONST_FLOAT:
+      return c.v.c_float.v != 0.0f;
+    case CONST_BOOL:
+      return c.v.c_bool.v != 0;
+    case CONST_NONE:
+      return 0;
+    case CONST_STRING:
+      return c.v.c_str.v[0] != '\0';
+    default:
+      return -1;
+    }
+}
+
+/* whether st writes the variable ld reads, in the same frame */
+static int
+same_var (instr_t ld, instr_t st)
+{
+  if (ld.a != st.a)
+    return 0;
+
+  switch (ld.op)
+    {
+    case OP_LOAD:
+      return st.op == OP_STORE;
+    case OP_LOAD_FAST:
+      return ld.b == 0 && st.op == OP_STORE_FAST;
+    case OP_LOAD_NAME:
+      return ld.b == 0 && st.op == OP_STORE_NAME && st.b == 0;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * LOAD_CONST; JUMP_IF_FALSE becomes a JUMP when the constant is false
+ * and goes away when it is true, as for `while 1` and `if 0`.
+ */
+static size_t
+pass_constbr (opt_unit_t *u)
+{
+  size_t c = 0;
+
+  mark_targets (u);
+
+  for (size_t i = 0; i + 1 < u->n; i++)
+    {
+      instr_t *in = &u->in[i];
+
+      if (in[0].op != OP_LOAD_CONST || in[1].op != OP_JUMP_IF_FALSE
+          || u->tgt[i + 1])
+        continue;
+
+      int t = const_truth (u->vm->map_consts[in[0].a]);
+
+      if (t < 0)
+        continue;
+
+      u->del[i] = 1;
+
+      if (t)
+        u->del[i + 1] = 1;
+      else
+        in[1] = (instr_t){ .op = OP_JUMP, .a = in[1].a, .b = 0 };
+
+      c++;
+      i++;
+    }
+
+  return c;
+}
+
+/* where a jump to o ends up once it has gone through plain jumps */
+static size_t
+jump_dest (opt_unit_t *u, size_t o)
+{
+  for (size_t hops = 0; u->in[o].op == OP_JUMP && hops < u->n; hops++)
+    o = off (u, u->in[o]);
+
+  return o;
+}
+
+/**
+ * Branches that land on a JUMP go straight to its target, a JUMP that
+ * lands on a RETURN becomes that RETURN and a JUMP to the next op goes.
+ */
+static size_t
+pass_thread (opt_unit_t *u)
+{
+  size_t c = 0;
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      instr_t *in = &u->in[i];
+
+      if (in->op != OP_JUMP && in->op != OP_JUMP_IF_FALSE
+          && in->op != OP_CMP_JUMP && in->op != OP_LOAD_ITER_NEXT)
+        continue;
+
+      size_t t = jump_dest (u, off (u, *in));
+
+      if (t != off (u, *in))
+        {
+          in->a = u->ip + t;
+          c++;
+        }
+
+      if (in->op != OP_JUMP)
+        continue;
+
+      if (u->in[t].op == OP_RETURN)
+        {
+          *in = u->in[t];
+          c++;
+        }
+      else if (t == i + 1)
+        {
+          u->del[i] = 1;
+          c++;
+        }
+    }
+
+  return c;
+}
+
+/* what follows a JUMP or RETURN up to the next jump target */
+static size_t
+pass_dead (opt_unit_t *u)
+{
+  size_t c = 0;
+
+  mark_targets (u);
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      if (u->in[i].op != OP_JUMP && u->in[i].op != OP_RETURN)
+        continue;
+
+      size_t j = i + 1;
+
+      for (; j + 1 < u->n && !u->tgt[j]; j++)
+        {
+          u->del[j] = 1;
+          c++;
+        }
+
+      i = j - 1;
+    }
+
+  return c;
+}
+
+/**
+ * Everything no path from the unit's start reaches. Function bodies are
+ * reached from their OP_LOAD_FUNC_CODED and class ends from their
+ * OP_LOAD_BUILDCLASS, so whole functions go when nothing defines them.
+ */
+static size_t
+pass_unreach (opt_unit_t *u)
+{
+  unsigned char *r = u->tgt;
+  size_t *wl = u->map, wn = 0, c = 0;
+
+  memset (r, 0, u->n);
+  wl[wn++] = 0;
+
+  while (wn)
+    {
+      for (size_t i = wl[--wn]; i < u->n && !r[i]; i++)
+        {
+          instr_t in = u->in[i];
+          r[i] = 1;
+
+          if (SF_OP_HAS_IP (in.op) && in.op != OP_LOAD_BUILDCLASS_END
+              && !r[off (u, in)])
+            wl[wn++] = off (u, in);
+
+          if (in.op == OP_JUMP || in.op == OP_RETURN)
+            break;
+        }
+    }
+
+  r[u->n - 1] = 1;
+
+  for (size_t i = 0; i < u->n; i++)
+    if (!r[i])
+      {
+        u->del[i] = 1;
+        c++;
+      }
+
+  return c;
+}
+
+/* LOAD x; STORE x stores what was there */
+static size_t
+pass_loadstore (opt_unit_t *u)
+{
+  size_t c = 0;
+
+  mark_targets (u);
+
+  for (size_t i = 0; i + 1 < u->n; i++)
+    if (same_var (u->in[i], u->in[i + 1]) && !u->tgt[i + 1])
+      {
+        u->del[i] = u->del[i + 1] = 1;
+        c++;
+        i++;
+      }
+
+  return c;
+}
+
+/* STORE x; LOAD x keeps the value on the stack instead */
+static size_t
+pass_dup (opt_unit_t *u)
+{
+  size_t c = 0;
+
+  mark_targets (u);
+
+  for (size_t i = 0; i + 1 < u->n; i++)
+    if (same_var (u->in[i + 1], u->in[i]) && !u->tgt[i + 1])
+      {
+        u->in[i + 1] = u->in[i];
+        u->in[i] = (instr_t){ .op = OP_DUP, .a = 0, .b = 0 };
+        c++;
+        i++;
+      }
+
+  return c;
+}
+
+/* function start -> its LOAD_FUNC_CODED, 0 elsewhere; n + 1 entries */
+static size_t *
+func_ends (opt_unit_t *u)
+{
+  size_t *fend = SFMALLOC ((u->n + 1) * sizeof (*fend));
+
+  memset (fend, 0, (u->n + 1) * sizeof (*fend));
+
+  for (size_t i = 0; i < u->n; i++)
+    if (u->in[i].op == OP_LOAD_FUNC_CODED)
+      fend[off (u, u->in[i])] = i;
+
+  return fend;
+}
+
+/* the next op of the function at k, stepping over nested bodies */
+static size_t
+func_next (opt_unit_t *u, const size_t *fend, size_t k)
+{
+  instr_t in = u->in[k];
+
+  k = in.op == OP_LOAD_BUILDCLASS ? off (u, in) + 1 : k + 1;
+
+  while (fend[k])
+    k = fend[k];
+
+  return k;
+}
+
+/* a value a types block pushed: entry 2k + j of the op at k, -1 if it
+   was there before the block started */
+typedef struct
+{
+  long at;
+  int isint;
+
+} ty_ent_t;
+
+typedef struct
+{
+  opt_unit_t *u;
+  size_t *fend;         /* function start -> its LOAD_FUNC_CODED, or 0 */
+  unsigned char *cand;  /* locals taken to only ever hold ints */
+  size_t nl;
+  unsigned char *raw;   /* 2 per op, its int goes to a typed op */
+  unsigned char *typed; /* the op reads ints */
+  ty_ent_t *st;
+  size_t sl, sc;
+
+} ty_t;
+
+static void
+ty_push (ty_t *t, long at, int isint)
+{
+  if (t->sl == t->sc)
+    {
+      t->sc = t->sc ? t->sc << 1 : 32;
+      t->st = SFREALLOC (t->st, t->sc * sizeof (*t->st));
+    }
+
+  if (at >= 0)
+    t->raw[at] = isint;
+
+  t->st[t->sl++] = (ty_ent_t){ .at = at, .isint = isint };
+}
+
+static ty_ent_t
+ty_pop (ty_t *t)
+{
+  if (!t->sl)
+    return (ty_ent_t){ .at = -1, .isint = 0 };
+
+  return t->st[--t->sl];
+}
+
+/* e goes to an op that wants an object */
+static void
+ty_box (ty_t *t, ty_ent_t e)
+{
+  if (e.isint)
+    t->raw[e.at] = 0;
+}
+
+static void
+ty_flush (ty_t *t)
+{
+  while (t->sl)
+    ty_box (t, ty_pop (t));
+}
+
+static size_t
+ty_next (ty_t *t, size_t k)
+{
+  return func_next (t->u, t->fend, k);
+}
+
+/**
+ * One walk over the function [s, e). Values only stay typed within a
+ * block, what is on the stack at a jump target or goes to an op the
+ * pass does not know is an object. Returns nonzero when a local turned
+ * out not to be an int.
+ */
+static int
+ty_walk (ty_t *t, size_t s, size_t e)
+{
+  opt_unit_t *u = t->u;
+  int changed = 0;
+
+  t->sl = 0;
+
+  for (size_t k = s; k < e; k = ty_next (t, k))
+    {
+      instr_t in = u->in[k];
+      long at = 2 * (long)k;
+
+      t->typed[k] = 0;
+
+      if (u->tgt[k])
+        ty_flush (t);
+
+      switch (in.op)
+        {
+        case OP_LOAD_CONST:
+          ty_push (t, at, u->vm->map_consts[in.a].type == CONST_INT);
+          break;
+
+        case OP_LOAD_FAST:
+          if (in.b != 0)
+            goto generic;
+
+          ty_push (t, at, t->cand[in.a]);
+          break;
+
+        case OP_LOAD:
+          ty_push (t, -1, 0);
+          break;
+
+        case OP_STORE:
+          ty_box (t, ty_pop (t));
+          break;
+
+        case OP_STORE_FAST:
+          {
+            ty_ent_t v = ty_pop (t);
+
+            if (t->cand[in.a] && !v.isint)
+              {
+                t->cand[in.a] = 0;
+                changed = 1;
+              }
+
+            if (!t->cand[in.a])
+              ty_box (t, v);
+          }
+          break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+          {
+            ty_ent_t r = ty_pop (t), l = ty_pop (t);
+
+            t->typed[k] = l.isint && r.isint;
+
+            if (!t->typed[k])
+              {
+                ty_box (t, l);
+                ty_box (t, r);
+              }
+
+            ty_push (t, at, t->typed[k]);
+          }
+          break;
+
+        case OP_ADD_1:
+          {
+            ty_ent_t v = ty_pop (t);
+
+            t->typed[k] = v.isint;
+            ty_push (t, at, v.isint);
+          }
+          break;
+
+        case OP_CMP:
+        case OP_CMP_JUMP:
+          {
+            ty_ent_t r = ty_pop (t), l = ty_pop (t);
+            int type = in.op == OP_CMP ? in.a : in.b;
+
+            /* one int is enough, the other is guarded */
+            t->typed[k] = (l.isint || r.isint) && type >= CMP_EQEQ
+                          && type <= CMP_GEQ;
+
+            if (!t->typed[k])
+              {
+                ty_box (t, l);
+                ty_box (t, r);
+              }
+            else
+              t->typed[k] = 1 | (l.isint ? 0 : SF_CMP_L_OBJ)
+                            | (r.isint ? 0 : SF_CMP_R_OBJ);
+
+            if (in.op == OP_CMP)
+              ty_push (t, at, 0);
+            else
+              ty_flush (t);
+          }
+          break;
+
+        case OP_DUP:
+          {
+            ty_ent_t v = ty_pop (t);
+
+            t->typed[k] = v.isint;
+            ty_push (t, v.isint ? at : v.at, v.isint);
+            ty_push (t, at + 1, v.isint);
+          }
+          break;
+
+        case OP_JUMP_IF_FALSE:
+          ty_box (t, ty_pop (t));
+          ty_flush (t);
+          break;
+
+        default:
+        generic:
+          ty_flush (t);
+          break;
+        }
+    }
+
+  return changed;
+}
+
+/* rewrites the function [s, e) once ty_walk is done with it */
+static size_t
+ty_rewrite (ty_t *t, size_t s, size_t e, const int *slot)
+{
+  opt_unit_t *u = t->u;
+  size_t c = 0;
+
+  for (size_t k = s; k < e; k = ty_next (t, k))
+    {
+      instr_t *in = &u->in[k];
+      int box = !t->raw[2 * k];
+
+      switch (in->op)
+        {
+        case OP_LOAD_CONST:
+          if (box || u->vm->map_consts[in->a].type != CONST_INT)
+            continue;
+
+          *in = (instr_t){ .op = OP_CONST_I,
+                           .a = u->vm->map_consts[in->a].v.c_int.v };
+          break;
+
+        case OP_LOAD_FAST:
+        case OP_STORE_FAST:
+          if (in->op == OP_LOAD_FAST && in->b != 0)
+            continue;
+
+          if (!t->cand[in->a])
+            continue;
+
+          *in = (instr_t){ .op = in->op == OP_LOAD_FAST ? OP_LOAD_I
+                                                        : OP_STORE_I,
+                           .a = slot[in->a],
+                           .b = in->op == OP_LOAD_FAST && box };
+          break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_ADD_1:
+          if (!t->typed[k])
+            continue;
+
+          *in = (instr_t){ .op = in->op == OP_ADD     ? OP_ADD_I
+                                 : in->op == OP_SUB   ? OP_SUB_I
+                                 : in->op == OP_MUL   ? OP_MUL_I
+                                                      : OP_ADD_1_I,
+                           .b = box };
+          break;
+
+        case OP_DUP:
+          if (!t->typed[k])
+            continue;
+
+          *in = (instr_t){ .op = OP_DUP_I,
+                           .b = box | !t->raw[2 * k + 1] << 1 };
+          break;
+
+        case OP_CMP:
+          {
+            if (!t->typed[k])
+              continue;
+
+            int b = in->a | (t->typed[k] & ~1);
+
+            /* and the branch on it, when nothing jumps in between */
+            if (k + 1 < e && in[1].op == OP_JUMP_IF_FALSE && !u->tgt[k + 1])
+              {
+                in[1] = (instr_t){ .op = OP_CMP_JUMP_I, .a = in[1].a, .b = b };
+                u->del[k] = 1;
+              }
+            else
+              *in = (instr_t){ .op = OP_CMP_I, .b = b };
+          }
+          break;
+
+        case OP_CMP_JUMP:
+          if (!t->typed[k])
+            continue;
+
+          *in = (instr_t){ .op = OP_CMP_JUMP_I,
+                           .a = in->a,
+                           .b = in->b | (t->typed[k] & ~1) };
+          break;
+
+        default:
+          continue;
+        }
+
+      c++;
+    }
+
+  return c;
+}
+
+/* where the op at k in a function can go besides the next one, or -1 */
+static long
+ty_jump (opt_unit_t *u, size_t k)
+{
+  instr_t in = u->in[k];
+
+  if (!SF_OP_HAS_IP (in.op) || in.op == OP_LOAD_FUNC_CODED
+      || in.op == OP_LOAD_BUILDCLASS || in.op == OP_LOAD_BUILDCLASS_END)
+    return -1;
+
+  return (long)off (u, in);
+}
+
+/**
+ * Drops the locals of the function [s, e) that some path reads before
+ * storing to them. The interpreter fails on such a read, an int slot
+ * would hand out a 0 instead, so they stay objects.
+ */
+static void
+ty_assigned (ty_t *t, size_t s, size_t e, size_t nl)
+{
+  opt_unit_t *u = t->u;
+  size_t n = e - s;
+  uint64_t *set = SFMALLOC (n * sizeof (*set)); /* stored on every path */
+  unsigned char *seen = SFMALLOC (n);
+  int changed = 1;
+
+  memset (seen, 0, n);
+  set[0] = 0;
+  seen[0] = 1;
+
+  while (changed)
+    {
+      changed = 0;
+
+      for (size_t k = s; k < e; k = ty_next (t, k))
+        {
+          instr_t in = u->in[k];
+          uint64_t out = set[k - s];
+          size_t to[2];
+          int tn = 0;
+
+          if (!seen[k - s])
+            continue;
+
+          if (in.op == OP_STORE_FAST && in.b == 0)
+            out |= UINT64_C (1) << in.a;
+
+          if (in.op != OP_JUMP && in.op != OP_RETURN
+              && in.op != OP_TAIL_CALL)
+            to[tn++] = ty_next (t, k);
+
+          long j = ty_jump (u, k);
+
+          if (j >= 0)
+            to[tn++] = (size_t)j;
+
+          for (int q = 0; q < tn; q++)
+            {
+              size_t d = to[q];
+
+              if (d < s || d >= e)
+                continue;
+
+              if (!seen[d - s])
+                {
+                  seen[d - s] = 1;
+                  set[d - s] = out;
+                  changed = 1;
+                }
+              else if ((set[d - s] & out) != set[d - s])
+                {
+                  set[d - s] &= out;
+                  changed = 1;
+                }
+            }
+        }
+    }
+
+  for (size_t k = s; k < e; k = ty_next (t, k))
+    {
+      instr_t in = u->in[k];
+
+      if (seen[k - s] && in.op == OP_LOAD_FAST && in.b == 0
+          && (size_t)in.a < nl && !(set[k - s] >> in.a & 1))
+        t->cand[in.a] = 0;
+    }
+
+  SFFREE (seen);
+  SFFREE (set);
+}
+
+/* the types pass over the function [s, e) */
+static size_t
+ty_func (ty_t *t, size_t s, size_t e)
+{
+  opt_unit_t *u = t->u;
+  int slot[SF_FRAME_LOCALS_CAP];
+  size_t nl = 0;
+
+  for (size_t k = s; k < e; k = ty_next (t, k))
+    if (u->in[k].op == OP_STORE_FAST || u->in[k].op == OP_LOAD_FAST)
+      nl = (size_t)u->in[k].a + 1 > nl ? (size_t)u->in[k].a + 1 : nl;
+
+  /* more locals than a fresh frame holds is rare, and left alone */
+  if (nl == 0 || nl > SF_FRAME_LOCALS_CAP)
+    return 0;
+
+  memset (t->cand, 0, nl);
+
+  for (size_t k = s; k < e; k = ty_next (t, k))
+    if (u->in[k].op == OP_STORE_FAST)
+      t->cand[u->in[k].a] = 1;
+
+  ty_assigned (t, s, e, nl);
+
+  for (;;)
+    {
+      while (ty_walk (t, s, e))
+        ;
+
+      int n = 0, over = 0;
+
+      for (size_t a = 0; a < nl; a++)
+        if (t->cand[a] && n == SF_FRAME_INTS)
+          {
+            t->cand[a] = 0;
+            over = 1;
+          }
+        else if (t->cand[a])
+          slot[a] = n++;
+
+      if (!over)
+        break;
+    }
+
+  return ty_rewrite (t, s, e, slot);
+}
+
+/**
+ * Locals of coded functions that only ever get ints (constants, other
+ * such locals and int arithmetic on them) move to the frame's int
+ * slots, and the arithmetic, comparisons and branches on them become
+ * typed ops that leave the ints unboxed on the stack. A comparison with
+ * one int operand guards the other. Units where a function reads the
+ * locals of an enclosing one are left alone.
+ */
+static size_t
+pass_types (opt_unit_t *u)
+{
+  ty_t t = { .u = u };
+  size_t c = 0;
+
+  for (size_t i = 0; i < u->n; i++)
+    if (u->in[i].op == OP_LOAD_FAST && u->in[i].b != 0)
+      return 0;
+
+  mark_targets (u);
+
+  t.fend = func_ends (u);
+  t.raw = SFMALLOC (2 * u->n);
+  t.typed = SFMALLOC (u->n);
+  t.cand = SFMALLOC (SF_FRAME_LOCALS_CAP);
+  memset (t.raw, 0, 2 * u->n);
+
+  for (size_t i = 0; i < u->n; i++)
+    if (u->in[i].op == OP_LOAD_FUNC_CODED)
+      c += ty_func (&t, off (u, u->in[i]), i);
+
+  SFFREE (t.st);
+  SFFREE (t.cand);
+  SFFREE (t.typed);
+  SFFREE (t.raw);
+  SFFREE (t.fend);
+
+  return c;
+}
+
+/* a call the inline pass copies its callee into */
+typedef struct
+{
+  size_t at;  /* the LOAD of the callee, or the DOT_ACCESS of a method */
+  size_t fn;  /* the callee's LOAD_FUNC_CODED */
+  int base;   /* its locals in the caller's frame */
+  int nl;     /* how many, a scratch one follows */
+  size_t len; /* what the site becomes */
+
+} il_site_t;
+
+typedef struct
+{
+  opt_unit_t *u;
+  size_t *fend;
+  size_t *gfn; /* global -> the LOAD_FUNC_CODED its only store takes, + 1;
+                  0 with no store, (size_t)-1 with any other */
+  size_t gl;
+  size_t *meth; /* STORE_NAMEs of methods, the only ones of their name */
+  size_t ml;
+
+  il_site_t *sites;
+  size_t sl;
+
+} il_t;
+
+/* the STORE_NAME of the one method called name, its LOAD_FUNC_CODED
+   + 1, or 0 */
+static size_t
+il_method (il_t *t, const char *name)
+{
+  for (size_t m = 0; m < t->ml; m++)
+    if (!strcmp (t->u->in[t->meth[m]].c, name))
+      return t->meth[m];
+
+  return 0;
+}
+
+/**
+ * How long the body of the function defined at fn is once copied into
+ * a call, 0 if it cannot be. The copy runs in the caller's frame, so
+ * the callee defines nothing, touches no names and does not call itself
+ * through me, the op the call gets it with. With need its result has to
+ * come from a return statement. nl gets the locals it uses.
+ */
+static size_t
+il_callee (il_t *t, size_t fn, int need, instr_t me, int *nl)
+{
+  opt_unit_t *u = t->u;
+  size_t argc = u->in[fn].b, b = off (u, u->in[fn]) + argc, len = 0;
+
+  if (fn <= b || fn - b > u->vm->inline_len
+      || u->in[fn - 1].op != OP_RETURN)
+    return 0;
+
+  for (size_t p = 0; p < argc; p++)
+    if (u->in[b - argc + p].op != OP_STORE_FAST
+        || u->in[b - argc + p].a != (int)p)
+      return 0;
+
+  *nl = (int)argc;
+
+  for (size_t k = b; k < fn; k++)
+    {
+      instr_t in = u->in[k];
+
+      switch (in.op)
+        {
+        case OP_LOAD_FUNC_CODED:
+        case OP_LOAD_BUILDCLASS:
+        case OP_LOAD_BUILDCLASS_END:
+        case OP_LOAD_NAME:
+        case OP_STORE_NAME:
+        case OP_IMPORT:
+        case OP_IMPORT_ALIAS:
+        case OP_TAIL_CALL:
+          return 0;
+
+        case OP_LOAD_FAST:
+        case OP_STORE_FAST:
+          *nl = in.a + 1 > *nl ? in.a + 1 : *nl;
+          break;
+
+        case OP_RETURN:
+          /* RETURN 0 pushes None, there is no op for that in a copy */
+          if (in.a != 1 && need
+              && (k == b || u->tgt[k]
+                  || (u->in[k - 1].op != OP_JUMP
+                      && u->in[k - 1].op != OP_RETURN)))
+            return 0;
+
+          len += in.a == 1 && !need;
+          break;
+
+        case OP_LOAD:
+          if (me.op == OP_LOAD && in.a == me.a)
+            return 0;
+          break;
+
+        case OP_DOT_ACCESS:
+          if (me.op == OP_DOT_ACCESS && !strcmp (in.c, me.c))
+            return 0;
+          break;
+
+        default:
+          break;
+        }
+
+      if (SF_OP_HAS_IP (in.op) && (off (u, in) < b || off (u, in) >= fn))
+        return 0;
+    }
+
+  return len + fn - b;
+}
+
+/* whether s is a call in the function caller to inline, growing the
+   unit by no more than room */
+static int
+il_site (il_t *t, il_site_t *s, size_t caller, size_t room)
+{
+  opt_unit_t *u = t->u;
+  instr_t in = u->in[s->at], call = u->in[s->at + 1];
+  size_t argc, bl;
+
+  if (s->at + 1 >= caller || call.op != OP_CALL || u->tgt[s->at + 1])
+    return 0;
+
+  if (in.op == OP_LOAD && (size_t)in.a < t->gl && t->gfn[in.a] != 0
+      && t->gfn[in.a] != (size_t)-1)
+    {
+      s->fn = t->gfn[in.a] - 1;
+      argc = call.a;
+    }
+  else if (in.op == OP_DOT_ACCESS && !u->tgt[s->at]
+           && (s->fn = il_method (t, in.c)) != 0)
+    {
+      s->fn--;
+      argc = call.a + 1;
+    }
+  else
+    return 0;
+
+  if (s->fn == caller || (size_t)u->in[s->fn].b != argc)
+    return 0;
+
+  bl = il_callee (t, s->fn, call.b == 1, in, &s->nl);
+
+  if (!bl || s->base + s->nl + 1 > SF_FRAME_LOCALS_CAP)
+    return 0;
+
+  s->len = 3 + argc + bl;
+  return s->len - 2 <= room;
+}
+
+/**
+ * What site s becomes: the guard, the arguments stored as the callee's
+ * prologue would, its body on locals from s->base with every RETURN a
+ * jump past the site, then the call as it was, for when the guard
+ * fails. Jumps are from the start of the site, as splice () wants.
+ */
+static instr_t *
+il_emit (il_t *t, const il_site_t *s)
+{
+  opt_unit_t *u = t->u;
+  instr_t fn = u->in[s->fn], at = u->in[s->at], call = u->in[s->at + 1];
+  int self = at.op == OP_DOT_ACCESS, need = call.b == 1;
+  size_t argc = fn.b, b = off (u, fn) + argc, o = 0;
+  size_t end = s->len, slow = end - 1 - self;
+  size_t *bm = SFMALLOC ((s->fn - b) * sizeof (*bm));
+  instr_t *out = SFMALLOC (s->len * sizeof (*out));
+
+  if (self)
+    out[o++] = (instr_t){
+      .op = OP_GUARD_METHOD, .a = (int)slow, .b = fn.a, .c = at.c
+    };
+  else
+    {
+      out[o++] = at;
+      out[o++] = (instr_t){ .op = OP_GUARD_FN, .a = (int)slow, .b = fn.a };
+    }
+
+  /* the receiver is on top, then the arguments last to first */
+  if (self)
+    out[o++] = (instr_t){ .op = OP_STORE_FAST, .a = s->base };
+
+  for (size_t p = argc; p-- > (size_t)self;)
+    out[o++] = (instr_t){ .op = OP_STORE_FAST, .a = s->base + (int)p };
+
+  for (size_t k = b, q = o; k < s->fn; k++)
+    {
+      bm[k - b] = q;
+      q += 1 + (u->in[k].op == OP_RETURN && u->in[k].a == 1 && !need);
+    }
+
+  for (size_t k = b; k < s->fn; k++)
+    {
+      instr_t in = u->in[k];
+
+      if (in.op == OP_LOAD_FAST || in.op == OP_STORE_FAST)
+        in.a += s->base;
+      else if (in.op == OP_RETURN)
+        {
+          /* a result the statement call drops goes to the scratch */
+          if (in.a == 1 && !need)
+            out[o++] = (instr_t){ .op = OP_STORE_FAST,
+                                  .a = s->base + s->nl };
+
+          in = (instr_t){ .op = OP_JUMP, .a = (int)end };
+        }
+      else if (SF_OP_HAS_IP (in.op))
+        in.a = (int)bm[off (u, in) - b];
+
+      out[o++] = in;
+    }
+
+  if (self)
+    out[o++] = at;
+
+  out[o++] = call;
+  assert (o == end);
+
+  SFFREE (bm);
+  return out;
+}
+
+static int
+il_site_cmp (const void *a, const void *b)
+{
+  size_t x = ((const il_site_t *)a)->at, y = ((const il_site_t *)b)->at;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * Calls from coded functions to small coded ones whose target is known
+ * get the callee's body in their place: calls to a global only ever
+ * bound to a function of the unit, and method calls by a name only one
+ * class of the unit defines. A guard checks the callee is still that
+ * function, falling back to the call. The copy keeps the callee's
+ * locals alive in the caller's frame, so units that could have
+ * destructors (define `_kill` or import anything) are left alone, as
+ * are units where a function reads the locals of an enclosing one.
+ */
+static size_t
+pass_inline (opt_unit_t *u)
+{
+  il_t t = { .u = u };
+  size_t room, sc = 0;
+
+  if (u->n >= SF_INLINE_GROWTH * u->n0 || u->vm->inline_len == 0)
+    return 0;
+
+  room = SF_INLINE_GROWTH * u->n0 - u->n;
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      instr_t in = u->in[i];
+
+      if ((in.op == OP_LOAD_FAST && in.b != 0) || in.op == OP_IMPORT
+          || in.op == OP_IMPORT_ALIAS
+          || (in.op == OP_STORE_NAME && in.c != NULL
+              && !strcmp (in.c, "_kill")))
+        return 0;
+
+      if ((in.op == OP_LOAD || in.op == OP_STORE) && (size_t)in.a >= t.gl)
+        t.gl = (size_t)in.a + 1;
+    }
+
+  t.gfn = SFMALLOC ((t.gl + 1) * sizeof (*t.gfn));
+  t.meth = SFMALLOC (u->n * sizeof (*t.meth));
+  memset (t.gfn, 0, (t.gl + 1) * sizeof (*t.gfn));
+
+  for (size_t i = 1; i < u->n; i++)
+    {
+      instr_t in = u->in[i];
+      int fn = u->in[i - 1].op == OP_LOAD_FUNC_CODED;
+
+      if (in.op == OP_STORE)
+        t.gfn[in.a] = t.gfn[in.a] == 0 && fn ? i : (size_t)-1;
+      else if (in.op == OP_STORE_NAME && in.b == 0 && in.c != NULL && fn)
+        t.meth[t.ml++] = i;
+    }
+
+  /* nor a method by a name something else defines, attributes of
+     objects are for the guard */
+  size_t w = 0;
+
+  for (size_t m = 0; m < t.ml; m++)
+    {
+      const char *name = u->in[t.meth[m]].c;
+      size_t n = 0;
+
+      for (size_t i = 0; i < u->n; i++)
+        n += u->in[i].op == OP_STORE_NAME && u->in[i].b == 0
+             && u->in[i].c != NULL && !strcmp (u->in[i].c, name);
+
+      if (n == 1)
+        t.meth[w++] = t.meth[m];
+    }
+
+  t.ml = w;
+
+  mark_targets (u);
+  t.fend = func_ends (u);
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      if (u->in[i].op != OP_LOAD_FUNC_CODED)
+        continue;
+
+      size_t s = off (u, u->in[i]);
+      int nl = u->in[i].b;
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        if ((u->in[k].op == OP_LOAD_FAST || u->in[k].op == OP_STORE_FAST)
+            && u->in[k].a + 1 > nl)
+          nl = u->in[k].a + 1;
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        {
+          il_site_t st = { .at = k, .base = nl };
+
+          if (!il_site (&t, &st, i, room))
+            continue;
+
+          if (t.sl == sc)
+            {
+              sc = sc ? sc << 1 : 8;
+              t.sites = SFREALLOC (t.sites, sc * sizeof (*t.sites));
+            }
+
+          t.sites[t.sl++] = st;
+          nl = st.base + st.nl + 1;
+          room -= st.len - 2;
+          k++;
+        }
+    }
+
+  if (t.sl)
+    {
+      qsort (t.sites, t.sl, sizeof (*t.sites), il_site_cmp);
+
+      edit_t *ed = SFMALLOC (t.sl * sizeof (*ed));
+
+      for (size_t si = 0; si < t.sl; si++)
+        ed[si] = (edit_t){ .at = t.sites[si].at,
+                           .n = 2,
+                           .in = il_emit (&t, &t.sites[si]),
+                           .len = t.sites[si].len };
+
+      splice (u, ed, t.sl);
+
+      for (size_t si = 0; si < t.sl; si++)
+        SFFREE (ed[si].in);
+
+      SFFREE (ed);
+    }
+
+  SFFREE (t.sites);
+  SFFREE (t.fend);
+  SFFREE (t.meth);
+  SFFREE (t.gfn);
+
+  return t.sl;
+}
+
+/* a class whose objects can live in the locals of a function */
+typedef struct
+{
+  int g;             /* the global it is bound to */
+  size_t init;       /* the LOAD_FUNC_CODED of its _init */
+  const char **fld;  /* what _init sets on self, in that order */
+  int fl;
+  int nl;            /* locals of _init */
+  size_t len;        /* what a construction becomes */
+
+} sr_class_t;
+
+typedef struct
+{
+  opt_unit_t *u;
+  size_t *fend;
+  sr_class_t *cls;
+  size_t cl;
+
+} sr_t;
+
+static int
+sr_field (const sr_class_t *c, const char *name)
+{
+  for (int f = 0; f < c->fl; f++)
+    if (!strcmp (c->fld[f], name))
+      return f;
+
+  return -1;
+}
+
+/**
+ * Whether the class built at k is one to take apart, filling c. It has
+ * to be bound once to a global, define no `_kill` and an _init that is
+ * straight-line code, defines nothing, touches no names and does with
+ * self only set fields and read ones it set.
+ */
+static int
+sr_class (sr_t *t, size_t k, const size_t *gst, sr_class_t *c)
+{
+  opt_unit_t *u = t->u;
+  size_t e = off (u, u->in[k]), fn = 0, b;
+  int inits = 0;
+
+  if (e + 1 >= u->n || u->in[e + 1].op != OP_STORE
+      || gst[u->in[e + 1].a] != 1)
+    return 0;
+
+  for (size_t i = k + 1; i < e; i = func_next (u, t->fend, i))
+    {
+      instr_t in = u->in[i];
+
+      if (in.op != OP_STORE_NAME || in.b != 0 || in.c == NULL)
+        continue;
+
+      if (!strcmp (in.c, "_kill"))
+        return 0;
+
+      if (!strcmp (in.c, "_init"))
+        {
+          if (u->in[i - 1].op != OP_LOAD_FUNC_CODED)
+            return 0;
+
+          fn = i - 1;
+          inits++;
+        }
+    }
+
+  if (inits != 1 || u->in[fn].b < 1)
+    return 0;
+
+  *c = (sr_class_t){ .g = u->in[e + 1].a, .init = fn, .nl = u->in[fn].b };
+  b = off (u, u->in[fn]) + c->nl;
+
+  if (fn <= b || fn - b > u->vm->inline_len + 1
+      || u->in[fn - 1].op != OP_RETURN || u->in[fn - 1].a != 0)
+    return 0;
+
+  for (int p = 0; p < c->nl; p++)
+    if (u->in[b - c->nl + p].op != OP_STORE_FAST
+        || u->in[b - c->nl + p].a != p)
+      return 0;
+
+  c->fld = SFMALLOC ((fn - b) * sizeof (*c->fld));
+  c->len = c->nl - 1;
+
+  for (size_t i = b; i < fn - 1; i++)
+    {
+      instr_t in = u->in[i];
+
+      if (SF_OP_HAS_IP (in.op))
+        goto no;
+
+      switch (in.op)
+        {
+        case OP_LOAD_NAME:
+        case OP_IMPORT:
+        case OP_IMPORT_ALIAS:
+        case OP_RETURN:
+        case OP_TAIL_CALL:
+          goto no;
+
+        case OP_STORE_NAME:
+          if (in.b != 1)
+            goto no;
+          break;
+
+        case OP_STORE_FAST:
+          if (in.a == 0)
+            goto no;
+
+          c->nl = in.a + 1 > c->nl ? in.a + 1 : c->nl;
+          break;
+
+        case OP_LOAD_FAST:
+          c->nl = in.a + 1 > c->nl ? in.a + 1 : c->nl;
+
+          if (in.a != 0)
+            break;
+
+          /* self, for the op after it */
+          in = u->in[++i];
+
+          if (in.op == OP_STORE_NAME && in.b == 1 && in.c != NULL)
+            {
+              if (sr_field (c, in.c) < 0)
+                c->fld[c->fl++] = in.c;
+            }
+          else if (in.op != OP_DOT_ACCESS || sr_field (c, in.c) < 0)
+            goto no;
+          break;
+
+        default:
+          break;
+        }
+
+      c->len++;
+    }
+
+  return 1;
+
+no:
+  SFFREE (c->fld);
+  return 0;
+}
+
+/* the class x = C (...) at k builds, -1 if none pass_scalar knows */
+static int
+sr_site (sr_t *t, size_t k)
+{
+  opt_unit_t *u = t->u;
+
+  if (k < 2)
+    return -1;
+
+  instr_t ld = u->in[k - 2], call = u->in[k - 1];
+
+  if (ld.op != OP_LOAD || call.op != OP_CALL || call.b != 1
+      || u->tgt[k - 1] || u->tgt[k])
+    return -1;
+
+  for (size_t c = 0; c < t->cl; c++)
+    if (t->cls[c].g == ld.a && call.a + 1 == u->in[t->cls[c].init].b)
+      return (int)c;
+
+  return -1;
+}
+
+/* what x = C (...) becomes, the fields of x on locals from slot */
+static instr_t *
+sr_emit (sr_t *t, const sr_class_t *c, int slot, int base)
+{
+  opt_unit_t *u = t->u;
+  size_t argc = u->in[c->init].b, b = off (u, u->in[c->init]) + argc;
+  instr_t *out = SFMALLOC (c->len * sizeof (*out));
+  size_t o = 0;
+
+  /* the arguments are on the stack last to first, self is not */
+  for (size_t p = argc; p-- > 1;)
+    out[o++] = (instr_t){ .op = OP_STORE_FAST, .a = base + (int)p - 1 };
+
+  for (size_t i = b; i < c->init - 1; i++)
+    {
+      instr_t in = u->in[i];
+
+      if (in.op == OP_LOAD_FAST && in.a == 0)
+        {
+          in = u->in[++i];
+          in = (instr_t){ .op = in.op == OP_DOT_ACCESS ? OP_LOAD_FAST
+                                                       : OP_STORE_FAST,
+                          .a = slot + sr_field (c, in.c) };
+        }
+      else if (in.op == OP_LOAD_FAST || in.op == OP_STORE_FAST)
+        in.a += base - 1;
+
+      out[o++] = in;
+    }
+
+  assert (o == c->len);
+  return out;
+}
+
+/**
+ * Value objects a function only builds and reads fields of are never
+ * allocated: a local x that only ever gets C (...) of a class taken
+ * apart by sr_class () and is only used as x.f or x.f = v, f one of
+ * the fields _init sets, becomes a local per field. The construction
+ * becomes the body of _init on those, and x.f the local of f. Anything
+ * else done with x, a method call or passing it on, keeps the object.
+ * Units where a function reads the locals of an enclosing one are left
+ * alone.
+ */
+static size_t
+pass_scalar (opt_unit_t *u)
+{
+  sr_t t = { .u = u };
+  size_t gl = 0, *gst, c = 0, ne = 0, ec = 0;
+  edit_t *ed = NULL;
+
+  if (u->vm->inline_len == 0)
+    return 0;
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      instr_t in = u->in[i];
+
+      if ((in.op == OP_LOAD_FAST && in.b != 0)
+          || (in.op == OP_STORE_NAME && in.b == 1 && in.c != NULL
+              && (!strcmp (in.c, "_init") || !strcmp (in.c, "_kill"))))
+        return 0;
+
+      if ((in.op == OP_LOAD || in.op == OP_STORE) && (size_t)in.a >= gl)
+        gl = (size_t)in.a + 1;
+    }
+
+  gst = SFMALLOC ((gl + 1) * sizeof (*gst));
+  memset (gst, 0, (gl + 1) * sizeof (*gst));
+
+  for (size_t i = 0; i < u->n; i++)
+    if (u->in[i].op == OP_STORE)
+      gst[u->in[i].a]++;
+
+  mark_targets (u);
+  t.fend = func_ends (u);
+
+  for (size_t i = 0; i < u->n; i++)
+    if (u->in[i].op == OP_LOAD_BUILDCLASS)
+      {
+        sr_class_t cl;
+
+        if (!sr_class (&t, i, gst, &cl))
+          continue;
+
+        t.cls = SFREALLOC (t.cls, (t.cl + 1) * sizeof (*t.cls));
+        t.cls[t.cl++] = cl;
+      }
+
+  for (size_t i = 0; i < u->n && t.cl; i++)
+    {
+      if (u->in[i].op != OP_LOAD_FUNC_CODED)
+        continue;
+
+      size_t s = off (u, u->in[i]);
+      int argc = u->in[i].b, nl = argc, scratch = 0;
+      int cls[SF_FRAME_LOCALS_CAP], slot[SF_FRAME_LOCALS_CAP];
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        if ((u->in[k].op == OP_LOAD_FAST || u->in[k].op == OP_STORE_FAST)
+            && u->in[k].a + 1 > nl)
+          nl = u->in[k].a + 1;
+
+      if (nl > SF_FRAME_LOCALS_CAP)
+        continue;
+
+      /* -1 while nothing is stored, -2 for locals that stay */
+      for (int x = 0; x < nl; x++)
+        cls[x] = x < argc ? -2 : -1;
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        {
+          instr_t in = u->in[k];
+
+          if (in.op != OP_STORE_FAST || cls[in.a] == -2)
+            continue;
+
+          int cn = sr_site (&t, k);
+
+          cls[in.a] = cn < 0 || (cls[in.a] >= 0 && cls[in.a] != cn) ? -2 : cn;
+        }
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        {
+          instr_t in = u->in[k], nx = u->in[k + 1];
+
+          if (in.op != OP_LOAD_FAST || cls[in.a] < 0)
+            continue;
+
+          if (u->tgt[k + 1]
+              || (nx.op != OP_DOT_ACCESS
+                  && (nx.op != OP_STORE_NAME || nx.b != 1))
+              || nx.c == NULL || sr_field (&t.cls[cls[in.a]], nx.c) < 0)
+            cls[in.a] = -2;
+        }
+
+      for (int x = argc, n = nl; x < n; x++)
+        {
+          const sr_class_t *cl = cls[x] >= 0 ? &t.cls[cls[x]] : NULL;
+
+          slot[x] = -1;
+
+          if (cl == NULL
+              || nl + cl->fl + (cl->nl - 1 > scratch ? cl->nl - 1 : scratch)
+                     > SF_FRAME_LOCALS_CAP)
+            continue;
+
+          slot[x] = nl;
+          nl += cl->fl;
+          scratch = cl->nl - 1 > scratch ? cl->nl - 1 : scratch;
+          c++;
+        }
+
+      for (size_t k = s; k < i; k = func_next (u, t.fend, k))
+        {
+          instr_t in = u->in[k];
+
+          if ((in.op != OP_LOAD_FAST && in.op != OP_STORE_FAST)
+              || in.a < argc || slot[in.a] < 0)
+            continue;
+
+          const sr_class_t *cl = &t.cls[cls[in.a]];
+          edit_t e;
+
+          if (in.op == OP_STORE_FAST)
+            e = (edit_t){ .at = k - 2,
+                          .n = 3,
+                          .in = sr_emit (&t, cl, slot[in.a], nl),
+                          .len = cl->len };
+          else
+            {
+              instr_t nx = u->in[k + 1];
+
+              e = (edit_t){ .at = k, .n = 2, .len = 1 };
+              e.in = SFMALLOC (sizeof (*e.in));
+              *e.in = (instr_t){ .op = nx.op == OP_DOT_ACCESS ? OP_LOAD_FAST
+                                                              : OP_STORE_FAST,
+                                 .a = slot[in.a] + sr_field (cl, nx.c) };
+            }
+
+          if (ne == ec)
+            {
+              ec = ec ? ec << 1 : 16;
+              ed = SFREALLOC (ed, ec * sizeof (*ed));
+            }
+
+          ed[ne++] = e;
+        }
+    }
+
+  if (ne)
+    {
+      qsort (ed, ne, sizeof (*ed), edit_cmp);
+      splice (u, ed, ne);
+    }
+
+  for (size_t e = 0; e < ne; e++)
+    SFFREE (ed[e].in);
+
+  for (size_t k = 0; k < t.cl; k++)
+    SFFREE (t.cls[k].fld);
+
+  SFFREE (ed);
+  SFFREE (t.cls);
+  SFFREE (t.fend);
+  SFFREE (gst);
+
+  return c;
+}
+
+/**
+ * The ops of functions whose frame some nested function reads through
+ * LOAD_FAST with b > 0, and of every function inside them. The frames
+ * are only found by counting back from the reader, so none of those
+ * may move. Class bodies are not counted as levels, which can only
+ * take in more functions than needed.
+ */
+static unsigned char *
+tail_captured (opt_unit_t *u)
+{
+  unsigned char *cap = SFMALLOC (u->n);
+
+  memset (cap, 0, u->n);
+
+  for (size_t k = 0; k < u->n; k++)
+    {
+      if (u->in[k].op != OP_LOAD_FAST || u->in[k].b == 0)
+        continue;
+
+      /* the outermost of the b functions around the reader's own */
+      size_t s = 0, e = 0, lev = 0;
+
+      for (size_t i = k + 1; i < u->n; i++)
+        {
+          if (u->in[i].op != OP_LOAD_FUNC_CODED || off (u, u->in[i]) > k)
+            continue;
+
+          /* bodies around k nest and end in a LOAD_FUNC_CODED, so the
+             inner ones come first */
+          if (lev != 0 && lev <= (size_t)u->in[k].b)
+            {
+              s = off (u, u->in[i]);
+              e = i;
+            }
+
+          lev++;
+        }
+
+      if (e != 0)
+        memset (cap + s, 1, e - s);
+    }
+
+  return cap;
+}
+
+/**
+ * A call whose result the function returns at once, CALL n 1; RETURN 1,
+ * becomes TAIL_CALL n, which runs a coded callee in the frame of the
+ * caller instead of one of its own, so recursion in tail form runs in
+ * constant space. Functions a nested one reads the locals of are left
+ * alone, with everything inside them, as a tail call moves frames.
+ */
+static size_t
+pass_tail (opt_unit_t *u)
+{
+  size_t *fend, c = 0;
+  unsigned char *cap;
+
+  mark_targets (u);
+  fend = func_ends (u);
+  cap = tail_captured (u);
+
+  for (size_t i = 0; i < u->n; i++)
+    {
+      if (u->in[i].op != OP_LOAD_FUNC_CODED || cap[off (u, u->in[i])])
+        continue;
+
+      for (size_t k = off (u, u->in[i]); k < i; k = func_next (u, fend, k))
+        {
+          instr_t *in = &u->in[k];
+
+          if (in[0].op != OP_CALL || in[0].b != 1 || k + 1 >= i
+              || in[1].op != OP_RETURN || in[1].a != 1)
+            continue;
+
+          in[0].op = OP_TAIL_CALL;
+
+          /* the RETURN stays for whatever jumps to it */
+          u->del[k + 1] = !u->tgt[k + 1];
+          c++;
+        }
+    }
+
+  SFFREE (cap);
+  SFFREE (fend);
+  return c;
+}
+
+static const struct
+{
+  int flag;
+  const char *name;
+  size_t (*run) (opt_unit_t *);
+
+} passes[] = {
+  /* first, what it copies goes through the others in the same round */
+  { SF_OPT_INLINE, "inline", pass_inline },
+  { SF_OPT_SCALAR, "scalar", pass_scalar },
+  { SF_OPT_CONSTBR, "constbr", pass_constbr },
+  { SF_OPT_THREAD, "thread", pass_thread },
+  { SF_OPT_DEAD, "dead", pass_dead },
+  { SF_OPT_UNREACH, "unreach", pass_unreach },
+  { SF_OPT_LOADSTORE, "loadstore", pass_loadstore },
+  { SF_OPT_DUP, "dup", pass_dup },
+  { SF_OPT_LICM, "licm", NULL },
+  { SF_OPT_TYPES, "types", NULL },
+  { SF_OPT_TAIL, "tail", NULL },
+};
+
+#define NPASSES (sizeof (passes) / sizeof (*passes))
+
+/**
+ * Runs the passes in which over vm->insts[ip, inst_len), the code of
+ * one unit. Jumps out of the unit are not allowed, and it has to end
+ * with the RETURN codegen puts there.
+ */
+SF_API void
+sf_opt_run (vm_t *vm, size_t ip, int which)
+{
+  if (!which || vm->inst_len - ip < 2)
+    return;
+
+  opt_unit_t u = { .vm = vm,
+                   .in = vm->insts + ip,
+                   .ip = ip,
+                   .n = vm->inst_len - ip,
+                   .n0 = vm->inst_len - ip };
+
+  assert (u.in[u.n - 1].op == OP_RETURN);
+
+  u.del = SFMALLOC (2 * u.n);
+  u.tgt = u.del + u.n;
+  u.map = SFMALLOC ((u.n + 1) * sizeof (*u.map));
+  memset (u.del, 0, u.n);
+
+  for (int r = 0; r < SF_OPT_ROUNDS; r++)
+    {
+      size_t c = 0;
+
+      for (size_t p = 0; p < NPASSES; p++)
+        if ((which & passes[p].flag) && passes[p].run != NULL)
+          {
+            c += passes[p].run (&u);
+            compact (&u);
+          }
+
+      if (!c)
+        break;
+    }
+
+  /* then what the other passes do not know: a way out of a function
+     besides RETURN, and typed ops */
+  if (which & SF_OPT_TAIL)
+    {
+      pass_tail (&u);
+      compact (&u);
+    }
+
+  if (which & SF_OPT_TYPES)
+    {
+      pass_types (&u);
+      compact (&u);
+    }
+
+  SFFREE (u.map);
+  SFFREE (u.del);
+}
+
+/* a size from s, like $SF_INLINE, def when s is NULL or not a number */
+SF_API size_t
+sf_opt_parse_len (const char *s, size_t def)
+{
+  char *e;
+  unsigned long v;
+
+  if (s == NULL)
+    return def;
+
+  v = strtoul (s, &e, 10);
+
+  if (e == s || *e != '\0')
+    {
+      fprintf (stderr, "SF_INLINE: not a size '%s'\n", s);
+      return def;
+    }
+
+  return (size_t)v;
+}
+
+/**
+ * Applies a list like "all,-dup" to the pass set: a name adds a pass, a
+ * leading '-' takes it out, "all" adds every pass and "none" or "0"
+ * clears the set. NULL leaves the set as it is.
+ */
+SF_API int
+sf_opt_parse (const char *s, int set)
+{
+  if (s == NULL)
+    return set;
+
+  while (*s)
+    {
+      size_t n = strcspn (s, ",");
+      int neg = *s == '-';
+      const char *w = s + neg;
+      size_t wl = n - neg;
+      int f = -1;
+
+      if (wl == 3 && !strncmp (w, "all", 3))
+        f = SF_OPT_ALL;
+      else if ((wl == 4 && !strncmp (w, "none", 4))
+               || (wl == 1 && *w == '0'))
+        {
+          set = 0;
+          f = 0;
+        }
+      else
+        for (size_t p = 0; p < NPASSES; p++)
+          if (strlen (passes[p].name) == wl
+              && !strncmp (w, passes[p].name, wl))
+            f = passes[p].flag;
+
+      if (f < 0)
+        fprintf (stderr, "SF_OPT: unknown pass '%.*s'\n", (int)wl, w);
+      else if (neg)
+        set &= ~f;
+      else
+        set |= f;
+
+      s += n + (s[n] == ',');
+    }
+
+  return set;
+}
@@ -0,0 +1,54 @@
+#if !defined(OPT_H)
+#define OPT_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Peephole and flow passes over the code of one compilation unit, run
+ * once codegen is done with it. Each pass can be turned off on its own,
+ * through vm->opt or $SF_OPT, a comma separated list of pass names like
+ * "all,-dup" ("none" or "0" turns them all off).
+ */
+enum OptPass
+{
+  SF_OPT_CONSTBR = 1 << 0,   /* branches on a constant condition */
+  SF_OPT_THREAD = 1 << 1,    /* jumps to jumps, returns and the next op */
+  SF_OPT_DEAD = 1 << 2,      /* code after a JUMP or RETURN */
+  SF_OPT_UNREACH = 1 << 3,   /* blocks no path reaches */
+  SF_OPT_LOADSTORE = 1 << 4, /* LOAD x; STORE x */
+  SF_OPT_DUP = 1 << 5,       /* STORE x; LOAD x into DUP; STORE x */
+  SF_OPT_LICM = 1 << 6,      /* loop invariants, hoisted by codegen */
+  SF_OPT_TYPES = 1 << 7,     /* unboxed int locals and arithmetic */
+  SF_OPT_INLINE = 1 << 8,    /* small coded functions copied into calls */
+  SF_OPT_TAIL = 1 << 9,      /* calls in tail position reuse the frame */
+  SF_OPT_SCALAR = 1 << 10,   /* objects that stay in a function, in locals */
+};
+
+#define SF_OPT_ALL ((1 << 11) - 1)
+#define SF_OPT_DEFAULT SF_OPT_ALL
+
+/* passes run again while they still change something, up to this */
+#define SF_OPT_ROUNDS (4)
+
+/* callees of up to this many instructions get inlined ($SF_INLINE=n) */
+#define SF_INLINE_LEN (24)
+
+/* and inlining stops once a unit is this many times its size */
+#define SF_INLINE_GROWTH (2)
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_opt_run (vm_t *, size_t, int);
+  SF_API int sf_opt_parse (const char *, int);
+  SF_API size_t sf_opt_parse_len (const char *, size_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // OPT_H
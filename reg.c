@@ -0,0 +1,1041 @@
+#include "reg.h"
+#include "jit.h"
+#include "opt.h"
+#include "verify.h"
+
+enum
+{
+  RO_ENTER,    /* a arguments off the VM stack, into locals with b */
+  RO_MOV,      /* d = a, which a temporary hands over */
+  RO_COPY,     /* d = a, a temporary too keeps its own */
+  RO_LOAD,     /* d = global a */
+  RO_STORE,    /* global d = a */
+  RO_ADD,      /* d = a + b, as the next ones */
+  RO_SUB,
+  RO_MUL,
+  RO_ADD_1,    /* d = a + 1 */
+  RO_CMP,      /* d = a c b */
+  RO_JUMP,     /* to c */
+  RO_JUMP_IF_FALSE, /* on a, to c */
+  RO_CMP_JUMP, /* to c unless a d b */
+  RO_RETURN,   /* a */
+  RO_STEP,     /* runs ip on the a operands at c, results from d */
+};
+
+/* what a STEP can do besides going on at the next instruction */
+#define R_JUMPS (1 << 0)
+#define R_TAIL (1 << 1)
+
+SF_API int
+sf_reg_parse (const char *s, int tier)
+{
+  if (s == NULL)
+    return tier;
+
+  if (!strcmp (s, "stack"))
+    return SF_TIER_STACK;
+
+  if (!strcmp (s, "reg"))
+    return SF_TIER_REG;
+
+  fprintf (stderr, "SF_VM: unknown tier '%s'\n", s);
+  return tier;
+}
+
+SF_API reg_t *
+sf_reg_new (int tier)
+{
+  if (tier != SF_TIER_REG)
+    return NULL;
+
+  reg_t *g = SFMALLOC (sizeof (*g));
+
+  g->fns = NULL;
+  g->fl = 0;
+  g->fc = 0;
+  g->at = NULL;
+  g->al = 0;
+
+  return g;
+}
+
+SF_API void
+sf_reg_free (reg_t *g, vm_t *vm)
+{
+  if (g == NULL)
+    return;
+
+  for (size_t i = 0; i < g->fl; i++)
+    {
+      reg_fn_t *f = &g->fns[i];
+
+      for (size_t j = 0; j < f->kl; j++)
+        DR (f->k[j], vm);
+
+      SFFREE (f->code);
+      SFFREE (f->ops);
+      SFFREE (f->k);
+      SFFREE (f->pc);
+    }
+
+  SFFREE (g->fns);
+  SFFREE (g->at);
+  SFFREE (g);
+}
+
+/**
+ * Sets the tier vm runs functions on. The register VM replaces the JIT
+ * and the types pass, which only code compiled from now on goes
+ * without.
+ */
+SF_API void
+sf_reg_use (vm_t *vm, int tier)
+{
+  sf_reg_free (vm->reg, vm);
+  vm->reg = sf_reg_new (tier);
+
+  if (vm->reg == NULL)
+    return;
+
+  sf_jit_free (vm->jit);
+  vm->jit = NULL;
+  vm->opt &= ~SF_OPT_TYPES;
+}
+
+/* a coded function at [lp, end) was defined, run by OP_LOAD_FUNC_CODED */
+SF_API void
+sf_reg_func (vm_t *vm, size_t lp, size_t end)
+{
+  reg_t *g = vm->reg;
+
+  if (lp < g->al && g->at[lp])
+    return;
+
+  if (lp >= g->al)
+    {
+      size_t al = g->al;
+
+      g->al = vm->inst_len > lp ? vm->inst_len : lp + 1;
+      g->at = SFREALLOC (g->at, g->al * sizeof (*g->at));
+      memset (g->at + al, 0, (g->al - al) * sizeof (*g->at));
+    }
+
+  if (g->fl == g->fc)
+    {
+      g->fc = g->fc ? g->fc << 1 : 16;
+      g->fns = SFREALLOC (g->fns, g->fc * sizeof (*g->fns));
+    }
+
+  g->fns[g->fl++] = (reg_fn_t){ .lp = lp, .end = end };
+  g->at[lp] = g->fl;
+}
+
+/* sf_verify_effect () for the instructions the translation takes */
+static int
+r_effect (instr_t in, int *pop, int *push)
+{
+  switch (in.op)
+    {
+    case OP_IMPORT:
+    case OP_LOAD_I:
+    case OP_STORE_I:
+    case OP_CONST_I:
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+    case OP_ADD_1_I:
+    case OP_CMP_I:
+    case OP_CMP_JUMP_I:
+    case OP_DUP_I:
+      return 0;
+
+    default:
+      return sf_verify_effect (in, pop, push);
+    }
+}
+
+/* the depth at the target of the jump in, from depth d before it */
+static int
+r_edge (instr_t in, int d)
+{
+  switch (in.op)
+    {
+    case OP_JUMP_IF_FALSE:
+    case OP_LOAD_ITER_NEXT:
+      return d - 1;
+    case OP_CMP_JUMP:
+      return d - 2;
+    default:
+      return d;
+    }
+}
+
+static int
+r_jumps (instr_t in)
+{
+  return in.op == OP_JUMP || in.op == OP_JUMP_IF_FALSE
+         || in.op == OP_CMP_JUMP || in.op == OP_LOAD_ITER_NEXT
+         || in.op == OP_GUARD_FN || in.op == OP_GUARD_METHOD;
+}
+
+static int
+r_falls (instr_t in)
+{
+  return in.op != OP_JUMP && in.op != OP_RETURN && in.op != OP_TAIL_CALL;
+}
+
+typedef struct
+{
+  vm_t *vm;
+  reg_fn_t *f;
+  size_t n;
+
+  int *depth; /* per ip - lp, -1 where nothing reaches */
+  unsigned char *tgt;
+
+  int *st; /* the slot of each stack entry */
+  int sl;
+  long last; /* an instruction whose d may go to a local instead */
+
+  size_t cc;
+  size_t ol, oc;
+
+} rt_t;
+
+static size_t
+rt_emit (rt_t *t, rinstr_t ri)
+{
+  reg_fn_t *f = t->f;
+
+  if (f->n == t->cc)
+    {
+      t->cc = t->cc ? t->cc << 1 : 64;
+      f->code = SFREALLOC (f->code, t->cc * sizeof (*f->code));
+    }
+
+  f->code[f->n] = ri;
+  return f->n++;
+}
+
+/* the stack entries from p on into their temporaries */
+static void
+rt_spill (rt_t *t, int p)
+{
+  for (; p < t->sl; p++)
+    if (t->st[p] != t->f->nl + p)
+      {
+        rt_emit (t, (rinstr_t){ .op = RO_MOV, .d = t->f->nl + p,
+                                .a = t->st[p] });
+        t->st[p] = t->f->nl + p;
+        t->last = -1;
+      }
+}
+
+/* a constant operand for LOAD_CONST a, or 0 if it is not one */
+static int
+rt_const (rt_t *t, int a)
+{
+  reg_fn_t *f = t->f;
+  const_t c = t->vm->map_consts[a];
+
+  if (c.type != CONST_INT && c.type != CONST_FLOAT && c.type != CONST_BOOL
+      && c.type != CONST_NONE)
+    return 0;
+
+  obj_t *o = sf_objstore_box (&c);
+
+  IR (o);
+  f->k = SFREALLOC (f->k, (f->kl + 1) * sizeof (*f->k));
+  f->k[f->kl++] = o;
+
+  return ~(int)(f->kl - 1);
+}
+
+/* a stack instruction run as it is, its operands on top */
+static void
+rt_step (rt_t *t, instr_t in, size_t ip, int pop, int push)
+{
+  reg_fn_t *f = t->f;
+  int flags = (r_jumps (in) ? R_JUMPS : 0)
+              | (in.op == OP_TAIL_CALL ? R_TAIL : 0);
+
+  /* a jump lands with every entry in its temporary */
+  if (flags)
+    rt_spill (t, 0);
+
+  size_t at = t->ol;
+
+  if (t->ol + pop > t->oc)
+    {
+      t->oc = t->ol + pop + 64;
+      f->ops = SFREALLOC (f->ops, t->oc * sizeof (*f->ops));
+    }
+
+  t->ol += pop;
+  t->sl -= pop;
+  if (pop > 0)
+    memcpy (f->ops + at, t->st + t->sl, pop * sizeof (*f->ops));
+
+  rt_emit (t, (rinstr_t){ .op = RO_STEP,
+                          .d = f->nl + t->sl,
+                          .a = pop,
+                          .b = flags,
+                          .c = (int)at,
+                          .ip = ip });
+
+  for (int j = 0; j < push; j++, t->sl++)
+    t->st[t->sl] = f->nl + t->sl;
+
+  t->last = -1;
+}
+
+/**
+ * Walks [lp, end) from lp, depth by depth. Fails on an instruction not
+ * taken, a jump out, or a depth that depends on the way there.
+ */
+static int
+rt_depths (rt_t *t, int *maxd)
+{
+  reg_fn_t *f = t->f;
+  instr_t *in = t->vm->insts + f->lp;
+  size_t *work = SFMALLOC ((t->n + 1) * sizeof (*work)), wl = 0;
+  int ok = 1;
+
+  t->depth[0] = t->vm->insts[f->end].b;
+  work[wl++] = 0;
+  *maxd = t->depth[0];
+
+  while (wl && ok)
+    {
+      size_t k = work[--wl];
+      int d = t->depth[k], pop, push;
+
+      if (!r_effect (in[k], &pop, &push) || d < pop)
+        {
+          ok = 0;
+          break;
+        }
+
+      int nd = d - pop + push;
+
+      *maxd = nd > *maxd ? nd : *maxd;
+
+      for (int e = 0; e < 2; e++)
+        {
+          size_t to;
+          int td;
+
+          if (e == 0)
+            {
+              if (!r_falls (in[k]))
+                continue;
+              to = k + 1;
+              td = nd;
+            }
+          else
+            {
+              if (!r_jumps (in[k]))
+                continue;
+
+              to = (size_t)in[k].a - f->lp;
+              td = r_edge (in[k], d);
+
+              if ((size_t)in[k].a < f->lp || to >= t->n)
+                {
+                  ok = 0;
+                  break;
+                }
+
+              t->tgt[to] = 1;
+            }
+
+          if (to >= t->n)
+            {
+              ok = 0;
+              break;
+            }
+
+          if (t->depth[to] < 0)
+            {
+              t->depth[to] = td;
+              work[wl++] = to;
+            }
+          else if (t->depth[to] != td)
+            {
+              ok = 0;
+              break;
+            }
+        }
+    }
+
+  SFFREE (work);
+  return ok;
+}
+
+static int
+rt_body (rt_t *t)
+{
+  reg_fn_t *f = t->f;
+  instr_t *in = t->vm->insts + f->lp;
+  int argc = t->vm->insts[f->end].b, live = 0;
+  size_t k = 0;
+
+  /* the prologue stores the arguments to their locals */
+  int direct = 1;
+
+  for (int p = 0; p < argc; p++)
+    if ((size_t)p >= t->n || in[p].op != OP_STORE_FAST || in[p].a != p
+        || in[p].b != 0 || t->tgt[p])
+      direct = 0;
+
+  rt_emit (t, (rinstr_t){ .op = RO_ENTER, .a = argc, .b = direct });
+
+  if (direct)
+    {
+      k = argc;
+      t->sl = 0;
+      live = 1;
+    }
+  else
+    {
+      for (t->sl = 0; t->sl < argc; t->sl++)
+        t->st[t->sl] = f->nl + t->sl;
+      live = 1;
+    }
+
+  t->last = -1;
+
+  for (; k < t->n; k++)
+    {
+      instr_t i = in[k];
+      int pop, push;
+
+      if (t->depth[k] < 0)
+        {
+          live = 0;
+          continue;
+        }
+
+      if (t->tgt[k] || !live)
+        {
+          if (live)
+            rt_spill (t, 0);
+
+          for (t->sl = 0; t->sl < t->depth[k]; t->sl++)
+            t->st[t->sl] = f->nl + t->sl;
+
+          t->last = -1;
+        }
+
+      f->pc[k] = (int)f->n;
+      live = r_falls (i);
+      r_effect (i, &pop, &push);
+
+      switch (i.op)
+        {
+        case OP_LOAD_CONST:
+          {
+            int s = rt_const (t, i.a);
+
+            if (s == 0)
+              rt_step (t, i, f->lp + k, 0, 1);
+            else
+              t->st[t->sl++] = s;
+          }
+          break;
+
+        case OP_LOAD_FAST:
+          if (i.b != 0)
+            rt_step (t, i, f->lp + k, 0, 1);
+          else
+            t->st[t->sl++] = i.a;
+          break;
+
+        case OP_STORE_FAST:
+          {
+            int s = t->st[--t->sl], spilt = 0;
+
+            /* what still reads the old value reads it now */
+            for (int p = 0; p < t->sl; p++)
+              if (t->st[p] == i.a)
+                {
+                  rt_emit (t, (rinstr_t){ .op = RO_MOV, .d = f->nl + p,
+                                          .a = i.a });
+                  t->st[p] = f->nl + p;
+                  spilt = 1;
+                }
+
+            if (s >= f->nl && !spilt && t->last >= 0
+                && f->code[t->last].d == s)
+              f->code[t->last].d = i.a;
+            else if (s != i.a)
+              rt_emit (t, (rinstr_t){ .op = RO_MOV, .d = i.a, .a = s });
+
+            t->last = -1;
+          }
+          break;
+
+        case OP_LOAD:
+          t->last = (long)rt_emit (t, (rinstr_t){ .op = RO_LOAD,
+                                                  .d = f->nl + t->sl,
+                                                  .a = i.a });
+          t->st[t->sl] = f->nl + t->sl;
+          t->sl++;
+          break;
+
+        case OP_STORE:
+          t->sl--;
+          rt_emit (t, (rinstr_t){ .op = RO_STORE, .d = i.a,
+                                  .a = t->st[t->sl] });
+          t->last = -1;
+          break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_CMP:
+          {
+            int b = t->st[--t->sl], a = t->st[--t->sl];
+            int op = i.op == OP_ADD   ? RO_ADD
+                     : i.op == OP_SUB ? RO_SUB
+                     : i.op == OP_MUL ? RO_MUL
+                                      : RO_CMP;
+
+            /* a compare for a branch becomes one */
+            if (op == RO_CMP && k + 1 < t->n
+                && in[k + 1].op == OP_JUMP_IF_FALSE && !t->tgt[k + 1])
+              {
+                rt_spill (t, 0);
+                rt_emit (t, (rinstr_t){ .op = RO_CMP_JUMP, .d = i.a,
+                                        .a = a, .b = b,
+                                        .c = in[k + 1].a,
+                                        .ip = f->lp + k });
+                t->depth[++k] = -2;
+                t->last = -1;
+                break;
+              }
+
+            t->last = (long)rt_emit (t, (rinstr_t){ .op = op,
+                                                    .d = f->nl + t->sl,
+                                                    .a = a,
+                                                    .b = b,
+                                                    .c = i.a,
+                                                    .ip = f->lp + k });
+            t->st[t->sl] = f->nl + t->sl;
+            t->sl++;
+          }
+          break;
+
+        case OP_ADD_1:
+          {
+            int a = t->st[--t->sl];
+
+            t->last = (long)rt_emit (t, (rinstr_t){ .op = RO_ADD_1,
+                                                    .d = f->nl + t->sl,
+                                                    .a = a,
+                                                    .ip = f->lp + k });
+            t->st[t->sl] = f->nl + t->sl;
+            t->sl++;
+          }
+          break;
+
+        case OP_DUP:
+          {
+            int s = t->st[t->sl - 1];
+
+            if (s >= f->nl)
+              {
+                t->last = (long)rt_emit (t, (rinstr_t){ .op = RO_COPY,
+                                                        .d = f->nl + t->sl,
+                                                        .a = s });
+                s = f->nl + t->sl;
+              }
+
+            t->st[t->sl++] = s;
+          }
+          break;
+
+        case OP_CMP_JUMP:
+          {
+            int b = t->st[--t->sl], a = t->st[--t->sl];
+
+            rt_spill (t, 0);
+            rt_emit (t, (rinstr_t){ .op = RO_CMP_JUMP, .d = i.b, .a = a,
+                                    .b = b, .c = i.a, .ip = f->lp + k });
+            t->last = -1;
+          }
+          break;
+
+        case OP_JUMP_IF_FALSE:
+          {
+            int a = t->st[--t->sl];
+
+            rt_spill (t, 0);
+            rt_emit (t, (rinstr_t){ .op = RO_JUMP_IF_FALSE, .a = a,
+                                    .c = i.a });
+            t->last = -1;
+          }
+          break;
+
+        case OP_JUMP:
+          rt_spill (t, 0);
+          rt_emit (t, (rinstr_t){ .op = RO_JUMP, .c = i.a });
+          break;
+
+        case OP_RETURN:
+          if (i.a == 1)
+            {
+              rt_emit (t, (rinstr_t){ .op = RO_RETURN,
+                                      .a = t->st[--t->sl] });
+              break;
+            }
+          /* fallthrough */
+
+        default:
+          rt_step (t, i, f->lp + k, pop, push);
+          break;
+        }
+    }
+
+  /* jump targets as instructions */
+  for (size_t j = 0; j < f->n; j++)
+    {
+      rinstr_t *ri = &f->code[j];
+
+      if (ri->op == RO_JUMP || ri->op == RO_JUMP_IF_FALSE
+          || ri->op == RO_CMP_JUMP)
+        ri->c = f->pc[ri->c - f->lp];
+    }
+
+  return 1;
+}
+
+/* the register code of f, 0 if it stays on the stack VM */
+static int
+reg_translate (vm_t *vm, reg_fn_t *f)
+{
+  rt_t t = { .vm = vm, .f = f, .n = f->end - f->lp };
+  instr_t *in = vm->insts + f->lp;
+  int maxd, ok;
+
+  if (t.n == 0 || f->end >= INT32_MAX)
+    return 0;
+
+  t.depth = SFMALLOC (t.n * sizeof (*t.depth));
+  t.tgt = SFMALLOC (t.n);
+  f->pc = SFMALLOC (t.n * sizeof (*f->pc));
+
+  for (size_t k = 0; k < t.n; k++)
+    {
+      t.depth[k] = -1;
+      f->pc[k] = -1;
+    }
+
+  memset (t.tgt, 0, t.n);
+  ok = rt_depths (&t, &maxd);
+
+  if (ok)
+    {
+      f->nl = vm->insts[f->end].b;
+
+      for (size_t k = 0; k < t.n; k++)
+        if (t.depth[k] >= 0
+            && (in[k].op == OP_LOAD_FAST || in[k].op == OP_STORE_FAST)
+            && in[k].b == 0 && in[k].a + 1 > f->nl)
+          f->nl = in[k].a + 1;
+
+      f->win = f->nl + maxd + 1;
+      t.st = SFMALLOC ((maxd + 1) * sizeof (*t.st));
+      ok = rt_body (&t);
+      SFFREE (t.st);
+    }
+
+  SFFREE (t.depth);
+  SFFREE (t.tgt);
+
+  return ok;
+}
+
+static inline int
+r_isint (obj_t *o)
+{
+  return o != NULL && o->type == OBJ_CONST
+         && o->v.o_const.v.type == CONST_INT;
+}
+
+static inline int
+r_int (obj_t *o)
+{
+  return o->v.o_const.v.v.c_int.v;
+}
+
+static inline obj_t *
+r_get (obj_t **L, obj_t **K, int s)
+{
+  return s < 0 ? K[~s] : L[s];
+}
+
+/* operand s, read as o, is used up: a temporary lets go of it */
+static inline void
+r_done (vm_t *vm, obj_t **L, int nl, int s, obj_t *o)
+{
+  if (s >= nl)
+    {
+      L[s] = NULL;
+
+      if (o != NULL)
+        DR (o, vm);
+    }
+}
+
+/* slot d gets o, which comes with a reference of its own */
+static inline void
+r_set (vm_t *vm, obj_t **L, int d, obj_t *o)
+{
+  obj_t *old = L[d];
+
+  L[d] = o;
+
+  if (old != NULL)
+    DR (old, vm);
+}
+
+static inline void
+r_push (vm_t *vm, obj_t *o)
+{
+  if (vm->sp >= vm->stack_cap)
+    {
+      vm->stack_cap += SF_VM_STACK_CAP;
+      vm->stack = SFREALLOC (vm->stack, vm->stack_cap * sizeof (*vm->stack));
+    }
+
+  vm->stack[vm->sp++] = o;
+}
+
+/* operand s onto the VM stack, with a reference of its own */
+static inline void
+r_push_slot (vm_t *vm, obj_t **L, obj_t **K, int nl, int s)
+{
+  obj_t *o = r_get (L, K, s);
+
+  if (s >= nl)
+    L[s] = NULL;
+  else if (o != NULL)
+    IR (o);
+
+  r_push (vm, o);
+}
+
+static inline obj_t *
+r_box_int (int v)
+{
+  obj_t *o = sf_objstore_box (
+      &(const_t){ .type = CONST_INT, .v.c_int.v = v });
+
+  IR (o);
+  return o;
+}
+
+/* as OP_CMP and OP_CMP_I compare, ints ordered as floats */
+static int
+r_cmp (int type, obj_t *l, obj_t *r)
+{
+  if (r_isint (l) && r_isint (r))
+    {
+      int a = r_int (l), b = r_int (r);
+
+      switch (type)
+        {
+        case CMP_EQEQ:
+          return a == b;
+        case CMP_NEQ:
+          return a != b;
+        case CMP_LE:
+          return (float)a < (float)b;
+        case CMP_GE:
+          return (float)a > (float)b;
+        case CMP_LEQ:
+          return (float)a <= (float)b;
+        case CMP_GEQ:
+          return (float)a >= (float)b;
+        default:
+          return 0;
+        }
+    }
+
+  switch (type)
+    {
+    case CMP_EQEQ:
+      return sf_obj_eqeq (l, r);
+    case CMP_GE:
+      return sf_obj_ge (l, r);
+    case CMP_GEQ:
+      return sf_obj_geq (l, r);
+    case CMP_LE:
+      return sf_obj_le (l, r);
+    case CMP_LEQ:
+      return sf_obj_leq (l, r);
+    case CMP_NEQ:
+      return sf_obj_neq (l, r);
+    default:
+      return 0;
+    }
+}
+
+/* the frame's window holds f's locals and temporaries */
+static obj_t **
+r_window (vm_t *vm, const reg_fn_t *f)
+{
+  frame_t *fr = &vm->frames[vm->fp - 1];
+
+  if ((size_t)f->win > fr->l.locals_cap)
+    {
+      size_t cap = fr->l.locals_cap;
+
+      fr->l.locals_cap = f->win;
+      fr->l.locals = SFREALLOC (fr->l.locals,
+                                fr->l.locals_cap * sizeof (*fr->l.locals));
+
+      for (size_t j = cap; j < fr->l.locals_cap; j++)
+        fr->l.locals[j] = NULL;
+    }
+
+  if ((size_t)f->win > fr->l.locals_count)
+    fr->l.locals_count = f->win;
+
+  return fr->l.locals;
+}
+
+/**
+ * The stack op ri stands for, on its operands a and b pushed to the VM
+ * stack, for whatever the inline paths do not handle.
+ */
+static obj_t **
+r_slow (vm_t *vm, const reg_fn_t *f, const rinstr_t *ri, obj_t **L, int n)
+{
+  size_t s0 = vm->sp;
+
+  r_push_slot (vm, L, f->k, f->nl, ri->a);
+
+  if (n == 2)
+    r_push_slot (vm, L, f->k, f->nl, ri->b);
+
+  sf_vm_step (vm, ri->ip);
+  L = vm->frames[vm->fp - 1].l.locals;
+
+  r_set (vm, L, ri->d, vm->sp > s0 ? vm->stack[--vm->sp] : NULL);
+  vm->sp = s0;
+
+  return L;
+}
+
+static int
+reg_exec (vm_t *vm, const reg_fn_t *f)
+{
+  const rinstr_t *pc = f->code;
+  obj_t **K = f->k, **L = r_window (vm, f);
+  int nl = f->nl;
+
+  for (;;)
+    {
+      const rinstr_t *ri = pc++;
+
+      switch (ri->op)
+        {
+        case RO_ENTER:
+          for (int p = 0; p < ri->a; p++)
+            r_set (vm, L, ri->b ? p : nl + ri->a - 1 - p,
+                   vm->stack[--vm->sp]);
+          break;
+
+        case RO_MOV:
+        case RO_COPY:
+          {
+            obj_t *o = r_get (L, K, ri->a);
+
+            if (ri->a >= nl && ri->op == RO_MOV)
+              L[ri->a] = NULL;
+            else if (o != NULL)
+              IR (o);
+
+            r_set (vm, L, ri->d, o);
+          }
+          break;
+
+        case RO_LOAD:
+          {
+            obj_t *o = vm->globals[ri->a];
+
+            if (o != NULL)
+              IR (o);
+
+            r_set (vm, L, ri->d, o);
+          }
+          break;
+
+        case RO_STORE:
+          {
+            obj_t *o = r_get (L, K, ri->a);
+
+            if (ri->a >= nl)
+              L[ri->a] = NULL;
+            else if (o != NULL)
+              IR (o);
+
+            if (vm->globals[ri->d] != NULL)
+              DR (vm->globals[ri->d], vm);
+
+            vm->globals[ri->d] = o;
+          }
+          break;
+
+        case RO_ADD:
+        case RO_SUB:
+        case RO_MUL:
+          {
+            obj_t *a = r_get (L, K, ri->a), *b = r_get (L, K, ri->b);
+
+            if (!r_isint (a) || !r_isint (b))
+              {
+                L = r_slow (vm, f, ri, L, 2);
+                break;
+              }
+
+            unsigned x = (unsigned)r_int (a), y = (unsigned)r_int (b);
+            obj_t *o = r_box_int ((int)(ri->op == RO_ADD   ? x + y
+                                        : ri->op == RO_SUB ? x - y
+                                                           : x * y));
+
+            r_done (vm, L, nl, ri->a, a);
+            r_done (vm, L, nl, ri->b, b);
+            r_set (vm, L, ri->d, o);
+          }
+          break;
+
+        case RO_ADD_1:
+          {
+            obj_t *a = r_get (L, K, ri->a);
+
+            if (!r_isint (a))
+              {
+                L = r_slow (vm, f, ri, L, 1);
+                break;
+              }
+
+            obj_t *o = r_box_int ((int)((unsigned)r_int (a) + 1u));
+
+            r_done (vm, L, nl, ri->a, a);
+            r_set (vm, L, ri->d, o);
+          }
+          break;
+
+        case RO_CMP:
+          {
+            obj_t *a = r_get (L, K, ri->a), *b = r_get (L, K, ri->b);
+            obj_t *o = sf_objstore_box (&(const_t){
+                .type = CONST_BOOL, .v.c_bool.v = r_cmp (ri->c, a, b) });
+
+            IR (o);
+            r_done (vm, L, nl, ri->a, a);
+            r_done (vm, L, nl, ri->b, b);
+            r_set (vm, L, ri->d, o);
+          }
+          break;
+
+        case RO_CMP_JUMP:
+          {
+            obj_t *a = r_get (L, K, ri->a), *b = r_get (L, K, ri->b);
+            int rc = r_cmp (ri->d, a, b);
+
+            r_done (vm, L, nl, ri->a, a);
+            r_done (vm, L, nl, ri->b, b);
+
+            if (!rc)
+              pc = f->code + ri->c;
+          }
+          break;
+
+        case RO_JUMP:
+          pc = f->code + ri->c;
+          break;
+
+        case RO_JUMP_IF_FALSE:
+          {
+            obj_t *a = r_get (L, K, ri->a);
+            int no = sf_obj_isfalse (*a);
+
+            r_done (vm, L, nl, ri->a, a);
+
+            if (no)
+              pc = f->code + ri->c;
+          }
+          break;
+
+        case RO_RETURN:
+          r_push_slot (vm, L, K, nl, ri->a);
+          return SF_VM_RETURN;
+
+        case RO_STEP:
+          {
+            size_t s0 = vm->sp, next;
+
+            for (int j = 0; j < ri->a; j++)
+              r_push_slot (vm, L, K, nl, f->ops[ri->c + j]);
+
+            next = sf_vm_step (vm, ri->ip);
+
+            /* a return leaves its value on the stack, a tail call the
+               arguments of the function the frame goes on with */
+            if (next == SF_VM_STEP_END)
+              return SF_VM_RETURN;
+
+            if (ri->b & R_TAIL)
+              return SF_VM_TAIL;
+
+            L = vm->frames[vm->fp - 1].l.locals;
+
+            for (size_t j = s0; j < vm->sp; j++)
+              r_set (vm, L, ri->d + (int)(j - s0), vm->stack[j]);
+
+            vm->sp = s0;
+
+            if (next != ri->ip + 1)
+              pc = f->code + f->pc[next - f->lp];
+          }
+          break;
+
+        default:
+          assert (0 && "unknown register instruction");
+          break;
+        }
+    }
+}
+
+/**
+ * Runs the frame on top from vm->ip as register code if a coded
+ * function starts there. Returns how the frame was left, SF_VM_NEXT
+ * with vm->ip untouched if the stack VM has to run it.
+ */
+SF_API int
+sf_reg_run (vm_t *vm)
+{
+  reg_t *g = vm->reg;
+  size_t ip = vm->ip;
+
+  if (ip >= g->al || !g->at[ip]
+      || vm->frames[vm->fp - 1].type != FRAME_LOCAL)
+    return SF_VM_NEXT;
+
+  reg_fn_t *f = &g->fns[g->at[ip] - 1];
+
+  if (f->state == 0)
+    f->state = reg_translate (vm, f) ? 1 : -1;
+
+  if (f->state < 0)
+    return SF_VM_NEXT;
+
+  /* calls from it can add functions, and move fns */
+  reg_fn_t run = *f;
+
+  return reg_exec (vm, &run);
+}
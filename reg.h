@@ -0,0 +1,87 @@
+#if !defined(REG_H)
+#define REG_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+#include "object.h"
+
+/**
+ * FISH-R, a register encoding of coded functions with a dispatch loop
+ * of its own, run instead of the stack VM when a VM is set up with
+ * $SF_VM=reg (or sf_reg_use ()). The first call of a function
+ * translates its bytecode, once the passes are done with it. Register
+ * instructions name the slots of the frame's window they read and
+ * write: the function's locals, then one slot per stack depth. `a = b +
+ * c` is one ADD a, b, c, with no stack traffic and no references taken
+ * on b and c. Loads of locals and of int, float, bool and none
+ * constants fold into the instruction using them, a compare feeding a
+ * branch becomes a compare and branch. Any other stack instruction
+ * runs through sf_vm_step (), its operands pushed to the VM stack and
+ * its results taken back into the window.
+ *
+ * Functions the translation does not take, the ones with class bodies,
+ * imports or typed ops, and code outside functions run on the stack
+ * VM. The register VM stands in for the JIT and the types pass (typed
+ * ops are stack code), so picking it turns both off.
+ */
+enum VmTier
+{
+  SF_TIER_STACK = 0,
+  SF_TIER_REG = 1,
+};
+
+typedef struct
+{
+  int op;
+  int d, a, b; /* slots: locals, then temporaries; ~k is constant k */
+  int c;       /* a jump target, a comparison or a STEP's operands */
+  size_t ip;   /* the stack instruction it was */
+
+} rinstr_t;
+
+typedef struct
+{
+  size_t lp, end; /* instructions [lp, end) */
+  int state;      /* 0 until translated, -1 if it stays on the stack VM */
+
+  int nl;  /* locals, the temporaries follow */
+  int win; /* locals and temporaries */
+  rinstr_t *code;
+  size_t n;
+  int *ops; /* operand slots of STEPs */
+  obj_t **k;
+  size_t kl;
+  int *pc; /* ip - lp -> instruction, where a STEP can jump */
+
+} reg_fn_t;
+
+typedef struct _reg_s
+{
+  reg_fn_t *fns;
+  size_t fl;
+  size_t fc;
+
+  uint32_t *at; /* ip -> index into fns + 1, 0 if none */
+  size_t al;
+
+} reg_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API reg_t *sf_reg_new (int);
+  SF_API void sf_reg_free (reg_t *, vm_t *);
+  SF_API int sf_reg_parse (const char *, int);
+  SF_API void sf_reg_use (vm_t *, int);
+
+  SF_API void sf_reg_func (vm_t *, size_t, size_t);
+  SF_API int sf_reg_run (vm_t *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // REG_H
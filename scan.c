@@ -0,0 +1,243 @@
+#include "scan.h"
+#include "vec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86
+#include <immintrin.h>
+
+#define SCAN_SSE2_FN __attribute__ ((target ("sse2")))
+#define SCAN_AVX2_FN __attribute__ ((target ("avx2")))
+
+/* whole aligned blocks are read, past the NUL but never past its page */
+#define SCAN_WHOLE_BLOCKS __attribute__ ((no_sanitize_address))
+#endif // __GNUC__ && x86
+
+typedef struct
+{
+  size_t (*spaces) (const char *, char);
+  size_t (*ident) (const char *, char);
+  size_t (*digits) (const char *, char);
+  size_t (*string) (const char *, char);
+
+} scan_kernels_t;
+
+static inline int
+scan_isident (char c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+         || (c >= '0' && c <= '9') || c == '_';
+}
+
+static size_t
+spaces_scalar (const char *p, char q)
+{
+  const char *s = p;
+  (void)q;
+
+  while (*p == ' ')
+    p++;
+
+  return p - s;
+}
+
+static size_t
+ident_scalar (const char *p, char q)
+{
+  const char *s = p;
+  (void)q;
+
+  while (scan_isident (*p))
+    p++;
+
+  return p - s;
+}
+
+static size_t
+digits_scalar (const char *p, char q)
+{
+  const char *s = p;
+  (void)q;
+
+  while (*p >= '0' && *p <= '9')
+    p++;
+
+  return p - s;
+}
+
+static size_t
+string_scalar (const char *p, char q)
+{
+  const char *s = p;
+
+  while (*p && *p != q && *p != '\\')
+    p++;
+
+  return p - s;
+}
+
+static const scan_kernels_t scan_scalar = {
+  spaces_scalar,
+  ident_scalar,
+  digits_scalar,
+  string_scalar,
+};
+
+#if defined(SCAN_X86)
+
+/**
+ * NAME##_WIDTH scans aligned blocks for the first byte where the STOP
+ * expression (over block c and quote q) is set. Bytes of the first
+ * block that come before p are masked off. Only string uses q.
+ */
+#define SCAN_KERNEL(NAME, ISA, FN, V, W, LOAD, MOVEMASK, STOP)                \
+  FN SCAN_WHOLE_BLOCKS static size_t NAME##_##ISA (const char *p, char q)     \
+  {                                                                           \
+    const char *a = (const char *)((uintptr_t)p & ~(uintptr_t)(W - 1));       \
+    V c = LOAD ((const V *)a);                                                \
+    (void)q;                                                                  \
+    uint32_t m = (uint32_t)MOVEMASK (STOP) & (~0u << (p - a));                \
+                                                                              \
+    while (!m)                                                                \
+      {                                                                       \
+        a += W;                                                               \
+        c = LOAD ((const V *)a);                                              \
+        m = (uint32_t)MOVEMASK (STOP);                                        \
+      }                                                                       \
+                                                                              \
+    return a + __builtin_ctz (m) - p;                                         \
+  }
+
+#define SCAN_ISA(ISA, FN, V, W, X)                                            \
+  FN static inline V in_range_##ISA (V c, char lo, char hi)                   \
+  {                                                                           \
+    return X##_and_si##W (X##_cmpgt_epi8 (c, X##_set1_epi8 (lo - 1)),         \
+                          X##_cmpgt_epi8 (X##_set1_epi8 (hi + 1), c));        \
+  }                                                                           \
+                                                                              \
+  FN static inline V not_##ISA (V c)                                          \
+  {                                                                           \
+    return X##_cmpeq_epi8 (c, X##_setzero_si##W ());                          \
+  }                                                                           \
+                                                                              \
+  FN static inline V eq_##ISA (V c, char q)                                   \
+  {                                                                           \
+    return X##_cmpeq_epi8 (c, X##_set1_epi8 (q));                             \
+  }                                                                           \
+                                                                              \
+  FN static inline V ident_mask_##ISA (V c)                                   \
+  {                                                                           \
+    V l = X##_or_si##W (c, X##_set1_epi8 (0x20));                             \
+    return X##_or_si##W (                                                     \
+        X##_or_si##W (in_range_##ISA (l, 'a', 'z'),                           \
+                      in_range_##ISA (c, '0', '9')),                          \
+        eq_##ISA (c, '_'));                                                   \
+  }                                                                           \
+                                                                              \
+  SCAN_KERNEL (spaces, ISA, FN, V, W / 8, X##_load_si##W, X##_movemask_epi8,  \
+               not_##ISA (eq_##ISA (c, ' ')))                                 \
+  SCAN_KERNEL (ident, ISA, FN, V, W / 8, X##_load_si##W, X##_movemask_epi8,   \
+               not_##ISA (ident_mask_##ISA (c)))                              \
+  SCAN_KERNEL (digits, ISA, FN, V, W / 8, X##_load_si##W, X##_movemask_epi8,  \
+               not_##ISA (in_range_##ISA (c, '0', '9')))                      \
+  SCAN_KERNEL (string, ISA, FN, V, W / 8, X##_load_si##W, X##_movemask_epi8,  \
+               X##_or_si##W (X##_or_si##W (eq_##ISA (c, q),                   \
+                                           eq_##ISA (c, '\\')),               \
+                             not_##ISA (c)))
+
+SCAN_ISA (sse2, SCAN_SSE2_FN, __m128i, 128, _mm)
+SCAN_ISA (avx2, SCAN_AVX2_FN, __m256i, 256, _mm256)
+
+static const scan_kernels_t scan_sse2 = {
+  spaces_sse2,
+  ident_sse2,
+  digits_sse2,
+  string_sse2,
+};
+
+static const scan_kernels_t scan_avx2 = {
+  spaces_avx2,
+  ident_avx2,
+  digits_avx2,
+  string_avx2,
+};
+
+#endif // SCAN_X86
+
+static const scan_kernels_t *_Atomic scan_k = &scan_scalar;
+
+/**
+ * Follows sf_vec_setlevel, the lexer calls this once per source. Lexers
+ * on other threads may be reading scan_k meanwhile, so it is atomic;
+ * the kernel tables are constant, so nothing else needs ordering.
+ */
+SF_API void
+sf_scan_init (void)
+{
+  const scan_kernels_t *k = &scan_scalar;
+
+#if defined(SCAN_X86)
+  if (sf_vec_level () >= VEC_LEVEL_AVX2)
+    k = &scan_avx2;
+  else if (sf_vec_level () >= VEC_LEVEL_SSE2)
+    k = &scan_sse2;
+#endif // SCAN_X86
+
+  atomic_store_explicit (&scan_k, k, memory_order_relaxed);
+}
+
+static inline const scan_kernels_t *
+scan_kernels (void)
+{
+  return atomic_load_explicit (&scan_k, memory_order_relaxed);
+}
+
+/**
+ * Most runs are a few bytes long, a vector pass costs more than it
+ * saves there. The wrappers scan the first SCAN_SHORT bytes in C and
+ * only hand longer runs to the kernels.
+ */
+#define SCAN_SHORT (8)
+
+SF_API size_t
+sf_scan_spaces (const char *p)
+{
+  size_t n = 0;
+
+  while (n < SCAN_SHORT && p[n] == ' ')
+    n++;
+
+  return n < SCAN_SHORT ? n : n + scan_kernels ()->spaces (p + n, ' ');
+}
+
+SF_API size_t
+sf_scan_ident (const char *p)
+{
+  size_t n = 0;
+
+  while (n < SCAN_SHORT && scan_isident (p[n]))
+    n++;
+
+  return n < SCAN_SHORT ? n : n + scan_kernels ()->ident (p + n, '\0');
+}
+
+SF_API size_t
+sf_scan_digits (const char *p)
+{
+  size_t n = 0;
+
+  while (n < SCAN_SHORT && p[n] >= '0' && p[n] <= '9')
+    n++;
+
+  return n < SCAN_SHORT ? n : n + scan_kernels ()->digits (p + n, '\0');
+}
+
+SF_API size_t
+sf_scan_string (const char *p, char q)
+{
+  size_t n = 0;
+
+  while (n < SCAN_SHORT && p[n] && p[n] != q && p[n] != '\\')
+    n++;
+
+  return n < SCAN_SHORT ? n : n + scan_kernels ()->string (p + n, q);
+}
@@ -0,0 +1,28 @@
+#if !defined(SCAN_H)
+#define SCAN_H
+
+#include "header.h"
+
+/**
+ * Run scanners for the lexer. Each returns how many bytes from p
+ * belong to the run; all of them stop at the terminating NUL. The
+ * SSE2/AVX2 versions follow the level picked in vec.c (SF_VEC caps it)
+ * and only do aligned loads, so they never read into the next page.
+ */
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_scan_init (void);
+
+  SF_API size_t sf_scan_spaces (const char *);
+  SF_API size_t sf_scan_ident (const char *);
+  SF_API size_t sf_scan_digits (const char *);
+  SF_API size_t sf_scan_string (const char *, char);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // SCAN_H
@@ -0,0 +1,81 @@
+#include "scope.h"
+
+#define SCOPE_MIN_CAP (4)
+
+/* names are interned, their address is the key */
+static inline uint64_t
+name_hash (const char *name)
+{
+  uint64_t h = (uint64_t)(uintptr_t)name;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+SF_API void
+sf_scope_open (scope_t *sc, arena_t *a)
+{
+  sc->mark = sf_arena_mark (a);
+  sc->ec = SCOPE_MIN_CAP;
+  sc->el = 0;
+  sc->ents = sf_arena_alloc (a, sc->ec * sizeof (*sc->ents));
+
+  sf_swiss_init (&sc->idx, 0);
+}
+
+SF_API void
+sf_scope_close (scope_t *sc, arena_t *a)
+{
+  sf_swiss_free (&sc->idx);
+  sf_arena_release (a, sc->mark);
+}
+
+SF_API vval_t *
+sf_scope_get (scope_t *sc, const char *name)
+{
+  uint64_t h = name_hash (name);
+  swiss_iter_t it;
+  int32_t i;
+
+  sf_swiss_find (&sc->idx, h, &it);
+
+  while ((i = sf_swiss_next (&sc->idx, &it)) != -1)
+    if (sc->ents[i].name == name)
+      return &sc->ents[i].v;
+
+  return NULL;
+}
+
+/**
+ * The name must not be in the scope yet. The result stays valid until
+ * the next add to the same scope.
+ */
+SF_API vval_t *
+sf_scope_add (scope_t *sc, arena_t *a, const char *name, vval_t v)
+{
+  uint64_t h = name_hash (name);
+
+  if (sc->el == sc->ec || sf_swiss_full (&sc->idx))
+    {
+      if (sc->el == sc->ec)
+        {
+          sc->ents = sf_arena_grow (a, sc->ents, sc->ec * sizeof (*sc->ents),
+                                    2 * sc->ec * sizeof (*sc->ents));
+          sc->ec <<= 1;
+        }
+
+      sf_swiss_free (&sc->idx);
+      sf_swiss_init (&sc->idx, sc->el * 2 > sc->ec ? sc->el * 2 : sc->ec);
+
+      for (size_t i = 0; i < sc->el; i++)
+        sf_swiss_insert (&sc->idx, sc->ents[i].hash, (int32_t)i);
+    }
+
+  sc->ents[sc->el] = (scope_ent_t){ .name = name, .hash = h, .v = v };
+  sf_swiss_insert (&sc->idx, h, (int32_t)sc->el);
+
+  return &sc->ents[sc->el++].v;
+}
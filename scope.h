@@ -0,0 +1,55 @@
+#if !defined(SCOPE_H)
+#define SCOPE_H
+
+#include "arena.h"
+#include "header.h"
+#include "swiss.h"
+
+typedef struct
+{
+  size_t pos;
+  int slot;
+
+} vval_t;
+
+typedef struct
+{
+  const char *name;
+  uint64_t hash;
+  vval_t v;
+
+} scope_ent_t;
+
+/**
+ * Names of one codegen scope. Names are interned, so they are keyed by
+ * address. Entries sit in the compile arena and scopes only nest, so
+ * the innermost scope grows in place and closing it gives its memory
+ * back to the arena. Like a dict, a scope gets a swiss index only once
+ * it outgrows SF_SWISS_SMALL names.
+ */
+typedef struct
+{
+  scope_ent_t *ents;
+  size_t el, ec;
+
+  swiss_t idx;
+  arena_mark_t mark; /* the arena before this scope was opened */
+
+} scope_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_scope_open (scope_t *, arena_t *);
+  SF_API void sf_scope_close (scope_t *, arena_t *);
+
+  SF_API vval_t *sf_scope_get (scope_t *, const char *);
+  SF_API vval_t *sf_scope_add (scope_t *, arena_t *, const char *, vval_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // SCOPE_H
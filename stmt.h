@@ -1,6 +1,7 @@
 #if !defined(STMT_H)
 #define STMT_H
 
+#include "arena.h"
 #include "expr.h"
 #include "header.h"
 #include "malloc.h"
@@ -113,6 +114,8 @@ typedef struct
   size_t vl;
   size_t vc;
 
+  arena_t arena; /* every node of a tree from sf_ast_gen */
+
 } StmtSM;
 
 #define STMT_SM_VALS_CAP (512)
@@ -123,7 +126,6 @@ extern "C"
 #endif // __cplusplus
 
   SF_API void sf_stmt_print (stmt_t);
-  SF_API void sf_stmt_free (stmt_t *);
 
 #if defined(__cplusplus)
 }
@@ -1,19 +1,26 @@
 #if !defined(SUNFLOWER_H)
 #define SUNFLOWER_H
 
+#include "aot.h"
+#include "arena.h"
 #include "ast.h"
 #include "bytecode.h"
 #include "cl.h"
 #include "codegen.h"
 #include "const.h"
 #include "expr.h"
+#include "fishc.h"
 #include "header.h"
-#include "ht.h"
+#include "imports.h"
+#include "jit.h"
 #include "malloc.h"
 #include "mut.h"
 #include "natives.h"
 #include "object.h"
+#include "opt.h"
+#include "reg.h"
 #include "stmt.h"
 #include "token.h"
+#include "verify.h"
 
 #endif // SUNFLOWER_H
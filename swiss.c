@@ -0,0 +1,198 @@
+#include "swiss.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#define H1(X) ((size_t)((X) >> 7))
+#define H2(X) ((int8_t)((X) & 0x7f))
+
+/* bit i set when control byte i of the group equals c */
+static inline uint32_t
+group_match (const int8_t *g, int8_t c)
+{
+#if defined(__SSE2__)
+  __m128i v = _mm_loadu_si128 ((const __m128i *)g);
+  return (uint32_t)_mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 (c)));
+#else
+  uint32_t m = 0;
+
+  for (int i = 0; i < SF_SWISS_GROUP; i++)
+    m |= (uint32_t)(g[i] == c) << i;
+
+  return m;
+#endif // __SSE2__
+}
+
+/* empty and deleted are the only control bytes with the sign bit set */
+static inline uint32_t
+group_free (const int8_t *g)
+{
+#if defined(__SSE2__)
+  return (uint32_t)_mm_movemask_epi8 (
+      _mm_loadu_si128 ((const __m128i *)g));
+#else
+  uint32_t m = 0;
+
+  for (int i = 0; i < SF_SWISS_GROUP; i++)
+    m |= (uint32_t)(g[i] < 0) << i;
+
+  return m;
+#endif // __SSE2__
+}
+
+/* groups are aligned, probing walks them in triangular steps */
+static inline size_t
+group_first (swiss_t *s, uint64_t h)
+{
+  return H1 (h) & (s->cap - 1) & ~(size_t)(SF_SWISS_GROUP - 1);
+}
+
+SF_API void
+sf_swiss_init (swiss_t *s, size_t n)
+{
+  s->n = 0;
+
+  if (n <= SF_SWISS_SMALL)
+    {
+      s->ctrl = NULL;
+      s->slots = NULL;
+      s->cap = 0;
+      s->left = SF_SWISS_SMALL;
+      return;
+    }
+
+  size_t cap = SF_SWISS_GROUP;
+
+  while (cap - cap / 8 < n)
+    cap <<= 1;
+
+  s->cap = cap;
+  s->left = cap - cap / 8;
+  s->ctrl = SFMALLOC (cap * sizeof (*s->ctrl));
+  s->slots = SFMALLOC (cap * sizeof (*s->slots));
+
+  memset (s->ctrl, SF_SWISS_EMPTY, cap * sizeof (*s->ctrl));
+}
+
+SF_API void
+sf_swiss_free (swiss_t *s)
+{
+  if (s->ctrl == NULL)
+    return;
+
+  SFFREE (s->ctrl);
+  SFFREE (s->slots);
+  s->ctrl = NULL;
+  s->slots = NULL;
+}
+
+/* the caller rebuilds the index from its entries when this is set */
+SF_API int
+sf_swiss_full (swiss_t *s)
+{
+  return !s->left;
+}
+
+SF_API void
+sf_swiss_find (swiss_t *s, uint64_t h, swiss_iter_t *it)
+{
+  it->step = 0;
+  it->g = 0;
+
+  if (s->ctrl == NULL)
+    return;
+
+  it->h2 = H2 (h);
+  it->g = group_first (s, h);
+  it->m = group_match (s->ctrl + it->g, it->h2);
+  it->last = group_match (s->ctrl + it->g, SF_SWISS_EMPTY) != 0;
+}
+
+/**
+ * Next entry position whose control byte matches, or -1. Small tables
+ * yield every entry, callers compare the cached hash either way.
+ */
+SF_API int32_t
+sf_swiss_next (swiss_t *s, swiss_iter_t *it)
+{
+  if (s->ctrl == NULL)
+    {
+      if (it->g >= s->n)
+        return -1;
+
+      it->at = it->g;
+      return (int32_t)it->g++;
+    }
+
+  while (!it->m)
+    {
+      if (it->last)
+        return -1;
+
+      it->step += SF_SWISS_GROUP;
+      it->g = (it->g + it->step) & (s->cap - 1);
+      it->m = group_match (s->ctrl + it->g, it->h2);
+      it->last = group_match (s->ctrl + it->g, SF_SWISS_EMPTY) != 0;
+    }
+
+  it->at = it->g + __builtin_ctz (it->m);
+  it->m &= it->m - 1;
+
+  return s->slots[it->at];
+}
+
+/* v must not be indexed yet, small tables take entries in order */
+SF_API void
+sf_swiss_insert (swiss_t *s, uint64_t h, int32_t v)
+{
+  assert (s->left);
+
+  if (s->ctrl == NULL)
+    {
+      assert ((size_t)v == s->n);
+      s->n++;
+      s->left--;
+      return;
+    }
+
+  size_t g = group_first (s, h);
+  size_t step = 0;
+  uint32_t f;
+
+  while (!(f = group_free (s->ctrl + g)))
+    {
+      step += SF_SWISS_GROUP;
+      g = (g + step) & (s->cap - 1);
+    }
+
+  size_t at = g + __builtin_ctz (f);
+
+  if (s->ctrl[at] == SF_SWISS_EMPTY)
+    s->left--;
+
+  s->ctrl[at] = H2 (h);
+  s->slots[at] = v;
+}
+
+/**
+ * Drops the slot of the last match. A group that still has an empty
+ * slot never made a probe move past it, so the slot can go back to
+ * empty instead of leaving a tombstone.
+ */
+SF_API void
+sf_swiss_erase (swiss_t *s, swiss_iter_t *it)
+{
+  if (s->ctrl == NULL)
+    return;
+
+  size_t g = it->at & ~(size_t)(SF_SWISS_GROUP - 1);
+
+  if (group_match (s->ctrl + g, SF_SWISS_EMPTY))
+    {
+      s->ctrl[it->at] = SF_SWISS_EMPTY;
+      s->left++;
+    }
+  else
+    s->ctrl[it->at] = SF_SWISS_DELETED;
+}
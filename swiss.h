@@ -0,0 +1,66 @@
+#if !defined(SWISS_H)
+#define SWISS_H
+
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Hash index shared by dict_t, scope_t and the module store. All keep
+ * their entries in a dense array with the hash cached next to the key;
+ * this maps a hash to candidate entry positions.
+ *
+ * Every slot has a control byte, either empty, deleted, or the low 7
+ * bits of the hash of the entry it holds. Probing loads 16 control
+ * bytes at a time and compares them all against the hash in one go, so
+ * entries are only touched for slots whose 7 bits already match.
+ *
+ * Up to SF_SWISS_SMALL entries there is no index at all, lookups just
+ * walk the entries and compare the cached hashes.
+ */
+#define SF_SWISS_GROUP (16)
+#define SF_SWISS_SMALL (8)
+
+#define SF_SWISS_EMPTY ((int8_t)-128)
+#define SF_SWISS_DELETED ((int8_t)-2)
+
+typedef struct
+{
+  int8_t *ctrl; /* NULL while the table is small */
+  int32_t *slots;
+  size_t cap;  /* power of two, at least SF_SWISS_GROUP */
+  size_t left; /* inserts that fit before a rebuild */
+  size_t n;    /* entries while small */
+
+} swiss_t;
+
+typedef struct
+{
+  size_t g; /* first slot of the group being matched */
+  size_t step;
+  size_t at; /* slot of the last match */
+  uint32_t m;
+  int last;
+  int8_t h2;
+
+} swiss_iter_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_swiss_init (swiss_t *, size_t);
+  SF_API void sf_swiss_free (swiss_t *);
+  SF_API int sf_swiss_full (swiss_t *);
+
+  SF_API void sf_swiss_find (swiss_t *, uint64_t, swiss_iter_t *);
+  SF_API int32_t sf_swiss_next (swiss_t *, swiss_iter_t *);
+
+  SF_API void sf_swiss_insert (swiss_t *, uint64_t, int32_t);
+  SF_API void sf_swiss_erase (swiss_t *, swiss_iter_t *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // SWISS_H
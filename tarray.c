@@ -0,0 +1,194 @@
+#include "tarray.h"
+#include "object.h"
+
+#include <limits.h>
+
+SF_API size_t
+sf_tarray_elsize (int type)
+{
+  switch (type)
+    {
+    case TARRAY_I32:
+      return sizeof (int32_t);
+    case TARRAY_I64:
+      return sizeof (int64_t);
+    case TARRAY_F64:
+      return sizeof (double);
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+SF_API const char *
+sf_tarray_typename (int type)
+{
+  switch (type)
+    {
+    case TARRAY_I32:
+      return "i32";
+    case TARRAY_I64:
+      return "i64";
+    case TARRAY_F64:
+      return "f64";
+    default:
+      break;
+    }
+
+  return "?";
+}
+
+SF_API tarray_t *
+sf_tarray_new (int type, size_t len)
+{
+  tarray_t *t = SFMALLOC (sizeof (*t));
+  t->type = type;
+  t->len = len;
+  t->borrowed = 0;
+
+  /* never hand out NULL, kernels index the buffer unconditionally */
+  t->v.raw = SFMALLOC ((len ? len : 1) * sf_tarray_elsize (type));
+  memset (t->v.raw, 0, len * sf_tarray_elsize (type));
+
+  return t;
+}
+
+SF_API tarray_t *
+sf_tarray_alias (int type, void *buf, size_t len)
+{
+  tarray_t *t = SFMALLOC (sizeof (*t));
+  t->type = type;
+  t->len = len;
+  t->borrowed = 1;
+  t->v.raw = buf;
+
+  return t;
+}
+
+SF_API void
+sf_tarray_free (tarray_t *t)
+{
+  if (!t->borrowed)
+    SFFREE (t->v.raw);
+
+  SFFREE (t);
+}
+
+SF_API const_t
+sf_tarray_get (tarray_t *t, size_t i)
+{
+  const_t c;
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      c.type = CONST_INT;
+      c.v.c_int.v = t->v.i32[i];
+      break;
+
+    case TARRAY_I64:
+      /* the VM's integers are C ints, one that does not fit is an error
+         rather than wrapped around */
+      if (t->v.i64[i] < INT_MIN || t->v.i64[i] > INT_MAX)
+        {
+          printf ("i64 array element %lld does not fit in an int.\n",
+                  (long long)t->v.i64[i]);
+          exit (EXIT_FAILURE);
+        }
+
+      c.type = CONST_INT;
+      c.v.c_int.v = (int)t->v.i64[i];
+      break;
+
+    case TARRAY_F64:
+      /* the VM's floats are single precision, the element is rounded to
+         the nearest one; kernels and copies keep the double */
+      c.type = CONST_FLOAT;
+      c.v.c_float.v = (float)t->v.f64[i];
+      break;
+
+    default:
+      c.type = CONST_NONE;
+      break;
+    }
+
+  return c;
+}
+
+SF_API void
+sf_tarray_set (tarray_t *t, size_t i, const_t c)
+{
+  double d = 0.0;
+  int64_t n = 0;
+
+  switch (c.type)
+    {
+    case CONST_INT:
+      n = c.v.c_int.v;
+      d = (double)n;
+      break;
+
+    case CONST_FLOAT:
+      d = c.v.c_float.v;
+      n = (int64_t)d;
+      break;
+
+    case CONST_BOOL:
+      n = c.v.c_bool.v != 0;
+      d = (double)n;
+      break;
+
+    default:
+      printf ("cannot store non-numeric value in %s array.\n",
+              sf_tarray_typename (t->type));
+      exit (EXIT_FAILURE);
+    }
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      t->v.i32[i] = (int32_t)n;
+      break;
+
+    case TARRAY_I64:
+      t->v.i64[i] = n;
+      break;
+
+    case TARRAY_F64:
+      t->v.f64[i] = d;
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* element copy between typed arrays, without sf_tarray_get's narrowing */
+SF_API void
+sf_tarray_copyel (tarray_t *d, size_t i, tarray_t *s, size_t j)
+{
+  if (d->type == TARRAY_F64)
+    {
+      d->v.f64[i] = s->type == TARRAY_I32   ? s->v.i32[j]
+                    : s->type == TARRAY_I64 ? (double)s->v.i64[j]
+                                            : s->v.f64[j];
+      return;
+    }
+
+  int64_t n = s->type == TARRAY_I32   ? s->v.i32[j]
+              : s->type == TARRAY_I64 ? s->v.i64[j]
+                                      : (int64_t)s->v.f64[j];
+
+  if (d->type == TARRAY_I32)
+    d->v.i32[i] = (int32_t)n;
+  else
+    d->v.i64[i] = n;
+}
+
+SF_API struct object_s *
+sf_tarray_box (tarray_t *t, size_t i)
+{
+  const_t c = sf_tarray_get (t, i);
+  return sf_objstore_box (&c);
+}
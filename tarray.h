@@ -0,0 +1,63 @@
+#if !defined(TARRAY_H)
+#define TARRAY_H
+
+#include "const.h"
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * Typed arrays store numbers unboxed in one contiguous buffer.
+ * Elements only become obj_t's when they escape into the VM
+ * (OP_SQR_ACCESS, iteration), stores write straight into the buffer.
+ * Every read boxes, even when an arithmetic op is all that takes the
+ * value: no tier (types pass, JIT, FISH-R, sunflower-aot) reads
+ * elements unboxed yet. An i64 element outside the range of an int is
+ * an error when read, an f64 one is rounded to the VM's float.
+ */
+enum TArrayType
+{
+  TARRAY_I32 = 0,
+  TARRAY_I64 = 1,
+  TARRAY_F64 = 2,
+};
+
+struct object_s;
+typedef struct __tarray_s
+{
+  int type;
+
+  union
+  {
+    int32_t *i32;
+    int64_t *i64;
+    double *f64;
+    void *raw;
+
+  } v;
+
+  size_t len;
+  int borrowed; /* buffer belongs to another array, see sf_tarray_alias */
+
+} tarray_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API tarray_t *sf_tarray_new (int, size_t);
+  SF_API tarray_t *sf_tarray_alias (int, void *, size_t);
+  SF_API void sf_tarray_free (tarray_t *);
+  SF_API size_t sf_tarray_elsize (int);
+  SF_API const char *sf_tarray_typename (int);
+
+  SF_API const_t sf_tarray_get (tarray_t *, size_t);
+  SF_API void sf_tarray_set (tarray_t *, size_t, const_t);
+  SF_API void sf_tarray_copyel (tarray_t *, size_t, tarray_t *, size_t);
+  SF_API struct object_s *sf_tarray_box (tarray_t *, size_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // TARRAY_H
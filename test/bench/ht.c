@@ -0,0 +1,137 @@
+#include "ht.h"
+
+#define HT_MIN_CAP (4)
+
+static inline uint64_t
+fnv1a_hash (const char *s)
+{
+  uint64_t h = 14695981039346656037ULL;
+  while (*s)
+    {
+      h ^= (unsigned char)*s++;
+      h *= 1099511628211ULL;
+    }
+  return h;
+}
+
+/* drop deleted entries and rebuild the index with room for one more */
+static void
+ht_grow (hashtable_t *ht)
+{
+  size_t w = 0;
+
+  for (size_t i = 0; i < ht->vl; i++)
+    if (ht->vals[i].name != NULL)
+      ht->vals[w++] = ht->vals[i];
+
+  ht->vl = w;
+
+  if (ht->vl == ht->vc)
+    {
+      ht->vc <<= 1;
+      ht->vals = SFREALLOC (ht->vals, ht->vc * sizeof (*ht->vals));
+    }
+
+  sf_swiss_free (&ht->idx);
+  sf_swiss_init (&ht->idx, ht->vl * 2 > ht->vc ? ht->vl * 2 : ht->vc);
+
+  for (size_t i = 0; i < ht->vl; i++)
+    sf_swiss_insert (&ht->idx, ht->vals[i].hash, (int32_t)i);
+}
+
+static htval_t *
+ht_find (hashtable_t *ht, const char *key, uint64_t hash, swiss_iter_t *it)
+{
+  int32_t i;
+  sf_swiss_find (&ht->idx, hash, it);
+
+  while ((i = sf_swiss_next (&ht->idx, it)) != -1)
+    {
+      htval_t *e = &ht->vals[i];
+
+      if (e->hash == hash && e->name != NULL && strcmp (e->name, key) == 0)
+        return e;
+    }
+
+  return NULL;
+}
+
+SF_API hashtable_t *
+sf_ht_new (void)
+{
+  hashtable_t *ht = SFMALLOC (sizeof (*ht));
+  ht->vc = HT_MIN_CAP;
+  ht->vl = 0;
+  ht->len = 0;
+  ht->vals = SFMALLOC (ht->vc * sizeof (*ht->vals));
+
+  sf_swiss_init (&ht->idx, 0);
+  return ht;
+}
+
+SF_API void
+sf_ht_free (hashtable_t *ht)
+{
+  for (size_t i = 0; i < ht->vl; i++)
+    {
+      if (ht->vals[i].name != NULL && ht->vals[i].val != NULL)
+        {
+          // SFFREE (ht->vals[i].name);
+          SFFREE (ht->vals[i].val);
+        }
+    }
+
+  sf_swiss_free (&ht->idx);
+  SFFREE (ht->vals);
+  SFFREE (ht);
+}
+
+SF_API void
+sf_ht_insert (hashtable_t *ht, const char *key, void *val)
+{
+  uint64_t hash = fnv1a_hash (key);
+  swiss_iter_t it;
+  htval_t *e = ht_find (ht, key, hash, &it);
+
+  if (e != NULL)
+    {
+      e->val = val;
+      return;
+    }
+
+  if (ht->vl == ht->vc || sf_swiss_full (&ht->idx))
+    ht_grow (ht);
+
+  ht->vals[ht->vl] = (htval_t){ .hash = hash, .name = (char *)key, .val = val };
+  sf_swiss_insert (&ht->idx, hash, (int32_t)ht->vl++);
+  ht->len++;
+}
+
+SF_API void *
+sf_ht_get (hashtable_t *ht, const char *key, int *gr)
+{
+  swiss_iter_t it;
+  htval_t *e = ht_find (ht, key, fnv1a_hash (key), &it);
+
+  if (gr)
+    *gr = e != NULL;
+
+  return e != NULL ? e->val : NULL;
+}
+
+SF_API void
+sf_ht_delete (hashtable_t *ht, const char *key)
+{
+  swiss_iter_t it;
+  htval_t *e = ht_find (ht, key, fnv1a_hash (key), &it);
+
+  if (e == NULL)
+    return;
+
+  /* names belong to the caller, same as in sf_ht_free */
+  e->name = NULL;
+  e->val = NULL;
+
+  sf_swiss_erase (&ht->idx, &it);
+  ht->len--;
+}
@@ -3,45 +3,32 @@
 
 #include "header.h"
 #include "malloc.h"
-
-typedef enum
-{
-  HT_EMPTY = 0,
-  HT_ACTIVE,
-  HT_TOMBSTONE
-} ht_state_t;
+#include "swiss.h"
 
 typedef struct
 {
   uint64_t hash;
-  char *name;
+  char *name; /* NULL once deleted */
   void *val;
-  ht_state_t state;
 } htval_t;
 
-#define SF_FASTCACHE_SIZE (8)
-
-typedef struct
-{
-  char *keys[SF_FASTCACHE_SIZE];
-  void *vals[SF_FASTCACHE_SIZE];
-  size_t c;
-
-} fastcache_t;
-
+/**
+ * Names to values, what codegen scopes were before scope_t. Only
+ * HT_BENCH builds it now. Entries are kept in insertion order, the
+ * swiss index finds them by hash. A table starts out with room for a
+ * handful of names and no index.
+ */
 typedef struct
 {
   htval_t *vals;
-  size_t cap;
-  size_t entries;
-  size_t tombstones;
+  size_t vl; /* entries used, deleted ones included */
+  size_t vc;
+  size_t len; /* live entries */
 
-  fastcache_t fast;
+  swiss_t idx;
 
 } hashtable_t;
 
-#define SF_HT_LINEAR_CUTOFF 12
-
 #if defined(__cplusplus)
 extern "C"
 {
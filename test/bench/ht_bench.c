@@ -0,0 +1,525 @@
+/**
+ * hashtable_t against the table it replaced (quadratic probing over
+ * 1024 inline slots plus an 8 entry strcmp cache, kept below with an
+ * old_ prefix, less the delete nothing here times).
+ *
+ *   HT_BENCH [scale]    time both tables
+ *   HT_BENCH --check    only check the new table
+ */
+#include "ht.h"
+#include <sunflower.h>
+#include <time.h>
+
+typedef enum
+{
+  OLD_EMPTY = 0,
+  OLD_ACTIVE,
+  OLD_TOMBSTONE
+} old_state_t;
+
+typedef struct
+{
+  uint64_t hash;
+  char *name;
+  void *val;
+  old_state_t state;
+} old_htval_t;
+
+#define OLD_FASTCACHE_SIZE (8)
+
+typedef struct
+{
+  char *keys[OLD_FASTCACHE_SIZE];
+  void *vals[OLD_FASTCACHE_SIZE];
+  size_t c;
+
+} old_fastcache_t;
+
+typedef struct
+{
+  old_htval_t *vals;
+  size_t cap;
+  size_t entries;
+  size_t tombstones;
+
+  old_fastcache_t fast;
+
+} old_ht_t;
+
+static inline uint64_t
+old_fnv1a (const char *s)
+{
+  uint64_t h = 14695981039346656037ULL;
+  while (*s)
+    {
+      h ^= (unsigned char)*s++;
+      h *= 1099511628211ULL;
+    }
+  return h;
+}
+
+static inline size_t
+old_next_pow2 (size_t x)
+{
+  size_t p = 1;
+  while (p < x)
+    p <<= 1;
+  return p;
+}
+
+static void
+old_init_table (old_ht_t *ht, size_t cap)
+{
+  ht->cap = old_next_pow2 (cap);
+  ht->entries = 0;
+  ht->tombstones = 0;
+
+  ht->vals = SFMALLOC (ht->cap * sizeof (*ht->vals));
+  for (size_t i = 0; i < ht->cap; i++)
+    {
+      ht->vals[i].state = OLD_EMPTY;
+      ht->vals[i].name = NULL;
+      ht->vals[i].val = NULL;
+    }
+
+  ht->fast.c = 0;
+}
+
+static void
+old_resize (old_ht_t *ht, size_t new_cap)
+{
+  old_htval_t *old_vals = ht->vals;
+  size_t old_cap = ht->cap;
+
+  old_init_table (ht, new_cap);
+
+  size_t mask = ht->cap - 1;
+
+  for (size_t i = 0; i < old_cap; i++)
+    {
+      if (old_vals[i].state != OLD_ACTIVE)
+        continue;
+
+      uint64_t h = old_vals[i].hash;
+      size_t idx = h & mask;
+      size_t step = 1;
+
+      while (ht->vals[idx].state == OLD_ACTIVE)
+        {
+          idx = (idx + step) & mask;
+          step += 2;
+        }
+
+      ht->vals[idx] = old_vals[i];
+      ht->entries++;
+    }
+
+  SFFREE (old_vals);
+}
+
+static old_ht_t *
+old_ht_new (void)
+{
+  old_ht_t *ht = SFMALLOC (sizeof (*ht));
+  old_init_table (ht, 1024);
+  return ht;
+}
+
+static void
+old_ht_free (old_ht_t *ht)
+{
+  for (size_t i = 0; i < ht->fast.c; i++)
+    {
+      SFFREE (ht->fast.vals[i]);
+    }
+
+  for (size_t i = 0; i < ht->cap; i++)
+    {
+      if (ht->vals[i].val != NULL)
+        {
+          // SFFREE (ht->vals[i].name);
+          SFFREE (ht->vals[i].val);
+        }
+    }
+
+  SFFREE (ht->vals);
+  SFFREE (ht);
+}
+
+static void
+old_ht_insert (old_ht_t *ht, const char *key, void *val)
+{
+  if (ht->fast.c < OLD_FASTCACHE_SIZE)
+    {
+      ht->fast.keys[ht->fast.c] = (char *)key;
+      ht->fast.vals[ht->fast.c++] = val;
+
+      return;
+    }
+
+  if ((ht->entries + ht->tombstones) * 10 >= ht->cap * 7)
+    old_resize (ht, ht->cap * 2);
+
+  uint64_t hash = old_fnv1a (key);
+  size_t mask = ht->cap - 1;
+  size_t idx = hash & mask;
+  size_t step = 1;
+
+  ssize_t tomb = -1;
+
+  while (1)
+    {
+      old_htval_t *e = &ht->vals[idx];
+
+      if (step > 32)
+        {
+          old_resize (ht, ht->cap);
+          return old_ht_insert (ht, key, val);
+        }
+
+      if (e->state == OLD_EMPTY)
+        {
+          if (tomb != -1)
+            {
+              idx = (size_t)tomb;
+              ht->tombstones--;
+            }
+
+          ht->vals[idx] = (old_htval_t){
+            .hash = hash, .name = (char *)key, .val = val, .state = OLD_ACTIVE
+          };
+          ht->entries++;
+          return;
+        }
+
+      if (e->state == OLD_TOMBSTONE && tomb == -1)
+        tomb = (ssize_t)idx;
+
+      else if (e->state == OLD_ACTIVE && e->hash == hash
+               && strcmp (e->name, key) == 0)
+        {
+          e->val = val;
+          return;
+        }
+
+      idx = (idx + step) & mask;
+      step += 2;
+    }
+}
+
+static void *
+old_ht_get (old_ht_t *ht, const char *key, int *gr)
+{
+  for (size_t i = 0; i < ht->fast.c; i++)
+    {
+      if (!strcmp (ht->fast.keys[i], key))
+        {
+          if (gr != NULL)
+            *gr = 1;
+
+          return ht->fast.vals[i];
+        }
+    }
+
+  uint64_t hash = old_fnv1a (key);
+  size_t mask = ht->cap - 1;
+  size_t idx = hash & mask;
+  size_t step = 1;
+
+  while (1)
+    {
+      old_htval_t *e = &ht->vals[idx];
+
+      if (e->state == OLD_EMPTY)
+        break;
+
+      if (e->state == OLD_ACTIVE && e->hash == hash
+          && strcmp (e->name, key) == 0)
+        {
+          if (gr)
+            *gr = 1;
+          return e->val;
+        }
+
+      idx = (idx + step) & mask;
+      step += 2;
+    }
+
+  if (gr)
+    *gr = 0;
+  return NULL;
+}
+
+static inline double
+now_sec (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char **
+make_keys (size_t n, const char *pfx)
+{
+  char **k = SFMALLOC (n * sizeof (*k));
+
+  for (size_t i = 0; i < n; i++)
+    {
+      char b[32];
+      snprintf (b, sizeof (b), "%s%zu", pfx, i);
+      k[i] = SFSTRDUP (b);
+    }
+
+  return k;
+}
+
+static void
+free_keys (char **k, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    SFFREE (k[i]);
+
+  SFFREE (k);
+}
+
+static void
+expect (int c, const char *what, size_t i)
+{
+  if (c)
+    return;
+
+  printf ("ht_bench: %s failed at %zu\n", what, i);
+  exit (EXIT_FAILURE);
+}
+
+static int *
+boxed (size_t i)
+{
+  int *p = SFMALLOC (sizeof (*p));
+  *p = (int)i;
+  return p;
+}
+
+static void
+check (size_t n)
+{
+  char **keys = make_keys (n, "k");
+  char **miss = make_keys (n, "m");
+  hashtable_t *ht = sf_ht_new ();
+
+  for (size_t i = 0; i < n; i++)
+    {
+      sf_ht_insert (ht, keys[i], boxed (i));
+
+      /* the scopes look names up while they are still being filled */
+      for (size_t j = 0; j <= i; j += 1 + i / 16)
+        {
+          int g = 0;
+          int *v = sf_ht_get (ht, keys[j], &g);
+          expect (g && *v == (int)j, "get", j);
+
+          sf_ht_get (ht, miss[j], &g);
+          expect (!g, "miss", j);
+        }
+    }
+
+  expect (ht->len == n, "len", n);
+
+  for (size_t i = 0; i < n; i += 2)
+    {
+      int g = 1;
+      SFFREE (sf_ht_get (ht, keys[i], NULL));
+      sf_ht_delete (ht, keys[i]);
+      sf_ht_get (ht, keys[i], &g);
+      expect (!g, "delete", i);
+    }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      int g = 0;
+      int *v = sf_ht_get (ht, keys[i], &g);
+      expect (g == (int)(i & 1) && (!g || *v == (int)i), "get after delete",
+              i);
+    }
+
+  /* deleted names can come back, the table compacts around them */
+  for (size_t i = 0; i < n; i += 2)
+    sf_ht_insert (ht, keys[i], boxed (i));
+
+  for (size_t i = 0; i < n; i++)
+    {
+      int g = 0;
+      int *v = sf_ht_get (ht, keys[i], &g);
+      expect (g && *v == (int)i, "reinsert", i);
+    }
+
+  expect (ht->len == n, "len after reinsert", n);
+
+  sf_ht_free (ht);
+  free_keys (keys, n);
+  free_keys (miss, n);
+}
+
+/* codegen makes one small table per function body and drops it after */
+#define SCOPE_MAX (12)
+
+static double
+bench_scopes_new (char **keys, char **miss, size_t rounds)
+{
+  double t = now_sec ();
+  size_t hits = 0;
+
+  for (size_t r = 0; r < rounds; r++)
+    {
+      size_t k = 2 + r % (SCOPE_MAX - 1);
+      hashtable_t *ht = sf_ht_new ();
+
+      for (size_t i = 0; i < k; i++)
+        sf_ht_insert (ht, keys[i], NULL);
+
+      for (size_t n = 0; n < 4; n++)
+        for (size_t i = 0; i < k; i++)
+          {
+            int g;
+            sf_ht_get (ht, keys[i], &g);
+            hits += g;
+            sf_ht_get (ht, miss[i], &g);
+            hits += g;
+          }
+
+      sf_ht_free (ht);
+    }
+
+  expect (hits > 0, "scopes", rounds);
+  return now_sec () - t;
+}
+
+static double
+bench_scopes_old (char **keys, char **miss, size_t rounds)
+{
+  double t = now_sec ();
+  size_t hits = 0;
+
+  for (size_t r = 0; r < rounds; r++)
+    {
+      size_t k = 2 + r % (SCOPE_MAX - 1);
+      old_ht_t *ht = old_ht_new ();
+
+      for (size_t i = 0; i < k; i++)
+        old_ht_insert (ht, keys[i], NULL);
+
+      for (size_t n = 0; n < 4; n++)
+        for (size_t i = 0; i < k; i++)
+          {
+            int g;
+            old_ht_get (ht, keys[i], &g);
+            hits += g;
+            old_ht_get (ht, miss[i], &g);
+            hits += g;
+          }
+
+      old_ht_free (ht);
+    }
+
+  expect (hits > 0, "scopes", rounds);
+  return now_sec () - t;
+}
+
+static double
+bench_large_new (char **keys, char **miss, size_t n)
+{
+  double t = now_sec ();
+  size_t hits = 0;
+  hashtable_t *ht = sf_ht_new ();
+
+  for (size_t i = 0; i < n; i++)
+    sf_ht_insert (ht, keys[i], NULL);
+
+  for (size_t r = 0; r < 4; r++)
+    for (size_t i = 0; i < n; i++)
+      {
+        int g;
+        sf_ht_get (ht, keys[i], &g);
+        hits += g;
+        sf_ht_get (ht, miss[i], &g);
+        hits += g;
+      }
+
+  sf_ht_free (ht);
+  expect (hits == 4 * n, "large", n);
+  return now_sec () - t;
+}
+
+static double
+bench_large_old (char **keys, char **miss, size_t n)
+{
+  double t = now_sec ();
+  size_t hits = 0;
+  old_ht_t *ht = old_ht_new ();
+
+  for (size_t i = 0; i < n; i++)
+    old_ht_insert (ht, keys[i], NULL);
+
+  for (size_t r = 0; r < 4; r++)
+    for (size_t i = 0; i < n; i++)
+      {
+        int g;
+        old_ht_get (ht, keys[i], &g);
+        hits += g;
+        old_ht_get (ht, miss[i], &g);
+        hits += g;
+      }
+
+  old_ht_free (ht);
+
+  /* growing it resets the cache, the names held there are lost */
+  if (hits != 4 * n)
+    printf ("old table lost %zu of %zu names\n", n - hits / 4, n);
+
+  return now_sec () - t;
+}
+
+static void
+report (const char *name, size_t ops, double t_old, double t_new)
+{
+  printf ("%-8s %10zu ops   old %7.1f ns/op   new %7.1f ns/op   x%.2f\n",
+          name, ops, t_old * 1e9 / ops, t_new * 1e9 / ops, t_old / t_new);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--check"))
+    {
+      check (5);
+      check (SF_SWISS_SMALL);
+      check (100);
+      check (5000);
+      printf ("ht_bench: ok\n");
+      return 0;
+    }
+
+  size_t scale = argc > 1 ? (size_t)atol (argv[1]) : 1;
+  size_t rounds = 200000 * scale;
+  size_t n = 100000 * scale;
+
+  char **keys = make_keys (n, "name_");
+  char **miss = make_keys (n, "other_");
+
+  /* 8 lookups per name per round plus the inserts */
+  size_t sops = 0;
+  for (size_t r = 0; r < rounds; r++)
+    sops += 9 * (2 + r % (SCOPE_MAX - 1));
+
+  double so = bench_scopes_old (keys, miss, rounds);
+  double sn = bench_scopes_new (keys, miss, rounds);
+  report ("scopes", sops, so, sn);
+
+  double lo = bench_large_old (keys, miss, n);
+  double ln = bench_large_new (keys, miss, n);
+  report ("large", 9 * n, lo, ln);
+
+  free_keys (keys, n);
+  free_keys (miss, n);
+  return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * Lexer throughput over synthetic sources, once per scanner level.
+ *
+ *   LEX_BENCH [MB]      MB/s for each source and level (default 16 MB)
+ *   LEX_BENCH --check   token streams must match the scalar scanners
+ */
+#include <stdarg.h>
+#include <sunflower.h>
+#include <time.h>
+#include <vec.h>
+
+static inline double
+now_sec (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct
+{
+  char *s;
+  size_t len, cap;
+
+} buf_t;
+
+static void
+put (buf_t *b, const char *fmt, ...)
+{
+  va_list ap;
+
+  for (;;)
+    {
+      va_start (ap, fmt);
+      int n = vsnprintf (b->s + b->len, b->cap - b->len, fmt, ap);
+      va_end (ap);
+
+      if ((size_t)n < b->cap - b->len)
+        {
+          b->len += n;
+          return;
+        }
+
+      b->cap = b->cap * 2 + n;
+      b->s = SFREALLOC (b->s, b->cap);
+    }
+}
+
+static void
+indent (buf_t *b, int d)
+{
+  put (b, "%*s", d * 4, "");
+}
+
+/* classes and functions, nested a few levels deep */
+static void
+gen_code (buf_t *b, size_t bytes)
+{
+  for (size_t i = 0; b->len < bytes; i++)
+    {
+      put (b, "class Shape_%zu\n", i);
+      indent (b, 1);
+      put (b, "fun area_of_shape (self, width_value, height_value)\n");
+
+      for (int d = 2; d < 7; d++)
+        {
+          indent (b, d);
+          put (b, "if width_value > %zu and height_value <= %d.%d\n", i,
+               d, d * 7);
+        }
+
+      indent (b, 7);
+      put (b, "return width_value * height_value + self.offset_%zu\n", i);
+      indent (b, 1);
+      put (b, "fun describe (self)\n");
+      indent (b, 2);
+      put (b, "putln (\"shape number %zu has an area\")\n", i);
+      put (b, "s_%zu = Shape_%zu ()\n\n", i, i);
+    }
+}
+
+/* the generated configuration scripts: big dicts of quoted strings */
+static void
+gen_config (buf_t *b, size_t bytes)
+{
+  for (size_t i = 0; b->len < bytes; i++)
+    {
+      put (b, "service_%zu = {\"name\": \"frontend-%zu\", \"replicas\": %zu, "
+              "\"image\": \"registry.example.com/team/frontend:%zu.%zu\", "
+              "\"command\": \"/usr/bin/env serve --port %zu --log-level "
+              "info\\tverbose\", \"ratio\": %zu.25}\n",
+           i, i, i % 16, i / 100, i % 100, 8000 + i % 1000, i % 10);
+    }
+}
+
+/* escapes, odd spacing and runs across block boundaries */
+static void
+gen_edges (buf_t *b, size_t bytes)
+{
+  for (size_t i = 0; b->len < bytes; i++)
+    {
+      int w = (int)(i % 70);
+
+      put (b, "%*sx%.*s = '%.*s\\'%.*s\\\\' + \"\\n%.*s\" + %.*s.%.*s\n",
+           w, "", w % 40,
+           "abcdefghij_klmnopqrst0123456789ABCDEFGHIJ", w % 33,
+           "                                        ", w % 17,
+           "\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"", w % 29,
+           "some text with spaces, inside", 1 + w % 19,
+           "1234567890123456789", 1 + w % 23, "12345678901234567890123");
+    }
+
+  /* an unterminated string and trailing spaces right before the end */
+  put (b, "tail = 'no closing quote    ");
+}
+
+/* the source starts shift bytes into a fresh allocation */
+static TokenSM *
+lex (const char *src, size_t len, size_t shift)
+{
+  char *s = SFMALLOC (len + shift + 2);
+  memcpy (s + shift, src, len);
+  s[shift + len] = '\n';
+  s[shift + len + 1] = '\0';
+
+  TokenSM *smt = sf_statem_token_new (s + shift);
+  sf_token_gen (smt);
+  smt->raw = s;
+
+  return smt;
+}
+
+static void
+lex_free (TokenSM *smt)
+{
+  SFFREE (smt->raw);
+  sf_statem_token_free (smt);
+}
+
+static int
+same_token (token_t *a, const char *as, token_t *b, const char *bs)
+{
+  if (a->type != b->type || a->len != b->len || a->s - as != b->s - bs)
+    return 0;
+
+  switch (a->type)
+    {
+    case TOK_SPACE:
+      return a->v.space.v == b->v.space.v;
+    case TOK_INTEGER:
+      return a->v.t_integer.value == b->v.t_integer.value;
+    case TOK_FLOAT:
+      return a->v.t_float.value == b->v.t_float.value;
+    case TOK_STRING:
+      return a->v.t_string.esc == b->v.t_string.esc;
+    case TOK_OPERATOR:
+    case TOK_KEYWORD:
+      return !strcmp (sf_token_name (a), sf_token_name (b));
+    case TOK_BOOL:
+      return a->v.t_bool.value == b->v.t_bool.value;
+    default:
+      break;
+    }
+
+  return 1;
+}
+
+static void
+check_source (const char *name, buf_t *b)
+{
+  /* every alignment of the source against the 32 byte blocks */
+  for (size_t shift = 0; shift < 32; shift++)
+    {
+      sf_vec_setlevel (VEC_LEVEL_SCALAR);
+      TokenSM *want = lex (b->s, b->len, shift);
+
+      for (int l = VEC_LEVEL_SSE2; l <= VEC_LEVEL_AVX2; l++)
+        {
+          sf_vec_setlevel (l);
+
+          if (sf_vec_level () != l)
+            continue;
+
+          TokenSM *got = lex (b->s, b->len, shift);
+          int ok = got->vl == want->vl;
+
+          for (size_t i = 0; ok && i < want->vl; i++)
+            {
+              ok = same_token (&want->vals[i], want->raw, &got->vals[i],
+                               got->raw);
+
+              if (!ok)
+                printf ("lex_bench: %s, %s, shift %zu: token %zu differs\n",
+                        name, sf_vec_levelname (l), shift, i);
+            }
+
+          if (!ok)
+            exit (EXIT_FAILURE);
+
+          lex_free (got);
+        }
+
+      lex_free (want);
+    }
+}
+
+static void
+bench_source (const char *name, buf_t *b)
+{
+  for (int l = VEC_LEVEL_SCALAR; l <= VEC_LEVEL_AVX2; l++)
+    {
+      sf_vec_setlevel (l);
+
+      if (sf_vec_level () != l)
+        continue;
+
+      double best = 1e30;
+      size_t toks = 0;
+
+      for (int r = 0; r < 3; r++)
+        {
+          char *s = SFMALLOC (b->len + 2);
+          memcpy (s, b->s, b->len);
+          s[b->len] = '\n';
+          s[b->len + 1] = '\0';
+
+          double t = now_sec ();
+          TokenSM *smt = sf_statem_token_new (s);
+          sf_token_gen (smt);
+          t = now_sec () - t;
+
+          toks = smt->vl;
+          best = t < best ? t : best;
+
+          sf_statem_token_free (smt);
+          SFFREE (s);
+        }
+
+      printf ("%-8s %-7s %8.1f MB/s   %9zu tokens\n", name,
+              sf_vec_levelname (l), b->len / best / 1e6, toks);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  int check = argc > 1 && !strcmp (argv[1], "--check");
+  size_t mb = argc > 1 && !check ? (size_t)atol (argv[1]) : 16;
+  size_t bytes = check ? 64 * 1024 : mb << 20;
+
+  struct
+  {
+    const char *name;
+    void (*gen) (buf_t *, size_t);
+
+  } srcs[] = {
+    { "code", gen_code },
+    { "config", gen_config },
+    { "edges", gen_edges },
+  };
+
+  for (size_t i = 0; i < sizeof (srcs) / sizeof (*srcs); i++)
+    {
+      buf_t b = { SFMALLOC (4096), 0, 4096 };
+      srcs[i].gen (&b, bytes);
+
+      if (check)
+        check_source (srcs[i].name, &b);
+      else
+        bench_source (srcs[i].name, &b);
+
+      SFFREE (b.s);
+    }
+
+  if (check)
+    printf ("lex_bench: ok\n");
+
+  return 0;
+}
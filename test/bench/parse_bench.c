@@ -0,0 +1,258 @@
+/**
+ * Parser time over nested sources, at the same size for every depth.
+ *
+ *   PARSE_BENCH [lines]   lex, parse and free times per nesting depth
+ *   PARSE_BENCH --check   the trees must have the generated shape
+ */
+#include <stdarg.h>
+#include <sunflower.h>
+#include <time.h>
+
+static inline double
+now_sec (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct
+{
+  char *s;
+  size_t len, cap;
+
+} buf_t;
+
+static void
+put (buf_t *b, const char *fmt, ...)
+{
+  va_list ap;
+
+  for (;;)
+    {
+      va_start (ap, fmt);
+      int n = vsnprintf (b->s + b->len, b->cap - b->len, fmt, ap);
+      va_end (ap);
+
+      if ((size_t)n < b->cap - b->len)
+        {
+          b->len += n;
+          return;
+        }
+
+      b->cap = b->cap * 2 + n;
+      b->s = SFREALLOC (b->s, b->cap);
+    }
+}
+
+static void
+indent (buf_t *b, int d)
+{
+  put (b, "%*s", d * 4, "");
+}
+
+/**
+ * One chain of if, while and fun blocks, depth levels deep, in the
+ * shape of the nested stress code in bench.py. Every level has a
+ * statement before and after its inner block, the one before spans
+ * two lines. Gives 3 * depth + 1 statements.
+ */
+static void
+gen_chain (buf_t *b, int depth, size_t c)
+{
+  for (int d = 0; d < depth; d++)
+    {
+      indent (b, d);
+
+      switch (d % 3)
+        {
+        case 0:
+          put (b, "if a%d == %zu\n", d, c);
+          break;
+        case 1:
+          put (b, "while i%d < %d\n", d, d);
+          break;
+        default:
+          put (b, "fun f%d_%zu (x, y)\n", d, c);
+          break;
+        }
+
+      indent (b, d + 1);
+      put (b, "x%d = [%d, (i%d +\n", d, d, d);
+      indent (b, d + 2);
+      put (b, "%zu), %d]\n", c, d);
+    }
+
+  for (int d = depth - 1; d >= 0; d--)
+    {
+      indent (b, d + 1);
+      put (b, "y%d = x%d\n", d, d);
+
+      if (d == 1)
+        put (b, "\n");
+    }
+
+  put (b, "else\n");
+  indent (b, 1);
+  put (b, "putln (a0)\n");
+}
+
+static size_t
+gen_nested (buf_t *b, int depth, size_t lines)
+{
+  size_t chains = lines / (3 * depth + 3) + 1;
+
+  for (size_t c = 0; c < chains; c++)
+    gen_chain (b, depth, c);
+
+  return chains;
+}
+
+static TokenSM *
+lex (const char *src, size_t len)
+{
+  char *s = SFMALLOC (len + 2);
+  memcpy (s, src, len);
+  s[len] = '\n';
+  s[len + 1] = '\0';
+
+  TokenSM *smt = sf_statem_token_new (s);
+  sf_token_gen (smt);
+  smt->raw = s;
+
+  return smt;
+}
+
+static void
+lex_free (TokenSM *smt)
+{
+  SFFREE (smt->raw);
+  sf_statem_token_free (smt);
+}
+
+/* statements below s, itself included, and how deep they go */
+static size_t
+walk (stmt_t *s, int d, int *deepest)
+{
+  stmt_t *body = NULL;
+  size_t bl = 0, n = 1;
+
+  if (s->type == STMT_EOF)
+    return 0;
+
+  *deepest = d > *deepest ? d : *deepest;
+
+  switch (s->type)
+    {
+    case STMT_IFBLOCK:
+      body = s->v.s_ifblock.body;
+      bl = s->v.s_ifblock.bl;
+
+      for (size_t i = 0; i < s->v.s_ifblock.else_bl; i++)
+        n += walk (&s->v.s_ifblock.else_body[i], d + 1, deepest);
+      break;
+    case STMT_WHILE:
+      body = s->v.s_while.body;
+      bl = s->v.s_while.bl;
+      break;
+    case STMT_FUNDECL:
+      body = s->v.s_fundecl.body;
+      bl = s->v.s_fundecl.bl;
+      break;
+    default:
+      break;
+    }
+
+  for (size_t i = 0; i < bl; i++)
+    n += walk (&body[i], d + 1, deepest);
+
+  return n;
+}
+
+static void
+check_depth (int depth)
+{
+  buf_t b = { SFMALLOC (4096), 0, 4096 };
+  size_t chains = gen_nested (&b, depth, 2000);
+
+  TokenSM *smt = lex (b.s, b.len);
+  StmtSM *st = sf_ast_gen (smt);
+
+  size_t n = 0, top = 0;
+  int deepest = 0;
+
+  for (size_t i = 0; i < st->vl; i++)
+    {
+      n += walk (&st->vals[i], 1, &deepest);
+      top += st->vals[i].type != STMT_EOF;
+    }
+
+  if (top != chains || n != chains * (3 * depth + 1) || deepest != depth + 1)
+    {
+      printf ("parse_bench: depth %d: %zu top level, %zu statements, "
+              "%d deep, wanted %zu, %zu, %d\n",
+              depth, top, n, deepest, chains, chains * (3 * depth + 1),
+              depth + 1);
+      exit (EXIT_FAILURE);
+    }
+
+  sf_ast_free (st);
+  lex_free (smt);
+  SFFREE (b.s);
+}
+
+static void
+bench_depth (int depth, size_t lines)
+{
+  buf_t b = { SFMALLOC (4096), 0, 4096 };
+  gen_nested (&b, depth, lines);
+
+  double best_lex = 1e30, best_parse = 1e30, best_free = 1e30;
+  size_t toks = 0;
+
+  for (int r = 0; r < 3; r++)
+    {
+      double t = now_sec ();
+      TokenSM *smt = lex (b.s, b.len);
+      double t1 = now_sec ();
+      StmtSM *st = sf_ast_gen (smt);
+      double t2 = now_sec ();
+      sf_ast_free (st);
+      double t3 = now_sec ();
+
+      toks = smt->vl;
+      best_lex = t1 - t < best_lex ? t1 - t : best_lex;
+      best_parse = t2 - t1 < best_parse ? t2 - t1 : best_parse;
+      best_free = t3 - t2 < best_free ? t3 - t2 : best_free;
+
+      lex_free (smt);
+    }
+
+  printf ("depth %4d   lex %7.2f ms   parse %7.2f ms   free %6.2f ms   "
+          "%6.1f ns/token\n",
+          depth, best_lex * 1e3, best_parse * 1e3, best_free * 1e3,
+          best_parse / toks * 1e9);
+
+  SFFREE (b.s);
+}
+
+int
+main (int argc, char **argv)
+{
+  int check = argc > 1 && !strcmp (argv[1], "--check");
+  size_t lines = argc > 1 && !check ? (size_t)atol (argv[1]) : 100000;
+  int depths[] = { 1, 4, 16, 64, 256 };
+
+  for (size_t i = 0; i < sizeof (depths) / sizeof (*depths); i++)
+    {
+      if (check)
+        check_depth (depths[i]);
+      else
+        bench_depth (depths[i], lines);
+    }
+
+  if (check)
+    printf ("parse_bench: ok\n");
+
+  return 0;
+}
@@ -0,0 +1,900 @@
+/**
+ * Bytecode diffs of the optimization passes. Every case compiles its
+ * source with no passes and with the ones it names and compares the
+ * diff of the two listings with the one it expects. Listings name jump
+ * targets by label, so code that only moved does not show up.
+ *
+ *   OPT_CHECK          run the cases
+ *   OPT_CHECK --dump   print every diff as it comes out now
+ */
+#include <stdarg.h>
+#include <sunflower.h>
+
+typedef struct
+{
+  const char *name;
+  const char *passes;
+  const char *src;
+  const char *diff;
+
+} opt_case_t;
+
+static const opt_case_t cases[] = {
+  { "constbr: while 1 loses its test", "constbr",
+    "i = 0\n"
+    "while 1\n"
+    "    i = i + 2\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "L0:\n"
+    "- LOAD_CONST 1 0\n"
+    "- JUMP_IF_FALSE L1 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 2 0\n"
+    "  ADD 0 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L0 0\n"
+    "- L1:\n"
+    "  RETURN 0 0\n" },
+
+  { "constbr: while 0 jumps past its body", "constbr",
+    "i = 0\n"
+    "while 0\n"
+    "    i = i + 2\n"
+    "putln (i)\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "L0:\n"
+    "- LOAD_CONST 0 0\n"
+    "- JUMP_IF_FALSE L1 0\n"
+    "+ JUMP L1 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  ADD 0 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L0 0\n"
+    "L1:\n"
+    "  LOAD 16 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  RETURN 0 0\n" },
+
+  { "thread: nested ifs leave through one jump", "thread",
+    "x = 1\n"
+    "if x == 1\n"
+    "    if x == 2\n"
+    "        putln (1)\n"
+    "else\n"
+    "    putln (2)\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 0 0\n"
+    "- CMP_JUMP L1 0\n"
+    "+ CMP_JUMP L0 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 1 0\n"
+    "- CMP_JUMP L0 0\n"
+    "+ CMP_JUMP L1 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "- JUMP L0 0\n"
+    "+ RETURN 0 0\n"
+    "+ RETURN 0 0\n"
+    "L0:\n"
+    "- JUMP L2 0\n"
+    "- L1:\n"
+    "  LOAD_CONST 1 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "- L2:\n"
+    "+ L1:\n"
+    "  RETURN 0 0\n" },
+
+  { "dead: code after a return", "dead",
+    "fun f (x)\n"
+    "    return x\n"
+    "    putln (x)\n"
+    "f (1)\n",
+    "  JUMP L1 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  RETURN 1 0\n"
+    "- LOAD_FAST 0 0\n"
+    "- LOAD 0 0\n"
+    "- CALL 1 0\n"
+    "- RETURN 0 0\n"
+    "L1:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  LOAD 16 0\n"
+    "  CALL 1 0\n"
+    "  RETURN 0 0\n" },
+
+  { "unreach: a loop after a loop that never ends", "constbr,unreach",
+    "x = 1\n"
+    "while 1\n"
+    "    x = 2\n"
+    "while x\n"
+    "    x = 0\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "L0:\n"
+    "- LOAD_CONST 0 0\n"
+    "- JUMP_IF_FALSE L1 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L0 0\n"
+    "- L1:\n"
+    "- LOAD 16 0\n"
+    "- JUMP_IF_FALSE L2 0\n"
+    "- LOAD_CONST 2 0\n"
+    "- STORE 16 0\n"
+    "- JUMP L1 0\n"
+    "- L2:\n"
+    "  RETURN 0 0\n" },
+
+  { "unreach: dead only stops at the loop", "constbr,dead",
+    "x = 1\n"
+    "while 1\n"
+    "    x = 2\n"
+    "while x\n"
+    "    x = 0\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "L0:\n"
+    "- LOAD_CONST 0 0\n"
+    "- JUMP_IF_FALSE L1 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L0 0\n"
+    "L1:\n"
+    "  LOAD 16 0\n"
+    "  JUMP_IF_FALSE L2 0\n"
+    "  LOAD_CONST 2 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L1 0\n"
+    "L2:\n"
+    "  RETURN 0 0\n" },
+
+  { "loadstore: x = x", "loadstore",
+    "x = 1\n"
+    "x = x\n"
+    "putln (x)\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "  LOAD 16 0\n"
+    "- STORE 16 0\n"
+    "- LOAD 16 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  RETURN 0 0\n" },
+
+  { "dup: a store read back at once", "dup",
+    "x = 1\n"
+    "y = x\n"
+    "putln (y)\n",
+    "  LOAD_CONST 0 0\n"
+    "+ DUP 0 0\n"
+    "  STORE 16 0\n"
+    "- LOAD 16 0\n"
+    "+ DUP 0 0\n"
+    "  STORE 17 0\n"
+    "- LOAD 17 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  RETURN 0 0\n" },
+
+  { "licm: invariant arithmetic moves to a preheader", "licm",
+    "n = 4\n"
+    "i = 0\n"
+    "s = 0\n"
+    "while i < n * 2\n"
+    "    s = s + n * 3 + i\n"
+    "    i = i + 1\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  STORE 17 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  STORE 18 0\n"
+    "- L0:\n"
+    "  LOAD 17 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 2 0\n"
+    "  MUL 0 0\n"
+    "- CMP_JUMP L1 2\n"
+    "- LOAD 18 0\n"
+    "+ CMP_JUMP L2 2\n"
+    "  LOAD 16 0\n"
+    "+ LOAD_CONST 2 0\n"
+    "+ MUL 0 0\n"
+    "+ STORE 19 0\n"
+    "+ LOAD 16 0\n"
+    "  LOAD_CONST 3 0\n"
+    "  MUL 0 0\n"
+    "+ STORE 20 0\n"
+    "+ JUMP L1 0\n"
+    "+ L0:\n"
+    "+ LOAD 17 0\n"
+    "+ LOAD 19 0\n"
+    "+ CMP_JUMP L2 2\n"
+    "+ L1:\n"
+    "+ LOAD 18 0\n"
+    "+ LOAD 20 0\n"
+    "  ADD 0 0\n"
+    "  LOAD 17 0\n"
+    "  ADD 0 0\n"
+    "  STORE 18 0\n"
+    "  LOAD 17 0\n"
+    "  ADD_1 0 0\n"
+    "  STORE 17 0\n"
+    "  JUMP L0 0\n"
+    "- L1:\n"
+    "+ L2:\n"
+    "  RETURN 0 0\n" },
+
+  { "licm: item reads stay put in a loop that calls", "licm",
+    "p = [3, 4]\n"
+    "i = 0\n"
+    "while i < p[1]\n"
+    "    i = i + 1\n"
+    "while i < p[1] + 2\n"
+    "    putln (i)\n"
+    "    i = i + 1\n",
+    "  LOAD_CONST 0 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  LOAD_ARRAY 2 0\n"
+    "  STORE 16 0\n"
+    "  LOAD_CONST 2 0\n"
+    "  STORE 17 0\n"
+    "- L0:\n"
+    "  LOAD 17 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 3 0\n"
+    "  SQR_ACCESS 0 0\n"
+    "- CMP_JUMP L1 2\n"
+    "+ CMP_JUMP L2 2\n"
+    "+ LOAD 16 0\n"
+    "+ LOAD_CONST 3 0\n"
+    "+ SQR_ACCESS 0 0\n"
+    "+ STORE 18 0\n"
+    "+ JUMP L1 0\n"
+    "+ L0:\n"
+    "  LOAD 17 0\n"
+    "+ LOAD 18 0\n"
+    "+ CMP_JUMP L2 2\n"
+    "+ L1:\n"
+    "+ LOAD 17 0\n"
+    "  ADD_1 0 0\n"
+    "  STORE 17 0\n"
+    "  JUMP L0 0\n"
+    "- L1:\n"
+    "+ L2:\n"
+    "  LOAD 17 0\n"
+    "  LOAD 16 0\n"
+    "  LOAD_CONST 3 0\n"
+    "  SQR_ACCESS 0 0\n"
+    "  LOAD_CONST 4 0\n"
+    "  ADD 0 0\n"
+    "- CMP_JUMP L2 2\n"
+    "+ CMP_JUMP L3 2\n"
+    "  LOAD 17 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  LOAD 17 0\n"
+    "  ADD_1 0 0\n"
+    "  STORE 17 0\n"
+    "- JUMP L1 0\n"
+    "- L2:\n"
+    "+ JUMP L2 0\n"
+    "+ L3:\n"
+    "  RETURN 0 0\n" },
+
+  { "all: a search loop", "all,-types",
+    "fun first_above (n)\n"
+    "    i = 0\n"
+    "    while 1\n"
+    "        i = i + 1\n"
+    "        sq = i * i\n"
+    "        if sq > n\n"
+    "            return i\n"
+    "putln (first_above (50))\n",
+    "- JUMP L4 0\n"
+    "+ JUMP L2 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  STORE_FAST 1 0\n"
+    "L1:\n"
+    "- LOAD_CONST 1 0\n"
+    "- JUMP_IF_FALSE L3 0\n"
+    "  LOAD_FAST 1 0\n"
+    "  ADD_1 0 0\n"
+    "+ DUP 0 0\n"
+    "+ DUP 0 0\n"
+    "  STORE_FAST 1 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- LOAD_FAST 1 0\n"
+    "  MUL 0 0\n"
+    "+ DUP 0 0\n"
+    "  STORE_FAST 2 0\n"
+    "- LOAD_FAST 2 0\n"
+    "  LOAD_FAST 0 0\n"
+    "- CMP_JUMP L2 3\n"
+    "+ CMP_JUMP L1 3\n"
+    "  LOAD_FAST 1 0\n"
+    "  RETURN 1 0\n"
+    "- JUMP L2 0\n"
+    "L2:\n"
+    "- JUMP L1 0\n"
+    "- L3:\n"
+    "- RETURN 0 0\n"
+    "- L4:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "  LOAD_CONST 2 0\n"
+    "  LOAD 16 0\n"
+    "  CALL 1 1\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  RETURN 0 0\n" },
+
+  { "types: an int loop against a parameter", "types",
+    "fun count (n)\n"
+    "    i = 0\n"
+    "    s = 0\n"
+    "    while i < n\n"
+    "        s = s + i * 2\n"
+    "        i = i + 1\n"
+    "    return s\n",
+    "  JUMP L3 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "- LOAD_CONST 0 0\n"
+    "- STORE_FAST 1 0\n"
+    "- LOAD_CONST 0 0\n"
+    "- STORE_FAST 2 0\n"
+    "+ CONST_I 0 0\n"
+    "+ STORE_I 0 0\n"
+    "+ CONST_I 0 0\n"
+    "+ STORE_I 1 0\n"
+    "L1:\n"
+    "- LOAD_FAST 1 0\n"
+    "+ LOAD_I 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "- CMP_JUMP L2 2\n"
+    "- LOAD_FAST 2 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- LOAD_CONST 1 0\n"
+    "- MUL 0 0\n"
+    "- ADD 0 0\n"
+    "- STORE_FAST 2 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- ADD_1 0 0\n"
+    "- STORE_FAST 1 0\n"
+    "+ CMP_JUMP_I L2 34\n"
+    "+ LOAD_I 1 0\n"
+    "+ LOAD_I 0 0\n"
+    "+ CONST_I 2 0\n"
+    "+ MUL_I 0 0\n"
+    "+ ADD_I 0 0\n"
+    "+ STORE_I 1 0\n"
+    "+ LOAD_I 0 0\n"
+    "+ ADD_1_I 0 0\n"
+    "+ STORE_I 0 0\n"
+    "  JUMP L1 0\n"
+    "L2:\n"
+    "- LOAD_FAST 2 0\n"
+    "+ LOAD_I 1 1\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L3:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 14 0\n"
+    "  RETURN 0 0\n" },
+
+  { "types: a local some path reads before storing stays boxed", "types",
+    "fun f (n)\n"
+    "    if n > 5\n"
+    "        x = 1\n"
+    "    y = 0\n"
+    "    while y < n\n"
+    "        y = y + 1\n"
+    "    return x + y\n",
+    "  JUMP L4 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "- LOAD_CONST 0 0\n"
+    "- CMP_JUMP L1 3\n"
+    "+ CONST_I 5 0\n"
+    "+ CMP_JUMP_I L1 19\n"
+    "  LOAD_CONST 1 0\n"
+    "  STORE_FAST 1 0\n"
+    "  JUMP L1 0\n"
+    "L1:\n"
+    "- LOAD_CONST 2 0\n"
+    "- STORE_FAST 2 0\n"
+    "+ CONST_I 0 0\n"
+    "+ STORE_I 0 0\n"
+    "L2:\n"
+    "- LOAD_FAST 2 0\n"
+    "+ LOAD_I 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "- CMP_JUMP L3 2\n"
+    "- LOAD_FAST 2 0\n"
+    "- ADD_1 0 0\n"
+    "- STORE_FAST 2 0\n"
+    "+ CMP_JUMP_I L3 34\n"
+    "+ LOAD_I 0 0\n"
+    "+ ADD_1_I 0 0\n"
+    "+ STORE_I 0 0\n"
+    "  JUMP L2 0\n"
+    "L3:\n"
+    "  LOAD_FAST 1 0\n"
+    "- LOAD_FAST 2 0\n"
+    "+ LOAD_I 0 1\n"
+    "  ADD 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L4:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "  RETURN 0 0\n" },
+
+  { "types: a local that once holds an object stays boxed", "types,dup",
+    "fun f (n)\n"
+    "    x = 1\n"
+    "    y = x + 2\n"
+    "    putln (y)\n"
+    "    x = n\n"
+    "    return x + y\n",
+    "  JUMP L1 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "- LOAD_CONST 0 0\n"
+    "+ CONST_I 1 0\n"
+    "+ DUP_I 0 2\n"
+    "  STORE_FAST 1 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- LOAD_CONST 1 0\n"
+    "- ADD 0 0\n"
+    "- STORE_FAST 2 0\n"
+    "- LOAD_FAST 2 0\n"
+    "+ CONST_I 2 0\n"
+    "+ ADD_I 0 0\n"
+    "+ DUP_I 0 1\n"
+    "+ STORE_I 0 0\n"
+    "  LOAD 0 0\n"
+    "  CALL 1 0\n"
+    "  LOAD_FAST 0 0\n"
+    "+ DUP 0 0\n"
+    "  STORE_FAST 1 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- LOAD_FAST 2 0\n"
+    "+ LOAD_I 0 1\n"
+    "  ADD 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L1:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "  RETURN 0 0\n" },
+
+  { "inline: a call to a small global function", "inline",
+    "fun sq (x)\n"
+    "    return x * x\n"
+    "fun f (n)\n"
+    "    return sq (n) + 1\n",
+    "  JUMP L1 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  MUL 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L1:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "- JUMP L3 0\n"
+    "+ JUMP L5 0\n"
+    "L2:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD 16 0\n"
+    "+ GUARD_FN L3 1\n"
+    "+ STORE_FAST 1 0\n"
+    "+ LOAD_FAST 1 0\n"
+    "+ LOAD_FAST 1 0\n"
+    "+ MUL 0 0\n"
+    "+ JUMP L4 0\n"
+    "+ JUMP L4 0\n"
+    "+ L3:\n"
+    "  CALL 1 1\n"
+    "+ L4:\n"
+    "  ADD_1 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "- L3:\n"
+    "+ L5:\n"
+    "  LOAD_FUNC_CODED L2 1\n"
+    "  STORE 17 0\n"
+    "  RETURN 0 0\n" },
+
+  { "inline: a method only one class defines, its result dropped",
+    "inline",
+    "class C\n"
+    "    v = 0\n"
+    "    fun get (self)\n"
+    "        return self.v\n"
+    "fun f (c)\n"
+    "    c.get ()\n",
+    "L0:\n"
+    "  LOAD_BUILDCLASS L3 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  STORE_NAME 0 0\n"
+    "  JUMP L2 0\n"
+    "L1:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  DOT_ACCESS 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L2:\n"
+    "  LOAD_FUNC_CODED L1 1\n"
+    "  STORE_NAME 1 0\n"
+    "L3:\n"
+    "  LOAD_BUILDCLASS_END L0 0\n"
+    "  STORE 16 0\n"
+    "- JUMP L5 0\n"
+    "+ JUMP L7 0\n"
+    "L4:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "+ GUARD_METHOD L5 4\n"
+    "+ STORE_FAST 1 0\n"
+    "+ LOAD_FAST 1 0\n"
+    "  DOT_ACCESS 0 0\n"
+    "+ STORE_FAST 2 0\n"
+    "+ JUMP L6 0\n"
+    "+ JUMP L6 0\n"
+    "+ L5:\n"
+    "+ DOT_ACCESS 0 0\n"
+    "  CALL 0 0\n"
+    "+ L6:\n"
+    "  RETURN 0 0\n"
+    "- L5:\n"
+    "+ L7:\n"
+    "  LOAD_FUNC_CODED L4 1\n"
+    "  STORE 17 0\n"
+    "  RETURN 0 0\n" },
+
+  { "tail: a call whose result is returned", "tail",
+    "fun count (n, acc)\n"
+    "    if n == 0\n"
+    "        return acc\n"
+    "    return count (n - 1, acc + 1)\n",
+    "  JUMP L2 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  STORE_FAST 1 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  CMP_JUMP L1 0\n"
+    "  LOAD_FAST 1 0\n"
+    "  RETURN 1 0\n"
+    "  JUMP L1 0\n"
+    "L1:\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD_CONST 1 0\n"
+    "  SUB 0 0\n"
+    "  LOAD_FAST 1 0\n"
+    "  ADD_1 0 0\n"
+    "  LOAD 14 0\n"
+    "- CALL 2 1\n"
+    "- RETURN 1 0\n"
+    "+ TAIL_CALL 2 1\n"
+    "  RETURN 0 0\n"
+    "L2:\n"
+    "  LOAD_FUNC_CODED L0 2\n"
+    "  STORE 14 0\n"
+    "  RETURN 0 0\n" },
+
+  { "tail: only functions a nested one reads the frame of keep calls",
+    "tail",
+    "fun go (n)\n"
+    "    return go (n - 1)\n"
+    "fun adder (k)\n"
+    "    fun add (x)\n"
+    "        return x + k\n"
+    "    return add (k)\n",
+    "  JUMP L1 0\n"
+    "L0:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD_CONST 0 0\n"
+    "  SUB 0 0\n"
+    "  LOAD 16 0\n"
+    "- CALL 1 1\n"
+    "- RETURN 1 0\n"
+    "+ TAIL_CALL 1 1\n"
+    "  RETURN 0 0\n"
+    "L1:\n"
+    "  LOAD_FUNC_CODED L0 1\n"
+    "  STORE 16 0\n"
+    "  JUMP L5 0\n"
+    "L2:\n"
+    "  STORE_FAST 0 0\n"
+    "  JUMP L4 0\n"
+    "L3:\n"
+    "  STORE_FAST 2 0\n"
+    "  LOAD_FAST 2 0\n"
+    "  LOAD_FAST 0 1\n"
+    "  ADD 0 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L4:\n"
+    "  LOAD_FUNC_CODED L3 1\n"
+    "  STORE_FAST 1 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  LOAD_FAST 1 0\n"
+    "  CALL 1 1\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L5:\n"
+    "  LOAD_FUNC_CODED L2 1\n"
+    "  STORE 17 0\n"
+    "  RETURN 0 0\n" },
+
+  { "scalar: an object only read field by field", "scalar",
+    "class P\n"
+    "    fun _init (self, x)\n"
+    "        self.x = x\n"
+    "fun f (n)\n"
+    "    p = P (n)\n"
+    "    return p.x\n",
+    "L0:\n"
+    "  LOAD_BUILDCLASS L3 0\n"
+    "  JUMP L2 0\n"
+    "L1:\n"
+    "  STORE_FAST 0 0\n"
+    "  STORE_FAST 1 0\n"
+    "  LOAD_FAST 1 0\n"
+    "  LOAD_FAST 0 0\n"
+    "  STORE_NAME 0 1\n"
+    "  RETURN 0 0\n"
+    "L2:\n"
+    "  LOAD_FUNC_CODED L1 2\n"
+    "  STORE_NAME 0 0\n"
+    "L3:\n"
+    "  LOAD_BUILDCLASS_END L0 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L5 0\n"
+    "L4:\n"
+    "  STORE_FAST 0 0\n"
+    "  LOAD_FAST 0 0\n"
+    "- LOAD 16 0\n"
+    "- CALL 1 1\n"
+    "- STORE_FAST 1 0\n"
+    "- LOAD_FAST 1 0\n"
+    "- DOT_ACCESS 0 0\n"
+    "+ STORE_FAST 3 0\n"
+    "+ LOAD_FAST 3 0\n"
+    "+ STORE_FAST 2 0\n"
+    "+ LOAD_FAST 2 0\n"
+    "  RETURN 1 0\n"
+    "  RETURN 0 0\n"
+    "L5:\n"
+    "  LOAD_FUNC_CODED L4 1\n"
+    "  STORE 17 0\n"
+    "  RETURN 0 0\n" },
+
+  { "none: nothing changes", "none",
+    "x = 1\n"
+    "while 1\n"
+    "    x = x\n",
+    "  LOAD_CONST 0 0\n"
+    "  STORE 16 0\n"
+    "L0:\n"
+    "  LOAD_CONST 0 0\n"
+    "  JUMP_IF_FALSE L1 0\n"
+    "  LOAD 16 0\n"
+    "  STORE 16 0\n"
+    "  JUMP L0 0\n"
+    "L1:\n"
+    "  RETURN 0 0\n" },
+};
+
+typedef struct
+{
+  char *s;
+  size_t len, cap;
+
+} buf_t;
+
+static void
+put (buf_t *b, const char *fmt, ...)
+{
+  va_list ap;
+
+  for (;;)
+    {
+      va_start (ap, fmt);
+      int n = vsnprintf (b->s + b->len, b->cap - b->len, fmt, ap);
+      va_end (ap);
+
+      if ((size_t)n < b->cap - b->len)
+        {
+          b->len += n;
+          return;
+        }
+
+      b->cap = b->cap * 2 + n;
+      b->s = SFREALLOC (b->s, b->cap);
+    }
+}
+
+/* one line per op, "L<n>:" lines before jump targets */
+static char **
+listing (const char *src, int passes, size_t *nl)
+{
+  size_t sl = strlen (src);
+  char *s = SFMALLOC (sl + 2);
+  memcpy (s, src, sl);
+  s[sl] = '\n';
+  s[sl + 1] = '\0';
+
+  vm_t vm = sf_vm_new ();
+  vm.opt = passes;
+  sf_natives_add_tovm (&vm);
+
+  TokenSM *smt = sf_statem_token_new (s);
+  sf_token_gen (smt);
+  StmtSM *st = sf_ast_gen (smt);
+
+  sf_vm_gen_bytecode (&vm, st);
+  sf_opt_run (&vm, 0, passes);
+
+  int *label = SFMALLOC ((vm.inst_len + 1) * sizeof (*label));
+  int nlab = 0;
+
+  for (size_t i = 0; i <= vm.inst_len; i++)
+    label[i] = -1;
+
+  for (size_t i = 0; i < vm.inst_len; i++)
+    if (SF_OP_HAS_IP (vm.insts[i].op))
+      label[vm.insts[i].a] = 0;
+
+  for (size_t i = 0; i <= vm.inst_len; i++)
+    if (label[i] == 0)
+      label[i] = ++nlab;
+
+  char **lines = SFMALLOC ((2 * vm.inst_len + 1) * sizeof (*lines));
+  *nl = 0;
+
+  for (size_t i = 0; i < vm.inst_len; i++)
+    {
+      instr_t in = vm.insts[i];
+      buf_t b = { SFMALLOC (64), 0, 64 };
+
+      if (label[i] > 0)
+        {
+          buf_t l = { SFMALLOC (16), 0, 16 };
+          put (&l, "L%d:", label[i] - 1);
+          lines[(*nl)++] = l.s;
+        }
+
+      put (&b, "%s ", sf_vm_op_name (in.op) + 3);
+
+      if (SF_OP_HAS_IP (in.op))
+        put (&b, "L%d %d", label[in.a] - 1, in.b);
+      else
+        put (&b, "%d %d", in.a, in.b);
+
+      lines[(*nl)++] = b.s;
+    }
+
+  SFFREE (label);
+  sf_ast_free (st);
+  sf_statem_token_free (smt);
+  SFFREE (s);
+
+  return lines;
+}
+
+/* the two listings as a line diff, kept lines start with two spaces */
+static char *
+diff (char **a, size_t an, char **b, size_t bn)
+{
+  size_t *lcs = SFMALLOC ((an + 1) * (bn + 1) * sizeof (*lcs));
+  buf_t out = { SFMALLOC (256), 0, 256 };
+
+#define LCS(I, J) lcs[(I) * (bn + 1) + (J)]
+
+  for (size_t i = an + 1; i-- > 0;)
+    for (size_t j = bn + 1; j-- > 0;)
+      {
+        if (i == an || j == bn)
+          LCS (i, j) = 0;
+        else if (!strcmp (a[i], b[j]))
+          LCS (i, j) = LCS (i + 1, j + 1) + 1;
+        else
+          LCS (i, j) = LCS (i + 1, j) > LCS (i, j + 1) ? LCS (i + 1, j)
+                                                        : LCS (i, j + 1);
+      }
+
+  size_t i = 0, j = 0;
+  out.s[0] = '\0';
+
+  while (i < an || j < bn)
+    {
+      if (i < an && j < bn && !strcmp (a[i], b[j]))
+        {
+          /* labels are only shown with the ops they mark */
+          put (&out, a[i][0] == 'L' && strchr (a[i], ':') ? "%s\n" : "  %s\n",
+               a[i]);
+          i++;
+          j++;
+        }
+      else if (i < an && (j == bn || LCS (i + 1, j) >= LCS (i, j + 1)))
+        put (&out, "- %s\n", a[i++]);
+      else
+        put (&out, "+ %s\n", b[j++]);
+    }
+
+#undef LCS
+
+  SFFREE (lcs);
+  return out.s;
+}
+
+static void
+free_lines (char **l, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    SFFREE (l[i]);
+
+  SFFREE (l);
+}
+
+int
+main (int argc, char **argv)
+{
+  int dump = argc > 1 && !strcmp (argv[1], "--dump");
+  int failed = 0;
+
+  sf_objstore_init ();
+
+  for (size_t c = 0; c < sizeof (cases) / sizeof (*cases); c++)
+    {
+      const opt_case_t *t = &cases[c];
+      size_t an, bn;
+
+      char **a = listing (t->src, 0, &an);
+      char **b = listing (t->src, sf_opt_parse (t->passes, 0), &bn);
+      char *d = diff (a, an, b, bn);
+
+      if (dump)
+        printf ("%s\n%s\n", t->name, d);
+      else if (strcmp (d, t->diff))
+        {
+          printf ("opt_check: %s\n--- expected\n%s--- got\n%s", t->name,
+                  t->diff, d);
+          failed = 1;
+        }
+
+      SFFREE (d);
+      free_lines (a, an);
+      free_lines (b, bn);
+    }
+
+  if (!dump && !failed)
+    printf ("opt_check: ok\n");
+
+  return failed;
+}
@@ -0,0 +1,41 @@
+# Runs a script's sunflower-aot build against the interpreter and
+# compares both stdouts with the expected output. Invoked by
+# sf_aot_test() in CMakeLists.txt.
+#
+# The C program runs once with the JIT on and once with it off, which
+# leaves only the code it was built with.
+
+get_filename_component(dir ${SCRIPT} DIRECTORY)
+set(ENV{SF_FISHC} 0)
+
+file(READ ${EXPECTED} expected)
+
+execute_process(COMMAND ${EXE} ${SCRIPT}
+                WORKING_DIRECTORY ${dir}
+                OUTPUT_VARIABLE interp
+                RESULT_VARIABLE rc)
+
+if(NOT rc EQUAL 0 OR NOT interp STREQUAL expected)
+    message(FATAL_ERROR "${SCRIPT} does not run right interpreted\n"
+                        "${interp}")
+endif()
+
+foreach(jit on off)
+    set(ENV{SF_JIT} ${jit})
+    execute_process(COMMAND ${AOT}
+                    WORKING_DIRECTORY ${dir}
+                    OUTPUT_VARIABLE out
+                    ERROR_VARIABLE err
+                    RESULT_VARIABLE rc)
+
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "${AOT} (jit ${jit}) exited with ${rc}\n"
+                            "${out}${err}")
+    endif()
+
+    if(NOT out STREQUAL interp)
+        message(FATAL_ERROR "${AOT} (jit ${jit}) differs from the "
+                            "interpreter\n--- interpreter\n${interp}\n"
+                            "--- aot\n${out}")
+    endif()
+endforeach()
@@ -0,0 +1,44 @@
+# Runs one Sunflower script and compares its stdout with the expected
+# output. Invoked by sf_script_test() in CMakeLists.txt.
+#
+# The script runs in DIR (by default its own directory) twice against an
+# empty .fishc cache in CACHE: once compiling from source and once
+# loading what the first run wrote. With FAIL set the script has to
+# exit with a failure status, after printing the expected output.
+
+if(NOT DIR)
+    get_filename_component(DIR ${SCRIPT} DIRECTORY)
+endif()
+
+file(REMOVE_RECURSE ${CACHE})
+file(MAKE_DIRECTORY ${CACHE})
+set(ENV{SF_FISHC_DIR} ${CACHE})
+
+file(READ ${EXPECTED} expected)
+
+foreach(pass cold warm)
+    execute_process(COMMAND ${EXE} ${ARGS} ${SCRIPT}
+                    WORKING_DIRECTORY ${DIR}
+                    OUTPUT_VARIABLE out
+                    ERROR_VARIABLE err
+                    RESULT_VARIABLE rc)
+
+    if(FAIL AND rc EQUAL 0)
+        message(FATAL_ERROR "${SCRIPT} (${pass}) should have failed\n"
+                            "${out}${err}")
+    elseif(NOT FAIL AND NOT rc EQUAL 0)
+        message(FATAL_ERROR "${SCRIPT} (${pass}) exited with ${rc}\n"
+                            "${out}${err}")
+    endif()
+
+    if(NOT out STREQUAL expected)
+        message(FATAL_ERROR "output mismatch for ${SCRIPT} (${pass})\n"
+                            "--- expected\n${expected}\n--- got\n${out}")
+    endif()
+endforeach()
+
+file(GLOB cached ${CACHE}/*.fishc)
+
+if(NOT cached)
+    message(FATAL_ERROR "${SCRIPT} left nothing in ${CACHE}")
+endif()
@@ -53,6 +53,7 @@ test3 ()
 
   vm.fp = 1;
   sf_vm_gen_bytecode (&vm, stt);
+  sf_opt_run (&vm, 0, vm.opt);
   sf_vm_print_b (&vm);
   vm.fp = 0;
 
@@ -86,10 +87,88 @@ test3 ()
   // D (sf_obj_print (*os[5]));
 }
 
+/**
+ * Runs a script without the token/AST/bytecode dumps, used by ctest.
+ * The modules in pre are imported before the script is compiled, with
+ * jobs > 0 the ones it imports are compiled on that many threads. jit
+ * overrides $SF_JIT and mode $SF_VM.
+ */
+void
+run_file (const char *path, const char **pre, int pl, int jobs,
+          const char *jit, const char *mode)
+{
+  vm_t vm = sf_vm_new ();
+  sf_natives_add_tovm (&vm);
+
+  if (jit != NULL)
+    {
+      sf_jit_free (vm.jit);
+      vm.jit = sf_jit_new (sf_jit_parse (jit, SF_JIT_ON));
+    }
+
+  if (mode != NULL)
+    sf_reg_use (&vm, sf_reg_parse (mode, SF_TIER_STACK));
+
+  for (int i = 0; i < pl; i++)
+    sf_vm_import (&vm, pre[i], NULL);
+
+  size_t start = vm.inst_len;
+
+  vm.fp = 1;
+  sf_fishc_compile (&vm, path);
+  vm.fp = 0;
+
+  if (jobs > 0)
+    sf_imports_compile (&vm, start, jobs);
+
+  frame_t top = sf_frame_new_local ();
+  top.pop_ret_val = 0;
+  top.return_ip = vm.inst_len - 1;
+  top.stack_base = vm.sp;
+  sf_vm_addframe (&vm, top);
+
+  vm.ip = start;
+  sf_vm_exec_frame_top (&vm);
+}
+
+/* TEST_EXE [-p module]... [-j threads] [--jit=mode] [--vm=mode] [script] */
 int
 main (int argc, char const *argv[])
 {
+  const char *pre[16];
+  const char *jit = NULL, *mode = NULL;
+  int a = 1, pl = 0, jobs = 0;
+
   sf_objstore_init ();
-  test3 ();
+
+  while (a + 1 < argc)
+    {
+      if (!strncmp (argv[a], "--jit=", 6))
+        {
+          jit = argv[a++] + 6;
+          continue;
+        }
+
+      if (!strncmp (argv[a], "--vm=", 5))
+        {
+          mode = argv[a++] + 5;
+          continue;
+        }
+
+      if (!strcmp (argv[a], "-p") && pl < 16)
+        pre[pl++] = argv[a + 1];
+      else if (!strcmp (argv[a], "-j"))
+        jobs = atoi (argv[a + 1]);
+      else
+        break;
+
+      a += 2;
+    }
+
+  if (a < argc)
+    run_file (argv[a], pre, pl, jobs, jit, mode);
+  else
+    test3 ();
+
   return 0;
-}
\ No newline at end of file
+}
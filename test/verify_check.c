@@ -0,0 +1,224 @@
+/**
+ * Verdicts of the bytecode verifier. Source cases compile a script with
+ * the default passes and verify each function it defines, in the order
+ * of their code: '+' for one that passed, '-' for one that did not.
+ * Bytecode cases verify one hand written body, to get at what codegen
+ * never emits.
+ */
+#include <sunflower.h>
+
+typedef struct
+{
+  const char *name;
+  const char *src;
+  const char *verdicts;
+
+} src_case_t;
+
+static const src_case_t src_cases[] = {
+  { "arithmetic and a loop",
+    "fun f (n)\n"
+    "    s = 0\n"
+    "    while n > 0\n"
+    "        s = s + n * 2\n"
+    "        n = n - 1\n"
+    "    return s\n",
+    "+" },
+
+  { "returns from inside for loops",
+    "fun f (xs, k)\n"
+    "    for x in xs\n"
+    "        for y in xs\n"
+    "            if x + y > k\n"
+    "                return x\n"
+    "    return 0\n",
+    "+" },
+
+  { "calls, containers and attributes",
+    "fun g (a, b)\n"
+    "    return [a, b]\n"
+    "fun f (o, xs)\n"
+    "    o.n = g (xs[0], o.n)\n"
+    "    return {'a': xs[1:2]}\n",
+    "++" },
+
+  { "methods, one reading a name of its class",
+    "class C\n"
+    "    k = 1\n"
+    "    fun _init (self, n)\n"
+    "        self.n = n\n"
+    "    fun get (self)\n"
+    "        return self.n\n"
+    "    fun make (self)\n"
+    "        return C (self.n + k)\n",
+    "++-" },
+
+  { "a class body inside a function",
+    "fun f ()\n"
+    "    class D\n"
+    "        x = 1\n"
+    "    return D\n",
+    "-" },
+};
+
+typedef struct
+{
+  const char *name;
+  int argc;
+  instr_t code[8];
+  size_t n;
+  int ok;
+
+} code_case_t;
+
+#define I(OP, A, B) { .op = (OP), .a = (A), .b = (B) }
+
+/* bodies start at ip 0 */
+static const code_case_t code_cases[] = {
+  { "an iterator loop",
+    1,
+    { I (OP_LOAD_FAST, 0, 0), I (OP_GET_ITER, 0, 0),
+      I (OP_LOAD_ITER_NEXT, 5, 1), I (OP_STORE_FAST, 1, 0),
+      I (OP_JUMP, 2, 0), I (OP_RETURN, 0, 0) },
+    6,
+    1 },
+
+  { "a compare and branch meeting the path past it",
+    1,
+    { I (OP_LOAD_FAST, 0, 0), I (OP_LOAD_CONST, 0, 0),
+      I (OP_CMP_JUMP, 4, CMP_GE), I (OP_JUMP, 4, 0),
+      I (OP_RETURN, 0, 0) },
+    5,
+    1 },
+
+  { "more pops than the stack has",
+    1,
+    { I (OP_STORE_FAST, 0, 0), I (OP_STORE_FAST, 1, 0),
+      I (OP_RETURN, 0, 0) },
+    3,
+    0 },
+
+  { "a jump out of the body",
+    0,
+    { I (OP_JUMP, 100, 0), I (OP_RETURN, 0, 0) },
+    2,
+    0 },
+
+  { "two depths at a join",
+    0,
+    { I (OP_LOAD_CONST, 0, 0), I (OP_JUMP_IF_FALSE, 3, 0),
+      I (OP_LOAD_CONST, 0, 0), I (OP_RETURN, 0, 0) },
+    4,
+    0 },
+
+  { "an iterator stored to a local",
+    1,
+    { I (OP_LOAD_FAST, 0, 0), I (OP_GET_ITER, 0, 0),
+      I (OP_STORE_FAST, 1, 0), I (OP_RETURN, 0, 0) },
+    4,
+    0 },
+
+  { "LOAD_ITER_NEXT on something else",
+    1,
+    { I (OP_LOAD_FAST, 0, 0), I (OP_LOAD_ITER_NEXT, 3, 1),
+      I (OP_RETURN, 0, 0), I (OP_RETURN, 0, 0) },
+    4,
+    0 },
+
+  { "a local past a frame's room",
+    0,
+    { I (OP_LOAD_FAST, SF_FRAME_LOCALS_CAP, 0), I (OP_RETURN, 1, 0) },
+    2,
+    0 },
+
+  { "a path off the end",
+    0,
+    { I (OP_LOAD_CONST, 0, 0), I (OP_STORE_FAST, 0, 0) },
+    2,
+    0 },
+};
+
+#undef I
+
+static vm_t
+compile (const char *src)
+{
+  size_t sl = strlen (src);
+  char *s = SFMALLOC (sl + 2);
+  memcpy (s, src, sl);
+  s[sl] = '\n';
+  s[sl + 1] = '\0';
+
+  vm_t vm = sf_vm_new ();
+  sf_natives_add_tovm (&vm);
+
+  TokenSM *smt = sf_statem_token_new (s);
+  sf_token_gen (smt);
+  StmtSM *st = sf_ast_gen (smt);
+
+  sf_vm_gen_bytecode (&vm, st);
+  sf_opt_run (&vm, 0, vm.opt);
+
+  SFFREE (s);
+  return vm;
+}
+
+int
+main (void)
+{
+  int failed = 0;
+  char got[32];
+
+  sf_objstore_init ();
+
+  for (size_t c = 0; c < sizeof (src_cases) / sizeof (*src_cases); c++)
+    {
+      const src_case_t *t = &src_cases[c];
+      vm_t vm = compile (t->src);
+      size_t gl = 0;
+
+      if (vm.verify == NULL)
+        vm.verify = sf_verify_new (1);
+
+      /* bodies come before their LOAD_FUNC_CODED, nested ones first */
+      for (size_t lp = 0; lp < vm.inst_len && gl + 1 < sizeof (got); lp++)
+        for (size_t k = lp; k < vm.inst_len; k++)
+          if (vm.insts[k].op == OP_LOAD_FUNC_CODED
+              && (size_t)vm.insts[k].a == lp)
+            got[gl++] = sf_verify_func (&vm, lp, k) ? '+' : '-';
+
+      got[gl] = '\0';
+
+      if (strcmp (got, t->verdicts))
+        {
+          printf ("verify_check: %s\n  expected %s, got %s\n", t->name,
+                  t->verdicts, got);
+          failed = 1;
+        }
+    }
+
+  for (size_t c = 0; c < sizeof (code_cases) / sizeof (*code_cases); c++)
+    {
+      const code_case_t *t = &code_cases[c];
+      vm_t vm = sf_vm_new ();
+
+      if (vm.verify == NULL)
+        vm.verify = sf_verify_new (1);
+
+      memcpy (vm.insts, t->code, t->n * sizeof (*t->code));
+      vm.insts[t->n] = (instr_t){ .op = OP_LOAD_FUNC_CODED, .b = t->argc };
+      vm.inst_len = t->n + 1;
+
+      if (sf_verify_func (&vm, 0, t->n) != t->ok)
+        {
+          printf ("verify_check: %s\n  expected it to %s\n", t->name,
+                  t->ok ? "pass" : "fail");
+          failed = 1;
+        }
+    }
+
+  if (!failed)
+    printf ("verify_check: ok\n");
+
+  return failed;
+}
@@ -1,4 +1,5 @@
 #include "token.h"
+#include "scan.h"
 
 SF_API TokenSM *
 sf_statem_token_new (char *r)
@@ -16,87 +17,85 @@ sf_statem_token_new (char *r)
   return smt;
 }
 
-int
-is_keyword (char *r)
-{
-  static const char *KEYWORDS[]
-      = { "if",    "else",     "for",     "while",  "in",  "to",
-          "step",  "class",    "fun",     "return", "or",  "and",
-          "not",   "repeat",   "import",  "as",     "try", "catch",
-          "break", "continue", "extends", NULL };
-
-  for (size_t i = 0; KEYWORDS[i] != NULL; i++)
-    if (!strcmp (KEYWORDS[i], r))
-      return 1;
+/**
+ * Keywords, booleans and none, placed by a perfect hash of the first
+ * and last letter and the length (KW_HASH), so one compare settles it.
+ */
+#define KW_HASH(S, N) (((S)[0] * 6 + (S)[(N) - 1] * 60 + (N)) & 63)
 
-  return 0;
+static const struct
+{
+  const char *w;
+  int type;
+
+} KEYWORDS[64] = {
+  [0] = { "in", TOK_KEYWORD },       [4] = { "none", TOK_NONE },
+  [6] = { "continue", TOK_KEYWORD }, [7] = { "not", TOK_KEYWORD },
+  [11] = { "class", TOK_KEYWORD },   [14] = { "else", TOK_KEYWORD },
+  [20] = { "or", TOK_KEYWORD },      [21] = { "false", TOK_BOOL },
+  [23] = { "try", TOK_KEYWORD },     [25] = { "extends", TOK_KEYWORD },
+  [31] = { "for", TOK_KEYWORD },     [32] = { "if", TOK_KEYWORD },
+  [34] = { "repeat", TOK_KEYWORD },  [37] = { "break", TOK_KEYWORD },
+  [40] = { "true", TOK_BOOL },       [44] = { "import", TOK_KEYWORD },
+  [47] = { "fun", TOK_KEYWORD },     [54] = { "step", TOK_KEYWORD },
+  [55] = { "catch", TOK_KEYWORD },   [57] = { "and", TOK_KEYWORD },
+  [58] = { "return", TOK_KEYWORD },  [59] = { "while", TOK_KEYWORD },
+  [60] = { "as", TOK_KEYWORD },      [62] = { "to", TOK_KEYWORD },
+};
+
+/* operator spellings; OP1 doubles as the set of operator characters */
+static const char *const OP1[128] = {
+  ['~'] = "~", ['!'] = "!", ['%'] = "%", ['^'] = "^",  ['&'] = "&",
+  ['*'] = "*", ['('] = "(", [')'] = ")", ['-'] = "-",  ['+'] = "+",
+  ['='] = "=", ['['] = "[", [']'] = "]", ['{'] = "{",  ['}'] = "}",
+  ['|'] = "|", [':'] = ":", ['/'] = "/", ['.'] = ".",  [','] = ",",
+  ['<'] = "<", ['>'] = ">", ['\\'] = "\\",
+};
+
+static const char *const OP_EQ[128] = {
+  ['+'] = "+=", ['-'] = "-=", ['*'] = "*=", ['/'] = "/=", ['%'] = "%=",
+  ['='] = "==", ['!'] = "!=", ['^'] = "^=", ['&'] = "&=", ['|'] = "|=",
+};
+
+static inline int
+is_idstart (char c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_';
 }
 
-int
-is_bool (char *r)
+static inline int
+is_digit (char c)
 {
-  return !strcmp (r, "true") || !strcmp (r, "false");
+  return c >= '0' && c <= '9';
 }
 
-void
-makeop (char *op)
+static const char *
+op_spelling (const char *p, uint32_t *n)
 {
-  switch (*op)
-    {
-    case '+':
-    case '-':
-    case '*':
-    case '/':
-    case '%':
-    case '=':
-      {
-        if (op[1] == '=')
-          op[2] = '\0';
-        else
-          op[1] = '\0';
-      }
-      break;
+  unsigned char c = (unsigned char)*p;
 
-    case '!':
-    case '^':
-    case '&':
-    case '|':
-      {
-        if (op[1] == '=')
-          op[2] = '\0';
-        else
-          op[1] = '\0';
-      }
-      break;
+  *n = 1;
 
-    case '<':
-    case '>':
-      {
-        if (op[1] == op[0])
-          {
-            if (op[2] != '=')
-              op[2] = '\0';
-          }
-        else
-          op[1] = '\0';
-      }
-      break;
+  if (p[1] == '=' && OP_EQ[c] != NULL)
+    {
+      *n = 2;
+      return OP_EQ[c];
+    }
 
-    case '.':
-    case '~':
-    case ',':
-      {
-        op[1] = '\0';
-      }
-      break;
+  if ((c == '<' || c == '>') && p[1] == c)
+    {
+      *n = p[2] == '=' ? 3 : 2;
 
-    default:
-      op[1] = '\0';
-      break;
+      if (c == '<')
+        return *n == 3 ? "<<=" : "<<";
+
+      return *n == 3 ? ">>=" : ">>";
     }
+
+  return OP1[c];
 }
 
-void
+static inline void
 __tokensm_add (TokenSM *smt, token_t tok)
 {
   if (smt->vl >= smt->vc)
@@ -105,184 +104,113 @@ __tokensm_add (TokenSM *smt, token_t tok)
   smt->vals[smt->vl++] = tok;
 }
 
-static char *__strbfr = NULL;
 SF_API token_t *
 sf_token_next (TokenSM *smt)
 {
   token_t res;
   res.type = -1;
-
-  int add_tok = 1;
+  res.s = smt->raw;
+  res.len = 1;
 
   char d = *smt->raw++;
 
   if (d == '\0')
     {
       res.type = TOK_EOF;
+      res.len = 0;
       __tokensm_add (smt, res);
       return &smt->vals[smt->vl - 1];
     }
 
-  if ((d >= 'A' && d <= 'Z') || (d >= 'a' && d <= 'z') || d == '_')
+  if (is_idstart (d))
     {
-      size_t idl = 0;
-      __strbfr[idl++] = d;
-
-      d = *smt->raw++;
-      while (d)
-        {
-          if ((d >= 'A' && d <= 'Z') || (d >= 'a' && d <= 'z')
-              || (d >= '0' && d <= '9') || d == '_')
-            {
-              __strbfr[idl++] = d;
-              d = *smt->raw++;
-            }
-          else
-            break;
-        }
+      const char *p = smt->raw + sf_scan_ident (smt->raw);
+      uint32_t n = (uint32_t)(p - res.s);
+      int h = KW_HASH (res.s, n);
 
-      __strbfr[idl] = '\0';
+      res.len = n;
+      res.type = TOK_IDENTIFIER;
 
-      if (is_keyword (__strbfr))
-        {
-          res.type = TOK_KEYWORD;
-          res.v.t_keyword.value = SFSTRDUP (__strbfr);
-        }
-      else if (is_bool (__strbfr))
+      if (KEYWORDS[h].w != NULL && !strncmp (KEYWORDS[h].w, res.s, n)
+          && KEYWORDS[h].w[n] == '\0')
         {
-          res.type = TOK_BOOL;
-          res.v.t_bool.value = *__strbfr == 't';
-        }
-      else if (!strcmp (__strbfr, "none"))
-        {
-          res.type = TOK_NONE;
-        }
-      else
-        {
-          res.type = TOK_IDENTIFIER;
-          res.v.t_identifier.value = SFSTRDUP (__strbfr);
+          res.type = KEYWORDS[h].type;
+
+          if (res.type == TOK_KEYWORD)
+            res.v.t_keyword.value = KEYWORDS[h].w;
+          else if (res.type == TOK_BOOL)
+            res.v.t_bool.value = *res.s == 't';
         }
 
-      smt->raw--;
+      smt->raw = (char *)p;
     }
 
-  else if (d >= '0' && d <= '9')
+  else if (is_digit (d))
     {
-      size_t idl = 0;
-      __strbfr[idl++] = d;
+      const char *p = smt->raw + sf_scan_digits (smt->raw);
+      int saw_dot = *p == '.';
 
-      d = *smt->raw++;
-      int saw_dot = 0;
-
-      while (d)
-        {
-          if ((d >= '0' && d <= '9') || d == '.')
-            {
-              if (d == '.')
-                {
-                  if (saw_dot)
-                    break;
-                  saw_dot = 1;
-                }
-
-              __strbfr[idl++] = d;
-              d = *smt->raw++;
-            }
-          else
-            break;
-        }
+      if (saw_dot)
+        p += 1 + sf_scan_digits (p + 1);
 
-      __strbfr[idl] = '\0';
+      res.len = (uint32_t)(p - res.s);
 
       if (saw_dot)
         {
+          /* strtod wants a terminated string and would read exponents */
+          char b[64];
+          size_t n = res.len < sizeof (b) ? res.len : sizeof (b) - 1;
+
+          memcpy (b, res.s, n);
+          b[n] = '\0';
+
           res.type = TOK_FLOAT;
-          res.v.t_float.value = atof (__strbfr);
+          res.v.t_float.value = (float)strtod (b, NULL);
         }
       else
         {
+          unsigned int iv = 0;
+
+          for (const char *q = res.s; q < p; q++)
+            iv = iv * 10 + (*q - '0');
+
           res.type = TOK_INTEGER;
-          res.v.t_integer.value = atoi (__strbfr);
+          res.v.t_integer.value = (int)iv;
         }
 
-      smt->raw--;
+      smt->raw = (char *)p;
     }
 
-  else if (strstr ("~!%^&*()-+=[]{}\\|:/.,<>", (char *)(char[]){ d, '\0' })
-           != NULL)
+  else if ((unsigned char)d < 128 && OP1[(unsigned char)d] != NULL)
     {
-      char op[4] = { 0 };
-      op[0] = d;
-
-      if (*smt->raw)
-        op[1] = *(smt->raw);
-
-      if (*(smt->raw + 1))
-        op[2] = *(smt->raw + 1);
-
-      makeop (op);
-
-      smt->raw += strlen (op) - 1;
-
       res.type = TOK_OPERATOR;
-      res.v.t_operator.value = SFSTRDUP (op);
+      res.v.t_operator.value = op_spelling (res.s, &res.len);
+
+      smt->raw += res.len - 1;
     }
   else if (d == '\'' || d == '\"')
     {
-      char qt = d;
-
-      size_t idl = 0;
-
-      d = *smt->raw++;
+      const char *p = smt->raw + sf_scan_string (smt->raw, d);
+      int esc = 0;
 
-      while (d)
+      while (*p == '\\')
         {
-          if (d == '\\' && *smt->raw)
+          if (p[1])
             {
-              char next = *smt->raw++;
-              switch (next)
-                {
-                case 'n':
-                  __strbfr[idl++] = '\n';
-                  break;
-                case 't':
-                  __strbfr[idl++] = '\t';
-                  break;
-                case 'r':
-                  __strbfr[idl++] = '\r';
-                  break;
-                case '\\':
-                  __strbfr[idl++] = '\\';
-                  break;
-                case '\'':
-                  __strbfr[idl++] = '\'';
-                  break;
-                case '\"':
-                  __strbfr[idl++] = '\"';
-                  break;
-                case '0':
-                  __strbfr[idl++] = '\0';
-                  break;
-                default:
-                  __strbfr[idl++] = '\\';
-                  __strbfr[idl++] = next;
-                  break;
-                }
-              d = *smt->raw++;
+              esc = 1;
+              p++;
             }
-          else if (d == qt)
-            break;
-          else
-            {
-              __strbfr[idl++] = d;
-              d = *smt->raw++;
-            }
-        }
 
-      __strbfr[idl] = '\0';
+          p++;
+          p += sf_scan_string (p, d);
+        }
 
       res.type = TOK_STRING;
-      res.v.t_string.value = SFSTRDUP (__strbfr);
+      res.s = smt->raw;
+      res.len = (uint32_t)(p - smt->raw);
+      res.v.t_string.esc = esc;
+
+      smt->raw = (char *)(*p ? p + 1 : p);
     }
   else if (d == '\n')
     {
@@ -290,26 +218,28 @@ sf_token_next (TokenSM *smt)
     }
   else if (d == ' ')
     {
-      if (smt->vl)
-        {
-          if (smt->vals[smt->vl - 1].type == TOK_NEWLINE && *smt->raw == ' ')
-            {
-              res.type = TOK_SPACE;
-              res.v.space.v = 2;
-              smt->raw++;
-            }
+      /* indentation is the run after a newline, other runs vanish */
+      size_t n = 1 + sf_scan_spaces (smt->raw);
+      token_t *prev = smt->vl ? &smt->vals[smt->vl - 1] : NULL;
 
-          if (smt->vals[smt->vl - 1].type == TOK_SPACE)
-            {
-              smt->vals[smt->vl - 1].v.space.v += 1;
-              add_tok = 0;
-            }
+      if (prev != NULL && prev->type == TOK_SPACE)
+        {
+          prev->v.space.v += n;
+          prev->len += (uint32_t)n;
+        }
+      else if (prev != NULL && prev->type == TOK_NEWLINE && n > 1)
+        {
+          res.type = TOK_SPACE;
+          res.v.space.v = n;
+          res.len = (uint32_t)n;
         }
+
+      smt->raw += n - 1;
     }
   else
     return &smt->vals[smt->vl - 1];
 
-  if (add_tok && res.type != -1)
+  if (res.type != -1)
     __tokensm_add (smt, res);
 
   return &smt->vals[smt->vl - 1];
@@ -318,16 +248,12 @@ sf_token_next (TokenSM *smt)
 SF_API void
 sf_token_gen (TokenSM *smt)
 {
-  if (__strbfr == NULL)
-    __strbfr = SFMALLOC (1024 * sizeof (char));
+  sf_scan_init ();
 
   token_t *n = sf_token_next (smt);
 
   while (n->type != TOK_EOF)
     n = sf_token_next (smt);
-
-  SFFREE (__strbfr);
-  __strbfr = NULL;
 }
 
 SF_API void
@@ -342,7 +268,7 @@ sf_token_resize (TokenSM *smt)
 {
   if (smt->vl >= smt->vc)
     {
-      smt->vc += SF_TOKEN_STATEM_VALS_CAP;
+      smt->vc <<= 1;
       smt->vals = SFREALLOC (smt->vals, smt->vc * sizeof (*smt->vals));
     }
 }
@@ -365,13 +291,13 @@ sf_token_print (token_t tok)
       printf ("Float: %f\n", tok.v.t_float.value);
       break;
     case TOK_STRING:
-      printf ("String: \"%s\"\n", tok.v.t_string.value);
+      printf ("String: \"%.*s\"\n", (int)tok.len, tok.s);
       break;
     case TOK_OPERATOR:
       printf ("Operator: '%s'\n", tok.v.t_operator.value);
       break;
     case TOK_IDENTIFIER:
-      printf ("Identifier: %s\n", tok.v.t_identifier.value);
+      printf ("Identifier: %.*s\n", (int)tok.len, tok.s);
       break;
     case TOK_KEYWORD:
       printf ("Keyword: %s\n", tok.v.t_keyword.value);
@@ -394,28 +320,92 @@ sf_tokensm_print (TokenSM *smt)
     }
 }
 
+/* tokens own nothing, kept for callers that free them one by one */
 SF_API void
 sf_token_free (token_t *t)
+{
+  (void)t;
+}
+
+SF_API const char *
+sf_token_name (token_t *t)
 {
   switch (t->type)
     {
-    case TOK_IDENTIFIER:
-      SFFREE ((void *)t->v.t_identifier.value);
-      break;
-
     case TOK_KEYWORD:
-      SFFREE ((void *)t->v.t_keyword.value);
-      break;
-
-    case TOK_STRING:
-      SFFREE ((void *)t->v.t_string.value);
-      break;
+      return t->v.t_keyword.value;
 
     case TOK_OPERATOR:
-      SFFREE ((void *)t->v.t_operator.value);
-      break;
+      return t->v.t_operator.value;
 
     default:
       break;
     }
-}
\ No newline at end of file
+
+  return sf_intern (t->s, t->len);
+}
+
+/* decodes into r, which has room for len + 1 bytes */
+SF_API char *
+sf_token_string_to (token_t *t, char *r)
+{
+  if (!t->v.t_string.esc)
+    {
+      memcpy (r, t->s, t->len);
+      r[t->len] = '\0';
+      return r;
+    }
+
+  const char *p = t->s, *e = t->s + t->len;
+  size_t n = 0;
+
+  while (p < e)
+    {
+      if (*p != '\\' || p + 1 == e)
+        {
+          r[n++] = *p++;
+          continue;
+        }
+
+      char next = p[1];
+      p += 2;
+
+      switch (next)
+        {
+        case 'n':
+          r[n++] = '\n';
+          break;
+        case 't':
+          r[n++] = '\t';
+          break;
+        case 'r':
+          r[n++] = '\r';
+          break;
+        case '\\':
+          r[n++] = '\\';
+          break;
+        case '\'':
+          r[n++] = '\'';
+          break;
+        case '\"':
+          r[n++] = '\"';
+          break;
+        case '0':
+          r[n++] = '\0';
+          break;
+        default:
+          r[n++] = '\\';
+          r[n++] = next;
+          break;
+        }
+    }
+
+  r[n] = '\0';
+  return r;
+}
+
+SF_API char *
+sf_token_string (token_t *t)
+{
+  return sf_token_string_to (t, SFMALLOC (t->len + 1));
+}
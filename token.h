@@ -2,6 +2,7 @@
 #define TOKEN_H
 
 #include "header.h"
+#include "intern.h"
 #include "malloc.h"
 
 enum TokenType
@@ -19,9 +20,18 @@ enum TokenType
   TOK_EOF
 };
 
+/**
+ * Tokens point into the source buffer instead of owning copies: s/len
+ * span the token text (a string's body without the quotes). Keywords
+ * and operators use static spellings; identifiers are interned with
+ * sf_token_name and strings decoded with sf_token_string when the
+ * parser needs them. The source must outlive its tokens.
+ */
 typedef struct
 {
   int type;
+  uint32_t len;
+  const char *s;
 
   union
   {
@@ -42,7 +52,7 @@ typedef struct
 
     struct
     {
-      const char *value;
+      int esc; /* body has escapes, sf_token_string decodes them */
     } t_string;
 
     struct
@@ -50,11 +60,6 @@ typedef struct
       const char *value;
     } t_operator;
 
-    struct
-    {
-      const char *value;
-    } t_identifier;
-
     struct
     {
       const char *value;
@@ -96,6 +101,10 @@ extern "C"
   SF_API void sf_tokensm_print (TokenSM *);
   SF_API void sf_token_free (token_t *);
 
+  SF_API const char *sf_token_name (token_t *);
+  SF_API char *sf_token_string (token_t *);
+  SF_API char *sf_token_string_to (token_t *, char *);
+
 #if defined(__cplusplus)
 }
 #endif // __cplusplus
@@ -0,0 +1,1305 @@
+#include "vec.h"
+
+#include <limits.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VEC_X86
+#include <immintrin.h>
+
+#define VEC_SSE2_FN __attribute__ ((target ("sse2")))
+#define VEC_AVX2_FN __attribute__ ((target ("avx2")))
+#endif // __GNUC__ && x86
+
+typedef struct
+{
+  int64_t (*sum_i32) (const int32_t *, size_t);
+  int64_t (*sum_i64) (const int64_t *, size_t);
+  double (*sum_f64) (const double *, size_t);
+
+  int32_t (*min_i32) (const int32_t *, size_t);
+  int64_t (*min_i64) (const int64_t *, size_t);
+  double (*min_f64) (const double *, size_t);
+
+  int32_t (*max_i32) (const int32_t *, size_t);
+  int64_t (*max_i64) (const int64_t *, size_t);
+  double (*max_f64) (const double *, size_t);
+
+  int64_t (*dot_i32) (const int32_t *, const int32_t *, size_t);
+  int64_t (*dot_i64) (const int64_t *, const int64_t *, size_t);
+  double (*dot_f64) (const double *, const double *, size_t);
+
+  void (*adds_i32) (int32_t *, const int32_t *, int32_t, size_t);
+  void (*adds_i64) (int64_t *, const int64_t *, int64_t, size_t);
+  void (*adds_f64) (double *, const double *, double, size_t);
+
+  void (*muls_i32) (int32_t *, const int32_t *, int32_t, size_t);
+  void (*muls_i64) (int64_t *, const int64_t *, int64_t, size_t);
+  void (*muls_f64) (double *, const double *, double, size_t);
+
+  void (*add_i32) (int32_t *, const int32_t *, const int32_t *, size_t);
+  void (*add_i64) (int64_t *, const int64_t *, const int64_t *, size_t);
+  void (*add_f64) (double *, const double *, const double *, size_t);
+
+  void (*mul_i32) (int32_t *, const int32_t *, const int32_t *, size_t);
+  void (*mul_i64) (int64_t *, const int64_t *, const int64_t *, size_t);
+  void (*mul_f64) (double *, const double *, const double *, size_t);
+
+  size_t (*count_i32) (const int32_t *, size_t, int, int32_t);
+  size_t (*count_i64) (const int64_t *, size_t, int, int64_t);
+  size_t (*count_f64) (const double *, size_t, int, double);
+
+  size_t (*filter_i32) (int32_t *, const int32_t *, size_t, int, int32_t);
+  size_t (*filter_i64) (int64_t *, const int64_t *, size_t, int, int64_t);
+  size_t (*filter_f64) (double *, const double *, size_t, int, double);
+
+} vec_kernels_t;
+
+/* expands STMT once per comparison operator */
+#define VEC_PRED(CMP, STMT)                                                   \
+  switch (CMP)                                                                \
+    {                                                                         \
+    case VEC_LT:                                                              \
+      STMT (<);                                                               \
+      break;                                                                  \
+    case VEC_LE:                                                              \
+      STMT (<=);                                                              \
+      break;                                                                  \
+    case VEC_GT:                                                              \
+      STMT (>);                                                               \
+      break;                                                                  \
+    case VEC_GE:                                                              \
+      STMT (>=);                                                              \
+      break;                                                                  \
+    case VEC_EQ:                                                              \
+      STMT (==);                                                              \
+      break;                                                                  \
+    case VEC_NE:                                                              \
+      STMT (!=);                                                              \
+      break;                                                                  \
+    default:                                                                  \
+      break;                                                                  \
+    }
+
+#define VEC_COUNT_LOOP(OP)                                                    \
+  for (size_t i = 0; i < n; i++)                                              \
+    c += a[i] OP k;
+
+#define VEC_FILTER_LOOP(OP)                                                   \
+  for (size_t i = 0; i < n; i++)                                              \
+    if (a[i] OP k)                                                            \
+      dst[w++] = a[i];
+
+/**
+ * Scalar kernels. Integer arithmetic goes through the unsigned types UT
+ * and UACC so overflow wraps the same way the SIMD lanes do.
+ */
+#define VEC_SCALAR_KERNELS(N, T, UT, ACC, UACC)                               \
+  static ACC sum_##N##_scalar (const T *a, size_t n)                          \
+  {                                                                           \
+    ACC s = 0;                                                                \
+    for (size_t i = 0; i < n; i++)                                            \
+      s = (ACC)((UACC)s + (UACC)a[i]);                                        \
+    return s;                                                                 \
+  }                                                                           \
+                                                                              \
+  static T min_##N##_scalar (const T *a, size_t n)                            \
+  {                                                                           \
+    T m = a[0];                                                               \
+    for (size_t i = 1; i < n; i++)                                            \
+      if (a[i] < m)                                                           \
+        m = a[i];                                                             \
+    return m;                                                                 \
+  }                                                                           \
+                                                                              \
+  static T max_##N##_scalar (const T *a, size_t n)                            \
+  {                                                                           \
+    T m = a[0];                                                               \
+    for (size_t i = 1; i < n; i++)                                            \
+      if (a[i] > m)                                                           \
+        m = a[i];                                                             \
+    return m;                                                                 \
+  }                                                                           \
+                                                                              \
+  static ACC dot_##N##_scalar (const T *a, const T *b, size_t n)              \
+  {                                                                           \
+    ACC s = 0;                                                                \
+    for (size_t i = 0; i < n; i++)                                            \
+      s = (ACC)((UACC)s + (UACC)a[i] * (UACC)b[i]);                           \
+    return s;                                                                 \
+  }                                                                           \
+                                                                              \
+  static void adds_##N##_scalar (T *dst, const T *a, T k, size_t n)           \
+  {                                                                           \
+    for (size_t i = 0; i < n; i++)                                            \
+      dst[i] = (T)((UT)a[i] + (UT)k);                                         \
+  }                                                                           \
+                                                                              \
+  static void muls_##N##_scalar (T *dst, const T *a, T k, size_t n)           \
+  {                                                                           \
+    for (size_t i = 0; i < n; i++)                                            \
+      dst[i] = (T)((UT)a[i] * (UT)k);                                         \
+  }                                                                           \
+                                                                              \
+  static void add_##N##_scalar (T *dst, const T *a, const T *b, size_t n)     \
+  {                                                                           \
+    for (size_t i = 0; i < n; i++)                                            \
+      dst[i] = (T)((UT)a[i] + (UT)b[i]);                                      \
+  }                                                                           \
+                                                                              \
+  static void mul_##N##_scalar (T *dst, const T *a, const T *b, size_t n)     \
+  {                                                                           \
+    for (size_t i = 0; i < n; i++)                                            \
+      dst[i] = (T)((UT)a[i] * (UT)b[i]);                                      \
+  }                                                                           \
+                                                                              \
+  static size_t count_##N##_scalar (const T *a, size_t n, int cmp, T k)       \
+  {                                                                           \
+    size_t c = 0;                                                             \
+    VEC_PRED (cmp, VEC_COUNT_LOOP);                                           \
+    return c;                                                                 \
+  }                                                                           \
+                                                                              \
+  static size_t filter_##N##_scalar (T *dst, const T *a, size_t n, int cmp,   \
+                                     T k)                                     \
+  {                                                                           \
+    size_t w = 0;                                                             \
+    VEC_PRED (cmp, VEC_FILTER_LOOP);                                          \
+    return w;                                                                 \
+  }
+
+VEC_SCALAR_KERNELS (i32, int32_t, uint32_t, int64_t, uint64_t)
+VEC_SCALAR_KERNELS (i64, int64_t, uint64_t, int64_t, uint64_t)
+VEC_SCALAR_KERNELS (f64, double, double, double, double)
+
+/**
+ * SIMD building blocks. A kernel runs full vectors of W lanes and hands
+ * the remaining tail to the scalar version.
+ */
+#define VEC_BINOP(ATTR, NAME, N, T, W, VT, LOAD, STORE, OP)                   \
+  ATTR static void NAME (T *dst, const T *a, const T *b, size_t n)            \
+  {                                                                           \
+    size_t i = 0;                                                             \
+    for (; i + W <= n; i += W)                                                \
+      STORE (dst + i, OP (LOAD (a + i), LOAD (b + i)));                       \
+    N##_scalar (dst + i, a + i, b + i, n - i);                                \
+  }
+
+#define VEC_SCALAROP(ATTR, NAME, N, T, W, VT, LOAD, STORE, SET1, OP)          \
+  ATTR static void NAME (T *dst, const T *a, T k, size_t n)                   \
+  {                                                                           \
+    VT kk = SET1 (k);                                                         \
+    size_t i = 0;                                                             \
+    for (; i + W <= n; i += W)                                                \
+      STORE (dst + i, OP (LOAD (a + i), kk));                                 \
+    N##_scalar (dst + i, a + i, k, n - i);                                    \
+  }
+
+#define VEC_MASKED(ATTR, N, LEVEL, T, W, VT, LOAD, SET1, MASK)                \
+  ATTR static size_t count_##N##_##LEVEL (const T *a, size_t n, int cmp,      \
+                                          T k)                                \
+  {                                                                           \
+    VT kk = SET1 (k);                                                         \
+    size_t i = 0, c = 0;                                                      \
+    for (; i + W <= n; i += W)                                                \
+      c += __builtin_popcount (MASK (LOAD (a + i), kk, cmp));                 \
+    return c + count_##N##_scalar (a + i, n - i, cmp, k);                     \
+  }                                                                           \
+                                                                              \
+  ATTR static size_t filter_##N##_##LEVEL (T *dst, const T *a, size_t n,      \
+                                           int cmp, T k)                      \
+  {                                                                           \
+    VT kk = SET1 (k);                                                         \
+    size_t i = 0, w = 0;                                                      \
+    for (; i + W <= n; i += W)                                                \
+      {                                                                       \
+        unsigned m = MASK (LOAD (a + i), kk, cmp);                            \
+        while (m)                                                             \
+          {                                                                   \
+            dst[w++] = a[i + __builtin_ctz (m)];                              \
+            m &= m - 1;                                                       \
+          }                                                                   \
+      }                                                                       \
+    return w + filter_##N##_scalar (dst + w, a + i, n - i, cmp, k);           \
+  }
+
+#if defined(VEC_X86)
+
+/* SSE2 */
+
+VEC_SSE2_FN static inline __m128i
+ld_si_sse2 (const void *p)
+{
+  return _mm_loadu_si128 ((const __m128i *)p);
+}
+
+VEC_SSE2_FN static inline void
+st_si_sse2 (void *p, __m128i v)
+{
+  _mm_storeu_si128 ((__m128i *)p, v);
+}
+
+VEC_SSE2_FN static inline __m128i
+sel_si_sse2 (__m128i m, __m128i a, __m128i b)
+{
+  return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));
+}
+
+VEC_SSE2_FN static int64_t
+sum_i32_sse2 (const int32_t *a, size_t n)
+{
+  __m128i acc = _mm_setzero_si128 ();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = ld_si_sse2 (a + i);
+      __m128i sign = _mm_srai_epi32 (v, 31);
+
+      /* sign-extend to 64-bit lanes so the sum cannot overflow */
+      acc = _mm_add_epi64 (acc, _mm_unpacklo_epi32 (v, sign));
+      acc = _mm_add_epi64 (acc, _mm_unpackhi_epi32 (v, sign));
+    }
+
+  int64_t l[2];
+  st_si_sse2 (l, acc);
+
+  return l[0] + l[1] + sum_i32_scalar (a + i, n - i);
+}
+
+VEC_SSE2_FN static int64_t
+sum_i64_sse2 (const int64_t *a, size_t n)
+{
+  __m128i acc = _mm_setzero_si128 ();
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2)
+    acc = _mm_add_epi64 (acc, ld_si_sse2 (a + i));
+
+  int64_t l[2];
+  st_si_sse2 (l, acc);
+
+  return (int64_t)((uint64_t)l[0] + (uint64_t)l[1]
+                   + (uint64_t)sum_i64_scalar (a + i, n - i));
+}
+
+VEC_SSE2_FN static double
+sum_f64_sse2 (const double *a, size_t n)
+{
+  __m128d acc = _mm_setzero_pd ();
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2)
+    acc = _mm_add_pd (acc, _mm_loadu_pd (a + i));
+
+  double l[2];
+  _mm_storeu_pd (l, acc);
+
+  return l[0] + l[1] + sum_f64_scalar (a + i, n - i);
+}
+
+VEC_SSE2_FN static int32_t
+min_i32_sse2 (const int32_t *a, size_t n)
+{
+  if (n < 4)
+    return min_i32_scalar (a, n);
+
+  __m128i m = ld_si_sse2 (a);
+  size_t i = 4;
+
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = ld_si_sse2 (a + i);
+      m = sel_si_sse2 (_mm_cmplt_epi32 (v, m), v, m);
+    }
+
+  int32_t l[4];
+  st_si_sse2 (l, m);
+
+  int32_t r = min_i32_scalar (l, 4);
+
+  if (i < n)
+    {
+      int32_t t = min_i32_scalar (a + i, n - i);
+      r = t < r ? t : r;
+    }
+
+  return r;
+}
+
+VEC_SSE2_FN static int32_t
+max_i32_sse2 (const int32_t *a, size_t n)
+{
+  if (n < 4)
+    return max_i32_scalar (a, n);
+
+  __m128i m = ld_si_sse2 (a);
+  size_t i = 4;
+
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = ld_si_sse2 (a + i);
+      m = sel_si_sse2 (_mm_cmpgt_epi32 (v, m), v, m);
+    }
+
+  int32_t l[4];
+  st_si_sse2 (l, m);
+
+  int32_t r = max_i32_scalar (l, 4);
+
+  if (i < n)
+    {
+      int32_t t = max_i32_scalar (a + i, n - i);
+      r = t > r ? t : r;
+    }
+
+  return r;
+}
+
+VEC_SSE2_FN static double
+min_f64_sse2 (const double *a, size_t n)
+{
+  if (n < 2)
+    return min_f64_scalar (a, n);
+
+  __m128d m = _mm_loadu_pd (a);
+  size_t i = 2;
+
+  for (; i + 2 <= n; i += 2)
+    m = _mm_min_pd (m, _mm_loadu_pd (a + i));
+
+  double l[2];
+  _mm_storeu_pd (l, m);
+
+  double r = l[1] < l[0] ? l[1] : l[0];
+
+  if (i < n && a[i] < r)
+    r = a[i];
+
+  return r;
+}
+
+VEC_SSE2_FN static double
+max_f64_sse2 (const double *a, size_t n)
+{
+  if (n < 2)
+    return max_f64_scalar (a, n);
+
+  __m128d m = _mm_loadu_pd (a);
+  size_t i = 2;
+
+  for (; i + 2 <= n; i += 2)
+    m = _mm_max_pd (m, _mm_loadu_pd (a + i));
+
+  double l[2];
+  _mm_storeu_pd (l, m);
+
+  double r = l[1] > l[0] ? l[1] : l[0];
+
+  if (i < n && a[i] > r)
+    r = a[i];
+
+  return r;
+}
+
+VEC_SSE2_FN static double
+dot_f64_sse2 (const double *a, const double *b, size_t n)
+{
+  __m128d acc = _mm_setzero_pd ();
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2)
+    acc = _mm_add_pd (acc,
+                      _mm_mul_pd (_mm_loadu_pd (a + i), _mm_loadu_pd (b + i)));
+
+  double l[2];
+  _mm_storeu_pd (l, acc);
+
+  return l[0] + l[1] + dot_f64_scalar (a + i, b + i, n - i);
+}
+
+VEC_BINOP (VEC_SSE2_FN, add_i32_sse2, add_i32, int32_t, 4, __m128i,
+           ld_si_sse2, st_si_sse2, _mm_add_epi32)
+VEC_BINOP (VEC_SSE2_FN, add_i64_sse2, add_i64, int64_t, 2, __m128i,
+           ld_si_sse2, st_si_sse2, _mm_add_epi64)
+VEC_BINOP (VEC_SSE2_FN, add_f64_sse2, add_f64, double, 2, __m128d,
+           _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd)
+VEC_BINOP (VEC_SSE2_FN, mul_f64_sse2, mul_f64, double, 2, __m128d,
+           _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd)
+
+VEC_SCALAROP (VEC_SSE2_FN, adds_i32_sse2, adds_i32, int32_t, 4, __m128i,
+              ld_si_sse2, st_si_sse2, _mm_set1_epi32, _mm_add_epi32)
+VEC_SCALAROP (VEC_SSE2_FN, adds_i64_sse2, adds_i64, int64_t, 2, __m128i,
+              ld_si_sse2, st_si_sse2, _mm_set1_epi64x, _mm_add_epi64)
+VEC_SCALAROP (VEC_SSE2_FN, adds_f64_sse2, adds_f64, double, 2, __m128d,
+              _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_add_pd)
+VEC_SCALAROP (VEC_SSE2_FN, muls_f64_sse2, muls_f64, double, 2, __m128d,
+              _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_mul_pd)
+
+VEC_SSE2_FN static inline unsigned
+mask_i32_sse2 (__m128i v, __m128i k, int cmp)
+{
+  switch (cmp)
+    {
+    case VEC_LT:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmplt_epi32 (v, k)));
+    case VEC_LE:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (v, k)))
+             ^ 0xf;
+    case VEC_GT:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (v, k)));
+    case VEC_GE:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmplt_epi32 (v, k)))
+             ^ 0xf;
+    case VEC_EQ:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (v, k)));
+    case VEC_NE:
+      return _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (v, k)))
+             ^ 0xf;
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+VEC_SSE2_FN static inline unsigned
+mask_f64_sse2 (__m128d v, __m128d k, int cmp)
+{
+  switch (cmp)
+    {
+    case VEC_LT:
+      return _mm_movemask_pd (_mm_cmplt_pd (v, k));
+    case VEC_LE:
+      return _mm_movemask_pd (_mm_cmple_pd (v, k));
+    case VEC_GT:
+      return _mm_movemask_pd (_mm_cmpgt_pd (v, k));
+    case VEC_GE:
+      return _mm_movemask_pd (_mm_cmpge_pd (v, k));
+    case VEC_EQ:
+      return _mm_movemask_pd (_mm_cmpeq_pd (v, k));
+    case VEC_NE:
+      return _mm_movemask_pd (_mm_cmpneq_pd (v, k));
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+VEC_MASKED (VEC_SSE2_FN, i32, sse2, int32_t, 4, __m128i, ld_si_sse2,
+            _mm_set1_epi32, mask_i32_sse2)
+VEC_MASKED (VEC_SSE2_FN, f64, sse2, double, 2, __m128d, _mm_loadu_pd,
+            _mm_set1_pd, mask_f64_sse2)
+
+/* AVX2 */
+
+VEC_AVX2_FN static inline __m256i
+ld_si_avx2 (const void *p)
+{
+  return _mm256_loadu_si256 ((const __m256i *)p);
+}
+
+VEC_AVX2_FN static inline void
+st_si_avx2 (void *p, __m256i v)
+{
+  _mm256_storeu_si256 ((__m256i *)p, v);
+}
+
+VEC_AVX2_FN static inline int64_t
+hsum_i64_avx2 (__m256i v)
+{
+  int64_t l[4];
+  st_si_avx2 (l, v);
+
+  return (int64_t)((uint64_t)l[0] + (uint64_t)l[1] + (uint64_t)l[2]
+                   + (uint64_t)l[3]);
+}
+
+VEC_AVX2_FN static inline double
+hsum_f64_avx2 (__m256d v)
+{
+  double l[4];
+  _mm256_storeu_pd (l, v);
+
+  return (l[0] + l[1]) + (l[2] + l[3]);
+}
+
+VEC_AVX2_FN static int64_t
+sum_i32_avx2 (const int32_t *a, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256 ();
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8)
+    {
+      __m128i lo = _mm_loadu_si128 ((const __m128i *)(a + i));
+      __m128i hi = _mm_loadu_si128 ((const __m128i *)(a + i + 4));
+
+      acc = _mm256_add_epi64 (acc, _mm256_cvtepi32_epi64 (lo));
+      acc = _mm256_add_epi64 (acc, _mm256_cvtepi32_epi64 (hi));
+    }
+
+  return hsum_i64_avx2 (acc) + sum_i32_scalar (a + i, n - i);
+}
+
+VEC_AVX2_FN static int64_t
+sum_i64_avx2 (const int64_t *a, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256 ();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    acc = _mm256_add_epi64 (acc, ld_si_avx2 (a + i));
+
+  return (int64_t)((uint64_t)hsum_i64_avx2 (acc)
+                   + (uint64_t)sum_i64_scalar (a + i, n - i));
+}
+
+VEC_AVX2_FN static double
+sum_f64_avx2 (const double *a, size_t n)
+{
+  __m256d acc = _mm256_setzero_pd ();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    acc = _mm256_add_pd (acc, _mm256_loadu_pd (a + i));
+
+  return hsum_f64_avx2 (acc) + sum_f64_scalar (a + i, n - i);
+}
+
+#define VEC_MINMAX_AVX2(NAME, N, T, W, VT, LOAD, STORE, OP, BETTER)           \
+  VEC_AVX2_FN static T NAME##_##N##_avx2 (const T *a, size_t n)               \
+  {                                                                           \
+    if (n < W)                                                                \
+      return NAME##_##N##_scalar (a, n);                                      \
+                                                                              \
+    VT m = LOAD (a);                                                          \
+    size_t i = W;                                                             \
+                                                                              \
+    for (; i + W <= n; i += W)                                                \
+      m = OP (m, LOAD (a + i));                                               \
+                                                                              \
+    T l[W];                                                                   \
+    STORE (l, m);                                                             \
+                                                                              \
+    T r = NAME##_##N##_scalar (l, W);                                         \
+                                                                              \
+    if (i < n)                                                                \
+      {                                                                       \
+        T t = NAME##_##N##_scalar (a + i, n - i);                             \
+        r = t BETTER r ? t : r;                                               \
+      }                                                                       \
+                                                                              \
+    return r;                                                                 \
+  }
+
+VEC_AVX2_FN static inline __m256i
+min_epi64_avx2 (__m256i a, __m256i b)
+{
+  return _mm256_blendv_epi8 (a, b, _mm256_cmpgt_epi64 (a, b));
+}
+
+VEC_AVX2_FN static inline __m256i
+max_epi64_avx2 (__m256i a, __m256i b)
+{
+  return _mm256_blendv_epi8 (b, a, _mm256_cmpgt_epi64 (a, b));
+}
+
+VEC_MINMAX_AVX2 (min, i32, int32_t, 8, __m256i, ld_si_avx2, st_si_avx2,
+                 _mm256_min_epi32, <)
+VEC_MINMAX_AVX2 (max, i32, int32_t, 8, __m256i, ld_si_avx2, st_si_avx2,
+                 _mm256_max_epi32, >)
+VEC_MINMAX_AVX2 (min, i64, int64_t, 4, __m256i, ld_si_avx2, st_si_avx2,
+                 min_epi64_avx2, <)
+VEC_MINMAX_AVX2 (max, i64, int64_t, 4, __m256i, ld_si_avx2, st_si_avx2,
+                 max_epi64_avx2, >)
+VEC_MINMAX_AVX2 (min, f64, double, 4, __m256d, _mm256_loadu_pd,
+                 _mm256_storeu_pd, _mm256_min_pd, <)
+VEC_MINMAX_AVX2 (max, f64, double, 4, __m256d, _mm256_loadu_pd,
+                 _mm256_storeu_pd, _mm256_max_pd, >)
+
+VEC_AVX2_FN static int64_t
+dot_i32_avx2 (const int32_t *a, const int32_t *b, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256 ();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    {
+      /* widen first, _mm256_mul_epi32 gives full 64-bit products */
+      __m256i x = _mm256_cvtepi32_epi64 (
+          _mm_loadu_si128 ((const __m128i *)(a + i)));
+      __m256i y = _mm256_cvtepi32_epi64 (
+          _mm_loadu_si128 ((const __m128i *)(b + i)));
+
+      acc = _mm256_add_epi64 (acc, _mm256_mul_epi32 (x, y));
+    }
+
+  return (int64_t)((uint64_t)hsum_i64_avx2 (acc)
+                   + (uint64_t)dot_i32_scalar (a + i, b + i, n - i));
+}
+
+VEC_AVX2_FN static double
+dot_f64_avx2 (const double *a, const double *b, size_t n)
+{
+  __m256d acc = _mm256_setzero_pd ();
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4)
+    acc = _mm256_add_pd (
+        acc, _mm256_mul_pd (_mm256_loadu_pd (a + i), _mm256_loadu_pd (b + i)));
+
+  return hsum_f64_avx2 (acc) + dot_f64_scalar (a + i, b + i, n - i);
+}
+
+VEC_BINOP (VEC_AVX2_FN, add_i32_avx2, add_i32, int32_t, 8, __m256i,
+           ld_si_avx2, st_si_avx2, _mm256_add_epi32)
+VEC_BINOP (VEC_AVX2_FN, add_i64_avx2, add_i64, int64_t, 4, __m256i,
+           ld_si_avx2, st_si_avx2, _mm256_add_epi64)
+VEC_BINOP (VEC_AVX2_FN, add_f64_avx2, add_f64, double, 4, __m256d,
+           _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd)
+VEC_BINOP (VEC_AVX2_FN, mul_i32_avx2, mul_i32, int32_t, 8, __m256i,
+           ld_si_avx2, st_si_avx2, _mm256_mullo_epi32)
+VEC_BINOP (VEC_AVX2_FN, mul_f64_avx2, mul_f64, double, 4, __m256d,
+           _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd)
+
+VEC_SCALAROP (VEC_AVX2_FN, adds_i32_avx2, adds_i32, int32_t, 8, __m256i,
+              ld_si_avx2, st_si_avx2, _mm256_set1_epi32, _mm256_add_epi32)
+VEC_SCALAROP (VEC_AVX2_FN, adds_i64_avx2, adds_i64, int64_t, 4, __m256i,
+              ld_si_avx2, st_si_avx2, _mm256_set1_epi64x, _mm256_add_epi64)
+VEC_SCALAROP (VEC_AVX2_FN, adds_f64_avx2, adds_f64, double, 4, __m256d,
+              _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+              _mm256_add_pd)
+VEC_SCALAROP (VEC_AVX2_FN, muls_i32_avx2, muls_i32, int32_t, 8, __m256i,
+              ld_si_avx2, st_si_avx2, _mm256_set1_epi32, _mm256_mullo_epi32)
+VEC_SCALAROP (VEC_AVX2_FN, muls_f64_avx2, muls_f64, double, 4, __m256d,
+              _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+              _mm256_mul_pd)
+
+VEC_AVX2_FN static inline unsigned
+mask_i32_avx2 (__m256i v, __m256i k, int cmp)
+{
+  __m256i m;
+  unsigned inv = 0;
+
+  switch (cmp)
+    {
+    case VEC_LT:
+      m = _mm256_cmpgt_epi32 (k, v);
+      break;
+    case VEC_LE:
+      m = _mm256_cmpgt_epi32 (v, k);
+      inv = 0xff;
+      break;
+    case VEC_GT:
+      m = _mm256_cmpgt_epi32 (v, k);
+      break;
+    case VEC_GE:
+      m = _mm256_cmpgt_epi32 (k, v);
+      inv = 0xff;
+      break;
+    case VEC_EQ:
+      m = _mm256_cmpeq_epi32 (v, k);
+      break;
+    default:
+      m = _mm256_cmpeq_epi32 (v, k);
+      inv = 0xff;
+      break;
+    }
+
+  return (unsigned)_mm256_movemask_ps (_mm256_castsi256_ps (m)) ^ inv;
+}
+
+VEC_AVX2_FN static inline unsigned
+mask_i64_avx2 (__m256i v, __m256i k, int cmp)
+{
+  __m256i m;
+  unsigned inv = 0;
+
+  switch (cmp)
+    {
+    case VEC_LT:
+      m = _mm256_cmpgt_epi64 (k, v);
+      break;
+    case VEC_LE:
+      m = _mm256_cmpgt_epi64 (v, k);
+      inv = 0xf;
+      break;
+    case VEC_GT:
+      m = _mm256_cmpgt_epi64 (v, k);
+      break;
+    case VEC_GE:
+      m = _mm256_cmpgt_epi64 (k, v);
+      inv = 0xf;
+      break;
+    case VEC_EQ:
+      m = _mm256_cmpeq_epi64 (v, k);
+      break;
+    default:
+      m = _mm256_cmpeq_epi64 (v, k);
+      inv = 0xf;
+      break;
+    }
+
+  return (unsigned)_mm256_movemask_pd (_mm256_castsi256_pd (m)) ^ inv;
+}
+
+VEC_AVX2_FN static inline unsigned
+mask_f64_avx2 (__m256d v, __m256d k, int cmp)
+{
+  switch (cmp)
+    {
+    case VEC_LT:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_LT_OQ));
+    case VEC_LE:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_LE_OQ));
+    case VEC_GT:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_GT_OQ));
+    case VEC_GE:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_GE_OQ));
+    case VEC_EQ:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_EQ_OQ));
+    case VEC_NE:
+      return _mm256_movemask_pd (_mm256_cmp_pd (v, k, _CMP_NEQ_UQ));
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+VEC_MASKED (VEC_AVX2_FN, i32, avx2, int32_t, 8, __m256i, ld_si_avx2,
+            _mm256_set1_epi32, mask_i32_avx2)
+VEC_MASKED (VEC_AVX2_FN, i64, avx2, int64_t, 4, __m256i, ld_si_avx2,
+            _mm256_set1_epi64x, mask_i64_avx2)
+VEC_MASKED (VEC_AVX2_FN, f64, avx2, double, 4, __m256d, _mm256_loadu_pd,
+            _mm256_set1_pd, mask_f64_avx2)
+
+#endif // VEC_X86
+
+#define VEC_SCALAR_ROW(N)                                                     \
+  .sum_##N = sum_##N##_scalar, .min_##N = min_##N##_scalar,                   \
+  .max_##N = max_##N##_scalar, .dot_##N = dot_##N##_scalar,                   \
+  .adds_##N = adds_##N##_scalar, .muls_##N = muls_##N##_scalar,               \
+  .add_##N = add_##N##_scalar, .mul_##N = mul_##N##_scalar,                   \
+  .count_##N = count_##N##_scalar, .filter_##N = filter_##N##_scalar
+
+static const vec_kernels_t vec_scalar = {
+  VEC_SCALAR_ROW (i32),
+  VEC_SCALAR_ROW (i64),
+  VEC_SCALAR_ROW (f64),
+};
+
+static vec_kernels_t vec_k;
+static int vec_lvl = -1;
+static int vec_hw = VEC_LEVEL_SCALAR;
+
+static void
+vec_build (int level)
+{
+  vec_k = vec_scalar;
+  vec_lvl = VEC_LEVEL_SCALAR;
+
+#if defined(VEC_X86)
+  if (level >= VEC_LEVEL_SSE2)
+    {
+      vec_k.sum_i32 = sum_i32_sse2;
+      vec_k.sum_i64 = sum_i64_sse2;
+      vec_k.sum_f64 = sum_f64_sse2;
+      vec_k.min_i32 = min_i32_sse2;
+      vec_k.max_i32 = max_i32_sse2;
+      vec_k.min_f64 = min_f64_sse2;
+      vec_k.max_f64 = max_f64_sse2;
+      vec_k.dot_f64 = dot_f64_sse2;
+      vec_k.add_i32 = add_i32_sse2;
+      vec_k.add_i64 = add_i64_sse2;
+      vec_k.add_f64 = add_f64_sse2;
+      vec_k.mul_f64 = mul_f64_sse2;
+      vec_k.adds_i32 = adds_i32_sse2;
+      vec_k.adds_i64 = adds_i64_sse2;
+      vec_k.adds_f64 = adds_f64_sse2;
+      vec_k.muls_f64 = muls_f64_sse2;
+      vec_k.count_i32 = count_i32_sse2;
+      vec_k.count_f64 = count_f64_sse2;
+      vec_k.filter_i32 = filter_i32_sse2;
+      vec_k.filter_f64 = filter_f64_sse2;
+      vec_lvl = VEC_LEVEL_SSE2;
+    }
+
+  if (level >= VEC_LEVEL_AVX2)
+    {
+      vec_k.sum_i32 = sum_i32_avx2;
+      vec_k.sum_i64 = sum_i64_avx2;
+      vec_k.sum_f64 = sum_f64_avx2;
+      vec_k.min_i32 = min_i32_avx2;
+      vec_k.max_i32 = max_i32_avx2;
+      vec_k.min_i64 = min_i64_avx2;
+      vec_k.max_i64 = max_i64_avx2;
+      vec_k.min_f64 = min_f64_avx2;
+      vec_k.max_f64 = max_f64_avx2;
+      vec_k.dot_i32 = dot_i32_avx2;
+      vec_k.dot_f64 = dot_f64_avx2;
+      vec_k.add_i32 = add_i32_avx2;
+      vec_k.add_i64 = add_i64_avx2;
+      vec_k.add_f64 = add_f64_avx2;
+      vec_k.mul_i32 = mul_i32_avx2;
+      vec_k.mul_f64 = mul_f64_avx2;
+      vec_k.adds_i32 = adds_i32_avx2;
+      vec_k.adds_i64 = adds_i64_avx2;
+      vec_k.adds_f64 = adds_f64_avx2;
+      vec_k.muls_i32 = muls_i32_avx2;
+      vec_k.muls_f64 = muls_f64_avx2;
+      vec_k.count_i32 = count_i32_avx2;
+      vec_k.count_i64 = count_i64_avx2;
+      vec_k.count_f64 = count_f64_avx2;
+      vec_k.filter_i32 = filter_i32_avx2;
+      vec_k.filter_i64 = filter_i64_avx2;
+      vec_k.filter_f64 = filter_f64_avx2;
+      vec_lvl = VEC_LEVEL_AVX2;
+    }
+#else
+  (void)level;
+#endif // VEC_X86
+}
+
+SF_API void
+sf_vec_init (void)
+{
+  if (vec_lvl != -1)
+    return;
+
+  vec_hw = VEC_LEVEL_SCALAR;
+
+#if defined(VEC_X86)
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("sse2"))
+    vec_hw = VEC_LEVEL_SSE2;
+
+  if (__builtin_cpu_supports ("avx2"))
+    vec_hw = VEC_LEVEL_AVX2;
+#endif // VEC_X86
+
+  int want = vec_hw;
+  const char *env = getenv ("SF_VEC");
+
+  if (env != NULL)
+    {
+      for (int l = VEC_LEVEL_SCALAR; l <= VEC_LEVEL_AVX2; l++)
+        if (!strcmp (env, sf_vec_levelname (l)))
+          want = l;
+    }
+
+  vec_build (want < vec_hw ? want : vec_hw);
+}
+
+SF_API int
+sf_vec_level (void)
+{
+  sf_vec_init ();
+  return vec_lvl;
+}
+
+SF_API void
+sf_vec_setlevel (int level)
+{
+  sf_vec_init ();
+  vec_build (level < vec_hw ? level : vec_hw);
+}
+
+SF_API const char *
+sf_vec_levelname (int level)
+{
+  switch (level)
+    {
+    case VEC_LEVEL_SCALAR:
+      return "scalar";
+    case VEC_LEVEL_SSE2:
+      return "sse2";
+    case VEC_LEVEL_AVX2:
+      return "avx2";
+    default:
+      break;
+    }
+
+  return "?";
+}
+
+SF_API int
+sf_vec_cmp_fromstr (const char *s)
+{
+  static const char *ops[] = { "<", "<=", ">", ">=", "==", "!=" };
+
+  for (int i = 0; i < (int)(sizeof (ops) / sizeof (ops[0])); i++)
+    if (!strcmp (s, ops[i]))
+      return i;
+
+  return -1;
+}
+
+static const_t
+vec_int (int64_t v)
+{
+  /* the VM's integers are C ints, a result that does not fit is an
+     error rather than wrapped around, as for sf_tarray_get */
+  if (v < INT_MIN || v > INT_MAX)
+    {
+      printf ("array kernel result %lld does not fit in an int.\n",
+              (long long)v);
+      exit (EXIT_FAILURE);
+    }
+
+  return (const_t){ .type = CONST_INT, .v.c_int.v = (int)v };
+}
+
+static const_t
+vec_float (double v)
+{
+  return (const_t){ .type = CONST_FLOAT, .v.c_float.v = (float)v };
+}
+
+static void
+vec_need_numeric (const_t *c)
+{
+  if (c->type == CONST_INT || c->type == CONST_FLOAT
+      || c->type == CONST_BOOL)
+    return;
+
+  printf ("array kernels expect a numeric operand.\n");
+  exit (EXIT_FAILURE);
+}
+
+static double
+vec_todouble (const_t c)
+{
+  vec_need_numeric (&c);
+
+  switch (c.type)
+    {
+    case CONST_INT:
+      return c.v.c_int.v;
+    case CONST_FLOAT:
+      return c.v.c_float.v;
+    default:
+      break;
+    }
+
+  return c.v.c_bool.v != 0;
+}
+
+SF_API const_t
+sf_vec_sum (tarray_t *t)
+{
+  sf_vec_init ();
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      return vec_int (vec_k.sum_i32 (t->v.i32, t->len));
+    case TARRAY_I64:
+      return vec_int (vec_k.sum_i64 (t->v.i64, t->len));
+    case TARRAY_F64:
+      return vec_float (vec_k.sum_f64 (t->v.f64, t->len));
+    default:
+      break;
+    }
+
+  return (const_t){ .type = CONST_NONE };
+}
+
+SF_API const_t
+sf_vec_min (tarray_t *t)
+{
+  sf_vec_init ();
+
+  if (!t->len)
+    return (const_t){ .type = CONST_NONE };
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      return vec_int (vec_k.min_i32 (t->v.i32, t->len));
+    case TARRAY_I64:
+      return vec_int (vec_k.min_i64 (t->v.i64, t->len));
+    case TARRAY_F64:
+      return vec_float (vec_k.min_f64 (t->v.f64, t->len));
+    default:
+      break;
+    }
+
+  return (const_t){ .type = CONST_NONE };
+}
+
+SF_API const_t
+sf_vec_max (tarray_t *t)
+{
+  sf_vec_init ();
+
+  if (!t->len)
+    return (const_t){ .type = CONST_NONE };
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      return vec_int (vec_k.max_i32 (t->v.i32, t->len));
+    case TARRAY_I64:
+      return vec_int (vec_k.max_i64 (t->v.i64, t->len));
+    case TARRAY_F64:
+      return vec_float (vec_k.max_f64 (t->v.f64, t->len));
+    default:
+      break;
+    }
+
+  return (const_t){ .type = CONST_NONE };
+}
+
+/* returns b itself when the types already agree, a converted copy if not */
+static tarray_t *
+vec_match (tarray_t *a, tarray_t *b)
+{
+  if (a->len != b->len)
+    {
+      printf ("array length mismatch (%zu and %zu).\n", a->len, b->len);
+      exit (EXIT_FAILURE);
+    }
+
+  if (a->type == b->type)
+    return b;
+
+  tarray_t *c = sf_tarray_new (a->type, b->len);
+
+  for (size_t i = 0; i < b->len; i++)
+    sf_tarray_copyel (c, i, b, i);
+
+  return c;
+}
+
+SF_API const_t
+sf_vec_dot (tarray_t *a, tarray_t *b)
+{
+  sf_vec_init ();
+
+  tarray_t *m = vec_match (a, b);
+  const_t r = (const_t){ .type = CONST_NONE };
+
+  switch (a->type)
+    {
+    case TARRAY_I32:
+      r = vec_int (vec_k.dot_i32 (a->v.i32, m->v.i32, a->len));
+      break;
+    case TARRAY_I64:
+      r = vec_int (vec_k.dot_i64 (a->v.i64, m->v.i64, a->len));
+      break;
+    case TARRAY_F64:
+      r = vec_float (vec_k.dot_f64 (a->v.f64, m->v.f64, a->len));
+      break;
+    default:
+      break;
+    }
+
+  if (m != b)
+    sf_tarray_free (m);
+
+  return r;
+}
+
+SF_API tarray_t *
+sf_vec_scalar (int op, tarray_t *a, const_t k)
+{
+  sf_vec_init ();
+
+  double d = vec_todouble (k);
+  tarray_t *r = sf_tarray_new (a->type, a->len);
+
+  switch (a->type)
+    {
+    case TARRAY_I32:
+      (op == VEC_ADD ? vec_k.adds_i32 : vec_k.muls_i32) (
+          r->v.i32, a->v.i32, (int32_t)(int64_t)d, a->len);
+      break;
+    case TARRAY_I64:
+      (op == VEC_ADD ? vec_k.adds_i64 : vec_k.muls_i64) (
+          r->v.i64, a->v.i64, (int64_t)d, a->len);
+      break;
+    case TARRAY_F64:
+      (op == VEC_ADD ? vec_k.adds_f64 : vec_k.muls_f64) (r->v.f64, a->v.f64,
+                                                         d, a->len);
+      break;
+    default:
+      break;
+    }
+
+  return r;
+}
+
+SF_API tarray_t *
+sf_vec_elementwise (int op, tarray_t *a, tarray_t *b)
+{
+  sf_vec_init ();
+
+  tarray_t *m = vec_match (a, b);
+  tarray_t *r = sf_tarray_new (a->type, a->len);
+
+  switch (a->type)
+    {
+    case TARRAY_I32:
+      (op == VEC_ADD ? vec_k.add_i32 : vec_k.mul_i32) (r->v.i32, a->v.i32,
+                                                       m->v.i32, a->len);
+      break;
+    case TARRAY_I64:
+      (op == VEC_ADD ? vec_k.add_i64 : vec_k.mul_i64) (r->v.i64, a->v.i64,
+                                                       m->v.i64, a->len);
+      break;
+    case TARRAY_F64:
+      (op == VEC_ADD ? vec_k.add_f64 : vec_k.mul_f64) (r->v.f64, a->v.f64,
+                                                       m->v.f64, a->len);
+      break;
+    default:
+      break;
+    }
+
+  if (m != b)
+    sf_tarray_free (m);
+
+  return r;
+}
+
+/**
+ * Integer arrays compared against an arbitrary number: rewrite the
+ * predicate so it runs on integer lanes. Returns 0 when the answer does
+ * not depend on the elements, with *all saying whether every one passes.
+ */
+static int
+vec_intpred (int *cmp, double d, int64_t lo, int64_t hi, int64_t *k,
+             int *all)
+{
+  if (d != d)
+    {
+      *all = *cmp == VEC_NE;
+      return 0;
+    }
+
+  if (d < (double)lo)
+    {
+      *all = *cmp == VEC_GT || *cmp == VEC_GE || *cmp == VEC_NE;
+      return 0;
+    }
+
+  if (d >= (double)hi + 1.0)
+    {
+      *all = *cmp == VEC_LT || *cmp == VEC_LE || *cmp == VEC_NE;
+      return 0;
+    }
+
+  int64_t f = (int64_t)d;
+
+  if ((double)f > d)
+    f--;
+
+  if ((double)f != d)
+    {
+      /* x < 2.5 is x <= 2, x >= 2.5 is x > 2 */
+      switch (*cmp)
+        {
+        case VEC_EQ:
+        case VEC_NE:
+          *all = *cmp == VEC_NE;
+          return 0;
+        case VEC_LT:
+        case VEC_LE:
+          *cmp = VEC_LE;
+          break;
+        default:
+          *cmp = VEC_GT;
+          break;
+        }
+    }
+
+  *k = f;
+  return 1;
+}
+
+SF_API size_t
+sf_vec_count (tarray_t *t, int cmp, const_t k)
+{
+  sf_vec_init ();
+
+  double d = vec_todouble (k);
+  int64_t ik = 0;
+  int all = 0;
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      if (!vec_intpred (&cmp, d, INT32_MIN, INT32_MAX, &ik, &all))
+        return all ? t->len : 0;
+
+      return vec_k.count_i32 (t->v.i32, t->len, cmp, (int32_t)ik);
+
+    case TARRAY_I64:
+      if (!vec_intpred (&cmp, d, INT64_MIN, INT64_MAX, &ik, &all))
+        return all ? t->len : 0;
+
+      return vec_k.count_i64 (t->v.i64, t->len, cmp, ik);
+
+    case TARRAY_F64:
+      return vec_k.count_f64 (t->v.f64, t->len, cmp, d);
+
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+SF_API tarray_t *
+sf_vec_filter (tarray_t *t, int cmp, const_t k)
+{
+  sf_vec_init ();
+
+  double d = vec_todouble (k);
+  int64_t ik = 0;
+  int all = 0;
+  size_t w = 0;
+
+  tarray_t *r = sf_tarray_new (t->type, t->len);
+
+  switch (t->type)
+    {
+    case TARRAY_I32:
+      if (!vec_intpred (&cmp, d, INT32_MIN, INT32_MAX, &ik, &all))
+        {
+          if (all)
+            memcpy (r->v.raw, t->v.raw, t->len * sizeof (int32_t));
+
+          w = all ? t->len : 0;
+          break;
+        }
+
+      w = vec_k.filter_i32 (r->v.i32, t->v.i32, t->len, cmp, (int32_t)ik);
+      break;
+
+    case TARRAY_I64:
+      if (!vec_intpred (&cmp, d, INT64_MIN, INT64_MAX, &ik, &all))
+        {
+          if (all)
+            memcpy (r->v.raw, t->v.raw, t->len * sizeof (int64_t));
+
+          w = all ? t->len : 0;
+          break;
+        }
+
+      w = vec_k.filter_i64 (r->v.i64, t->v.i64, t->len, cmp, ik);
+      break;
+
+    case TARRAY_F64:
+      w = vec_k.filter_f64 (r->v.f64, t->v.f64, t->len, cmp, d);
+      break;
+
+    default:
+      break;
+    }
+
+  r->len = w;
+  return r;
+}
@@ -0,0 +1,63 @@
+#if !defined(VEC_H)
+#define VEC_H
+
+#include "const.h"
+#include "header.h"
+#include "malloc.h"
+#include "tarray.h"
+
+/**
+ * Bulk kernels over typed arrays. Every kernel has a scalar version,
+ * x86 builds add SSE2 and AVX2 versions which are picked once at
+ * startup from what the CPU reports (SF_VEC=scalar|sse2|avx2 caps it).
+ */
+enum VecLevel
+{
+  VEC_LEVEL_SCALAR = 0,
+  VEC_LEVEL_SSE2 = 1,
+  VEC_LEVEL_AVX2 = 2,
+};
+
+enum VecOp
+{
+  VEC_ADD = 0,
+  VEC_MUL = 1,
+};
+
+enum VecCmp
+{
+  VEC_LT = 0,
+  VEC_LE = 1,
+  VEC_GT = 2,
+  VEC_GE = 3,
+  VEC_EQ = 4,
+  VEC_NE = 5,
+};
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API void sf_vec_init (void);
+  SF_API int sf_vec_level (void);
+  SF_API void sf_vec_setlevel (int);
+  SF_API const char *sf_vec_levelname (int);
+  SF_API int sf_vec_cmp_fromstr (const char *);
+
+  SF_API const_t sf_vec_sum (tarray_t *);
+  SF_API const_t sf_vec_min (tarray_t *);
+  SF_API const_t sf_vec_max (tarray_t *);
+  SF_API const_t sf_vec_dot (tarray_t *, tarray_t *);
+
+  SF_API tarray_t *sf_vec_scalar (int, tarray_t *, const_t);
+  SF_API tarray_t *sf_vec_elementwise (int, tarray_t *, tarray_t *);
+
+  SF_API size_t sf_vec_count (tarray_t *, int, const_t);
+  SF_API tarray_t *sf_vec_filter (tarray_t *, int, const_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // VEC_H
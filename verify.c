@@ -0,0 +1,348 @@
+#include "verify.h"
+
+SF_API int
+sf_verify_parse (const char *s, int on)
+{
+  if (s == NULL)
+    return on;
+
+  if (!strcmp (s, "off") || !strcmp (s, "0"))
+    return 0;
+
+  if (!strcmp (s, "on") || !strcmp (s, "1"))
+    return 1;
+
+  fprintf (stderr, "SF_VERIFY: unknown mode '%s'\n", s);
+  return on;
+}
+
+SF_API verify_t *
+sf_verify_new (int on)
+{
+  if (!on)
+    return NULL;
+
+  verify_t *v = SFMALLOC (sizeof (*v));
+
+  v->at = NULL;
+  v->al = 0;
+
+  return v;
+}
+
+SF_API void
+sf_verify_free (verify_t *v)
+{
+  if (v == NULL)
+    return;
+
+  SFFREE (v->at);
+  SFFREE (v);
+}
+
+/**
+ * What in takes off the stack and leaves there when it goes on to the
+ * next instruction, in pop and push. Returns 0 for class bodies, whose
+ * code runs in a frame of its own, and for ops codegen never emits.
+ */
+SF_API int
+sf_verify_effect (instr_t in, int *pop, int *push)
+{
+  *pop = 0;
+  *push = 0;
+
+  switch (in.op)
+    {
+    case OP_LOAD_CONST:
+    case OP_LOAD_FAST:
+    case OP_LOAD:
+    case OP_LOAD_NAME:
+    case OP_LOAD_FUNC_CODED:
+    case OP_IMPORT:
+    case OP_LOAD_I:
+    case OP_CONST_I:
+      *push = 1;
+      break;
+
+    case OP_STORE:
+    case OP_STORE_FAST:
+    case OP_JUMP_IF_FALSE:
+    case OP_STORE_I:
+    case OP_GUARD_FN:
+      *pop = 1;
+      break;
+
+    case OP_STORE_NAME:
+      *pop = in.b == 1 ? 2 : 1;
+      break;
+
+    case OP_STORE_SQR:
+      *pop = 3;
+      break;
+
+    case OP_CALL:
+      *pop = in.a + 1;
+      *push = in.b == 1;
+      break;
+
+    case OP_TAIL_CALL:
+      *pop = in.a + 1;
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_CMP:
+    case OP_SQR_ACCESS:
+    case OP_ADD_I:
+    case OP_SUB_I:
+    case OP_MUL_I:
+    case OP_CMP_I:
+      *pop = 2;
+      *push = 1;
+      break;
+
+    case OP_CMP_JUMP:
+    case OP_CMP_JUMP_I:
+      *pop = 2;
+      break;
+
+    case OP_ADD_1:
+    case OP_ADD_1_I:
+    case OP_DOT_ACCESS:
+    case OP_GET_ITER:
+    case OP_GUARD_METHOD:
+      *pop = 1;
+      *push = 1;
+      break;
+
+    case OP_DUP:
+    case OP_DUP_I:
+      *pop = 1;
+      *push = 2;
+      break;
+
+    case OP_RETURN:
+      /* RETURN 0 pushes the none it returns */
+      *pop = in.a == 1;
+      *push = in.a != 1;
+      break;
+
+    case OP_LOAD_ARRAY:
+      *pop = in.a;
+      *push = 1;
+      break;
+
+    case OP_LOAD_DICT:
+      *pop = 2 * in.a;
+      *push = 1;
+      break;
+
+    case OP_SLICE:
+      *pop = 1 + !!(in.a & 1) + !!(in.a & 2) + !!(in.a & 4);
+      *push = 1;
+      break;
+
+    case OP_RANGE_FAST:
+      *push = in.a < in.b;
+      break;
+
+    case OP_LOAD_ITER_NEXT:
+      *pop = 1;
+      *push = 1 + in.b;
+      break;
+
+    case OP_JUMP:
+      break;
+
+    default:
+      return 0;
+    }
+
+  return *pop >= 0 && *push >= 0;
+}
+
+typedef struct
+{
+  int depth; /* -1 until a path gets there */
+  uint64_t iters; /* which entries are iterators */
+
+} vstate_t;
+
+static int
+v_falls (instr_t in)
+{
+  return in.op != OP_JUMP && in.op != OP_RETURN && in.op != OP_TAIL_CALL;
+}
+
+/* the ip in can jump to, or -1 */
+static long
+v_jump (instr_t in)
+{
+  switch (in.op)
+    {
+    case OP_JUMP:
+    case OP_JUMP_IF_FALSE:
+    case OP_CMP_JUMP:
+    case OP_CMP_JUMP_I:
+    case OP_LOAD_ITER_NEXT:
+    case OP_GUARD_FN:
+    case OP_GUARD_METHOD:
+      return in.a;
+    default:
+      return -1;
+    }
+}
+
+/* s with entries from p up taken off */
+static uint64_t
+v_below (uint64_t s, int p)
+{
+  return p >= 64 ? s : s & ((UINT64_C (1) << p) - 1);
+}
+
+/* s at k goes to to, queued if it is the first to get there */
+static int
+v_reach (vstate_t *st, size_t *work, size_t *wl, size_t to, vstate_t s)
+{
+  if (st[to].depth < 0)
+    {
+      st[to] = s;
+      work[(*wl)++] = to;
+      return 1;
+    }
+
+  return st[to].depth == s.depth && st[to].iters == s.iters;
+}
+
+static int
+v_walk (vm_t *vm, size_t lp, size_t end, verify_fn_t *vf)
+{
+  const instr_t *in = vm->insts + lp;
+  size_t n = end - lp, wl = 0;
+  vstate_t *st = SFMALLOC (n * sizeof (*st));
+  size_t *work = SFMALLOC (n * sizeof (*work));
+  int ok = 1;
+
+  for (size_t k = 0; k < n; k++)
+    st[k].depth = -1;
+
+  st[0] = (vstate_t){ .depth = vm->insts[end].b, .iters = 0 };
+  work[wl++] = 0;
+  vf->depth = st[0].depth;
+  vf->nl = 0;
+
+  while (wl && ok)
+    {
+      size_t k = work[--wl];
+      instr_t i = in[k];
+      vstate_t s = st[k];
+      int pop, push;
+
+      /* names live in class frames, and an unpacking for loop pushes
+         what the value holds */
+      if (!sf_verify_effect (i, &pop, &push) || s.depth < pop
+          || s.depth - pop + push > SF_VERIFY_DEPTH || i.op == OP_LOAD_NAME
+          || (i.op == OP_STORE_NAME && i.b != 1)
+          || (i.op == OP_LOAD_ITER_NEXT && i.b != 1))
+        {
+          ok = 0;
+          break;
+        }
+
+      /* slots a fresh frame already has */
+      if (i.op == OP_LOAD_FAST || i.op == OP_STORE_FAST)
+        {
+          if (i.a < 0 || i.a >= SF_FRAME_LOCALS_CAP)
+            ok = 0;
+          else if (i.b == 0 && i.a + 1 > vf->nl)
+            vf->nl = i.a + 1;
+        }
+
+      if ((i.op == OP_LOAD_I || i.op == OP_STORE_I)
+          && (i.a < 0 || i.a >= SF_FRAME_INTS))
+        ok = 0;
+
+      /* an iterator is only ever taken by LOAD_ITER_NEXT, a DUP copies
+         it along */
+      int base = s.depth - pop;
+      uint64_t taken = s.iters & ~v_below (s.iters, base);
+
+      if (i.op == OP_LOAD_ITER_NEXT)
+        ok = ok && taken == UINT64_C (1) << base;
+      else if (i.op != OP_DUP)
+        ok = ok && !taken;
+
+      if (!ok)
+        break;
+
+      vstate_t next = { .depth = base + push,
+                        .iters = v_below (s.iters, base) };
+
+      if (i.op == OP_GET_ITER || i.op == OP_LOAD_ITER_NEXT)
+        next.iters |= UINT64_C (1) << base;
+      else if (i.op == OP_DUP && taken)
+        next.iters |= UINT64_C (3) << base;
+
+      if (next.depth > vf->depth)
+        vf->depth = next.depth;
+
+      if (v_falls (i))
+        {
+          /* IMPORT takes the IMPORT_ALIAS after it along */
+          size_t to = k + (i.op == OP_IMPORT ? 2 : 1);
+
+          if (to >= n || !v_reach (st, work, &wl, to, next))
+            ok = 0;
+        }
+
+      long j = v_jump (i);
+
+      if (ok && j >= 0)
+        {
+          /* the jump takes the ops' operands, not what they push */
+          vstate_t js = s;
+
+          if (i.op == OP_JUMP_IF_FALSE || i.op == OP_LOAD_ITER_NEXT)
+            js = (vstate_t){ .depth = base,
+                             .iters = v_below (s.iters, base) };
+          else if (i.op == OP_CMP_JUMP || i.op == OP_CMP_JUMP_I)
+            js = next;
+
+          if ((size_t)j < lp || (size_t)j >= end
+              || !v_reach (st, work, &wl, (size_t)j - lp, js))
+            ok = 0;
+        }
+    }
+
+  SFFREE (work);
+  SFFREE (st);
+
+  return ok;
+}
+
+/**
+ * Verifies the body at [lp, end), a coded function whose
+ * OP_LOAD_FUNC_CODED is at end, once. Returns whether it passed.
+ */
+SF_API int
+sf_verify_func (vm_t *vm, size_t lp, size_t end)
+{
+  verify_t *v = vm->verify;
+
+  if (lp >= v->al)
+    {
+      size_t al = v->al;
+
+      v->al = vm->inst_len > lp ? vm->inst_len : lp + 1;
+      v->at = SFREALLOC (v->at, v->al * sizeof (*v->at));
+      memset (v->at + al, 0, (v->al - al) * sizeof (*v->at));
+    }
+
+  verify_fn_t *vf = &v->at[lp];
+
+  if (vf->ok == 0)
+    vf->ok = end > lp && v_walk (vm, lp, end, vf) ? 1 : -1;
+
+  return vf->ok == 1;
+}
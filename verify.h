@@ -0,0 +1,73 @@
+#if !defined(VERIFY_H)
+#define VERIFY_H
+
+#include "bytecode.h"
+#include "header.h"
+#include "malloc.h"
+
+/**
+ * A load-time verifier for coded functions. OP_LOAD_FUNC_CODED hands
+ * it each body the first time the definition runs, after the passes.
+ * It walks every path from the entry, the arguments on the stack, and
+ * proves that:
+ *
+ *   - the stack depth at each instruction is the same on all paths and
+ *     never goes below what the instruction pops;
+ *   - locals and int slots are inside what a fresh frame has room for;
+ *   - jumps land inside the body and no path falls off its end;
+ *   - only LOAD_ITER_NEXT ever takes an iterator, and what it takes is
+ *     always one GET_ITER made.
+ *
+ * Bodies that pass run in the interpreter without the stack underflow
+ * and overflow checks, the frame's locals growth checks and the
+ * iterator assert (see vm_step's checked argument). What cannot be
+ * proved from the code, like a callee's arity, is still checked there.
+ * Bodies that do not pass, those of class bodies, name lookups and
+ * anything the walk does not know, run on the checked loop.
+ * $SF_VERIFY=off turns the verifier off.
+ */
+typedef struct
+{
+  int ok;    /* 1 passed, -1 did not, 0 not seen */
+  int nl;    /* locals it uses */
+  int depth; /* most stack entries it has above the frame's base */
+
+} verify_fn_t;
+
+typedef struct _verify_s
+{
+  verify_fn_t *at; /* ip of a body's first instruction -> the body */
+  size_t al;
+
+} verify_t;
+
+/* deepest stack a verified body may have, one bit per entry */
+#define SF_VERIFY_DEPTH (64)
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API verify_t *sf_verify_new (int);
+  SF_API void sf_verify_free (verify_t *);
+  SF_API int sf_verify_parse (const char *, int);
+
+  SF_API int sf_verify_effect (instr_t, int *, int *);
+  SF_API int sf_verify_func (vm_t *, size_t, size_t);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+/* the body starting at ip if it passed, NULL otherwise */
+static inline const verify_fn_t *
+sf_verify_get (const verify_t *v, size_t ip)
+{
+  if (v == NULL || ip >= v->al || v->at[ip].ok != 1)
+    return NULL;
+
+  return &v->at[ip];
+}
+
+#endif // VERIFY_H
@@ -0,0 +1,166 @@
+#include "view.h"
+#include "object.h"
+
+SF_API view_t *
+sf_view_new (struct object_s *p, size_t off, size_t len, ptrdiff_t stride)
+{
+  /* a view of a view points at the underlying array directly */
+  if (p->type == OBJ_VIEW)
+    {
+      view_t *pv = p->v.o_view.v;
+
+      off = pv->off + off * pv->stride;
+      stride *= pv->stride;
+      p = pv->parent;
+    }
+
+  assert (p->type == OBJ_ARRAY || p->type == OBJ_TARRAY);
+
+  view_t *v = SFMALLOC (sizeof (*v));
+  v->parent = p;
+  v->off = len ? off : 0;
+  v->len = len;
+  v->stride = stride;
+
+  IR (p);
+  return v;
+}
+
+SF_API void
+sf_view_free (view_t *v, struct _vm_s *vm)
+{
+  DR (v->parent, vm);
+  SFFREE (v);
+}
+
+SF_API size_t
+sf_view_plen (struct object_s *p)
+{
+  switch (p->type)
+    {
+    case OBJ_ARRAY:
+      return p->v.o_array.v->len;
+
+    case OBJ_TARRAY:
+      return p->v.o_tarray.v->len;
+
+    case OBJ_VIEW:
+      return p->v.o_view.v->len;
+
+    default:
+      break;
+    }
+
+  printf ("object is not sliceable.\n");
+  exit (EXIT_FAILURE);
+}
+
+/**
+ * Python slice rules: negative bounds count from the end, out of range
+ * bounds are clamped, a missing bound (NULL) runs to the matching end.
+ */
+SF_API void
+sf_view_bounds (size_t plen, const int64_t *lo, const int64_t *hi,
+                int64_t step, size_t *off, size_t *len)
+{
+  int64_t n = (int64_t)plen;
+  int64_t l, h;
+
+  if (!step)
+    {
+      printf ("slice step cannot be zero.\n");
+      exit (EXIT_FAILURE);
+    }
+
+  if (step > 0)
+    {
+      l = lo == NULL ? 0 : *lo < 0 ? *lo + n : *lo;
+      h = hi == NULL ? n : *hi < 0 ? *hi + n : *hi;
+
+      l = l < 0 ? 0 : l > n ? n : l;
+      h = h < 0 ? 0 : h > n ? n : h;
+
+      *len = h > l ? (h - l + step - 1) / step : 0;
+    }
+  else
+    {
+      l = lo == NULL ? n - 1 : *lo < 0 ? *lo + n : *lo;
+      h = hi == NULL ? -1 : *hi < 0 ? *hi + n : *hi;
+
+      l = l < -1 ? -1 : l > n - 1 ? n - 1 : l;
+      h = h < -1 ? -1 : h > n - 1 ? n - 1 : h;
+
+      *len = l > h ? (l - h - step - 1) / -step : 0;
+    }
+
+  *off = *len ? (size_t)l : 0;
+}
+
+SF_API size_t
+sf_view_idx (view_t *v, size_t i)
+{
+  return (size_t)((ptrdiff_t)v->off + (ptrdiff_t)i * v->stride);
+}
+
+SF_API struct object_s *
+sf_view_get (view_t *v, size_t i)
+{
+  size_t j = sf_view_idx (v, i);
+
+  if (v->parent->type == OBJ_TARRAY)
+    return sf_tarray_box (v->parent->v.o_tarray.v, j);
+
+  return v->parent->v.o_array.v->vals[j];
+}
+
+/* zero-copy typed array over a unit-stride view, NULL if there is none */
+SF_API tarray_t *
+sf_view_tarray (view_t *v)
+{
+  if (v->parent->type != OBJ_TARRAY || (v->stride != 1 && v->len > 1))
+    return NULL;
+
+  tarray_t *t = v->parent->v.o_tarray.v;
+
+  return sf_tarray_alias (t->type,
+                          (char *)t->v.raw
+                              + v->off * sf_tarray_elsize (t->type),
+                          v->len);
+}
+
+SF_API void
+sf_view_materialize (struct object_s *o, struct _vm_s *vm)
+{
+  assert (o->type == OBJ_VIEW);
+  view_t *v = o->v.o_view.v;
+
+  if (v->parent->type == OBJ_TARRAY)
+    {
+      tarray_t *p = v->parent->v.o_tarray.v;
+      tarray_t *t = sf_tarray_new (p->type, v->len);
+      size_t es = sf_tarray_elsize (p->type);
+
+      for (size_t i = 0; i < v->len; i++)
+        memcpy ((char *)t->v.raw + i * es,
+                (char *)p->v.raw + sf_view_idx (v, i) * es, es);
+
+      sf_view_free (v, vm);
+      o->type = OBJ_TARRAY;
+      o->v.o_tarray.v = t;
+    }
+  else
+    {
+      array_t *p = v->parent->v.o_array.v;
+      array_t *a = sf_array_withsize (v->len);
+
+      for (size_t i = 0; i < v->len; i++)
+        {
+          a->vals[i] = p->vals[sf_view_idx (v, i)];
+          IR (a->vals[i]);
+        }
+
+      sf_view_free (v, vm);
+      o->type = OBJ_ARRAY;
+      o->v.o_array.v = a;
+    }
+}
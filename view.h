@@ -0,0 +1,46 @@
+#if !defined(VIEW_H)
+#define VIEW_H
+
+#include "header.h"
+#include "malloc.h"
+#include "tarray.h"
+
+/**
+ * A view is what a[lo:hi:step] evaluates to: a window into an array or
+ * typed array that shares the parent's storage. Reads go straight to
+ * the parent, writing through a view first materializes it into its
+ * own array so the parent is never modified.
+ */
+struct object_s;
+struct _vm_s;
+typedef struct __view_s
+{
+  struct object_s *parent; /* OBJ_ARRAY or OBJ_TARRAY, never a view */
+  size_t off;
+  size_t len;
+  ptrdiff_t stride;
+
+} view_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif // __cplusplus
+
+  SF_API view_t *sf_view_new (struct object_s *, size_t, size_t, ptrdiff_t);
+  SF_API void sf_view_free (view_t *, struct _vm_s *);
+
+  SF_API size_t sf_view_plen (struct object_s *);
+  SF_API void sf_view_bounds (size_t, const int64_t *, const int64_t *,
+                              int64_t, size_t *, size_t *);
+
+  SF_API size_t sf_view_idx (view_t *, size_t);
+  SF_API struct object_s *sf_view_get (view_t *, size_t);
+  SF_API tarray_t *sf_view_tarray (view_t *);
+  SF_API void sf_view_materialize (struct object_s *, struct _vm_s *);
+
+#if defined(__cplusplus)
+}
+#endif // __cplusplus
+
+#endif // VIEW_H